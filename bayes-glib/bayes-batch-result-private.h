@@ -0,0 +1,43 @@
+/* bayes-batch-result-private.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BAYES_BATCH_RESULT_PRIVATE_H
+#define BAYES_BATCH_RESULT_PRIVATE_H
+
+#include "bayes-batch-result.h"
+
+G_BEGIN_DECLS
+
+struct _BayesBatchResult
+{
+   volatile gint ref_count;
+   guint n_documents;
+   guint n_classes;
+   gchar **class_names;
+   gint *best;
+   gdouble *scores;
+};
+
+G_GNUC_INTERNAL
+BayesBatchResult *_bayes_batch_result_new (gchar **class_names,
+                                           guint   n_documents);
+
+G_END_DECLS
+
+#endif /* BAYES_BATCH_RESULT_PRIVATE_H */
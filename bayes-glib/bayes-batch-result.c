@@ -0,0 +1,300 @@
+/* bayes-batch-result.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "bayes-batch-result.h"
+#include "bayes-batch-result-private.h"
+
+/**
+ * SECTION:bayes-batch-result
+ * @title: BayesBatchResult
+ * @short_description: Compact results of guessing many documents.
+ * @see_also: bayes_classifier_guess_batch()
+ *
+ * #BayesBatchResult contains the result of classifying a batch of
+ * documents with bayes_classifier_guess_batch(). Rather than a list of
+ * #BayesGuess per document, it holds a single table of classification
+ * names, the index of the best classification for every document and a
+ * packed matrix of the score of every classification for every document.
+ *
+ * The #BayesBatchResult structure is a reference counted #GBoxed type.
+ * You can reference the structure with bayes_batch_result_ref() and free
+ * the structure with bayes_batch_result_unref().
+ */
+
+/**
+ * _bayes_batch_result_new:
+ * @class_names: (in) (transfer full): The classification names.
+ * @n_documents: (in): The number of documents.
+ *
+ * Creates a new #BayesBatchResult with room for the scores of
+ * @n_documents documents. The best classification of every document is
+ * initialized to -1 and every score to 0.0.
+ *
+ * Returns: (transfer full): A newly allocated #BayesBatchResult.
+ */
+BayesBatchResult *
+_bayes_batch_result_new (gchar **class_names,
+                         guint   n_documents)
+{
+   BayesBatchResult *result;
+   guint i;
+
+   g_return_val_if_fail(class_names, NULL);
+
+   result = g_slice_new0(BayesBatchResult);
+   result->ref_count = 1;
+   result->class_names = class_names;
+   result->n_classes = g_strv_length(class_names);
+   result->n_documents = n_documents;
+   result->best = g_new(gint, MAX(n_documents, 1));
+   result->scores = g_new0(gdouble,
+                           MAX((gsize)n_documents * result->n_classes, 1));
+
+   for (i = 0; i < n_documents; i++) {
+      result->best[i] = -1;
+   }
+
+   return result;
+}
+
+/**
+ * bayes_batch_result_ref:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Increments the reference count of @result by one.
+ *
+ * Returns: The instance provided, @result.
+ */
+BayesBatchResult *
+bayes_batch_result_ref (BayesBatchResult *result)
+{
+   g_return_val_if_fail(result != NULL, NULL);
+   g_return_val_if_fail(result->ref_count > 0, NULL);
+
+   g_atomic_int_inc(&result->ref_count);
+   return result;
+}
+
+/**
+ * bayes_batch_result_unref:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Decrements the reference count of @result by one. Once the reference
+ * count reaches zero, the structure and allocated resources are released.
+ */
+void
+bayes_batch_result_unref (BayesBatchResult *result)
+{
+   g_return_if_fail(result != NULL);
+   g_return_if_fail(result->ref_count > 0);
+
+   if (g_atomic_int_dec_and_test(&result->ref_count)) {
+      g_strfreev(result->class_names);
+      g_free(result->best);
+      g_free(result->scores);
+      g_slice_free(BayesBatchResult, result);
+   }
+}
+
+/**
+ * bayes_batch_result_get_n_documents:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Retrieves the number of documents that were classified.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_batch_result_get_n_documents (BayesBatchResult *result)
+{
+   g_return_val_if_fail(result, 0);
+   return result->n_documents;
+}
+
+/**
+ * bayes_batch_result_get_n_classes:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Retrieves the number of classifications every document was scored
+ * against.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_batch_result_get_n_classes (BayesBatchResult *result)
+{
+   g_return_val_if_fail(result, 0);
+   return result->n_classes;
+}
+
+/**
+ * bayes_batch_result_get_class_names:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Retrieves the names of the classifications. The class indexes used by
+ * bayes_batch_result_get_best() and bayes_batch_result_get_score() are
+ * indexes into this array.
+ *
+ * Returns: (transfer none) (array zero-terminated=1): The class names.
+ */
+const gchar * const *
+bayes_batch_result_get_class_names (BayesBatchResult *result)
+{
+   g_return_val_if_fail(result, NULL);
+   return (const gchar * const *)result->class_names;
+}
+
+/**
+ * bayes_batch_result_get_best:
+ * @result: (in): A #BayesBatchResult.
+ * @document: (in): The index of the document.
+ *
+ * Retrieves the index of the most probable classification of @document.
+ *
+ * Returns: A class index or -1 if @document contained no tokens.
+ */
+gint
+bayes_batch_result_get_best (BayesBatchResult *result,
+                             guint             document)
+{
+   g_return_val_if_fail(result, -1);
+   g_return_val_if_fail(document < result->n_documents, -1);
+
+   return result->best[document];
+}
+
+/**
+ * bayes_batch_result_get_best_name:
+ * @result: (in): A #BayesBatchResult.
+ * @document: (in): The index of the document.
+ *
+ * Retrieves the name of the most probable classification of @document.
+ *
+ * Returns: A string which should not be modified or freed, or %NULL.
+ */
+const gchar *
+bayes_batch_result_get_best_name (BayesBatchResult *result,
+                                  guint             document)
+{
+   gint best;
+
+   g_return_val_if_fail(result, NULL);
+   g_return_val_if_fail(document < result->n_documents, NULL);
+
+   best = result->best[document];
+   return (best >= 0) ? result->class_names[best] : NULL;
+}
+
+/**
+ * bayes_batch_result_get_score:
+ * @result: (in): A #BayesBatchResult.
+ * @document: (in): The index of the document.
+ * @class_index: (in): The index of the classification.
+ *
+ * Retrieves the probability that @document is of the classification
+ * found at @class_index in bayes_batch_result_get_class_names().
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_batch_result_get_score (BayesBatchResult *result,
+                              guint             document,
+                              guint             class_index)
+{
+   g_return_val_if_fail(result, 0.0);
+   g_return_val_if_fail(document < result->n_documents, 0.0);
+   g_return_val_if_fail(class_index < result->n_classes, 0.0);
+
+   return result->scores[(gsize)document * result->n_classes + class_index];
+}
+
+/**
+ * bayes_batch_result_get_best_bytes:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Retrieves the most probable classification of every document as a
+ * packed array of #BayesBatchEntry, one per document. This is meant for
+ * language bindings, which can then read the whole result at once, for
+ * example with numpy.frombuffer(), instead of calling
+ * bayes_batch_result_get_best() for each document.
+ *
+ * Returns: (transfer full): A #GBytes.
+ */
+GBytes *
+bayes_batch_result_get_best_bytes (BayesBatchResult *result)
+{
+   BayesBatchEntry *entries;
+   guint i;
+
+   g_return_val_if_fail(result, NULL);
+
+   entries = g_new0(BayesBatchEntry, result->n_documents);
+
+   for (i = 0; i < result->n_documents; i++) {
+      entries[i].class_index = result->best[i];
+      if (result->best[i] >= 0) {
+         entries[i].score =
+            result->scores[(gsize)i * result->n_classes + result->best[i]];
+      }
+   }
+
+   return g_bytes_new_take(entries,
+                           sizeof(BayesBatchEntry) * result->n_documents);
+}
+
+/**
+ * bayes_batch_result_get_scores_bytes:
+ * @result: (in): A #BayesBatchResult.
+ *
+ * Retrieves the score of every classification for every document as a
+ * packed row-major matrix of native doubles, with one row per document
+ * and one column per classification.
+ *
+ * The bytes are not copied. They keep @result alive until released.
+ *
+ * Returns: (transfer full): A #GBytes.
+ */
+GBytes *
+bayes_batch_result_get_scores_bytes (BayesBatchResult *result)
+{
+   g_return_val_if_fail(result, NULL);
+
+   return g_bytes_new_with_free_func(result->scores,
+                                     sizeof(gdouble) *
+                                     (gsize)result->n_documents *
+                                     result->n_classes,
+                                     (GDestroyNotify)bayes_batch_result_unref,
+                                     bayes_batch_result_ref(result));
+}
+
+GType
+bayes_batch_result_get_type (void)
+{
+   static gsize initialized = FALSE;
+   static GType type_id;
+
+   if (g_once_init_enter(&initialized)) {
+      type_id = g_boxed_type_register_static("BayesBatchResult",
+                                             (GBoxedCopyFunc)bayes_batch_result_ref,
+                                             (GBoxedFreeFunc)bayes_batch_result_unref);
+      g_once_init_leave(&initialized, TRUE);
+   }
+
+   return type_id;
+}
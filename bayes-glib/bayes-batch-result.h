@@ -0,0 +1,71 @@
+/* bayes-batch-result.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef BAYES_BATCH_RESULT_H
+#define BAYES_BATCH_RESULT_H
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_BATCH_RESULT (bayes_batch_result_get_type())
+
+typedef struct _BayesBatchResult BayesBatchResult;
+typedef struct _BayesBatchEntry  BayesBatchEntry;
+
+/**
+ * BayesBatchEntry:
+ * @class_index: The index of the best classification or -1.
+ * @score: The score of the best classification.
+ *
+ * #BayesBatchEntry is the most probable classification of a single
+ * document as packed by bayes_batch_result_get_best_bytes(). Each entry
+ * is 16 bytes in native byte order: a 32-bit signed integer, 4 bytes of
+ * padding and a 64-bit double, that is "i4xd" for Python's struct module.
+ */
+struct _BayesBatchEntry
+{
+   gint32  class_index;
+
+   /*< private >*/
+   guint32 padding;
+
+   /*< public >*/
+   gdouble score;
+};
+
+gint                 bayes_batch_result_get_best         (BayesBatchResult *result,
+                                                          guint             document);
+GBytes              *bayes_batch_result_get_best_bytes   (BayesBatchResult *result);
+const gchar         *bayes_batch_result_get_best_name    (BayesBatchResult *result,
+                                                          guint             document);
+const gchar * const *bayes_batch_result_get_class_names  (BayesBatchResult *result);
+guint                bayes_batch_result_get_n_classes    (BayesBatchResult *result);
+guint                bayes_batch_result_get_n_documents  (BayesBatchResult *result);
+gdouble              bayes_batch_result_get_score        (BayesBatchResult *result,
+                                                          guint             document,
+                                                          guint             class_index);
+GBytes              *bayes_batch_result_get_scores_bytes (BayesBatchResult *result);
+GType                bayes_batch_result_get_type         (void) G_GNUC_CONST;
+BayesBatchResult    *bayes_batch_result_ref              (BayesBatchResult *result);
+void                 bayes_batch_result_unref            (BayesBatchResult *result);
+
+G_END_DECLS
+
+#endif /* BAYES_BATCH_RESULT_H */
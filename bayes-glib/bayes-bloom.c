@@ -0,0 +1,147 @@
+/* bayes-bloom.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "bayes-bloom.h"
+
+struct _BayesBloom
+{
+   guint64  *blocks;    /* n_blocks * BAYES_BLOOM_BLOCK_WORDS, aligned */
+   gpointer  allocated;
+   guint64   n_blocks;
+   guint     n_hashes;
+   guint     n_items;
+};
+
+/*
+ * Creates a filter sized so that after @capacity fingerprints have been
+ * added, a fingerprint that was not added is reported with a probability
+ * of about @false_positive_rate.
+ */
+BayesBloom *
+_bayes_bloom_new (guint   capacity,
+                  gdouble false_positive_rate)
+{
+   BayesBloom *bloom;
+   gdouble n_bits;
+   gsize offset;
+
+   g_return_val_if_fail(capacity > 0, NULL);
+   g_return_val_if_fail(false_positive_rate > 0.0, NULL);
+   g_return_val_if_fail(false_positive_rate < 1.0, NULL);
+
+   n_bits = ceil(-(gdouble)capacity * log(false_positive_rate) /
+                 (G_LN2 * G_LN2));
+
+   bloom = g_slice_new0(BayesBloom);
+   bloom->n_blocks = ((guint64)n_bits + BAYES_BLOOM_BLOCK_BITS - 1) /
+                     BAYES_BLOOM_BLOCK_BITS;
+   bloom->n_hashes = MAX(1, (guint)floor(n_bits / capacity * G_LN2 + 0.5));
+
+   /*
+    * Align the blocks to cache lines so each is read in one access.
+    */
+   bloom->allocated = g_malloc0((bloom->n_blocks + 1) * BAYES_BLOOM_BLOCK_SIZE);
+   offset = (guintptr)bloom->allocated % BAYES_BLOOM_BLOCK_SIZE;
+   bloom->blocks = (guint64 *)((guint8 *)bloom->allocated +
+                               (offset ? BAYES_BLOOM_BLOCK_SIZE - offset : 0));
+
+   return bloom;
+}
+
+void
+_bayes_bloom_add (BayesBloom             *bloom,
+                  const BayesFingerprint *fingerprint)
+{
+   g_return_if_fail(bloom);
+   g_return_if_fail(fingerprint);
+
+   _bayes_bloom_set(bloom->blocks, bloom->n_blocks, bloom->n_hashes,
+                    fingerprint);
+   bloom->n_items++;
+}
+
+gboolean
+_bayes_bloom_contains (BayesBloom             *bloom,
+                       const BayesFingerprint *fingerprint)
+{
+   g_return_val_if_fail(bloom, FALSE);
+   g_return_val_if_fail(fingerprint, FALSE);
+
+   return _bayes_bloom_test(bloom->blocks, bloom->n_blocks, bloom->n_hashes,
+                            fingerprint);
+}
+
+void
+_bayes_bloom_clear (BayesBloom *bloom)
+{
+   g_return_if_fail(bloom);
+
+   memset(bloom->blocks, 0, bloom->n_blocks * BAYES_BLOOM_BLOCK_SIZE);
+   bloom->n_items = 0;
+}
+
+guint
+_bayes_bloom_get_n_items (BayesBloom *bloom)
+{
+   g_return_val_if_fail(bloom, 0);
+   return bloom->n_items;
+}
+
+/*
+ * Returns the number of bytes used by @bloom.
+ */
+gsize
+_bayes_bloom_get_size (BayesBloom *bloom)
+{
+   g_return_val_if_fail(bloom, 0);
+   return sizeof *bloom + (bloom->n_blocks + 1) * BAYES_BLOOM_BLOCK_SIZE;
+}
+
+/*
+ * Returns the blocks of @bloom so that they can be saved and tested
+ * with _bayes_bloom_test() later.
+ */
+const guint64 *
+_bayes_bloom_get_blocks (BayesBloom *bloom,
+                         guint64    *n_blocks,
+                         guint      *n_hashes)
+{
+   g_return_val_if_fail(bloom, NULL);
+
+   if (n_blocks) {
+      *n_blocks = bloom->n_blocks;
+   }
+
+   if (n_hashes) {
+      *n_hashes = bloom->n_hashes;
+   }
+
+   return bloom->blocks;
+}
+
+void
+_bayes_bloom_free (BayesBloom *bloom)
+{
+   if (bloom) {
+      g_free(bloom->allocated);
+      g_slice_free(BayesBloom, bloom);
+   }
+}
@@ -0,0 +1,118 @@
+/* bayes-bloom.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_BLOOM_H
+#define BAYES_BLOOM_H
+
+#include "bayes-hash.h"
+
+G_BEGIN_DECLS
+
+/*
+ * BayesBloom is a Bloom filter of fingerprints. It may report that a
+ * fingerprint was added when it was not, but never the reverse. It is
+ * not thread-safe.
+ */
+typedef struct _BayesBloom BayesBloom;
+
+/*
+ * All the bits of a fingerprint fall within one block of 512 bits, a
+ * single cache line, chosen by the first half of the fingerprint. The
+ * bits within the block are derived from the second half (Kirsch and
+ * Mitzenmacher) rather than hashing k times. This is slightly less
+ * accurate than spreading the bits over the whole filter but costs one
+ * memory access rather than k.
+ */
+#define BAYES_BLOOM_BLOCK_BITS  512
+#define BAYES_BLOOM_BLOCK_SIZE  (BAYES_BLOOM_BLOCK_BITS / 8)
+#define BAYES_BLOOM_BLOCK_WORDS (BAYES_BLOOM_BLOCK_BITS / 64)
+
+#define BAYES_BLOOM_FOREACH_BIT(fingerprint, n_hashes, bit, i)          \
+   for (i = 0, bit = (guint32)(fingerprint)->h2 % BAYES_BLOOM_BLOCK_BITS; \
+        i < (n_hashes);                                                 \
+        i++, bit = ((guint32)(fingerprint)->h2 +                        \
+                    i * (guint32)(((fingerprint)->h2 >> 32) | 1)) %      \
+                   BAYES_BLOOM_BLOCK_BITS)
+
+static inline void
+_bayes_bloom_set (guint64                *blocks,
+                  guint64                 n_blocks,
+                  guint                   n_hashes,
+                  const BayesFingerprint *fingerprint)
+{
+   guint64 *block;
+   guint bit;
+   guint i;
+
+   block = blocks + (fingerprint->h1 % n_blocks) * BAYES_BLOOM_BLOCK_WORDS;
+
+   BAYES_BLOOM_FOREACH_BIT(fingerprint, n_hashes, bit, i) {
+      block[bit / 64] |= G_GUINT64_CONSTANT(1) << (bit % 64);
+   }
+}
+
+/*
+ * Tests @fingerprint against filter blocks that may have been saved
+ * from a #BayesBloom with _bayes_bloom_get_blocks().
+ */
+static inline gboolean
+_bayes_bloom_test (const guint64          *blocks,
+                   guint64                 n_blocks,
+                   guint                   n_hashes,
+                   const BayesFingerprint *fingerprint)
+{
+   const guint64 *block;
+   guint bit;
+   guint i;
+
+   block = blocks + (fingerprint->h1 % n_blocks) * BAYES_BLOOM_BLOCK_WORDS;
+
+   BAYES_BLOOM_FOREACH_BIT(fingerprint, n_hashes, bit, i) {
+      if (!(block[bit / 64] & (G_GUINT64_CONSTANT(1) << (bit % 64)))) {
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+G_GNUC_INTERNAL
+void           _bayes_bloom_add         (BayesBloom             *bloom,
+                                         const BayesFingerprint *fingerprint);
+G_GNUC_INTERNAL
+void           _bayes_bloom_clear       (BayesBloom             *bloom);
+G_GNUC_INTERNAL
+gboolean       _bayes_bloom_contains    (BayesBloom             *bloom,
+                                         const BayesFingerprint *fingerprint);
+G_GNUC_INTERNAL
+void           _bayes_bloom_free        (BayesBloom             *bloom);
+G_GNUC_INTERNAL
+const guint64 *_bayes_bloom_get_blocks  (BayesBloom             *bloom,
+                                         guint64                *n_blocks,
+                                         guint                  *n_hashes);
+G_GNUC_INTERNAL
+guint          _bayes_bloom_get_n_items (BayesBloom             *bloom);
+G_GNUC_INTERNAL
+gsize          _bayes_bloom_get_size    (BayesBloom             *bloom);
+G_GNUC_INTERNAL
+BayesBloom    *_bayes_bloom_new         (guint                   capacity,
+                                         gdouble                 false_positive_rate);
+
+G_END_DECLS
+
+#endif /* BAYES_BLOOM_H */
@@ -0,0 +1,63 @@
+/* bayes-classifier-private.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_CLASSIFIER_PRIVATE_H
+#define BAYES_CLASSIFIER_PRIVATE_H
+
+#include "bayes-classifier.h"
+#include "bayes-storage-memory-private.h"
+
+G_BEGIN_DECLS
+
+typedef struct _BayesClassifierSnapshot BayesClassifierSnapshot;
+
+G_GNUC_INTERNAL
+BayesCombiner             _bayes_classifier_get_combiner         (BayesClassifier          *classifier,
+                                                                  gpointer                 *user_data);
+G_GNUC_INTERNAL
+void                      _bayes_classifier_get_probabilities    (BayesClassifier          *classifier,
+                                                                  BayesClassifierSnapshot  *snapshot,
+                                                                  guint                     class_id,
+                                                                  gchar                   **tokens,
+                                                                  BayesStorageMemoryToken **resolved,
+                                                                  guint                     n_tokens,
+                                                                  gdouble                  *probs);
+G_GNUC_INTERNAL
+BayesTokenizer            _bayes_classifier_get_tokenizer        (BayesClassifier          *classifier,
+                                                                  gpointer                 *user_data);
+G_GNUC_INTERNAL
+BayesClassifierSnapshot  *_bayes_classifier_read_lock            (BayesClassifier          *classifier);
+G_GNUC_INTERNAL
+void                      _bayes_classifier_read_unlock          (BayesClassifier          *classifier,
+                                                                  BayesClassifierSnapshot  *snapshot);
+G_GNUC_INTERNAL
+BayesStorageMemoryToken **_bayes_classifier_resolve              (BayesClassifier          *classifier,
+                                                                  BayesClassifierSnapshot  *snapshot,
+                                                                  gchar                   **tokens,
+                                                                  guint                     n_tokens);
+G_GNUC_INTERNAL
+guint64                   _bayes_classifier_snapshot_get_serial  (BayesClassifierSnapshot  *snapshot);
+G_GNUC_INTERNAL
+BayesStorage             *_bayes_classifier_snapshot_get_storage (BayesClassifierSnapshot  *snapshot);
+G_GNUC_INTERNAL
+gchar                   **_bayes_classifier_tokenize             (BayesClassifier          *classifier,
+                                                                  const gchar              *text);
+
+G_END_DECLS
+
+#endif /* BAYES_CLASSIFIER_PRIVATE_H */
@@ -18,10 +18,25 @@
 
 #include <glib/gi18n.h>
 #include <math.h>
+#include <string.h>
+#include <time.h>
 
+#include "bayes-batch-result-private.h"
+#include "bayes-bloom.h"
 #include "bayes-classifier.h"
+#include "bayes-classifier-private.h"
+#include "bayes-combiner.h"
+#include "bayes-combiner-private.h"
+#include "bayes-document-private.h"
 #include "bayes-guess.h"
+#include "bayes-hash.h"
+#include "bayes-lru.h"
+#include "bayes-parallel.h"
+#include "bayes-probes.h"
+#include "bayes-storage-compact.h"
+#include "bayes-storage-compact-private.h"
 #include "bayes-storage-memory.h"
+#include "bayes-storage-memory-private.h"
 #include "bayes-tokenizer.h"
 
 /**
@@ -37,19 +52,113 @@
  * needs. For example, it could be used to train SPAM vs HAM, or perhaps
  * even guess if your boyfriend or girlfriend will react negatively to your
  * instant message.
+ *
+ * A #BayesClassifier may be used from multiple threads at once. Guesses
+ * run concurrently with each other while training waits for them to
+ * complete. Custom tokenizers and storage must therefore be safe to call
+ * from multiple threads for reading.
  */
 
 G_DEFINE_TYPE(BayesClassifier, bayes_classifier, G_TYPE_OBJECT)
 
-typedef gdouble (*BayesCombiner) (BayesClassifier  *classifier,
-                                  BayesGuess      **guesses,
-                                  guint             len,
-                                  const gchar      *name,
-                                  gpointer          user_data);
+/*
+ * Static tracepoints, see bayes-probes.h. Times are in nanoseconds.
+ *
+ *   train_entry (name, text length)
+ *   train_return (name, tokens, time)
+ *   guess_entry (text length)
+ *   guess_return (tokens, classes, time)
+ *   tokenize_entry (text length)
+ *   tokenize_return (tokens, time)
+ *   storage_add (name, token, count)
+ *   storage_lookup_entry (class, tokens)
+ *   storage_lookup_return (class, tokens, time)
+ */
+BAYES_PROBE_DEFINE(train_entry)
+BAYES_PROBE_DEFINE(train_return)
+BAYES_PROBE_DEFINE(guess_entry)
+BAYES_PROBE_DEFINE(guess_return)
+BAYES_PROBE_DEFINE(tokenize_entry)
+BAYES_PROBE_DEFINE(tokenize_return)
+BAYES_PROBE_DEFINE(storage_add)
+BAYES_PROBE_DEFINE(storage_lookup_entry)
+BAYES_PROBE_DEFINE(storage_lookup_return)
+
+/*
+ * Number of tokens bayes_classifier_guess_best() scores before checking
+ * whether the current class can still beat the leader.
+ */
+#define GUESS_BEST_CHUNK 32
+
+/*
+ * Enough for "#" followed by any #guint and the terminating nul.
+ */
+#define FEATURE_ID_LEN 12
+
+/*
+ * Most times a custom #BayesCombiner is given the probability of a single
+ * feature by bayes_classifier_guess_features(), whatever its weight.
+ */
+#define FEATURE_MAX_REPEAT 65536
+
+/*
+ * Default number of asynchronous operations that may be queued before
+ * new ones fail with G_IO_ERROR_BUSY.
+ */
+#define DEFAULT_MAX_PENDING 256
+
+/*
+ * Duplicate suppression remembers at most this many documents exactly.
+ * Older documents are only remembered by the Bloom filter, which
+ * mistakes a new document for a duplicate with this probability.
+ */
+#define DEDUP_RECENT_SIZE         1024
+#define DEDUP_FALSE_POSITIVE_RATE 0.001
+
+/*
+ * The storage in use along with what is known about its type. Guesses
+ * hold a reference for as long as they score against it, so replacing
+ * the storage never waits for them and the old one is released once the
+ * last of them is done. @lock is held for reading while scoring and for
+ * writing while training, since storage is not safe to read while it is
+ * modified.
+ */
+struct _BayesClassifierSnapshot
+{
+   volatile gint  ref_count;
+   GRWLock        lock;
+   guint64        serial;
+   BayesStorage  *storage;
+
+   /*
+    * Set when @storage is a #BayesStorageMemory so that it can be read
+    * directly rather than through the #BayesStorage interface.
+    */
+   BayesStorageMemory *memory;
+
+   /*
+    * Set when @storage is a #BayesStorageCompact, which has a faster way
+    * to score with bayes_combiner_naive().
+    */
+   BayesStorageCompact *compact;
+};
 
 struct _BayesClassifierPrivate
 {
-   BayesStorage *storage;
+   /*
+    * Held for reading while guessing or training and for writing while
+    * the callbacks and settings below are modified. The storage is not
+    * covered, see #BayesClassifierSnapshot.
+    */
+   GRWLock lock;
+
+   /*
+    * Only held long enough to take a reference on @snapshot or to
+    * replace it.
+    */
+   GMutex                   snapshot_lock;
+   BayesClassifierSnapshot *snapshot;
+   guint64                  snapshot_serial;
 
    BayesTokenizer token_func;
    gpointer       token_user_data;
@@ -58,213 +167,2280 @@ struct _BayesClassifierPrivate
    BayesCombiner  combiner_func;
    gpointer       combiner_user_data;
    GDestroyNotify combiner_notify;
+
+   /*
+    * Workers for bayes_classifier_guess_async() and
+    * bayes_classifier_train_async().
+    */
+   GThreadPool   *async_pool;
+   volatile gint  n_pending;
+   guint          max_pending;
+
+   /*
+    * Recent results of bayes_classifier_guess() by fingerprint of the
+    * input text. Guesses run concurrently, so the cache has a lock of
+    * its own.
+    */
+   GMutex    cache_lock;
+   BayesLru *cache;
+   guint     cache_size;
+   guint64   cache_hits;
+   guint64   cache_misses;
+
+   /*
+    * Fingerprints of recently trained documents, used to skip training
+    * the same document twice. Checked by concurrent trainers, so this has
+    * a lock of its own as well.
+    */
+   GMutex      dedup_lock;
+   BayesBloom *dedup_bloom;
+   BayesLru   *dedup_recent;
+   guint       dedup_size;
+   guint64     dedup_unique;
+   guint64     dedup_duplicates;
+
+   /*
+    * Counters for bayes_classifier_get_stats(). They are only updated
+    * while stats_enabled is set, so the hot paths pay a single branch
+    * when it is not.
+    */
+   gboolean   stats_enabled;
+   GMutex     stats_lock;
+   BayesStats stats;
+
+   /*
+    * The model file followed by bayes_classifier_watch_file(). Only used
+    * from the main context the watch was started in.
+    */
+   gchar        *watch_filename;
+   GFileMonitor *watch_monitor;
+   gulong        watch_handler;
+   GCancellable *watch_cancellable;
+   gboolean      watch_loading;
+   gboolean      watch_dirty;
 };
 
 enum
 {
    PROP_0,
+   PROP_CACHE_SIZE,
+   PROP_DEDUP_SIZE,
+   PROP_MAX_PENDING,
+   PROP_STATS_ENABLED,
    PROP_STORAGE,
    LAST_PROP
 };
 
+typedef struct
+{
+   guint64  serial;
+   guint64  generation;
+   GList   *guesses;
+} CacheEntry;
+
+typedef struct
+{
+   BayesClassifier          *classifier;
+   BayesClassifierSnapshot  *snapshot;
+   const gchar * const      *texts;
+   BayesBatchResult         *result;
+} GuessBatch;
+
+typedef struct
+{
+   gchar *name;
+   gchar *text;
+} AsyncOp;
+
+typedef struct
+{
+   BayesClassifier      *classifier;
+   const gchar * const  *names;
+   const gchar * const  *texts;
+   guint                 n_documents;
+   guint                 n_chunks;
+   GHashTable          **counts;
+} TrainBatch;
+
 static GParamSpec *gParamSpecs[LAST_PROP];
 
-static gdouble
-bayes_classifier_robinson (BayesClassifier  *classifier,
-                           BayesGuess      **guesses,
-                           guint             len,
-                           const gchar      *name,
-                           gpointer          user_data)
-{
-   gdouble nth;
-   gdouble P;
-   gdouble Q;
-   gdouble S;
-   gdouble v;
-   gdouble w;
-   gdouble g;
+/*
+ * Returns a monotonic time in nanoseconds for the stats timers.
+ */
+static inline guint64
+stats_now (void)
+{
+#ifdef CLOCK_MONOTONIC
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * G_GUINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#else
+   return g_get_monotonic_time() * 1000;
+#endif
+}
+
+/*
+ * Adds @delta to the counters of @classifier. The counters are shared by
+ * every thread using @classifier, so callers collect their own first and
+ * add them once.
+ */
+static void
+bayes_classifier_stats_add (BayesClassifier  *classifier,
+                            const BayesStats *delta)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+
+   g_mutex_lock(&priv->stats_lock);
+   priv->stats.n_documents += delta->n_documents;
+   priv->stats.n_tokens += delta->n_tokens;
+   priv->stats.n_unique_tokens += delta->n_unique_tokens;
+   priv->stats.n_lookups += delta->n_lookups;
+   priv->stats.n_cache_hits += delta->n_cache_hits;
+   priv->stats.n_hash_probes += delta->n_hash_probes;
+   priv->stats.tokenize_nsec += delta->tokenize_nsec;
+   priv->stats.lookup_nsec += delta->lookup_nsec;
+   priv->stats.combine_nsec += delta->combine_nsec;
+   g_mutex_unlock(&priv->stats_lock);
+}
+
+static BayesClassifierSnapshot *
+bayes_classifier_snapshot_new (BayesStorage *storage)
+{
+   BayesClassifierSnapshot *snapshot;
+
+   snapshot = g_slice_new0(BayesClassifierSnapshot);
+   snapshot->ref_count = 1;
+   g_rw_lock_init(&snapshot->lock);
+   snapshot->storage = storage;
+
+   /*
+    * Subclasses may override the interface, so only the exact type takes
+    * the direct path.
+    */
+   if (G_OBJECT_TYPE(storage) == BAYES_TYPE_STORAGE_MEMORY) {
+      snapshot->memory = (BayesStorageMemory *)storage;
+   } else if (G_OBJECT_TYPE(storage) == BAYES_TYPE_STORAGE_COMPACT) {
+      snapshot->compact = (BayesStorageCompact *)storage;
+   }
+
+   return snapshot;
+}
+
+static void
+bayes_classifier_snapshot_unref (BayesClassifierSnapshot *snapshot)
+{
+   if (g_atomic_int_dec_and_test(&snapshot->ref_count)) {
+      g_object_unref(snapshot->storage);
+      g_rw_lock_clear(&snapshot->lock);
+      g_slice_free(BayesClassifierSnapshot, snapshot);
+   }
+}
+
+/*
+ * Returns a new reference to the storage currently in use. It stays
+ * valid when the storage of @classifier is replaced meanwhile.
+ */
+static BayesClassifierSnapshot *
+bayes_classifier_snapshot_acquire (BayesClassifier *classifier)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   BayesClassifierSnapshot *snapshot;
+
+   g_mutex_lock(&priv->snapshot_lock);
+   snapshot = priv->snapshot;
+   g_atomic_int_inc(&snapshot->ref_count);
+   g_mutex_unlock(&priv->snapshot_lock);
+
+   return snapshot;
+}
+
+/*
+ * Returns the size of the vocabulary before training so that
+ * bayes_classifier_stats_add_vocabulary() can count the tokens that were
+ * added. Only #BayesStorageMemory is counted. Must be called with the
+ * lock of @snapshot held for writing.
+ */
+static inline guint
+bayes_classifier_stats_get_vocabulary (BayesClassifier         *classifier,
+                                       BayesClassifierSnapshot *snapshot)
+{
+   if (G_UNLIKELY(classifier->priv->stats_enabled) && snapshot->memory) {
+      return _bayes_storage_memory_get_n_tokens(snapshot->memory);
+   }
+
+   return 0;
+}
+
+static inline void
+bayes_classifier_stats_add_vocabulary (BayesClassifier         *classifier,
+                                       BayesClassifierSnapshot *snapshot,
+                                       guint                    n_before)
+{
+   BayesStats delta = { 0 };
+
+   if (G_UNLIKELY(classifier->priv->stats_enabled) && snapshot->memory) {
+      delta.n_unique_tokens =
+         _bayes_storage_memory_get_n_tokens(snapshot->memory) - n_before;
+      bayes_classifier_stats_add(classifier, &delta);
+   }
+}
+
+static gchar **
+bayes_classifier_tokenize (BayesClassifier *classifier,
+                           const gchar     *text)
+{
+   BayesClassifierPrivate *priv;
+   BayesStats delta = { 0 };
+   guint64 elapsed;
+   guint64 begin;
+   gchar **ret;
+   guint n_tokens;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(text, NULL);
+
+   priv = classifier->priv;
+
+   BAYES_PROBE1(tokenize_entry, strlen(text));
+
+   if (G_LIKELY(!priv->stats_enabled) &&
+       !BAYES_PROBE_ENABLED(tokenize_return)) {
+      return priv->token_func(text, priv->token_user_data);
+   }
+
+   begin = stats_now();
+   ret = priv->token_func(text, priv->token_user_data);
+   elapsed = stats_now() - begin;
+   n_tokens = ret ? g_strv_length(ret) : 0;
+
+   BAYES_PROBE2(tokenize_return, n_tokens, elapsed);
+
+   if (priv->stats_enabled) {
+      delta.tokenize_nsec = elapsed;
+      delta.n_documents = 1;
+      delta.n_tokens = n_tokens;
+      bayes_classifier_stats_add(classifier, &delta);
+   }
+
+   return ret;
+}
+
+gchar **
+_bayes_classifier_tokenize (BayesClassifier *classifier,
+                            const gchar     *text)
+{
+   return bayes_classifier_tokenize(classifier, text);
+}
+
+/*
+ * The lock must be held while calling the storage or the callbacks from
+ * outside of this file, such as from #BayesGuessContext. The storage to
+ * call is that of the returned snapshot, which is released by
+ * _bayes_classifier_read_unlock().
+ */
+BayesClassifierSnapshot *
+_bayes_classifier_read_lock (BayesClassifier *classifier)
+{
+   BayesClassifierSnapshot *snapshot;
+
+   g_rw_lock_reader_lock(&classifier->priv->lock);
+   snapshot = bayes_classifier_snapshot_acquire(classifier);
+   g_rw_lock_reader_lock(&snapshot->lock);
+
+   return snapshot;
+}
+
+void
+_bayes_classifier_read_unlock (BayesClassifier         *classifier,
+                               BayesClassifierSnapshot *snapshot)
+{
+   g_rw_lock_reader_unlock(&snapshot->lock);
+   bayes_classifier_snapshot_unref(snapshot);
+   g_rw_lock_reader_unlock(&classifier->priv->lock);
+}
+
+/*
+ * Identifies the storage of @snapshot. It changes every time the storage
+ * of the classifier is replaced, even by the same one.
+ */
+guint64
+_bayes_classifier_snapshot_get_serial (BayesClassifierSnapshot *snapshot)
+{
+   return snapshot->serial;
+}
+
+BayesStorage *
+_bayes_classifier_snapshot_get_storage (BayesClassifierSnapshot *snapshot)
+{
+   return snapshot->storage;
+}
+
+BayesCombiner
+_bayes_classifier_get_combiner (BayesClassifier *classifier,
+                                gpointer        *user_data)
+{
+   *user_data = classifier->priv->combiner_user_data;
+   return classifier->priv->combiner_func;
+}
+
+BayesTokenizer
+_bayes_classifier_get_tokenizer (BayesClassifier *classifier,
+                                 gpointer        *user_data)
+{
+   *user_data = classifier->priv->token_user_data;
+   return classifier->priv->token_func;
+}
+
+/*
+ * Returns TRUE if @text was recently trained as @name. Otherwise it is
+ * remembered as trained. Must be called with the lock held.
+ */
+static gboolean
+bayes_classifier_is_duplicate (BayesClassifier *classifier,
+                               const gchar     *name,
+                               const gchar     *text)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   BayesFingerprint fingerprint;
+   BayesFingerprint *key;
+   gboolean ret;
+
+   /*
+    * Seeding the text fingerprint with that of the name keeps the same
+    * text trained under different names apart.
+    */
+   _bayes_fingerprint_init(&fingerprint, name, strlen(name), 0);
+   _bayes_fingerprint_init(&fingerprint, text, strlen(text), fingerprint.h1);
+
+   g_mutex_lock(&priv->dedup_lock);
+
+   ret = (_bayes_lru_lookup(priv->dedup_recent, &fingerprint) ||
+          _bayes_bloom_contains(priv->dedup_bloom, &fingerprint));
+
+   if (ret) {
+      priv->dedup_duplicates++;
+   } else {
+      /*
+       * Start over once the filter is full rather than letting its false
+       * positive rate grow. The recent documents are still known exactly.
+       */
+      if (_bayes_bloom_get_n_items(priv->dedup_bloom) >= priv->dedup_size) {
+         _bayes_bloom_clear(priv->dedup_bloom);
+      }
+      _bayes_bloom_add(priv->dedup_bloom, &fingerprint);
+      key = g_new(BayesFingerprint, 1);
+      *key = fingerprint;
+      _bayes_lru_insert(priv->dedup_recent, key, GINT_TO_POINTER(TRUE));
+      priv->dedup_unique++;
+   }
+
+   g_mutex_unlock(&priv->dedup_lock);
+
+   return ret;
+}
+
+/*
+ * Forgets which documents were trained.
+ */
+static void
+bayes_classifier_dedup_clear (BayesClassifier *classifier)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+
+   g_mutex_lock(&priv->dedup_lock);
+   if (priv->dedup_bloom) {
+      _bayes_bloom_clear(priv->dedup_bloom);
+   }
+   _bayes_lru_remove_all(priv->dedup_recent);
+   g_mutex_unlock(&priv->dedup_lock);
+}
+
+/**
+ * bayes_classifier_new:
+ *
+ * Create a new instance of #BayesClassifier. The instance should be
+ * freed using g_object_unref().
+ *
+ * See bayes_classifier_train() for how to train your classifier.
+ * See bayes_classifier_guess() for guessing the classification of
+ * unknown input.
+ *
+ * Returns: (transfer full): A newly allocated #BayesClassifier.
+ */
+BayesClassifier *
+bayes_classifier_new (void)
+{
+   return g_object_new(BAYES_TYPE_CLASSIFIER, NULL);
+}
+
+/**
+ * bayes_classifier_train:
+ * @classifier: (in): A #BayesClassifier.
+ * @name: (in): The classification for @text.
+ * @text: (in): Text to tokenize and store for guessing.
+ *
+ * Tokenizes @text and stores the values under the classification named
+ * @name. These are used by bayes_classifier_guess() to determine
+ * the classification.
+ *
+ * If #BayesClassifier:dedup-size is set and @text was recently trained
+ * as @name, it is skipped without being tokenized.
+ */
+void
+bayes_classifier_train (BayesClassifier *classifier,
+                        const gchar     *name,
+                        const gchar     *text)
+{
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   gchar **tokens = NULL;
+   guint64 begin = 0;
+   guint n_before;
+   guint i = 0;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(name);
+   g_return_if_fail(text);
+
+   priv = classifier->priv;
+
+   BAYES_PROBE2(train_entry, name, strlen(text));
+   if (BAYES_PROBE_ENABLED(train_return)) {
+      begin = stats_now();
+   }
+
+   g_rw_lock_reader_lock(&priv->lock);
+
+   if (!priv->dedup_size ||
+       !bayes_classifier_is_duplicate(classifier, name, text)) {
+      tokens = bayes_classifier_tokenize(classifier, text);
+   }
+
+   if (tokens) {
+      snapshot = bayes_classifier_snapshot_acquire(classifier);
+      g_rw_lock_writer_lock(&snapshot->lock);
+      n_before = bayes_classifier_stats_get_vocabulary(classifier, snapshot);
+      for (i = 0; tokens[i]; i++) {
+         BAYES_PROBE3(storage_add, name, tokens[i], 1);
+         bayes_storage_add_token(snapshot->storage, name, tokens[i]);
+      }
+      bayes_storage_flush(snapshot->storage);
+      bayes_classifier_stats_add_vocabulary(classifier, snapshot, n_before);
+      g_rw_lock_writer_unlock(&snapshot->lock);
+      bayes_classifier_snapshot_unref(snapshot);
+   }
+
+   g_rw_lock_reader_unlock(&priv->lock);
+
+   g_strfreev(tokens);
+
+   BAYES_PROBE3(train_return, name, i, stats_now() - begin);
+}
+
+static void
+bayes_classifier_train_batch_worker (guint    index,
+                                     gpointer user_data)
+{
+   TrainBatch *batch = user_data;
+   GHashTable *counts;
+   GHashTable *tokens;
+   gpointer count;
+   gchar **strv;
+   guint begin;
+   guint end;
+   guint i;
+   guint j;
+
+   /*
+    * Each chunk of documents is counted into its own table so that the
+    * workers never contend with each other or with the storage.
+    */
+   counts = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                  (GDestroyNotify)g_hash_table_unref);
+   batch->counts[index] = counts;
+
+   begin = (guint64)batch->n_documents * index / batch->n_chunks;
+   end = (guint64)batch->n_documents * (index + 1) / batch->n_chunks;
+
+   for (i = begin; i < end; i++) {
+      if (batch->classifier->priv->dedup_size &&
+          bayes_classifier_is_duplicate(batch->classifier,
+                                        batch->names[i],
+                                        batch->texts[i])) {
+         continue;
+      }
+
+      if (!(strv = bayes_classifier_tokenize(batch->classifier,
+                                             batch->texts[i]))) {
+         continue;
+      }
+
+      if (!(tokens = g_hash_table_lookup(counts, batch->names[i]))) {
+         tokens = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, NULL);
+         g_hash_table_insert(counts, (gchar *)batch->names[i], tokens);
+      }
+
+      for (j = 0; strv[j]; j++) {
+         if ((count = g_hash_table_lookup(tokens, strv[j]))) {
+            g_hash_table_insert(tokens, strv[j],
+                                GUINT_TO_POINTER(GPOINTER_TO_UINT(count) + 1));
+         } else {
+            g_hash_table_insert(tokens, strv[j], GUINT_TO_POINTER(1));
+         }
+      }
+
+      /*
+       * The table took ownership of the token strings.
+       */
+      g_free(strv);
+   }
+}
+
+/**
+ * bayes_classifier_train_batch:
+ * @classifier: (in): A #BayesClassifier.
+ * @names: (in) (array zero-terminated=1): The classification of each
+ *   document in @texts.
+ * @texts: (in) (array zero-terminated=1): The documents to train.
+ *
+ * Trains @classifier with many documents at once. The document found at
+ * a given index of @texts is stored under the classification found at
+ * the same index of @names.
+ *
+ * The documents are tokenized and counted in parallel using the shared
+ * worker pool. The counts are then applied to the storage in a single
+ * pass, so each distinct token is stored once per batch rather than once
+ * per occurrence.
+ *
+ * Recently trained documents are skipped as with bayes_classifier_train().
+ */
+void
+bayes_classifier_train_batch (BayesClassifier     *classifier,
+                              const gchar * const *names,
+                              const gchar * const *texts)
+{
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   GHashTableIter iter;
+   GHashTableIter token_iter;
+   GHashTable *tokens;
+   TrainBatch batch;
+   gpointer count;
+   gchar *name;
+   gchar *token;
+   guint n_before;
+   guint i;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(names);
+   g_return_if_fail(texts);
+   g_return_if_fail(g_strv_length((gchar **)names) ==
+                    g_strv_length((gchar **)texts));
+
+   priv = classifier->priv;
+
+   batch.classifier = classifier;
+   batch.names = names;
+   batch.texts = texts;
+   batch.n_documents = g_strv_length((gchar **)texts);
+   batch.n_chunks = MIN(batch.n_documents,
+                        _bayes_parallel_get_n_threads() * 4);
+   batch.counts = g_new0(GHashTable *, MAX(batch.n_chunks, 1));
+
+   g_rw_lock_reader_lock(&priv->lock);
+
+   _bayes_parallel_for(batch.n_chunks,
+                       bayes_classifier_train_batch_worker,
+                       &batch);
+
+   snapshot = bayes_classifier_snapshot_acquire(classifier);
+   g_rw_lock_writer_lock(&snapshot->lock);
+   n_before = bayes_classifier_stats_get_vocabulary(classifier, snapshot);
+   for (i = 0; i < batch.n_chunks; i++) {
+      g_hash_table_iter_init(&iter, batch.counts[i]);
+      while (g_hash_table_iter_next(&iter, (gpointer *)&name,
+                                    (gpointer *)&tokens)) {
+         g_hash_table_iter_init(&token_iter, tokens);
+         while (g_hash_table_iter_next(&token_iter, (gpointer *)&token,
+                                       &count)) {
+            BAYES_PROBE3(storage_add, name, token, GPOINTER_TO_UINT(count));
+            bayes_storage_add_token_count(snapshot->storage, name, token,
+                                          GPOINTER_TO_UINT(count));
+         }
+      }
+   }
+   bayes_storage_flush(snapshot->storage);
+   bayes_classifier_stats_add_vocabulary(classifier, snapshot, n_before);
+   g_rw_lock_writer_unlock(&snapshot->lock);
+   bayes_classifier_snapshot_unref(snapshot);
+
+   g_rw_lock_reader_unlock(&priv->lock);
+
+   for (i = 0; i < batch.n_chunks; i++) {
+      g_hash_table_unref(batch.counts[i]);
+   }
+   g_free(batch.counts);
+}
+
+/*
+ * Returns the tokens of @features. Features named by identifier are
+ * formatted into @buffer, which must have room for FEATURE_ID_LEN bytes
+ * per feature.
+ */
+static const gchar **
+bayes_classifier_feature_tokens (const BayesFeature *features,
+                                 guint               n_features,
+                                 gchar              *buffer)
+{
+   const gchar **tokens;
    guint i;
 
-   nth = 1.0 / (gdouble)len;
+   tokens = g_new(const gchar *, MAX(n_features, 1));
+
+   for (i = 0; i < n_features; i++) {
+      if (features[i].name) {
+         tokens[i] = features[i].name;
+      } else {
+         g_snprintf(buffer, FEATURE_ID_LEN, "#%u", features[i].id);
+         tokens[i] = buffer;
+         buffer += FEATURE_ID_LEN;
+      }
+   }
+
+   return tokens;
+}
+
+static guint
+bayes_classifier_count_feature_ids (const BayesFeature *features,
+                                    guint               n_features)
+{
+   guint ret = 0;
+   guint i;
+
+   for (i = 0; i < n_features; i++) {
+      ret += !features[i].name;
+   }
+
+   return ret;
+}
+
+/**
+ * bayes_classifier_train_features:
+ * @classifier: (in): A #BayesClassifier.
+ * @name: (in): The classification for @features.
+ * @features: (in) (array length=n_features): The features of a document.
+ * @n_features: (in): The number of elements in @features.
+ *
+ * Trains @classifier with a document that has already been reduced to
+ * features, bypassing the tokenizer. Each feature is stored under the
+ * classification named @name as if its token had been seen as many
+ * times as its weight, rounded to the nearest whole number.
+ */
+void
+bayes_classifier_train_features (BayesClassifier    *classifier,
+                                 const gchar        *name,
+                                 const BayesFeature *features,
+                                 guint               n_features)
+{
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   const gchar **tokens;
+   gchar *buffer;
+   gdouble count;
+   guint n_before;
+   guint i;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(name);
+   g_return_if_fail(features || !n_features);
+
+   priv = classifier->priv;
+
+   buffer = g_malloc(FEATURE_ID_LEN *
+                     bayes_classifier_count_feature_ids(features,
+                                                        n_features) + 1);
+   tokens = bayes_classifier_feature_tokens(features, n_features, buffer);
+
+   g_rw_lock_reader_lock(&priv->lock);
+   snapshot = bayes_classifier_snapshot_acquire(classifier);
+   g_rw_lock_writer_lock(&snapshot->lock);
+   n_before = bayes_classifier_stats_get_vocabulary(classifier, snapshot);
+   for (i = 0; i < n_features; i++) {
+      count = floor(features[i].weight + 0.5);
+      if (count >= 1.0) {
+         BAYES_PROBE3(storage_add, name, tokens[i],
+                      (count < G_MAXUINT) ? (guint)count : G_MAXUINT);
+         bayes_storage_add_token_count(snapshot->storage, name, tokens[i],
+                                       (count < G_MAXUINT) ? count
+                                                           : G_MAXUINT);
+      }
+   }
+   bayes_storage_flush(snapshot->storage);
+   bayes_classifier_stats_add_vocabulary(classifier, snapshot, n_before);
+   g_rw_lock_writer_unlock(&snapshot->lock);
+   bayes_classifier_snapshot_unref(snapshot);
+   g_rw_lock_reader_unlock(&priv->lock);
+
+   g_free(tokens);
+   g_free(buffer);
+}
+
+static gint
+sort_guesses (gconstpointer a,
+              gconstpointer b)
+{
+   gdouble ap = bayes_guess_get_probability((BayesGuess *)a);
+   gdouble bp = bayes_guess_get_probability((BayesGuess *)b);
+   return (ap < bp) - (ap > bp);
+}
+
+/*
+ * Looks up the probabilities of @tokens for @class_id. @resolved may be
+ * the tokens already resolved with _bayes_storage_memory_lookup_token()
+ * when the storage is a #BayesStorageMemory.
+ */
+static void
+bayes_classifier_lookup (BayesClassifierSnapshot  *snapshot,
+                         guint                     class_id,
+                         gchar                   **tokens,
+                         BayesStorageMemoryToken **resolved,
+                         guint                     n_tokens,
+                         gdouble                  *probs)
+{
+   BayesStorageMemory *memory = snapshot->memory;
+   BayesStorage *storage = snapshot->storage;
+   guint64 begin = 0;
+   guint i;
+
+   BAYES_PROBE2(storage_lookup_entry, class_id, n_tokens);
+   if (BAYES_PROBE_ENABLED(storage_lookup_return)) {
+      begin = stats_now();
+   }
+
+   if (resolved) {
+      for (i = 0; i < n_tokens; i++) {
+         probs[i] = _bayes_storage_memory_get_token_probability(
+               memory, class_id, resolved[i]);
+      }
+   } else if (memory) {
+      for (i = 0; i < n_tokens; i++) {
+         probs[i] = _bayes_storage_memory_get_class_token_probability(
+               memory, class_id, tokens[i]);
+      }
+   } else {
+      for (i = 0; i < n_tokens; i++) {
+         probs[i] = bayes_storage_get_class_token_probability(storage,
+                                                              class_id,
+                                                              tokens[i]);
+      }
+   }
+
+   BAYES_PROBE3(storage_lookup_return, class_id, n_tokens,
+                stats_now() - begin);
+}
+
+static void
+bayes_classifier_get_probabilities (BayesClassifier          *classifier,
+                                    BayesClassifierSnapshot  *snapshot,
+                                    guint                     class_id,
+                                    gchar                   **tokens,
+                                    BayesStorageMemoryToken **resolved,
+                                    guint                     n_tokens,
+                                    gdouble                  *probs)
+{
+   BayesStats delta = { 0 };
+   guint64 begin;
+
+   if (G_LIKELY(!classifier->priv->stats_enabled)) {
+      bayes_classifier_lookup(snapshot, class_id, tokens, resolved,
+                              n_tokens, probs);
+      return;
+   }
+
+   begin = stats_now();
+   bayes_classifier_lookup(snapshot, class_id, tokens, resolved, n_tokens,
+                           probs);
+   delta.lookup_nsec = stats_now() - begin;
+   delta.n_lookups = n_tokens;
+   bayes_classifier_stats_add(classifier, &delta);
+}
+
+void
+_bayes_classifier_get_probabilities (BayesClassifier          *classifier,
+                                     BayesClassifierSnapshot  *snapshot,
+                                     guint                     class_id,
+                                     gchar                   **tokens,
+                                     BayesStorageMemoryToken **resolved,
+                                     guint                     n_tokens,
+                                     gdouble                  *probs)
+{
+   bayes_classifier_get_probabilities(classifier, snapshot, class_id,
+                                      tokens, resolved, n_tokens, probs);
+}
+
+/*
+ * Prepares @tokens to be scored against every class. A
+ * #BayesStorageMemory is probed once per token here and the tokens it
+ * found are returned for bayes_classifier_lookup(), to be freed with
+ * g_free(). Storage other than the built-in ones may fetch the counts of
+ * all @tokens at once instead, and %NULL is returned.
+ */
+static BayesStorageMemoryToken **
+bayes_classifier_resolve (BayesClassifier          *classifier,
+                          BayesClassifierSnapshot  *snapshot,
+                          gchar                   **tokens,
+                          guint                     n_tokens)
+{
+   BayesStorageMemoryToken **resolved;
+   BayesStats delta = { 0 };
+   guint64 begin;
+   guint i;
+
+   if (!snapshot->memory) {
+      if (!snapshot->compact) {
+         bayes_storage_prefetch_tokens(snapshot->storage,
+                                       (const gchar * const *)tokens,
+                                       n_tokens);
+      }
+      return NULL;
+   }
+
+   resolved = g_new(BayesStorageMemoryToken *, MAX(n_tokens, 1));
+
+   if (G_LIKELY(!classifier->priv->stats_enabled)) {
+      for (i = 0; i < n_tokens; i++) {
+         resolved[i] = _bayes_storage_memory_lookup_token(snapshot->memory,
+                                                          tokens[i]);
+      }
+      return resolved;
+   }
+
+   begin = stats_now();
+   for (i = 0; i < n_tokens; i++) {
+      resolved[i] = _bayes_storage_memory_probe_token(snapshot->memory,
+                                                      tokens[i],
+                                                      &delta.n_hash_probes);
+   }
+   delta.lookup_nsec = stats_now() - begin;
+   bayes_classifier_stats_add(classifier, &delta);
+
+   return resolved;
+}
+
+BayesStorageMemoryToken **
+_bayes_classifier_resolve (BayesClassifier          *classifier,
+                           BayesClassifierSnapshot  *snapshot,
+                           gchar                   **tokens,
+                           guint                     n_tokens)
+{
+   return bayes_classifier_resolve(classifier, snapshot, tokens, n_tokens);
+}
+
+/*
+ * Scores @tokens against the first @n_classes classifications and stores
+ * the result of the combiner in @scores, indexed by class identifier.
+ * @probs is scratch space for @n_tokens probabilities. Must be called
+ * with the locks held.
+ *
+ * A #BayesStorageMemory is only probed once per token, however many
+ * classifications there are.
+ */
+static void
+bayes_classifier_score (BayesClassifier          *classifier,
+                        BayesClassifierSnapshot  *snapshot,
+                        gchar                   **tokens,
+                        guint                     n_tokens,
+                        guint                     n_classes,
+                        gdouble                  *probs,
+                        gdouble                  *scores)
+{
+   BayesStorageMemoryToken **resolved = NULL;
+   BayesClassifierPrivate *priv = classifier->priv;
+   BayesStats delta = { 0 };
+   guint64 begin;
+   guint64 end;
+   guint i;
+
+   if (snapshot->compact && priv->combiner_func == bayes_combiner_naive) {
+      begin = G_UNLIKELY(priv->stats_enabled) ? stats_now() : 0;
+      _bayes_storage_compact_score_naive(snapshot->compact, tokens, n_tokens,
+                                         scores);
+      if (G_UNLIKELY(priv->stats_enabled)) {
+         delta.lookup_nsec = stats_now() - begin;
+         delta.n_lookups = n_tokens;
+         bayes_classifier_stats_add(classifier, &delta);
+      }
+      return;
+   }
+
+   resolved = bayes_classifier_resolve(classifier, snapshot, tokens,
+                                       n_tokens);
+
+   if (G_LIKELY(!priv->stats_enabled)) {
+      for (i = 0; i < n_classes; i++) {
+         bayes_classifier_lookup(snapshot, i, tokens, resolved, n_tokens,
+                                 probs);
+         scores[i] = priv->combiner_func(probs, n_tokens,
+                                         priv->combiner_user_data);
+      }
+      g_free(resolved);
+      return;
+   }
+
+   for (i = 0; i < n_classes; i++) {
+      begin = stats_now();
+      bayes_classifier_lookup(snapshot, i, tokens, resolved, n_tokens,
+                              probs);
+      end = stats_now();
+      scores[i] = priv->combiner_func(probs, n_tokens,
+                                      priv->combiner_user_data);
+      delta.lookup_nsec += end - begin;
+      delta.combine_nsec += stats_now() - end;
+   }
+
+   delta.n_lookups = (guint64)n_tokens * n_classes;
+   bayes_classifier_stats_add(classifier, &delta);
+
+   g_free(resolved);
+}
+
+static GList *
+copy_guesses (GList *guesses)
+{
+   guesses = g_list_copy(guesses);
+   g_list_foreach(guesses, (GFunc)bayes_guess_ref, NULL);
+   return guesses;
+}
+
+static void
+cache_entry_free (gpointer data)
+{
+   CacheEntry *entry = data;
+
+   g_list_foreach(entry->guesses, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(entry->guesses);
+   g_slice_free(CacheEntry, entry);
+}
+
+/*
+ * Forgets every remembered guess.
+ */
+static void
+bayes_classifier_cache_clear (BayesClassifier *classifier)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+
+   g_mutex_lock(&priv->cache_lock);
+   _bayes_lru_remove_all(priv->cache);
+   g_mutex_unlock(&priv->cache_lock);
+}
+
+/*
+ * Looks up the guesses for @fingerprint, discarding them if they were
+ * computed with another storage or the storage has been trained since.
+ * Must be called with the lock held.
+ */
+static gboolean
+bayes_classifier_cache_lookup (BayesClassifier          *classifier,
+                               BayesClassifierSnapshot  *snapshot,
+                               const BayesFingerprint   *fingerprint,
+                               guint64                   generation,
+                               GList                   **guesses)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   CacheEntry *entry;
+   gboolean ret = FALSE;
+
+   g_mutex_lock(&priv->cache_lock);
+
+   if ((entry = _bayes_lru_lookup(priv->cache, fingerprint))) {
+      if (entry->serial == snapshot->serial &&
+          entry->generation == generation) {
+         *guesses = copy_guesses(entry->guesses);
+         ret = TRUE;
+      } else {
+         _bayes_lru_remove(priv->cache, fingerprint);
+      }
+   }
+
+   if (ret) {
+      priv->cache_hits++;
+   } else {
+      priv->cache_misses++;
+   }
+
+   g_mutex_unlock(&priv->cache_lock);
+
+   if (ret && G_UNLIKELY(priv->stats_enabled)) {
+      BayesStats delta = { 0 };
+
+      delta.n_cache_hits = 1;
+      bayes_classifier_stats_add(classifier, &delta);
+   }
+
+   return ret;
+}
+
+static void
+bayes_classifier_cache_insert (BayesClassifier         *classifier,
+                               BayesClassifierSnapshot *snapshot,
+                               const BayesFingerprint  *fingerprint,
+                               guint64                  generation,
+                               GList                   *guesses)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   BayesFingerprint *key;
+   CacheEntry *entry;
+
+   key = g_new(BayesFingerprint, 1);
+   *key = *fingerprint;
+
+   entry = g_slice_new(CacheEntry);
+   entry->serial = snapshot->serial;
+   entry->generation = generation;
+   entry->guesses = copy_guesses(guesses);
+
+   g_mutex_lock(&priv->cache_lock);
+   _bayes_lru_insert(priv->cache, key, entry);
+   g_mutex_unlock(&priv->cache_lock);
+}
+
+/**
+ * bayes_classifier_guess:
+ * @classifier: (in): A #BayesClassifier.
+ * @text: (in): Text to tokenize and guess the classification.
+ *
+ * Tries to guess the classification of @text by tokenizing @text using
+ * the tokenizer provided to bayes_classifier_set_tokenizer()
+ * and testing each token against the classifiers training.
+ *
+ * This method returns a #GList of #BayesGuess instances. It is up to the
+ * caller to free the individual #BayesGuess structures as well as the
+ * containing #GList.
+ *
+ * [[
+ * GList *list = bayes_classifier_guess(classifier, "who am i?");
+ * g_list_foreach(list, (GFunc)bayes_guess_unref);
+ * g_list_free(list);
+ * ]]
+ *
+ * If #BayesClassifier:cache-size is set, the result is remembered and
+ * returned for the same @text until @classifier is trained again.
+ *
+ * Returns: (transfer full) (element-type BayesGuess*): The guesses.
+ */
+GList *
+bayes_classifier_guess (BayesClassifier *classifier,
+                        const gchar     *text)
+{
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   BayesFingerprint fingerprint;
+   const gchar * const *names;
+   guint64 generation = 0;
+   guint64 begin = 0;
+   gdouble *scores;
+   gdouble *probs;
+   gchar **tokens;
+   GList *ret = NULL;
+   guint n_classes;
+   guint n_tokens;
+   guint i;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(text, NULL);
+
+   priv = classifier->priv;
+
+   BAYES_PROBE1(guess_entry, strlen(text));
+   if (BAYES_PROBE_ENABLED(guess_return)) {
+      begin = stats_now();
+   }
+
+   snapshot = _bayes_classifier_read_lock(classifier);
+
+   if (priv->cache_size) {
+      _bayes_fingerprint_init(&fingerprint, text, strlen(text), 0);
+      generation = bayes_storage_get_generation(snapshot->storage);
+      if (bayes_classifier_cache_lookup(classifier, snapshot, &fingerprint,
+                                        generation, &ret)) {
+         _bayes_classifier_read_unlock(classifier, snapshot);
+         BAYES_PROBE3(guess_return, 0, g_list_length(ret),
+                      stats_now() - begin);
+         return ret;
+      }
+   }
+
+   tokens = bayes_classifier_tokenize(classifier, text);
+   names = bayes_storage_get_classes(snapshot->storage, &n_classes);
+
+   /*
+    * The probabilities of a class are kept in a contiguous array that is
+    * reused for every class, so the combiner can stream over it.
+    */
+   n_tokens = tokens ? g_strv_length(tokens) : 0;
+
+   if (n_tokens) {
+      probs = g_new(gdouble, n_tokens);
+      scores = g_new(gdouble, MAX(n_classes, 1));
+      bayes_classifier_score(classifier, snapshot, tokens, n_tokens,
+                             n_classes, probs, scores);
+      for (i = 0; i < n_classes; i++) {
+         ret = g_list_prepend(ret, bayes_guess_new(names[i], scores[i]));
+      }
+      g_free(scores);
+      g_free(probs);
+   }
+
+   ret = g_list_sort(ret, sort_guesses);
+
+   if (priv->cache_size) {
+      bayes_classifier_cache_insert(classifier, snapshot, &fingerprint,
+                                    generation, ret);
+   }
+
+   _bayes_classifier_read_unlock(classifier, snapshot);
+
+   g_strfreev(tokens);
+
+   BAYES_PROBE3(guess_return, n_tokens, n_classes, stats_now() - begin);
+
+   return ret;
+}
+
+/*
+ * Scores the distinct tokens of @document against every class and
+ * expands them by their number of occurrences for the combiner. With
+ * #BayesStorageMemory each distinct token is looked up only once for all
+ * of the classes. Must be called with the locks held.
+ */
+static GList *
+bayes_classifier_score_document (BayesClassifier         *classifier,
+                                 BayesClassifierSnapshot *snapshot,
+                                 BayesDocument           *document)
+{
+   BayesStorageMemoryToken **resolved = NULL;
+   BayesClassifierPrivate *priv = classifier->priv;
+   const gchar * const *names;
+   BayesStats delta = { 0 };
+   gboolean stats_enabled;
+   gdouble *distinct;
+   gdouble *probs;
+   guint64 begin = 0;
+   GList *ret = NULL;
+   guint n_classes;
+   guint i;
+   guint j;
+   guint k;
+   guint n;
+
+   names = bayes_storage_get_classes(snapshot->storage, &n_classes);
+
+   if (!document->n_tokens || !n_classes) {
+      return NULL;
+   }
+
+   distinct = g_new(gdouble, document->n_distinct);
+   probs = g_new(gdouble, document->n_tokens);
+   stats_enabled = G_UNLIKELY(priv->stats_enabled);
+
+   resolved = bayes_classifier_resolve(classifier, snapshot,
+                                       document->tokens,
+                                       document->n_distinct);
+
+   for (i = 0; i < n_classes; i++) {
+      bayes_classifier_get_probabilities(classifier, snapshot, i,
+                                         document->tokens, resolved,
+                                         document->n_distinct, distinct);
+
+      for (j = 0, k = 0; j < document->n_distinct; j++) {
+         for (n = 0; n < document->counts[j]; n++) {
+            probs[k++] = distinct[j];
+         }
+      }
+
+      if (stats_enabled) {
+         begin = stats_now();
+      }
+
+      ret = g_list_prepend(ret,
+                           bayes_guess_new(names[i],
+                                           priv->combiner_func(
+                                              probs, document->n_tokens,
+                                              priv->combiner_user_data)));
+
+      if (stats_enabled) {
+         delta.combine_nsec += stats_now() - begin;
+      }
+   }
+
+   if (stats_enabled) {
+      bayes_classifier_stats_add(classifier, &delta);
+   }
+
+   g_free(resolved);
+   g_free(distinct);
+   g_free(probs);
+
+   return g_list_sort(ret, sort_guesses);
+}
+
+/**
+ * bayes_classifier_guess_document:
+ * @classifier: (in): A #BayesClassifier.
+ * @document: (in): A #BayesDocument.
+ *
+ * Like bayes_classifier_guess() but guesses the classification of text
+ * that has already been tokenized into @document. The same @document may
+ * be passed to many classifiers so that it is only tokenized once.
+ *
+ * If the tokenizer of @classifier is not the one @document was created
+ * with, the text of @document is tokenized again.
+ *
+ * Returns: (transfer full) (element-type BayesGuess*): The guesses.
+ */
+GList *
+bayes_classifier_guess_document (BayesClassifier *classifier,
+                                 BayesDocument   *document)
+{
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   BayesDocument *copy = NULL;
+   GList *ret;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(document, NULL);
+
+   priv = classifier->priv;
+
+   snapshot = _bayes_classifier_read_lock(classifier);
+
+   if (document->tokenizer != priv->token_func ||
+       document->user_data != priv->token_user_data) {
+      document = copy = bayes_document_new(document->text,
+                                           priv->token_func,
+                                           priv->token_user_data);
+   }
+
+   ret = bayes_classifier_score_document(classifier, snapshot, document);
+
+   _bayes_classifier_read_unlock(classifier, snapshot);
+
+   if (copy) {
+      bayes_document_unref(copy);
+   }
+
+   return ret;
+}
+
+/**
+ * bayes_classifier_guess_features:
+ * @classifier: (in): A #BayesClassifier.
+ * @features: (in) (array length=n_features): The features of a document.
+ * @n_features: (in): The number of elements in @features.
+ *
+ * Like bayes_classifier_guess() but guesses the classification of a
+ * document that has already been reduced to features, bypassing the
+ * tokenizer.
+ *
+ * With the built-in combiners, each feature weighs in as if its token had
+ * been seen as many times as its weight, which need not be whole. A
+ * custom #BayesCombiner is given the probability of each feature as many
+ * times as its weight rounded to the nearest whole number, but at most
+ * 65536 times, and no more than %G_MAXUINT probabilities in total.
+ *
+ * Returns: (transfer full) (element-type BayesGuess*): The guesses.
+ */
+GList *
+bayes_classifier_guess_features (BayesClassifier    *classifier,
+                                 const BayesFeature *features,
+                                 guint               n_features)
+{
+   BayesStorageMemoryToken **resolved = NULL;
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   BayesEvidenceFunc func;
+   BayesEvidence evidence;
+   const gchar * const *names;
+   const gchar **tokens;
+   gdouble *weights;
+   gdouble *expanded = NULL;
+   gdouble *probs;
+   gdouble score;
+   gchar *buffer;
+   GList *ret = NULL;
+   guint *repeats = NULL;
+   guint n_classes;
+   gsize n_expanded = 0;
+   guint i;
+   guint j;
+   guint k;
+   guint n;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(features || !n_features, NULL);
+
+   priv = classifier->priv;
+
+   if (!n_features) {
+      return NULL;
+   }
+
+   buffer = g_malloc(FEATURE_ID_LEN *
+                     bayes_classifier_count_feature_ids(features,
+                                                        n_features) + 1);
+   tokens = bayes_classifier_feature_tokens(features, n_features, buffer);
+   weights = g_new(gdouble, n_features);
+   probs = g_new(gdouble, n_features);
+
+   for (i = 0; i < n_features; i++) {
+      weights[i] = MAX(features[i].weight, 0.0);
+   }
+
+   snapshot = _bayes_classifier_read_lock(classifier);
+
+   names = bayes_storage_get_classes(snapshot->storage, &n_classes);
+   func = _bayes_combiner_get_evidence_func(priv->combiner_func);
+
+   if (!func) {
+      repeats = g_new(guint, n_features);
+      for (i = 0; i < n_features; i++) {
+         repeats[i] = MIN(floor(weights[i] + 0.5), FEATURE_MAX_REPEAT);
+         if (repeats[i] > G_MAXUINT - n_expanded) {
+            repeats[i] = G_MAXUINT - n_expanded;
+         }
+         n_expanded += repeats[i];
+      }
+      expanded = g_new(gdouble, MAX(n_expanded, 1));
+   }
+
+   if (n_classes) {
+      resolved = bayes_classifier_resolve(classifier, snapshot,
+                                          (gchar **)tokens, n_features);
+   }
+
+   for (i = 0; i < n_classes; i++) {
+      bayes_classifier_get_probabilities(classifier, snapshot, i,
+                                         (gchar **)tokens, resolved,
+                                         n_features, probs);
+
+      if (func) {
+         memset(&evidence, 0, sizeof evidence);
+         _bayes_evidence_accumulate_weighted(&evidence, probs, weights,
+                                             n_features);
+         score = func(&evidence);
+      } else {
+         for (j = 0, k = 0; j < n_features; j++) {
+            for (n = repeats[j]; n; n--) {
+               expanded[k++] = probs[j];
+            }
+         }
+         score = priv->combiner_func(expanded, n_expanded,
+                                     priv->combiner_user_data);
+      }
+
+      ret = g_list_prepend(ret, bayes_guess_new(names[i], score));
+   }
+
+   _bayes_classifier_read_unlock(classifier, snapshot);
+
+   g_free(resolved);
+   g_free(expanded);
+   g_free(repeats);
+   g_free(probs);
+   g_free(weights);
+   g_free(tokens);
+   g_free(buffer);
+
+   return g_list_sort(ret, sort_guesses);
+}
+
+/*
+ * Scores the classes a few tokens at a time with @func, stopping with a
+ * class as soon as even the best case for its remaining tokens could not
+ * beat the leader. The class that leads after the first chunk is
+ * finished first so the others are measured against a good score from
+ * the start. Returns the best class and stores its score in @score.
+ * Must be called with the locks held.
+ */
+static guint
+bayes_classifier_score_best (BayesClassifier          *classifier,
+                             BayesClassifierSnapshot  *snapshot,
+                             gchar                   **tokens,
+                             BayesStorageMemoryToken **resolved,
+                             guint                     n_tokens,
+                             guint                     n_classes,
+                             BayesEvidenceFunc         func,
+                             gdouble                  *probs,
+                             gdouble                  *score)
+{
+   BayesEvidence *evidence;
+   BayesEvidence bound;
+   gdouble best = 0.0;
+   gdouble value;
+   guint best_id = 0;
+   guint lead = 0;
+   guint first;
+   guint len;
+   guint i;
+   guint j;
+   guint k;
+
+   evidence = g_new0(BayesEvidence, n_classes);
+   first = MIN(n_tokens, GUESS_BEST_CHUNK);
+
+   for (i = 0; i < n_classes; i++) {
+      bayes_classifier_get_probabilities(classifier, snapshot, i, tokens,
+                                         resolved, first, probs);
+      _bayes_evidence_accumulate(&evidence[i], probs, first);
+      value = func(&evidence[i]);
+      if (i == 0 || value > best) {
+         lead = i;
+         best = value;
+      }
+   }
+
+   for (k = 0; k < n_classes; k++) {
+      i = (lead + k) % n_classes;
+      value = -1.0;
+
+      for (j = first; j < n_tokens; j += len) {
+         if (k) {
+            bound = evidence[i];
+            _bayes_evidence_add_best_case(&bound, n_tokens - j);
+            if (func(&bound) <= best) {
+               break;
+            }
+         }
+
+         len = MIN(n_tokens - j, GUESS_BEST_CHUNK);
+         bayes_classifier_get_probabilities(classifier, snapshot, i,
+                                            tokens + j,
+                                            resolved ? resolved + j : NULL,
+                                            len, probs);
+         _bayes_evidence_accumulate(&evidence[i], probs, len);
+      }
+
+      if (j >= n_tokens) {
+         value = func(&evidence[i]);
+      }
+
+      if (k == 0 || value > best) {
+         best_id = i;
+         best = value;
+      }
+   }
+
+   g_free(evidence);
+
+   *score = best;
+
+   return best_id;
+}
+
+/**
+ * bayes_classifier_guess_best:
+ * @classifier: (in): A #BayesClassifier.
+ * @text: (in): Text to tokenize and guess the classification.
+ *
+ * Like bayes_classifier_guess() but only the most probable
+ * classification is returned.
+ *
+ * With bayes_combiner_naive() the classes are scored in the log domain a
+ * few tokens at a time. Scoring of a class stops as soon as even the
+ * best case for its remaining tokens could not beat the current leader.
+ * This makes this cheaper than bayes_classifier_guess() when there are
+ * many classes.
+ *
+ * Results remembered by bayes_classifier_guess() are used if
+ * #BayesClassifier:cache-size is set.
+ *
+ * Returns: (transfer full): A #BayesGuess or %NULL if @text contained
+ *   no tokens or nothing has been trained.
+ */
+BayesGuess *
+bayes_classifier_guess_best (BayesClassifier *classifier,
+                             const gchar     *text)
+{
+   BayesStorageMemoryToken **resolved = NULL;
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierPrivate *priv;
+   BayesFingerprint fingerprint;
+   const gchar * const *names;
+   BayesGuess *ret = NULL;
+   GList *guesses;
+   gdouble best = 0.0;
+   gdouble score;
+   gdouble *probs;
+   gchar **tokens;
+   guint n_classes;
+   guint n_tokens;
+   guint best_id = 0;
+   guint i;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(text, NULL);
+
+   priv = classifier->priv;
+
+   snapshot = _bayes_classifier_read_lock(classifier);
+
+   if (priv->cache_size) {
+      _bayes_fingerprint_init(&fingerprint, text, strlen(text), 0);
+      if (bayes_classifier_cache_lookup(classifier, snapshot, &fingerprint,
+                                        bayes_storage_get_generation(
+                                           snapshot->storage),
+                                        &guesses)) {
+         _bayes_classifier_read_unlock(classifier, snapshot);
+         if (guesses) {
+            ret = bayes_guess_ref(guesses->data);
+         }
+         g_list_foreach(guesses, (GFunc)bayes_guess_unref, NULL);
+         g_list_free(guesses);
+         return ret;
+      }
+   }
+
+   tokens = bayes_classifier_tokenize(classifier, text);
+   names = bayes_storage_get_classes(snapshot->storage, &n_classes);
+
+   n_tokens = tokens ? g_strv_length(tokens) : 0;
+
+   if (n_tokens && n_classes) {
+      probs = g_new(gdouble, n_tokens);
+      resolved = bayes_classifier_resolve(classifier, snapshot, tokens,
+                                          n_tokens);
+
+      /*
+       * Only the scores of the naive combiner separate quickly enough for
+       * the best case of the remaining tokens to rule a class out. With
+       * the other combiners the bound hardly ever prunes and checking it
+       * costs more than it saves.
+       */
+      if (priv->combiner_func == bayes_combiner_naive) {
+         best_id = bayes_classifier_score_best(classifier, snapshot, tokens,
+                                               resolved, n_tokens, n_classes,
+                                               _bayes_evidence_naive, probs,
+                                               &best);
+      } else {
+         for (i = 0; i < n_classes; i++) {
+            bayes_classifier_get_probabilities(classifier, snapshot, i,
+                                               tokens, resolved, n_tokens,
+                                               probs);
+            score = priv->combiner_func(probs, n_tokens,
+                                        priv->combiner_user_data);
+            if (i == 0 || score > best) {
+               best_id = i;
+               best = score;
+            }
+         }
+      }
+
+      ret = bayes_guess_new(names[best_id], best);
+
+      g_free(resolved);
+      g_free(probs);
+   }
+
+   _bayes_classifier_read_unlock(classifier, snapshot);
+
+   g_strfreev(tokens);
+
+   return ret;
+}
+
+static void
+bayes_classifier_guess_batch_worker (guint    index,
+                                     gpointer user_data)
+{
+   BayesBatchResult *result;
+   GuessBatch *batch = user_data;
+   gdouble *scores;
+   gdouble *probs;
+   gchar **tokens;
+   guint n_tokens;
+   guint i;
+
+   result = batch->result;
+   tokens = bayes_classifier_tokenize(batch->classifier, batch->texts[index]);
+   n_tokens = tokens ? g_strv_length(tokens) : 0;
+
+   if (n_tokens && result->n_classes) {
+      scores = &result->scores[(gsize)index * result->n_classes];
+      probs = g_new(gdouble, n_tokens);
+      bayes_classifier_score(batch->classifier, batch->snapshot, tokens,
+                             n_tokens, result->n_classes, probs, scores);
+      result->best[index] = 0;
+      for (i = 1; i < result->n_classes; i++) {
+         if (scores[i] > scores[result->best[index]]) {
+            result->best[index] = i;
+         }
+      }
+      g_free(probs);
+   }
+
+   g_strfreev(tokens);
+}
+
+/**
+ * bayes_classifier_guess_batch:
+ * @classifier: (in): A #BayesClassifier.
+ * @texts: (in) (array zero-terminated=1): The documents to classify.
+ *
+ * Guesses the classification of every document in @texts. The documents
+ * are spread across a shared pool of worker threads, so this is much
+ * faster than calling bayes_classifier_guess() for each of them on
+ * machines with more than one core.
+ *
+ * Rather than a list of #BayesGuess per document, the scores for every
+ * classification are returned in a single #BayesBatchResult.
+ *
+ * Returns: (transfer full): A #BayesBatchResult.
+ */
+BayesBatchResult *
+bayes_classifier_guess_batch (BayesClassifier     *classifier,
+                              const gchar * const *texts)
+{
+   const gchar * const *names;
+   GuessBatch batch;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(texts, NULL);
+
+   batch.snapshot = _bayes_classifier_read_lock(classifier);
+
+   names = bayes_storage_get_classes(batch.snapshot->storage, NULL);
+
+   batch.classifier = classifier;
+   batch.texts = texts;
+   batch.result = _bayes_batch_result_new(g_strdupv((gchar **)names),
+                                          g_strv_length((gchar **)texts));
+
+   _bayes_parallel_for(batch.result->n_documents,
+                       bayes_classifier_guess_batch_worker,
+                       &batch);
+
+   _bayes_classifier_read_unlock(classifier, batch.snapshot);
+
+   return batch.result;
+}
+
+static gboolean
+is_packed (GBytes *bytes)
+{
+   const gchar *data;
+   gsize length;
+
+   data = g_bytes_get_data(bytes, &length);
+   return !length || data[length - 1] == '\0';
+}
+
+/*
+ * Splits @bytes into the nul terminated strings it is made of without
+ * copying them.
+ */
+static const gchar **
+split_packed (GBytes *bytes)
+{
+   const gchar *data;
+   const gchar *end;
+   const gchar *nul;
+   GPtrArray *strv;
+   gsize length;
+
+   data = g_bytes_get_data(bytes, &length);
+   strv = g_ptr_array_new();
+
+   for (end = data + length; data < end; data = nul + 1) {
+      nul = memchr(data, '\0', end - data);
+      g_ptr_array_add(strv, (gchar *)data);
+   }
+
+   g_ptr_array_add(strv, NULL);
+
+   return (const gchar **)g_ptr_array_free(strv, FALSE);
+}
+
+/**
+ * bayes_classifier_guess_many:
+ * @classifier: (in): A #BayesClassifier.
+ * @texts: (in): The documents to classify, each terminated by a nul byte.
+ *
+ * Like bayes_classifier_guess_batch() but the documents are packed
+ * into a single #GBytes, such as b"\0".join(texts) + b"\0" in Python.
+ * A batch of documents then crosses a language binding as one
+ * buffer rather than one string at a time. Read the result with
+ * bayes_batch_result_get_best_bytes() and
+ * bayes_batch_result_get_scores_bytes().
+ *
+ * Returns: (transfer full): A #BayesBatchResult.
+ */
+BayesBatchResult *
+bayes_classifier_guess_many (BayesClassifier *classifier,
+                             GBytes          *texts)
+{
+   BayesBatchResult *ret;
+   const gchar **strv;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(texts, NULL);
+   g_return_val_if_fail(is_packed(texts), NULL);
+
+   strv = split_packed(texts);
+   ret = bayes_classifier_guess_batch(classifier, strv);
+   g_free(strv);
+
+   return ret;
+}
+
+/**
+ * bayes_classifier_train_many:
+ * @classifier: (in): A #BayesClassifier.
+ * @names: (in) (array zero-terminated=1): The classification of each
+ *   document in @texts.
+ * @texts: (in): The documents to train, each terminated by a nul byte.
+ *
+ * Like bayes_classifier_train_batch() but the documents are packed into
+ * a single #GBytes as with bayes_classifier_guess_many().
+ */
+void
+bayes_classifier_train_many (BayesClassifier     *classifier,
+                             const gchar * const *names,
+                             GBytes              *texts)
+{
+   const gchar **strv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(names);
+   g_return_if_fail(texts);
+   g_return_if_fail(is_packed(texts));
+
+   strv = split_packed(texts);
+   bayes_classifier_train_batch(classifier, names, strv);
+   g_free(strv);
+}
+
+/**
+ * bayes_classifier_import_delta:
+ * @classifier: (in): A #BayesClassifier.
+ * @delta: (in): A delta from bayes_storage_memory_export_delta().
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Applies @delta to the storage of @classifier with
+ * bayes_storage_import_delta(). Unlike calling that directly, this is
+ * safe while other threads are guessing with @classifier, which makes
+ * it suitable for replicas that keep serving while catching up with
+ * the node they are trained from.
+ *
+ * Returns: %TRUE if @delta was applied.
+ */
+gboolean
+bayes_classifier_import_delta (BayesClassifier  *classifier,
+                               GBytes           *delta,
+                               GError          **error)
+{
+   BayesClassifierSnapshot *snapshot;
+   gboolean ret;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), FALSE);
+   g_return_val_if_fail(delta, FALSE);
+
+   snapshot = bayes_classifier_snapshot_acquire(classifier);
+   g_rw_lock_writer_lock(&snapshot->lock);
+   ret = bayes_storage_import_delta(snapshot->storage, delta, error);
+   g_rw_lock_writer_unlock(&snapshot->lock);
+   bayes_classifier_snapshot_unref(snapshot);
+
+   return ret;
+}
+
+static void
+async_op_free (gpointer data)
+{
+   AsyncOp *op = data;
+
+   g_free(op->name);
+   g_free(op->text);
+   g_slice_free(AsyncOp, op);
+}
+
+static void
+free_guesses (gpointer data)
+{
+   g_list_foreach(data, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(data);
+}
+
+static void
+bayes_classifier_async_worker (gpointer data,
+                               gpointer user_data)
+{
+   BayesClassifier *classifier;
+   GTask *task = data;
+   AsyncOp *op;
+
+   classifier = g_task_get_source_object(task);
+   op = g_task_get_task_data(task);
+
+   if (!g_task_return_error_if_cancelled(task)) {
+      if (op->name) {
+         bayes_classifier_train(classifier, op->name, op->text);
+         g_task_return_boolean(task, TRUE);
+      } else {
+         g_task_return_pointer(task,
+                               bayes_classifier_guess(classifier, op->text),
+                               free_guesses);
+      }
+   }
+
+   g_atomic_int_add(&classifier->priv->n_pending, -1);
+   g_object_unref(task);
+}
+
+static void
+bayes_classifier_push_async (BayesClassifier     *classifier,
+                             const gchar         *name,
+                             const gchar         *text,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data,
+                             gpointer             source_tag)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   AsyncOp *op;
+   GTask *task;
+
+   task = g_task_new(classifier, cancellable, callback, user_data);
+   g_task_set_source_tag(task, source_tag);
+
+   /*
+    * Rather than queueing without bound while the workers fall behind,
+    * let the caller know it should slow down.
+    */
+   if (g_atomic_int_add(&priv->n_pending, 1) >= (gint)priv->max_pending) {
+      g_atomic_int_add(&priv->n_pending, -1);
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_BUSY,
+                              _("Too many pending operations."));
+      g_object_unref(task);
+      return;
+   }
+
+   op = g_slice_new0(AsyncOp);
+   op->name = g_strdup(name);
+   op->text = g_strdup(text);
+   g_task_set_task_data(task, op, async_op_free);
+
+   g_thread_pool_push(priv->async_pool, task, NULL);
+}
+
+/**
+ * bayes_classifier_guess_async:
+ * @classifier: (in): A #BayesClassifier.
+ * @text: (in): Text to tokenize and guess the classification.
+ * @cancellable: (in) (allow-none): A #GCancellable or %NULL.
+ * @callback: (in) (scope async): A callback to call upon completion.
+ * @user_data: (in): User data for @callback.
+ *
+ * Asynchronously performs bayes_classifier_guess() on a worker thread
+ * so that the calling main loop is not blocked. @callback is called in
+ * the thread-default main context of the caller and should call
+ * bayes_classifier_guess_finish() to retrieve the result.
+ *
+ * If more than #BayesClassifier:max-pending operations are already
+ * queued, the operation fails with %G_IO_ERROR_BUSY.
+ */
+void
+bayes_classifier_guess_async (BayesClassifier     *classifier,
+                              const gchar         *text,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(text);
+   g_return_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable));
+
+   bayes_classifier_push_async(classifier, NULL, text, cancellable,
+                               callback, user_data,
+                               bayes_classifier_guess_async);
+}
+
+/**
+ * bayes_classifier_guess_finish:
+ * @classifier: (in): A #BayesClassifier.
+ * @result: (in): A #GAsyncResult.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Completes an asynchronous request to bayes_classifier_guess_async().
+ *
+ * Returns: (transfer full) (element-type BayesGuess*): The guesses, or
+ *   %NULL if there were none or an error occurred.
+ */
+GList *
+bayes_classifier_guess_finish (BayesClassifier  *classifier,
+                               GAsyncResult     *result,
+                               GError          **error)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(g_task_is_valid(result, classifier), NULL);
+
+   return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * bayes_classifier_train_async:
+ * @classifier: (in): A #BayesClassifier.
+ * @name: (in): The classification for @text.
+ * @text: (in): Text to tokenize and store for guessing.
+ * @cancellable: (in) (allow-none): A #GCancellable or %NULL.
+ * @callback: (in) (scope async): A callback to call upon completion.
+ * @user_data: (in): User data for @callback.
+ *
+ * Asynchronously performs bayes_classifier_train() on a worker thread.
+ * @callback should call bayes_classifier_train_finish().
+ *
+ * If more than #BayesClassifier:max-pending operations are already
+ * queued, the operation fails with %G_IO_ERROR_BUSY.
+ */
+void
+bayes_classifier_train_async (BayesClassifier     *classifier,
+                              const gchar         *name,
+                              const gchar         *text,
+                              GCancellable        *cancellable,
+                              GAsyncReadyCallback  callback,
+                              gpointer             user_data)
+{
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(name);
+   g_return_if_fail(text);
+   g_return_if_fail(!cancellable || G_IS_CANCELLABLE(cancellable));
+
+   bayes_classifier_push_async(classifier, name, text, cancellable,
+                               callback, user_data,
+                               bayes_classifier_train_async);
+}
+
+/**
+ * bayes_classifier_train_finish:
+ * @classifier: (in): A #BayesClassifier.
+ * @result: (in): A #GAsyncResult.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Completes an asynchronous request to bayes_classifier_train_async().
+ *
+ * Returns: %TRUE if @text was trained, otherwise %FALSE and @error is set.
+ */
+gboolean
+bayes_classifier_train_finish (BayesClassifier  *classifier,
+                               GAsyncResult     *result,
+                               GError          **error)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), FALSE);
+   g_return_val_if_fail(g_task_is_valid(result, classifier), FALSE);
+
+   return g_task_propagate_boolean(G_TASK(result), error);
+}
+
+/**
+ * bayes_classifier_get_cache_size:
+ * @classifier: (in): A #BayesClassifier.
+ *
+ * Retrieves the #BayesClassifier:cache-size property.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_classifier_get_cache_size (BayesClassifier *classifier)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), 0);
+   return classifier->priv->cache_size;
+}
+
+/**
+ * bayes_classifier_set_cache_size:
+ * @classifier: (in): A #BayesClassifier.
+ * @cache_size: (in): The number of results to remember or 0.
+ *
+ * Sets the number of results of bayes_classifier_guess() that are
+ * remembered. Repeated input, such as the copies of a SPAM campaign, is
+ * then classified without being tokenized or scored again.
+ *
+ * Results are looked up by a 128-bit fingerprint of the input text and
+ * are discarded once the storage has been trained since they were
+ * computed. The least recently used result is evicted when the cache is
+ * full. A @cache_size of 0 disables the cache.
+ */
+void
+bayes_classifier_set_cache_size (BayesClassifier *classifier,
+                                 guint            cache_size)
+{
+   BayesClassifierPrivate *priv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+
+   priv = classifier->priv;
+
+   g_rw_lock_writer_lock(&priv->lock);
+   priv->cache_size = cache_size;
+   g_mutex_lock(&priv->cache_lock);
+   _bayes_lru_set_max_size(priv->cache, cache_size);
+   g_mutex_unlock(&priv->cache_lock);
+   g_rw_lock_writer_unlock(&priv->lock);
+
+   g_object_notify_by_pspec(G_OBJECT(classifier),
+                            gParamSpecs[PROP_CACHE_SIZE]);
+}
+
+/**
+ * bayes_classifier_get_cache_stats:
+ * @classifier: (in): A #BayesClassifier.
+ * @hits: (out) (allow-none): A location for the number of cache hits.
+ * @misses: (out) (allow-none): A location for the number of cache misses.
+ *
+ * Retrieves how often guesses were answered from the cache enabled with
+ * bayes_classifier_set_cache_size(). The hit rate is
+ * @hits / (@hits + @misses).
+ */
+void
+bayes_classifier_get_cache_stats (BayesClassifier *classifier,
+                                  guint64         *hits,
+                                  guint64         *misses)
+{
+   BayesClassifierPrivate *priv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+
+   priv = classifier->priv;
+
+   g_mutex_lock(&priv->cache_lock);
+   if (hits) {
+      *hits = priv->cache_hits;
+   }
+   if (misses) {
+      *misses = priv->cache_misses;
+   }
+   g_mutex_unlock(&priv->cache_lock);
+}
+
+/**
+ * bayes_classifier_get_dedup_size:
+ * @classifier: (in): A #BayesClassifier.
+ *
+ * Retrieves the #BayesClassifier:dedup-size property.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_classifier_get_dedup_size (BayesClassifier *classifier)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), 0);
+   return classifier->priv->dedup_size;
+}
+
+/**
+ * bayes_classifier_set_dedup_size:
+ * @classifier: (in): A #BayesClassifier.
+ * @dedup_size: (in): The number of documents to remember or 0.
+ *
+ * Enables skipping documents that are trained more than once, such as
+ * messages resubmitted by a feedback loop. Training a document that was
+ * recently trained under the same classification then has no effect and
+ * the document is not tokenized.
+ *
+ * The last 1024 documents are remembered exactly by fingerprint. Up to
+ * @dedup_size documents are remembered by a Bloom filter of about two
+ * bytes per document, which wrongly skips a new document with a
+ * probability of about 0.1%. The filter is emptied once it is full.
+ *
+ * Changing the size, or the storage, forgets every document. A
+ * @dedup_size of 0 disables duplicate suppression.
+ */
+void
+bayes_classifier_set_dedup_size (BayesClassifier *classifier,
+                                 guint            dedup_size)
+{
+   BayesClassifierPrivate *priv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
 
-   v = 1.0;
-   w = 1.0;
-   for (i = 0; i < len; i++) {
-      g = bayes_guess_get_probability(guesses[i]);
-      v *= (1.0 - g);
-      w *= g;
-   }
+   priv = classifier->priv;
 
-   P = 1.0 - pow(v, nth);
-   Q = 1.0 - pow(w, nth);
-   S = (P - Q) / (P + Q);
+   g_rw_lock_writer_lock(&priv->lock);
+   priv->dedup_size = dedup_size;
+   g_mutex_lock(&priv->dedup_lock);
+   _bayes_bloom_free(priv->dedup_bloom);
+   priv->dedup_bloom = dedup_size ?
+      _bayes_bloom_new(dedup_size, DEDUP_FALSE_POSITIVE_RATE) : NULL;
+   _bayes_lru_remove_all(priv->dedup_recent);
+   _bayes_lru_set_max_size(priv->dedup_recent,
+                           MIN(dedup_size, DEDUP_RECENT_SIZE));
+   g_mutex_unlock(&priv->dedup_lock);
+   g_rw_lock_writer_unlock(&priv->lock);
 
-   return (1 + S) / 2.0;
+   g_object_notify_by_pspec(G_OBJECT(classifier),
+                            gParamSpecs[PROP_DEDUP_SIZE]);
 }
 
-static gchar **
-bayes_classifier_tokenize (BayesClassifier *classifier,
-                           const gchar     *text)
+/**
+ * bayes_classifier_get_dedup_stats:
+ * @classifier: (in): A #BayesClassifier.
+ * @unique: (out) (allow-none): A location for the number of documents
+ *   trained.
+ * @duplicates: (out) (allow-none): A location for the number of
+ *   documents skipped.
+ *
+ * Retrieves how many documents were trained and how many were skipped as
+ * duplicates since duplicate suppression was enabled with
+ * bayes_classifier_set_dedup_size().
+ */
+void
+bayes_classifier_get_dedup_stats (BayesClassifier *classifier,
+                                  guint64         *unique,
+                                  guint64         *duplicates)
 {
    BayesClassifierPrivate *priv;
 
-   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
-   g_return_val_if_fail(text, NULL);
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
 
    priv = classifier->priv;
-   return priv->token_func(text, priv->token_user_data);
+
+   g_mutex_lock(&priv->dedup_lock);
+   if (unique) {
+      *unique = priv->dedup_unique;
+   }
+   if (duplicates) {
+      *duplicates = priv->dedup_duplicates;
+   }
+   g_mutex_unlock(&priv->dedup_lock);
 }
 
 /**
- * bayes_classifier_new:
+ * bayes_classifier_get_max_pending:
+ * @classifier: (in): A #BayesClassifier.
  *
- * Create a new instance of #BayesClassifier. The instance should be
- * freed using g_object_unref().
+ * Retrieves the #BayesClassifier:max-pending property.
  *
- * See bayes_classifier_train() for how to train your classifier.
- * See bayes_classifier_guess() for guessing the classification of
- * unknown input.
+ * Returns: A #guint.
+ */
+guint
+bayes_classifier_get_max_pending (BayesClassifier *classifier)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), 0);
+   return classifier->priv->max_pending;
+}
+
+/**
+ * bayes_classifier_set_max_pending:
+ * @classifier: (in): A #BayesClassifier.
+ * @max_pending: (in): The maximum number of pending operations.
  *
- * Returns: (transfer full): A newly allocated #BayesClassifier.
+ * Sets the maximum number of asynchronous operations that may be queued
+ * or running at once. See bayes_classifier_guess_async().
  */
-BayesClassifier *
-bayes_classifier_new (void)
+void
+bayes_classifier_set_max_pending (BayesClassifier *classifier,
+                                  guint            max_pending)
 {
-   return g_object_new(BAYES_TYPE_CLASSIFIER, NULL);
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(max_pending > 0);
+   g_return_if_fail(max_pending <= G_MAXINT);
+
+   classifier->priv->max_pending = max_pending;
+   g_object_notify_by_pspec(G_OBJECT(classifier),
+                            gParamSpecs[PROP_MAX_PENDING]);
 }
 
 /**
- * bayes_classifier_train:
+ * bayes_classifier_get_stats_enabled:
  * @classifier: (in): A #BayesClassifier.
- * @name: (in): The classification for @text.
- * @text: (in): Text to tokenize and store for guessing.
  *
- * Tokenizes @text and stores the values under the classification named
- * @name. These are used by bayes_classifier_guess() to determine
- * the classification.
+ * Retrieves the #BayesClassifier:stats-enabled property.
+ *
+ * Returns: %TRUE if @classifier is collecting stats.
+ */
+gboolean
+bayes_classifier_get_stats_enabled (BayesClassifier *classifier)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), FALSE);
+   return classifier->priv->stats_enabled;
+}
+
+/**
+ * bayes_classifier_set_stats_enabled:
+ * @classifier: (in): A #BayesClassifier.
+ * @stats_enabled: (in): If stats should be collected.
+ *
+ * Sets the #BayesClassifier:stats-enabled property. While it is set,
+ * @classifier counts the documents and tokens it handles and times the
+ * tokenizer, the storage and the combiner. Collecting stats slows
+ * guessing down a little, so it is disabled by default.
+ *
+ * The counters keep their values while disabled. See
+ * bayes_classifier_reset_stats().
  */
 void
-bayes_classifier_train (BayesClassifier *classifier,
-                        const gchar     *name,
-                        const gchar     *text)
+bayes_classifier_set_stats_enabled (BayesClassifier *classifier,
+                                    gboolean         stats_enabled)
 {
    BayesClassifierPrivate *priv;
-   gchar **tokens;
-   guint i;
 
    g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
-   g_return_if_fail(name);
-   g_return_if_fail(text);
 
    priv = classifier->priv;
 
-   if ((tokens = bayes_classifier_tokenize(classifier, text))) {
-      for (i = 0; tokens[i]; i++) {
-         bayes_storage_add_token(priv->storage, name, tokens[i]);
-      }
-      g_strfreev(tokens);
-   }
-}
+   g_rw_lock_writer_lock(&priv->lock);
+   priv->stats_enabled = !!stats_enabled;
+   g_rw_lock_writer_unlock(&priv->lock);
 
-static gint
-sort_guesses (gconstpointer a,
-              gconstpointer b)
-{
-   BayesGuess *ag = (gpointer)a;
-   BayesGuess *bg = (gpointer)b;
-   return (bayes_guess_get_probability(bg) -
-           bayes_guess_get_probability(ag))
-      * 100.0;
+   g_object_notify_by_pspec(G_OBJECT(classifier),
+                            gParamSpecs[PROP_STATS_ENABLED]);
 }
 
-static gdouble
-bayes_classifier_combiner (BayesClassifier  *classifier,
-                           BayesGuess      **guesses,
-                           guint             len,
-                           const gchar      *name)
+/**
+ * bayes_classifier_get_stats:
+ * @classifier: (in): A #BayesClassifier.
+ * @stats: (out caller-allocates): A location for the stats.
+ *
+ * Retrieves the counters collected while #BayesClassifier:stats-enabled
+ * was set. Hash probes and new tokens are only counted when the storage
+ * is a #BayesStorageMemory.
+ */
+void
+bayes_classifier_get_stats (BayesClassifier *classifier,
+                            BayesStats      *stats)
 {
-   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), 0.0);
-   g_return_val_if_fail(guesses, 0.0);
-   g_return_val_if_fail(len, 0.0);
-   g_return_val_if_fail(name, 0.0);
+   BayesClassifierPrivate *priv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+   g_return_if_fail(stats);
+
+   priv = classifier->priv;
 
-   return classifier->priv->combiner_func(classifier,
-                                          guesses,
-                                          len,
-                                          name,
-                                          classifier->priv->combiner_user_data);
+   g_mutex_lock(&priv->stats_lock);
+   *stats = priv->stats;
+   g_mutex_unlock(&priv->stats_lock);
 }
 
 /**
- * bayes_classifier_guess:
+ * bayes_classifier_reset_stats:
  * @classifier: (in): A #BayesClassifier.
- * @text: (in): Text to tokenize and guess the classification.
- *
- * Tries to guess the classification of @text by tokenizing @text using
- * the tokenizer provided to bayes_classifier_set_tokenizer()
- * and testing each token against the classifiers training.
- *
- * This method returns a #GList of #BayesGuess instances. It is up to the
- * caller to free the individual #BayesGuess structures as well as the
- * containing #GList.
- *
- * [[
- * GList *list = bayes_classifier_guess(classifier, "who am i?");
- * g_list_foreach(list, (GFunc)bayes_guess_unref);
- * g_list_free(list);
- * ]]
  *
- * Returns: (transfer full) (element-type BayesGuess*): The guesses.
+ * Sets every counter returned by bayes_classifier_get_stats() to zero.
  */
-GList *
-bayes_classifier_guess (BayesClassifier *classifier,
-                        const gchar     *text)
+void
+bayes_classifier_reset_stats (BayesClassifier *classifier)
 {
    BayesClassifierPrivate *priv;
-   BayesGuess *guess;
-   GPtrArray *guesses;
-   gdouble prob;
-   gchar **tokens;
-   gchar **names;
-   GList *ret = NULL;
-   guint i;
-   guint j;
 
-   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
-   g_return_val_if_fail(text, NULL);
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
 
    priv = classifier->priv;
 
-   tokens = bayes_classifier_tokenize(classifier, text);
-   names = bayes_storage_get_names(priv->storage);
-
-   for (i = 0; names[i]; i++) {
-      guesses = g_ptr_array_new_with_free_func((GDestroyNotify)bayes_guess_unref);
-      for (j = 0; tokens[j]; j++) {
-         prob = bayes_storage_get_token_probability(priv->storage,
-                                                    names[i],
-                                                    tokens[j]);
-         guess = bayes_guess_new(tokens[j], prob);
-         g_ptr_array_add(guesses, guess);
-      }
-      g_ptr_array_sort(guesses, sort_guesses);
-      if (guesses->len) {
-         guess = bayes_guess_new(names[i],
-                                 bayes_classifier_combiner(classifier,
-                                                           (BayesGuess **)guesses->pdata,
-                                                           guesses->len,
-                                                           names[i]));
-         ret = g_list_prepend(ret, guess);
-      }
-      g_ptr_array_unref(guesses);
-   }
-
-   g_strfreev(names);
-   g_strfreev(tokens);
-
-   ret = g_list_sort(ret, sort_guesses);
-
-   return ret;
+   g_mutex_lock(&priv->stats_lock);
+   memset(&priv->stats, 0, sizeof priv->stats);
+   g_mutex_unlock(&priv->stats_lock);
 }
 
 /**
@@ -278,8 +2454,53 @@ bayes_classifier_guess (BayesClassifier *classifier,
 BayesStorage *
 bayes_classifier_get_storage (BayesClassifier *classifier)
 {
+   BayesClassifierPrivate *priv;
+   BayesStorage *storage;
+
    g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
-   return classifier->priv->storage;
+
+   priv = classifier->priv;
+
+   g_mutex_lock(&priv->snapshot_lock);
+   storage = priv->snapshot->storage;
+   g_mutex_unlock(&priv->snapshot_lock);
+
+   return storage;
+}
+
+/*
+ * Replaces the storage of @classifier. Only the pointer is swapped, so
+ * this never waits for guesses in progress. They finish with the old
+ * storage, which is released by the last of them, while guesses started
+ * after the swap use the new one.
+ */
+static void
+bayes_classifier_swap_storage (BayesClassifier *classifier,
+                               BayesStorage    *storage)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   BayesClassifierSnapshot *snapshot;
+   BayesClassifierSnapshot *old_snapshot;
+
+   snapshot = bayes_classifier_snapshot_new(
+         storage ? g_object_ref(storage) : bayes_storage_memory_new());
+
+   g_mutex_lock(&priv->snapshot_lock);
+   old_snapshot = priv->snapshot;
+   snapshot->serial = ++priv->snapshot_serial;
+   priv->snapshot = snapshot;
+   g_mutex_unlock(&priv->snapshot_lock);
+
+   /*
+    * Guesses still scoring against the old storage may remember their
+    * results after this, but the serial keeps them from being used.
+    */
+   bayes_classifier_cache_clear(classifier);
+   bayes_classifier_dedup_clear(classifier);
+
+   if (old_snapshot) {
+      bayes_classifier_snapshot_unref(old_snapshot);
+   }
 }
 
 /**
@@ -294,16 +2515,11 @@ void
 bayes_classifier_set_storage (BayesClassifier *classifier,
                               BayesStorage    *storage)
 {
-   BayesClassifierPrivate *priv;
-
    g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
    g_return_if_fail(!storage || BAYES_IS_STORAGE(storage));
 
-   priv = classifier->priv;
-
-   g_clear_object(&priv->storage);
-   priv->storage = storage ? g_object_ref(storage)
-                           : bayes_storage_memory_new();
+   bayes_classifier_swap_storage(classifier, storage);
+   g_object_notify_by_pspec(G_OBJECT(classifier), gParamSpecs[PROP_STORAGE]);
 }
 
 /**
@@ -330,6 +2546,8 @@ bayes_classifier_set_tokenizer (BayesClassifier *classifier,
 
    priv = classifier->priv;
 
+   g_rw_lock_writer_lock(&priv->lock);
+
    if (priv->token_notify) {
       priv->token_notify(priv->token_user_data);
    }
@@ -337,9 +2555,28 @@ bayes_classifier_set_tokenizer (BayesClassifier *classifier,
    priv->token_func = tokenizer ? tokenizer : bayes_tokenizer_word;
    priv->token_user_data = tokenizer ? user_data : NULL;
    priv->token_notify = tokenizer ? notify : NULL;
+   bayes_classifier_cache_clear(classifier);
+
+   g_rw_lock_writer_unlock(&priv->lock);
 }
 
-static void
+/**
+ * bayes_classifier_set_combiner:
+ * @classifier: (in): A #BayesClassifier.
+ * @combiner: (in) (allow-none): A #BayesCombiner or %NULL.
+ * @user_data: (in): User data for @combiner.
+ * @notify: (in): Destruction notification for @user_data.
+ *
+ * Sets the combiner used by bayes_classifier_guess() to combine the
+ * probabilities of the individual tokens into the probability of a
+ * classification. If @combiner is %NULL, bayes_combiner_robinson()
+ * will be used.
+ *
+ * The built-in combiners bayes_combiner_robinson(),
+ * bayes_combiner_fisher() and bayes_combiner_naive() trade accuracy for
+ * speed in that order.
+ */
+void
 bayes_classifier_set_combiner (BayesClassifier *classifier,
                                BayesCombiner    combiner,
                                gpointer         user_data,
@@ -352,13 +2589,217 @@ bayes_classifier_set_combiner (BayesClassifier *classifier,
 
    priv = classifier->priv;
 
+   g_rw_lock_writer_lock(&priv->lock);
+
    if (priv->combiner_notify) {
       priv->combiner_notify(priv->combiner_user_data);
    }
 
-   priv->combiner_func = combiner ? combiner : bayes_classifier_robinson;
+   priv->combiner_func = combiner ? combiner : bayes_combiner_robinson;
    priv->combiner_user_data = combiner ? user_data : NULL;
    priv->combiner_notify = combiner ? notify : NULL;
+   bayes_classifier_cache_clear(classifier);
+
+   g_rw_lock_writer_unlock(&priv->lock);
+}
+
+static void bayes_classifier_watch_reload (BayesClassifier *classifier);
+
+static void
+bayes_classifier_watch_thread (GTask        *task,
+                               gpointer      source_object,
+                               gpointer      task_data,
+                               GCancellable *cancellable)
+{
+   BayesStorage *storage;
+   GError *error = NULL;
+
+   /*
+    * Mapping and validating the file is the slow part, so it happens
+    * here. The swap itself does not block guesses.
+    */
+   if (!(storage = bayes_storage_compact_new_from_file(task_data, &error))) {
+      g_task_return_error(task, error);
+      return;
+   }
+
+   if (!g_task_return_error_if_cancelled(task)) {
+      bayes_classifier_swap_storage(source_object, storage);
+      g_task_return_boolean(task, TRUE);
+   }
+
+   g_object_unref(storage);
+}
+
+static void
+bayes_classifier_watch_done (GObject      *object,
+                             GAsyncResult *result,
+                             gpointer      user_data)
+{
+   BayesClassifier *classifier = (BayesClassifier *)object;
+   BayesClassifierPrivate *priv = classifier->priv;
+   GError *error = NULL;
+
+   if (g_task_propagate_boolean(G_TASK(result), &error)) {
+      g_object_notify_by_pspec(object, gParamSpecs[PROP_STORAGE]);
+   } else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning("Failed to reload \"%s\", keeping the current model: %s",
+                (const gchar *)g_task_get_task_data(G_TASK(result)),
+                error->message);
+   }
+
+   /*
+    * The watch this reload belongs to may have been stopped meanwhile.
+    */
+   if (g_task_get_cancellable(G_TASK(result)) == priv->watch_cancellable) {
+      priv->watch_loading = FALSE;
+      if (priv->watch_dirty) {
+         bayes_classifier_watch_reload(classifier);
+      }
+   }
+
+   g_clear_error(&error);
+}
+
+static void
+bayes_classifier_watch_reload (BayesClassifier *classifier)
+{
+   BayesClassifierPrivate *priv = classifier->priv;
+   GTask *task;
+
+   /*
+    * Changes made while a reload is in progress are picked up by another
+    * one once it is done.
+    */
+   if (priv->watch_loading) {
+      priv->watch_dirty = TRUE;
+      return;
+   }
+
+   priv->watch_loading = TRUE;
+   priv->watch_dirty = FALSE;
+
+   task = g_task_new(classifier, priv->watch_cancellable,
+                     bayes_classifier_watch_done, NULL);
+   g_task_set_source_tag(task, bayes_classifier_watch_reload);
+   g_task_set_task_data(task, g_strdup(priv->watch_filename), g_free);
+   g_task_run_in_thread(task, bayes_classifier_watch_thread);
+   g_object_unref(task);
+}
+
+static void
+bayes_classifier_watch_changed (GFileMonitor      *monitor,
+                                GFile             *file,
+                                GFile             *other_file,
+                                GFileMonitorEvent  event,
+                                gpointer           user_data)
+{
+   /*
+    * Wait for the file to be completely written, or renamed into place.
+    */
+   if (event == G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT) {
+      bayes_classifier_watch_reload(user_data);
+   }
+}
+
+/**
+ * bayes_classifier_watch_file:
+ * @classifier: (in): A #BayesClassifier.
+ * @filename: (in): A model saved with bayes_storage_compact_save().
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Loads the #BayesStorageCompact saved in @filename as the storage of
+ * @classifier and loads it again whenever the file changes, so that a
+ * newly trained model can be deployed without restarting.
+ *
+ * Reloading maps the new file on a worker thread and then swaps it in
+ * atomically. Guesses in progress finish with the old model, which is
+ * released as soon as they have. If the new file cannot be loaded the
+ * current model is kept and a warning is logged. #BayesClassifier:storage
+ * is notified after every reload.
+ *
+ * Changes are noticed through a #GFileMonitor in the thread-default main
+ * context of the caller, which must be running. The file should be
+ * replaced by renaming a new file over it, as bayes_storage_compact_save()
+ * does, rather than rewritten in place while it is mapped.
+ *
+ * Any previous watch is stopped.
+ *
+ * Returns: %TRUE if @filename was loaded and is being watched.
+ */
+gboolean
+bayes_classifier_watch_file (BayesClassifier  *classifier,
+                             const gchar      *filename,
+                             GError          **error)
+{
+   BayesClassifierPrivate *priv;
+   BayesStorage *storage;
+   GFileMonitor *monitor;
+   GFile *file;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), FALSE);
+   g_return_val_if_fail(filename, FALSE);
+
+   priv = classifier->priv;
+
+   bayes_classifier_unwatch_file(classifier);
+
+   file = g_file_new_for_path(filename);
+   monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, error);
+   g_object_unref(file);
+
+   if (!monitor) {
+      return FALSE;
+   }
+
+   if (!(storage = bayes_storage_compact_new_from_file(filename, error))) {
+      g_object_unref(monitor);
+      return FALSE;
+   }
+
+   bayes_classifier_set_storage(classifier, storage);
+   g_object_unref(storage);
+
+   priv->watch_filename = g_strdup(filename);
+   priv->watch_monitor = monitor;
+   priv->watch_cancellable = g_cancellable_new();
+   priv->watch_handler =
+      g_signal_connect(monitor, "changed",
+                       G_CALLBACK(bayes_classifier_watch_changed), classifier);
+
+   return TRUE;
+}
+
+/**
+ * bayes_classifier_unwatch_file:
+ * @classifier: (in): A #BayesClassifier.
+ *
+ * Stops reloading the file given to bayes_classifier_watch_file(). The
+ * model currently loaded is kept.
+ */
+void
+bayes_classifier_unwatch_file (BayesClassifier *classifier)
+{
+   BayesClassifierPrivate *priv;
+
+   g_return_if_fail(BAYES_IS_CLASSIFIER(classifier));
+
+   priv = classifier->priv;
+
+   if (priv->watch_monitor) {
+      g_signal_handler_disconnect(priv->watch_monitor, priv->watch_handler);
+      g_file_monitor_cancel(priv->watch_monitor);
+      g_clear_object(&priv->watch_monitor);
+   }
+
+   if (priv->watch_cancellable) {
+      g_cancellable_cancel(priv->watch_cancellable);
+      g_clear_object(&priv->watch_cancellable);
+   }
+
+   g_clear_pointer(&priv->watch_filename, g_free);
+   priv->watch_loading = FALSE;
+   priv->watch_dirty = FALSE;
 }
 
 /**
@@ -372,9 +2813,24 @@ bayes_classifier_finalize (GObject *object)
 {
    BayesClassifier *classifier = (BayesClassifier *)object;
 
+   bayes_classifier_unwatch_file(classifier);
    bayes_classifier_set_tokenizer(classifier, NULL, NULL, NULL);
    bayes_classifier_set_combiner(classifier, NULL, NULL, NULL);
-   g_clear_object(&classifier->priv->storage);
+   bayes_classifier_snapshot_unref(classifier->priv->snapshot);
+   g_mutex_clear(&classifier->priv->snapshot_lock);
+   g_rw_lock_clear(&classifier->priv->lock);
+   _bayes_lru_free(classifier->priv->cache);
+   g_mutex_clear(&classifier->priv->cache_lock);
+   _bayes_bloom_free(classifier->priv->dedup_bloom);
+   _bayes_lru_free(classifier->priv->dedup_recent);
+   g_mutex_clear(&classifier->priv->dedup_lock);
+   g_mutex_clear(&classifier->priv->stats_lock);
+
+   /*
+    * Every queued task holds a reference to @classifier, so the pool is
+    * idle. Do not wait since we might be running on one of its threads.
+    */
+   g_thread_pool_free(classifier->priv->async_pool, FALSE, FALSE);
 
    G_OBJECT_CLASS(bayes_classifier_parent_class)->finalize(object);
 }
@@ -397,6 +2853,19 @@ bayes_classifier_get_property (GObject    *object,
    BayesClassifier *classifier = BAYES_CLASSIFIER(object);
 
    switch (prop_id) {
+   case PROP_CACHE_SIZE:
+      g_value_set_uint(value, bayes_classifier_get_cache_size(classifier));
+      break;
+   case PROP_DEDUP_SIZE:
+      g_value_set_uint(value, bayes_classifier_get_dedup_size(classifier));
+      break;
+   case PROP_MAX_PENDING:
+      g_value_set_uint(value, bayes_classifier_get_max_pending(classifier));
+      break;
+   case PROP_STATS_ENABLED:
+      g_value_set_boolean(value,
+                          bayes_classifier_get_stats_enabled(classifier));
+      break;
    case PROP_STORAGE:
       g_value_set_object(value, bayes_classifier_get_storage(classifier));
       break;
@@ -423,6 +2892,19 @@ bayes_classifier_set_property (GObject      *object,
    BayesClassifier *classifier = BAYES_CLASSIFIER(object);
 
    switch (prop_id) {
+   case PROP_CACHE_SIZE:
+      bayes_classifier_set_cache_size(classifier, g_value_get_uint(value));
+      break;
+   case PROP_DEDUP_SIZE:
+      bayes_classifier_set_dedup_size(classifier, g_value_get_uint(value));
+      break;
+   case PROP_MAX_PENDING:
+      bayes_classifier_set_max_pending(classifier, g_value_get_uint(value));
+      break;
+   case PROP_STATS_ENABLED:
+      bayes_classifier_set_stats_enabled(classifier,
+                                         g_value_get_boolean(value));
+      break;
    case PROP_STORAGE:
       bayes_classifier_set_storage(classifier, g_value_get_object(value));
       break;
@@ -448,6 +2930,74 @@ bayes_classifier_class_init (BayesClassifierClass *klass)
    object_class->set_property = bayes_classifier_set_property;
    g_type_class_add_private(object_class, sizeof(BayesClassifierPrivate));
 
+   /**
+    * BayesClassifier:cache-size:
+    *
+    * The "cache-size" property. The number of results of
+    * bayes_classifier_guess() to remember, or 0 to disable the cache.
+    */
+   gParamSpecs[PROP_CACHE_SIZE] =
+      g_param_spec_uint("cache-size",
+                        _("Cache Size"),
+                        _("The number of guess results to remember."),
+                        0,
+                        G_MAXUINT,
+                        0,
+                        G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_CACHE_SIZE,
+                                   gParamSpecs[PROP_CACHE_SIZE]);
+
+   /**
+    * BayesClassifier:dedup-size:
+    *
+    * The "dedup-size" property. The number of trained documents to
+    * remember so that training them again is skipped, or 0 to train
+    * every document.
+    */
+   gParamSpecs[PROP_DEDUP_SIZE] =
+      g_param_spec_uint("dedup-size",
+                        _("Dedup Size"),
+                        _("The number of trained documents to remember."),
+                        0,
+                        G_MAXUINT,
+                        0,
+                        G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_DEDUP_SIZE,
+                                   gParamSpecs[PROP_DEDUP_SIZE]);
+
+   /**
+    * BayesClassifier:max-pending:
+    *
+    * The "max-pending" property. The maximum number of asynchronous
+    * operations that may be pending before new ones fail with
+    * %G_IO_ERROR_BUSY.
+    */
+   gParamSpecs[PROP_MAX_PENDING] =
+      g_param_spec_uint("max-pending",
+                        _("Max Pending"),
+                        _("The maximum number of pending async operations."),
+                        1,
+                        G_MAXINT,
+                        DEFAULT_MAX_PENDING,
+                        G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_MAX_PENDING,
+                                   gParamSpecs[PROP_MAX_PENDING]);
+
+   /**
+    * BayesClassifier:stats-enabled:
+    *
+    * The "stats-enabled" property. If counters and timers should be
+    * collected for bayes_classifier_get_stats().
+    */
+   gParamSpecs[PROP_STATS_ENABLED] =
+      g_param_spec_boolean("stats-enabled",
+                           _("Stats Enabled"),
+                           _("If stats should be collected."),
+                           FALSE,
+                           G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_STATS_ENABLED,
+                                   gParamSpecs[PROP_STATS_ENABLED]);
+
    /**
     * BayesClassifier:storage:
     *
@@ -477,6 +3027,25 @@ bayes_classifier_init (BayesClassifier *classifier)
       G_TYPE_INSTANCE_GET_PRIVATE(classifier,
                                   BAYES_TYPE_CLASSIFIER,
                                   BayesClassifierPrivate);
+   g_rw_lock_init(&classifier->priv->lock);
+   g_mutex_init(&classifier->priv->snapshot_lock);
+   g_mutex_init(&classifier->priv->cache_lock);
+   classifier->priv->cache = _bayes_lru_new(0,
+                                            _bayes_fingerprint_hash,
+                                            _bayes_fingerprint_equal,
+                                            g_free,
+                                            cache_entry_free);
+   g_mutex_init(&classifier->priv->dedup_lock);
+   classifier->priv->dedup_recent = _bayes_lru_new(0,
+                                                   _bayes_fingerprint_hash,
+                                                   _bayes_fingerprint_equal,
+                                                   g_free,
+                                                   NULL);
+   g_mutex_init(&classifier->priv->stats_lock);
+   classifier->priv->max_pending = DEFAULT_MAX_PENDING;
+   classifier->priv->async_pool =
+      g_thread_pool_new(bayes_classifier_async_worker, NULL,
+                        _bayes_parallel_get_n_threads(), FALSE, NULL);
    bayes_classifier_set_tokenizer(classifier, NULL, NULL, NULL);
    bayes_classifier_set_combiner(classifier, NULL, NULL, NULL);
    bayes_classifier_set_storage(classifier, NULL);
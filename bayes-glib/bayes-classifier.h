@@ -19,8 +19,12 @@
 #ifndef BAYES_CLASSIFIER_H
 #define BAYES_CLASSIFIER_H
 
-#include <glib-object.h>
+#include <gio/gio.h>
 
+#include "bayes-batch-result.h"
+#include "bayes-combiner.h"
+#include "bayes-document.h"
+#include "bayes-guess.h"
 #include "bayes-storage.h"
 #include "bayes-tokenizer.h"
 
@@ -37,6 +41,8 @@ G_BEGIN_DECLS
 typedef struct _BayesClassifier        BayesClassifier;
 typedef struct _BayesClassifierClass   BayesClassifierClass;
 typedef struct _BayesClassifierPrivate BayesClassifierPrivate;
+typedef struct _BayesFeature           BayesFeature;
+typedef struct _BayesStats             BayesStats;
 
 struct _BayesClassifier
 {
@@ -51,20 +57,140 @@ struct _BayesClassifierClass
    GObjectClass parent_class;
 };
 
-BayesStorage    *bayes_classifier_get_storage   (BayesClassifier *classifier);
-GType            bayes_classifier_get_type      (void) G_GNUC_CONST;
-GList           *bayes_classifier_guess         (BayesClassifier *classifier,
-                                                 const gchar     *text);
-BayesClassifier *bayes_classifier_new           (void);
-void             bayes_classifier_set_storage   (BayesClassifier *classifier,
-                                                 BayesStorage    *storage);
-void             bayes_classifier_set_tokenizer (BayesClassifier *classifier,
-                                                 BayesTokenizer   tokenizer,
-                                                 gpointer         user_data,
-                                                 GDestroyNotify   notify);
-void             bayes_classifier_train         (BayesClassifier *classifier,
-                                                 const gchar     *name,
-                                                 const gchar     *text);
+/**
+ * BayesFeature:
+ * @name: The name of the feature or %NULL to use @id.
+ * @id: The identifier of the feature if @name is %NULL.
+ * @weight: How many times the feature was observed.
+ *
+ * #BayesFeature is a feature of a document that was extracted by the
+ * caller rather than by a #BayesTokenizer, such as a header flag or a
+ * bucketed model output. See bayes_classifier_train_features().
+ *
+ * Features identified by @id are stored as the token "#" followed by the
+ * identifier in decimal.
+ */
+struct _BayesFeature
+{
+   const gchar *name;
+   guint        id;
+   gdouble      weight;
+};
+
+/**
+ * BayesStats:
+ * @n_documents: Documents tokenized for training or guessing.
+ * @n_tokens: Tokens produced by the tokenizer.
+ * @n_unique_tokens: Tokens added to the vocabulary of a
+ *   #BayesStorageMemory by training.
+ * @n_lookups: Token probabilities read from the storage.
+ * @n_cache_hits: Guesses answered from the cache.
+ * @n_hash_probes: Hash table lookups made in a #BayesStorageMemory. Tokens
+ *   its vocabulary filter knows were never trained are not looked up.
+ * @tokenize_nsec: Nanoseconds spent in the tokenizer.
+ * @lookup_nsec: Nanoseconds spent reading token probabilities.
+ * @combine_nsec: Nanoseconds spent in the combiner.
+ *
+ * #BayesStats contains the counters of a #BayesClassifier while
+ * #BayesClassifier:stats-enabled is set. See bayes_classifier_get_stats().
+ */
+struct _BayesStats
+{
+   guint64 n_documents;
+   guint64 n_tokens;
+   guint64 n_unique_tokens;
+   guint64 n_lookups;
+   guint64 n_cache_hits;
+   guint64 n_hash_probes;
+   guint64 tokenize_nsec;
+   guint64 lookup_nsec;
+   guint64 combine_nsec;
+};
+
+guint             bayes_classifier_get_cache_size    (BayesClassifier      *classifier);
+void              bayes_classifier_get_cache_stats   (BayesClassifier      *classifier,
+                                                      guint64              *hits,
+                                                      guint64              *misses);
+guint             bayes_classifier_get_dedup_size    (BayesClassifier      *classifier);
+void              bayes_classifier_get_dedup_stats   (BayesClassifier      *classifier,
+                                                      guint64              *unique,
+                                                      guint64              *duplicates);
+guint             bayes_classifier_get_max_pending   (BayesClassifier      *classifier);
+void              bayes_classifier_get_stats         (BayesClassifier      *classifier,
+                                                      BayesStats           *stats);
+gboolean          bayes_classifier_get_stats_enabled (BayesClassifier      *classifier);
+BayesStorage     *bayes_classifier_get_storage       (BayesClassifier      *classifier);
+GType             bayes_classifier_get_type          (void) G_GNUC_CONST;
+GList            *bayes_classifier_guess             (BayesClassifier      *classifier,
+                                                      const gchar          *text);
+void              bayes_classifier_guess_async       (BayesClassifier      *classifier,
+                                                      const gchar          *text,
+                                                      GCancellable         *cancellable,
+                                                      GAsyncReadyCallback   callback,
+                                                      gpointer              user_data);
+BayesBatchResult *bayes_classifier_guess_batch       (BayesClassifier      *classifier,
+                                                      const gchar * const  *texts);
+BayesGuess       *bayes_classifier_guess_best        (BayesClassifier      *classifier,
+                                                      const gchar          *text);
+GList            *bayes_classifier_guess_document    (BayesClassifier      *classifier,
+                                                      BayesDocument        *document);
+GList            *bayes_classifier_guess_features    (BayesClassifier      *classifier,
+                                                      const BayesFeature   *features,
+                                                      guint                 n_features);
+GList            *bayes_classifier_guess_finish      (BayesClassifier      *classifier,
+                                                      GAsyncResult         *result,
+                                                      GError              **error);
+BayesBatchResult *bayes_classifier_guess_many        (BayesClassifier      *classifier,
+                                                      GBytes               *texts);
+gboolean          bayes_classifier_import_delta      (BayesClassifier      *classifier,
+                                                      GBytes               *delta,
+                                                      GError              **error);
+BayesClassifier  *bayes_classifier_new               (void);
+void              bayes_classifier_reset_stats       (BayesClassifier      *classifier);
+void              bayes_classifier_set_cache_size    (BayesClassifier      *classifier,
+                                                      guint                 cache_size);
+void              bayes_classifier_set_combiner      (BayesClassifier      *classifier,
+                                                      BayesCombiner         combiner,
+                                                      gpointer              user_data,
+                                                      GDestroyNotify        notify);
+void              bayes_classifier_set_dedup_size    (BayesClassifier      *classifier,
+                                                      guint                 dedup_size);
+void              bayes_classifier_set_max_pending   (BayesClassifier      *classifier,
+                                                      guint                 max_pending);
+void              bayes_classifier_set_stats_enabled (BayesClassifier      *classifier,
+                                                      gboolean              stats_enabled);
+void              bayes_classifier_set_storage       (BayesClassifier      *classifier,
+                                                      BayesStorage         *storage);
+void              bayes_classifier_set_tokenizer     (BayesClassifier      *classifier,
+                                                      BayesTokenizer        tokenizer,
+                                                      gpointer              user_data,
+                                                      GDestroyNotify        notify);
+void              bayes_classifier_train             (BayesClassifier      *classifier,
+                                                      const gchar          *name,
+                                                      const gchar          *text);
+void              bayes_classifier_train_async       (BayesClassifier      *classifier,
+                                                      const gchar          *name,
+                                                      const gchar          *text,
+                                                      GCancellable         *cancellable,
+                                                      GAsyncReadyCallback   callback,
+                                                      gpointer              user_data);
+void              bayes_classifier_train_batch       (BayesClassifier      *classifier,
+                                                      const gchar * const  *names,
+                                                      const gchar * const  *texts);
+void              bayes_classifier_train_features    (BayesClassifier      *classifier,
+                                                      const gchar          *name,
+                                                      const BayesFeature   *features,
+                                                      guint                 n_features);
+gboolean          bayes_classifier_train_finish      (BayesClassifier      *classifier,
+                                                      GAsyncResult         *result,
+                                                      GError              **error);
+void              bayes_classifier_train_many        (BayesClassifier      *classifier,
+                                                      const gchar * const  *names,
+                                                      GBytes               *texts);
+void              bayes_classifier_unwatch_file      (BayesClassifier      *classifier);
+gboolean          bayes_classifier_watch_file        (BayesClassifier      *classifier,
+                                                      const gchar          *filename,
+                                                      GError              **error);
 
 G_END_DECLS
 
@@ -0,0 +1,72 @@
+/* bayes-combiner-private.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_COMBINER_PRIVATE_H
+#define BAYES_COMBINER_PRIVATE_H
+
+#include "bayes-combiner.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Token probabilities are clamped to this range before being combined so
+ * that a single token can never veto a classification on its own. This
+ * matches the range produced by #BayesStorageMemory.
+ */
+#define BAYES_PROBABILITY_MIN 0.0001
+#define BAYES_PROBABILITY_MAX 0.9999
+
+/*
+ * BayesEvidence is the log-domain summary of a set of token
+ * probabilities. Every built-in combiner is a function of these sums,
+ * which lets the classifier accumulate them incrementally.
+ */
+typedef struct
+{
+   gdouble log_v;         /* Sum of log(1 - p) */
+   gdouble log_w;         /* Sum of log(p) for tokens with an opinion */
+   gdouble n_tokens;      /* Number of tokens seen */
+   gdouble n_informative; /* Number of tokens with an opinion */
+} BayesEvidence;
+
+typedef gdouble (*BayesEvidenceFunc) (const BayesEvidence *evidence);
+
+G_GNUC_INTERNAL
+BayesEvidenceFunc _bayes_combiner_get_evidence_func   (BayesCombiner        combiner);
+G_GNUC_INTERNAL
+void              _bayes_evidence_accumulate          (BayesEvidence       *evidence,
+                                                       const gdouble       *probabilities,
+                                                       guint                n_probabilities);
+G_GNUC_INTERNAL
+void              _bayes_evidence_accumulate_weighted (BayesEvidence       *evidence,
+                                                       const gdouble       *probabilities,
+                                                       const gdouble       *weights,
+                                                       guint                n_probabilities);
+G_GNUC_INTERNAL
+void              _bayes_evidence_add_best_case       (BayesEvidence       *evidence,
+                                                       gdouble              n_tokens);
+G_GNUC_INTERNAL
+gdouble           _bayes_evidence_fisher              (const BayesEvidence *evidence);
+G_GNUC_INTERNAL
+gdouble           _bayes_evidence_naive               (const BayesEvidence *evidence);
+G_GNUC_INTERNAL
+gdouble           _bayes_evidence_robinson            (const BayesEvidence *evidence);
+
+G_END_DECLS
+
+#endif /* BAYES_COMBINER_PRIVATE_H */
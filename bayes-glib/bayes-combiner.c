@@ -0,0 +1,472 @@
+/* bayes-combiner.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+
+#include "bayes-combiner.h"
+#include "bayes-combiner-private.h"
+
+/**
+ * SECTION:bayes-combiner
+ * @title: BayesCombiner
+ * @short_description: Reusable combiners for token probabilities.
+ *
+ * #BayesCombiner callbacks combine the probabilities of the individual
+ * tokens within a document into a single probability for a
+ * classification. See bayes_classifier_set_combiner().
+ *
+ * The built-in combiners work on sums of logarithms rather than
+ * products of probabilities, so they do not underflow on long
+ * documents.
+ *
+ * bayes_combiner_robinson() is the default and matches the behavior of
+ * earlier releases. bayes_combiner_fisher() uses Fisher's method of
+ * combining probabilities with an inverse chi-square test and tends to
+ * be more decisive. bayes_combiner_naive() is the naive Bayes product of
+ * odds and is the cheapest of the three.
+ */
+
+/*
+ * Number of independent accumulators used by _bayes_evidence_accumulate().
+ * Keeping several running products breaks the serial dependency between
+ * iterations so the compiler may vectorize the loop.
+ */
+#define N_LANES 4
+
+/*
+ * Every factor is at least BAYES_PROBABILITY_MIN, so a lane may safely
+ * multiply this many factors before its exponent has to be folded into
+ * the integer accumulator.
+ */
+#define RENORMALIZE_INTERVAL 64
+
+#define LOG_FACTORIAL_TABLE_SIZE 1024
+
+/*
+ * Terms of the chi-square series smaller than this, relative to the
+ * largest term, do not change the result at double precision.
+ */
+#define CHI2_EPSILON 1e-17
+
+static gdouble gLogFactorial[LOG_FACTORIAL_TABLE_SIZE];
+
+static inline gdouble
+log_factorial (guint n)
+{
+   static gsize initialized = FALSE;
+   guint i;
+
+   if (g_once_init_enter(&initialized)) {
+      gLogFactorial[0] = 0.0;
+      for (i = 1; i < G_N_ELEMENTS(gLogFactorial); i++) {
+         gLogFactorial[i] = gLogFactorial[i - 1] + log(i);
+      }
+      g_once_init_leave(&initialized, TRUE);
+   }
+
+   if (n < G_N_ELEMENTS(gLogFactorial)) {
+      return gLogFactorial[n];
+   }
+
+   return lgamma(n + 1.0);
+}
+
+static inline gdouble
+chi2_term (gdouble m,
+           gdouble log_m,
+           guint   i)
+{
+   return -m + i * log_m - log_factorial(i);
+}
+
+/*
+ * Computes the survival function of the chi-square distribution for an
+ * even number of degrees of freedom @v. The series is evaluated around
+ * its largest term in the log domain so that it neither underflows for
+ * large @x2 nor needs to visit every term.
+ */
+static gdouble
+chi2q (gdouble x2,
+       guint   v)
+{
+   gdouble log_peak;
+   gdouble log_m;
+   gdouble sum;
+   gdouble t;
+   gdouble m;
+   guint half;
+   guint peak;
+   guint i;
+
+   g_assert(v && !(v & 1));
+
+   m = x2 / 2.0;
+   half = v / 2;
+
+   if (m <= 0.0) {
+      return 1.0;
+   }
+
+   log_m = log(m);
+   peak = (guint)MIN(floor(m), half - 1);
+   log_peak = chi2_term(m, log_m, peak);
+
+   sum = 0.0;
+
+   i = peak;
+   do {
+      t = exp(chi2_term(m, log_m, i) - log_peak);
+      sum += t;
+   } while (t >= CHI2_EPSILON && i-- > 0);
+
+   for (i = peak + 1; i < half; i++) {
+      t = exp(chi2_term(m, log_m, i) - log_peak);
+      sum += t;
+      if (t < CHI2_EPSILON) {
+         break;
+      }
+   }
+
+   return MIN(1.0, exp(log_peak + log(sum)));
+}
+
+/**
+ * _bayes_evidence_accumulate:
+ * @evidence: (inout): A #BayesEvidence.
+ * @probabilities: (in): Per-token probabilities.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ *
+ * Adds the log-domain sums of @probabilities to @evidence.
+ *
+ * Rather than calling log() per token, the products are kept in
+ * several lanes and periodically split into mantissa and exponent with
+ * frexp(). That keeps the inner loop to multiplies and selects while
+ * still never underflowing.
+ */
+void
+_bayes_evidence_accumulate (BayesEvidence *evidence,
+                            const gdouble *probabilities,
+                            guint          n_probabilities)
+{
+   gdouble v[N_LANES];
+   gdouble w[N_LANES];
+   guint neutral[N_LANES];
+   gdouble g;
+   gdouble c;
+   guint lane;
+   guint end;
+   guint i;
+   gint v_exp = 0;
+   gint w_exp = 0;
+   gint e;
+
+   g_return_if_fail(evidence);
+   g_return_if_fail(probabilities || !n_probabilities);
+
+   for (lane = 0; lane < N_LANES; lane++) {
+      v[lane] = 1.0;
+      w[lane] = 1.0;
+      neutral[lane] = 0;
+   }
+
+   for (i = 0; i < n_probabilities;) {
+      end = i + MIN(n_probabilities - i, RENORMALIZE_INTERVAL * N_LANES);
+
+      for (; i + N_LANES <= end; i += N_LANES) {
+         for (lane = 0; lane < N_LANES; lane++) {
+            g = probabilities[i + lane];
+            c = CLAMP(g, BAYES_PROBABILITY_MIN, BAYES_PROBABILITY_MAX);
+            neutral[lane] += (g == 0.0);
+            v[lane] *= (g == 0.0) ? 1.0 : (1.0 - c);
+            w[lane] *= (g == 0.0) ? 1.0 : c;
+         }
+      }
+
+      for (; i < end; i++) {
+         g = probabilities[i];
+         c = CLAMP(g, BAYES_PROBABILITY_MIN, BAYES_PROBABILITY_MAX);
+         neutral[0] += (g == 0.0);
+         v[0] *= (g == 0.0) ? 1.0 : (1.0 - c);
+         w[0] *= (g == 0.0) ? 1.0 : c;
+      }
+
+      for (lane = 0; lane < N_LANES; lane++) {
+         v[lane] = frexp(v[lane], &e);
+         v_exp += e;
+         w[lane] = frexp(w[lane], &e);
+         w_exp += e;
+      }
+   }
+
+   for (lane = 1; lane < N_LANES; lane++) {
+      v[0] *= v[lane];
+      w[0] *= w[lane];
+      neutral[0] += neutral[lane];
+   }
+
+   evidence->log_v += log(v[0]) + v_exp * G_LN2;
+   evidence->log_w += log(w[0]) + w_exp * G_LN2;
+   evidence->n_tokens += n_probabilities;
+   evidence->n_informative += n_probabilities - neutral[0];
+}
+
+/**
+ * _bayes_evidence_accumulate_weighted:
+ * @evidence: (inout): A #BayesEvidence.
+ * @probabilities: (in): Per-token probabilities.
+ * @weights: (in): The weight of each probability.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ *
+ * Like _bayes_evidence_accumulate() but each probability counts as if it
+ * had been seen as many times as its weight, which need not be whole.
+ * Negative weights are treated as 0.
+ */
+void
+_bayes_evidence_accumulate_weighted (BayesEvidence *evidence,
+                                     const gdouble *probabilities,
+                                     const gdouble *weights,
+                                     guint          n_probabilities)
+{
+   gdouble weight;
+   gdouble g;
+   gdouble c;
+   guint i;
+
+   g_return_if_fail(evidence);
+   g_return_if_fail(probabilities || !n_probabilities);
+   g_return_if_fail(weights || !n_probabilities);
+
+   for (i = 0; i < n_probabilities; i++) {
+      g = probabilities[i];
+      weight = MAX(weights[i], 0.0);
+      evidence->n_tokens += weight;
+      if (g != 0.0) {
+         c = CLAMP(g, BAYES_PROBABILITY_MIN, BAYES_PROBABILITY_MAX);
+         evidence->log_v += weight * log(1.0 - c);
+         evidence->log_w += weight * log(c);
+         evidence->n_informative += weight;
+      }
+   }
+}
+
+/**
+ * _bayes_evidence_add_best_case:
+ * @evidence: (inout): A #BayesEvidence.
+ * @n_tokens: (in): The number of tokens not yet accumulated.
+ *
+ * Adds @n_tokens tokens of the highest possible probability to
+ * @evidence. Every built-in combiner is monotonic in each of the
+ * probabilities, so the result of combining @evidence afterwards is an
+ * upper bound for the final score.
+ */
+void
+_bayes_evidence_add_best_case (BayesEvidence *evidence,
+                               gdouble        n_tokens)
+{
+   g_return_if_fail(evidence);
+
+   evidence->log_v += n_tokens * log(1.0 - BAYES_PROBABILITY_MAX);
+   evidence->log_w += n_tokens * log(BAYES_PROBABILITY_MAX);
+   evidence->n_tokens += n_tokens;
+   evidence->n_informative += n_tokens;
+}
+
+/**
+ * _bayes_evidence_robinson:
+ * @evidence: (in): A #BayesEvidence.
+ *
+ * Robinson's geometric mean combiner. Tokens without an opinion count
+ * towards the number of tokens and, as in earlier releases, saturate the
+ * "not" side of the test.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+_bayes_evidence_robinson (const BayesEvidence *evidence)
+{
+   gdouble nth;
+   gdouble P;
+   gdouble Q;
+   gdouble S;
+
+   g_return_val_if_fail(evidence, 0.0);
+
+   if (!evidence->n_tokens) {
+      return 0.5;
+   }
+
+   nth = 1.0 / evidence->n_tokens;
+
+   P = -expm1(evidence->log_v * nth);
+   Q = (evidence->n_informative < evidence->n_tokens)
+       ? 1.0
+       : -expm1(evidence->log_w * nth);
+
+   if ((P + Q) == 0.0) {
+      return 0.5;
+   }
+
+   S = (P - Q) / (P + Q);
+
+   return (1.0 + S) / 2.0;
+}
+
+/**
+ * _bayes_evidence_fisher:
+ * @evidence: (in): A #BayesEvidence.
+ *
+ * Fisher's method, as popularized by SpamBayes. Both the evidence for
+ * and against the classification are tested with an inverse chi-square
+ * and the two results are averaged. Tokens without an opinion are
+ * ignored.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+_bayes_evidence_fisher (const BayesEvidence *evidence)
+{
+   gdouble S;
+   gdouble H;
+   guint v;
+
+   g_return_val_if_fail(evidence, 0.0);
+
+   if (evidence->n_informative < 1.0) {
+      return 0.5;
+   }
+
+   v = 2 * (guint)evidence->n_informative;
+
+   S = 1.0 - chi2q(-2.0 * evidence->log_v, v);
+   H = 1.0 - chi2q(-2.0 * evidence->log_w, v);
+
+   return CLAMP((1.0 + S - H) / 2.0, 0.0, 1.0);
+}
+
+/**
+ * _bayes_evidence_naive:
+ * @evidence: (in): A #BayesEvidence.
+ *
+ * The naive Bayes combination of independent probabilities, computed as
+ * the logistic function of the summed log-odds. Tokens without an
+ * opinion are ignored.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+_bayes_evidence_naive (const BayesEvidence *evidence)
+{
+   g_return_val_if_fail(evidence, 0.0);
+
+   if (!evidence->n_informative) {
+      return 0.5;
+   }
+
+   return 1.0 / (1.0 + exp(evidence->log_v - evidence->log_w));
+}
+
+/**
+ * _bayes_combiner_get_evidence_func:
+ * @combiner: (in): A #BayesCombiner.
+ *
+ * Retrieves the log-domain implementation of @combiner if it is one of
+ * the built-in combiners.
+ *
+ * Returns: A #BayesEvidenceFunc or %NULL for custom combiners.
+ */
+BayesEvidenceFunc
+_bayes_combiner_get_evidence_func (BayesCombiner combiner)
+{
+   if (combiner == bayes_combiner_robinson) {
+      return _bayes_evidence_robinson;
+   } else if (combiner == bayes_combiner_fisher) {
+      return _bayes_evidence_fisher;
+   } else if (combiner == bayes_combiner_naive) {
+      return _bayes_evidence_naive;
+   }
+
+   return NULL;
+}
+
+static inline gdouble
+combine (BayesEvidenceFunc  func,
+         const gdouble     *probabilities,
+         guint              n_probabilities)
+{
+   BayesEvidence evidence = { 0 };
+
+   _bayes_evidence_accumulate(&evidence, probabilities, n_probabilities);
+   return func(&evidence);
+}
+
+/**
+ * bayes_combiner_robinson:
+ * @probabilities: (in) (array length=n_probabilities): Per-token probabilities.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ * @user_data: (in): Unused.
+ *
+ * Combines @probabilities using Gary Robinson's geometric mean test.
+ * This is the default combiner of #BayesClassifier.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_combiner_robinson (const gdouble *probabilities,
+                         guint          n_probabilities,
+                         gpointer       user_data)
+{
+   return combine(_bayes_evidence_robinson, probabilities, n_probabilities);
+}
+
+/**
+ * bayes_combiner_fisher:
+ * @probabilities: (in) (array length=n_probabilities): Per-token probabilities.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ * @user_data: (in): Unused.
+ *
+ * Combines @probabilities using Fisher's method and an inverse
+ * chi-square test, as done by SpamBayes.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_combiner_fisher (const gdouble *probabilities,
+                       guint          n_probabilities,
+                       gpointer       user_data)
+{
+   return combine(_bayes_evidence_fisher, probabilities, n_probabilities);
+}
+
+/**
+ * bayes_combiner_naive:
+ * @probabilities: (in) (array length=n_probabilities): Per-token probabilities.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ * @user_data: (in): Unused.
+ *
+ * Combines @probabilities as independent naive Bayes evidence by
+ * summing their log-odds.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_combiner_naive (const gdouble *probabilities,
+                      guint          n_probabilities,
+                      gpointer       user_data)
+{
+   return combine(_bayes_evidence_naive, probabilities, n_probabilities);
+}
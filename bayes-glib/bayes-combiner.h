@@ -0,0 +1,57 @@
+/* bayes-combiner.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_COMBINER_H
+#define BAYES_COMBINER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/**
+ * BayesCombiner:
+ * @probabilities: (in) (array length=n_probabilities): Per-token probabilities.
+ * @n_probabilities: (in): The number of elements in @probabilities.
+ * @user_data: (in): User data provided during registration.
+ *
+ * #BayesCombiner is a callback that combines the probabilities of the
+ * individual tokens of a document, as returned from
+ * bayes_storage_get_token_probability(), into the probability that the
+ * document belongs to a classification.
+ *
+ * A probability of 0.0 means the storage had no opinion on the token.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+typedef gdouble (*BayesCombiner) (const gdouble *probabilities,
+                                  guint          n_probabilities,
+                                  gpointer       user_data);
+
+gdouble bayes_combiner_fisher   (const gdouble *probabilities,
+                                 guint          n_probabilities,
+                                 gpointer       user_data);
+gdouble bayes_combiner_naive    (const gdouble *probabilities,
+                                 guint          n_probabilities,
+                                 gpointer       user_data);
+gdouble bayes_combiner_robinson (const gdouble *probabilities,
+                                 guint          n_probabilities,
+                                 gpointer       user_data);
+
+G_END_DECLS
+
+#endif /* BAYES_COMBINER_H */
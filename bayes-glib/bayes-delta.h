@@ -0,0 +1,96 @@
+/* bayes-delta.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_DELTA_H
+#define BAYES_DELTA_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A delta holds token counts added to a storage since a checkpoint, as
+ * written by bayes_storage_memory_export_delta() and applied by
+ * bayes_storage_import_delta(). It has no alignment or byte order:
+ *
+ *   magic      - "BAYESDLT"
+ *   version    - varint, BAYES_DELTA_VERSION
+ *   n_classes  - varint, followed by each class name as a varint
+ *                length and its bytes
+ *   n_tokens   - varint, followed by each token in strcmp() order as
+ *                the varint length of the prefix it shares with the
+ *                previous token, the varint length of the rest of it
+ *                and its bytes, then the varint number of classes it
+ *                was added to and for each the varint index of the
+ *                class in the names above and the varint count added
+ *
+ * Sorting the tokens lets their common prefixes be left out.
+ */
+#define BAYES_DELTA_MAGIC   "BAYESDLT"
+#define BAYES_DELTA_VERSION 1
+
+/*
+ * Unsigned integers are written 7 bits at a time, least significant
+ * first, with the high bit of every byte but the last one set. Small
+ * values such as counts and lengths take a single byte.
+ */
+
+static inline void
+_bayes_varint_append (GByteArray *buffer,
+                      guint64     value)
+{
+   guint8 byte;
+
+   do {
+      byte = value & 0x7F;
+      value >>= 7;
+      if (value) {
+         byte |= 0x80;
+      }
+      g_byte_array_append(buffer, &byte, 1);
+   } while (value);
+}
+
+/*
+ * Reads a varint at *@data, advancing it. Returns %FALSE if the varint
+ * runs past @end or does not fit in 64 bits.
+ */
+static inline gboolean
+_bayes_varint_read (const guint8 **data,
+                    const guint8  *end,
+                    guint64       *value)
+{
+   guint64 result = 0;
+   guint shift;
+   guint8 byte;
+
+   for (shift = 0; *data < end && shift < 64; shift += 7) {
+      byte = *(*data)++;
+      result |= (guint64)(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+         *value = result;
+         return TRUE;
+      }
+   }
+
+   return FALSE;
+}
+
+G_END_DECLS
+
+#endif /* BAYES_DELTA_H */
@@ -0,0 +1,234 @@
+/* bayes-document.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bayes-document.h"
+#include "bayes-document-private.h"
+
+/**
+ * SECTION:bayes-document
+ * @title: BayesDocument
+ * @short_description: Text that has been tokenized ahead of time.
+ * @see_also: bayes_classifier_guess_document()
+ *
+ * #BayesDocument holds the tokens of a piece of text along with how
+ * often each of them occurs. When the same text is classified by many
+ * classifiers, such as a SPAM, a language and a topic classifier, it can
+ * be tokenized once into a #BayesDocument and passed to
+ * bayes_classifier_guess_document() of each of them.
+ *
+ * A document is only used as is by classifiers using the same tokenizer
+ * and user data it was created with. Other classifiers tokenize its text
+ * again.
+ *
+ * The #BayesDocument structure is a reference counted #GBoxed type.
+ * You can reference the structure with bayes_document_ref() and free
+ * the structure with bayes_document_unref().
+ */
+
+/**
+ * bayes_document_new:
+ * @text: (in): The text of the document.
+ * @tokenizer: (in) (allow-none) (scope call): A #BayesTokenizer or %NULL.
+ * @user_data: (in): User data for @tokenizer.
+ *
+ * Creates a new #BayesDocument by tokenizing @text with @tokenizer. If
+ * @tokenizer is %NULL, bayes_tokenizer_word() is used, which is also the
+ * default tokenizer of #BayesClassifier.
+ *
+ * @tokenizer and @user_data are only compared against those of a
+ * classifier later on and are not called again.
+ *
+ * Returns: (transfer full): A newly allocated #BayesDocument.
+ */
+BayesDocument *
+bayes_document_new (const gchar    *text,
+                    BayesTokenizer  tokenizer,
+                    gpointer        user_data)
+{
+   BayesDocument *document;
+   GHashTable *distinct;
+   GPtrArray *tokens;
+   GArray *counts;
+   gpointer index;
+   gchar **strv;
+   guint one = 1;
+   guint i;
+
+   g_return_val_if_fail(text, NULL);
+
+   if (!tokenizer) {
+      tokenizer = bayes_tokenizer_word;
+      user_data = NULL;
+   }
+
+   document = g_slice_new0(BayesDocument);
+   document->ref_count = 1;
+   document->tokenizer = tokenizer;
+   document->user_data = user_data;
+   document->text = g_strdup(text);
+
+   tokens = g_ptr_array_new();
+   counts = g_array_new(FALSE, FALSE, sizeof(guint));
+   distinct = g_hash_table_new(g_str_hash, g_str_equal);
+
+   if ((strv = tokenizer(text, user_data))) {
+      for (i = 0; strv[i]; i++) {
+         if (g_hash_table_lookup_extended(distinct, strv[i], NULL, &index)) {
+            g_array_index(counts, guint, GPOINTER_TO_UINT(index))++;
+            g_free(strv[i]);
+         } else {
+            g_hash_table_insert(distinct, strv[i],
+                                GUINT_TO_POINTER(tokens->len));
+            g_ptr_array_add(tokens, strv[i]);
+            g_array_append_val(counts, one);
+         }
+      }
+      document->n_tokens = i;
+
+      /*
+       * The distinct tokens now belong to @tokens.
+       */
+      g_free(strv);
+   }
+
+   g_ptr_array_add(tokens, NULL);
+
+   document->n_distinct = counts->len;
+   document->tokens = (gchar **)g_ptr_array_free(tokens, FALSE);
+   document->counts = (guint *)g_array_free(counts, FALSE);
+
+   g_hash_table_unref(distinct);
+
+   return document;
+}
+
+/**
+ * bayes_document_ref:
+ * @document: (in): A #BayesDocument.
+ *
+ * Increments the reference count of @document by one.
+ *
+ * Returns: The instance provided, @document.
+ */
+BayesDocument *
+bayes_document_ref (BayesDocument *document)
+{
+   g_return_val_if_fail(document != NULL, NULL);
+   g_return_val_if_fail(document->ref_count > 0, NULL);
+
+   g_atomic_int_inc(&document->ref_count);
+   return document;
+}
+
+/**
+ * bayes_document_unref:
+ * @document: (in): A #BayesDocument.
+ *
+ * Decrements the reference count of @document by one. Once the reference
+ * count reaches zero, the structure and allocated resources are released.
+ */
+void
+bayes_document_unref (BayesDocument *document)
+{
+   g_return_if_fail(document != NULL);
+   g_return_if_fail(document->ref_count > 0);
+
+   if (g_atomic_int_dec_and_test(&document->ref_count)) {
+      g_free(document->text);
+      g_strfreev(document->tokens);
+      g_free(document->counts);
+      g_slice_free(BayesDocument, document);
+   }
+}
+
+/**
+ * bayes_document_get_n_tokens:
+ * @document: (in): A #BayesDocument.
+ *
+ * Retrieves the number of tokens in @document, counting every occurrence
+ * of a token.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_document_get_n_tokens (BayesDocument *document)
+{
+   g_return_val_if_fail(document, 0);
+   return document->n_tokens;
+}
+
+/**
+ * bayes_document_get_text:
+ * @document: (in): A #BayesDocument.
+ *
+ * Retrieves the text @document was created from.
+ *
+ * Returns: A string which should not be modified or freed.
+ */
+const gchar *
+bayes_document_get_text (BayesDocument *document)
+{
+   g_return_val_if_fail(document, NULL);
+   return document->text;
+}
+
+/**
+ * bayes_document_get_tokens:
+ * @document: (in): A #BayesDocument.
+ * @counts: (out) (allow-none) (array length=n_tokens) (transfer none): A
+ *   location for the number of occurrences of each token.
+ * @n_tokens: (out) (allow-none): A location for the number of distinct
+ *   tokens.
+ *
+ * Retrieves the distinct tokens of @document in the order they first
+ * appear in the text.
+ *
+ * Returns: (transfer none) (array zero-terminated=1): The tokens.
+ */
+const gchar * const *
+bayes_document_get_tokens (BayesDocument  *document,
+                           const guint   **counts,
+                           guint          *n_tokens)
+{
+   g_return_val_if_fail(document, NULL);
+
+   if (counts) {
+      *counts = document->counts;
+   }
+   if (n_tokens) {
+      *n_tokens = document->n_distinct;
+   }
+
+   return (const gchar * const *)document->tokens;
+}
+
+GType
+bayes_document_get_type (void)
+{
+   static gsize initialized = FALSE;
+   static GType type_id;
+
+   if (g_once_init_enter(&initialized)) {
+      type_id = g_boxed_type_register_static("BayesDocument",
+                                             (GBoxedCopyFunc)bayes_document_ref,
+                                             (GBoxedFreeFunc)bayes_document_unref);
+      g_once_init_leave(&initialized, TRUE);
+   }
+
+   return type_id;
+}
@@ -0,0 +1,46 @@
+/* bayes-document.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_DOCUMENT_H
+#define BAYES_DOCUMENT_H
+
+#include <glib-object.h>
+
+#include "bayes-tokenizer.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_DOCUMENT (bayes_document_get_type())
+
+typedef struct _BayesDocument BayesDocument;
+
+guint                bayes_document_get_n_tokens (BayesDocument  *document);
+const gchar         *bayes_document_get_text     (BayesDocument  *document);
+const gchar * const *bayes_document_get_tokens   (BayesDocument  *document,
+                                                  const guint   **counts,
+                                                  guint          *n_tokens);
+GType                bayes_document_get_type     (void) G_GNUC_CONST;
+BayesDocument       *bayes_document_new          (const gchar    *text,
+                                                  BayesTokenizer  tokenizer,
+                                                  gpointer        user_data);
+BayesDocument       *bayes_document_ref          (BayesDocument  *document);
+void                 bayes_document_unref        (BayesDocument  *document);
+
+G_END_DECLS
+
+#endif /* BAYES_DOCUMENT_H */
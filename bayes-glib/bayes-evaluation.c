@@ -0,0 +1,562 @@
+/* bayes-evaluation.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bayes-classifier-private.h"
+#include "bayes-evaluation.h"
+#include "bayes-guess.h"
+#include "bayes-parallel.h"
+#include "bayes-storage-memory.h"
+#include "bayes-storage-memory-private.h"
+
+/**
+ * SECTION:bayes-evaluation
+ * @title: BayesEvaluation
+ * @short_description: k-fold cross validation of a classifier setup.
+ *
+ * #BayesEvaluation measures how well and how fast a classifier setup,
+ * meaning its tokenizer and combiner, classifies a labelled corpus. The
+ * corpus is split into k folds and every document is guessed by a
+ * classifier trained on the other k - 1 folds.
+ *
+ * Rather than training k classifiers on k - 1 folds each, every fold is
+ * trained once into a storage of its own, and the storage used to guess
+ * a fold is merged from the others. Training, merging and guessing all
+ * run on the shared worker threads.
+ *
+ * The result holds the accuracy, the confusion matrix, the throughput of
+ * guessing and the latency of single guesses. Compare the results of
+ * several setups to choose between them.
+ *
+ * The #BayesEvaluation structure is a reference counted #GBoxed type.
+ * You can reference the structure with bayes_evaluation_ref() and free
+ * the structure with bayes_evaluation_unref().
+ */
+
+struct _BayesEvaluation
+{
+   volatile gint ref_count;
+   guint n_documents;
+   guint n_folds;
+   guint n_classes;
+   guint n_correct;
+   gchar **class_names;
+   guint *confusion;   /* [actual][n_classes + 1], the last one unclassified */
+   gdouble *latencies; /* Seconds per guess, sorted */
+   gdouble train_seconds;
+   gdouble guess_seconds;
+};
+
+typedef struct
+{
+   BayesClassifier      *classifier;
+   const gchar * const  *names;
+   const gchar * const  *texts;
+   guint                 n_documents;
+   guint                 n_folds;
+   GHashTable           *class_ids;
+   BayesStorage        **partials; /* Fold -> storage trained with it */
+   BayesClassifier     **models;   /* Fold -> classifier for guessing it */
+   gint                 *predicted;
+   gdouble              *latencies;
+} Run;
+
+static BayesClassifier *
+run_new_classifier (Run *run)
+{
+   BayesClassifier *classifier;
+   BayesTokenizer tokenizer;
+   BayesCombiner combiner;
+   gpointer user_data;
+
+   classifier = bayes_classifier_new();
+
+   /*
+    * The setup is borrowed from the classifier being evaluated, which
+    * outlives the run. Caches would only skew the timings.
+    */
+   tokenizer = _bayes_classifier_get_tokenizer(run->classifier, &user_data);
+   bayes_classifier_set_tokenizer(classifier, tokenizer, user_data, NULL);
+   combiner = _bayes_classifier_get_combiner(run->classifier, &user_data);
+   bayes_classifier_set_combiner(classifier, combiner, user_data, NULL);
+   bayes_classifier_set_cache_size(classifier, 0);
+   bayes_classifier_set_dedup_size(classifier, 0);
+
+   return classifier;
+}
+
+static void
+run_train_fold (guint    fold,
+                gpointer user_data)
+{
+   BayesClassifier *classifier;
+   Run *run = user_data;
+   guint i;
+
+   classifier = run_new_classifier(run);
+   for (i = fold; i < run->n_documents; i += run->n_folds) {
+      bayes_classifier_train(classifier, run->names[i], run->texts[i]);
+   }
+   run->partials[fold] = g_object_ref(bayes_classifier_get_storage(classifier));
+   g_object_unref(classifier);
+}
+
+static void
+run_merge_fold (guint    fold,
+                gpointer user_data)
+{
+   BayesStorage *storage;
+   Run *run = user_data;
+   guint i;
+
+   storage = bayes_storage_memory_new();
+   for (i = 0; i < run->n_folds; i++) {
+      if (i != fold) {
+         _bayes_storage_memory_merge(BAYES_STORAGE_MEMORY(storage),
+                                     BAYES_STORAGE_MEMORY(run->partials[i]));
+      }
+   }
+
+   run->models[fold] = run_new_classifier(run);
+   bayes_classifier_set_storage(run->models[fold], storage);
+   g_object_unref(storage);
+}
+
+static void
+run_guess_document (guint    document,
+                    gpointer user_data)
+{
+   BayesGuess *guess;
+   Run *run = user_data;
+   gpointer class_id;
+   gint64 begin;
+
+   begin = g_get_monotonic_time();
+   guess = bayes_classifier_guess_best(run->models[document % run->n_folds],
+                                       run->texts[document]);
+   run->latencies[document] = (g_get_monotonic_time() - begin) /
+                              (gdouble)G_USEC_PER_SEC;
+
+   run->predicted[document] = -1;
+   if (guess) {
+      if (g_hash_table_lookup_extended(run->class_ids,
+                                       bayes_guess_get_name(guess),
+                                       NULL, &class_id)) {
+         run->predicted[document] = GPOINTER_TO_INT(class_id);
+      }
+      bayes_guess_unref(guess);
+   }
+}
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+   gdouble da = *(const gdouble *)a;
+   gdouble db = *(const gdouble *)b;
+
+   return (da > db) - (da < db);
+}
+
+/**
+ * bayes_evaluation_new:
+ * @classifier: (in): A #BayesClassifier whose setup is evaluated.
+ * @names: (in) (array zero-terminated=1): The classification of every
+ *   document.
+ * @texts: (in) (array zero-terminated=1): The documents, as many as
+ *   @names.
+ * @n_folds: (in): The number of folds, at least 2.
+ *
+ * Runs a @n_folds-fold cross validation of the tokenizer and combiner of
+ * @classifier on the labelled documents. Document i belongs to fold
+ * i modulo @n_folds. The storage of @classifier is neither used nor
+ * modified.
+ *
+ * Returns: (transfer full): A #BayesEvaluation.
+ */
+BayesEvaluation *
+bayes_evaluation_new (BayesClassifier     *classifier,
+                      const gchar * const *names,
+                      const gchar * const *texts,
+                      guint                n_folds)
+{
+   BayesEvaluation *evaluation;
+   GPtrArray *class_names;
+   gpointer class_id;
+   gint64 begin;
+   guint n_documents;
+   guint actual;
+   guint i;
+   Run run;
+
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+   g_return_val_if_fail(names, NULL);
+   g_return_val_if_fail(texts, NULL);
+   g_return_val_if_fail(g_strv_length((gchar **)names) ==
+                        g_strv_length((gchar **)texts), NULL);
+   g_return_val_if_fail(n_folds >= 2, NULL);
+
+   n_documents = g_strv_length((gchar **)texts);
+   g_return_val_if_fail(n_documents >= n_folds, NULL);
+
+   memset(&run, 0, sizeof run);
+   run.classifier = classifier;
+   run.names = names;
+   run.texts = texts;
+   run.n_documents = n_documents;
+   run.n_folds = n_folds;
+   run.class_ids = g_hash_table_new(g_str_hash, g_str_equal);
+   run.partials = g_new0(BayesStorage *, n_folds);
+   run.models = g_new0(BayesClassifier *, n_folds);
+   run.predicted = g_new(gint, n_documents);
+   run.latencies = g_new(gdouble, n_documents);
+
+   /*
+    * Classifications are numbered in the order they first appear.
+    */
+   class_names = g_ptr_array_new();
+   for (i = 0; i < n_documents; i++) {
+      if (!g_hash_table_lookup_extended(run.class_ids, names[i], NULL, NULL)) {
+         g_hash_table_insert(run.class_ids, (gchar *)names[i],
+                             GINT_TO_POINTER(class_names->len));
+         g_ptr_array_add(class_names, g_strdup(names[i]));
+      }
+   }
+   g_ptr_array_add(class_names, NULL);
+
+   evaluation = g_slice_new0(BayesEvaluation);
+   evaluation->ref_count = 1;
+   evaluation->n_documents = n_documents;
+   evaluation->n_folds = n_folds;
+   evaluation->n_classes = class_names->len - 1;
+   evaluation->class_names = (gchar **)g_ptr_array_free(class_names, FALSE);
+   evaluation->confusion = g_new0(guint, evaluation->n_classes *
+                                         (evaluation->n_classes + 1));
+
+   begin = g_get_monotonic_time();
+   _bayes_parallel_for(n_folds, run_train_fold, &run);
+   _bayes_parallel_for(n_folds, run_merge_fold, &run);
+   evaluation->train_seconds = (g_get_monotonic_time() - begin) /
+                               (gdouble)G_USEC_PER_SEC;
+
+   begin = g_get_monotonic_time();
+   _bayes_parallel_for(n_documents, run_guess_document, &run);
+   evaluation->guess_seconds = (g_get_monotonic_time() - begin) /
+                               (gdouble)G_USEC_PER_SEC;
+
+   for (i = 0; i < n_documents; i++) {
+      g_hash_table_lookup_extended(run.class_ids, names[i], NULL, &class_id);
+      actual = GPOINTER_TO_INT(class_id);
+      if (run.predicted[i] == (gint)actual) {
+         evaluation->n_correct++;
+      }
+      evaluation->confusion[actual * (evaluation->n_classes + 1) +
+                            (run.predicted[i] < 0 ? evaluation->n_classes
+                                                  : (guint)run.predicted[i])]++;
+   }
+
+   qsort(run.latencies, n_documents, sizeof(gdouble), compare_doubles);
+   evaluation->latencies = run.latencies;
+
+   for (i = 0; i < n_folds; i++) {
+      g_object_unref(run.partials[i]);
+      g_object_unref(run.models[i]);
+   }
+   g_free(run.partials);
+   g_free(run.models);
+   g_free(run.predicted);
+   g_hash_table_unref(run.class_ids);
+
+   return evaluation;
+}
+
+/**
+ * bayes_evaluation_ref:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Increments the reference count of @evaluation by one.
+ *
+ * Returns: The instance provided, @evaluation.
+ */
+BayesEvaluation *
+bayes_evaluation_ref (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation != NULL, NULL);
+   g_return_val_if_fail(evaluation->ref_count > 0, NULL);
+
+   g_atomic_int_inc(&evaluation->ref_count);
+   return evaluation;
+}
+
+/**
+ * bayes_evaluation_unref:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Decrements the reference count of @evaluation by one. Once the
+ * reference count reaches zero, the structure and allocated resources
+ * are released.
+ */
+void
+bayes_evaluation_unref (BayesEvaluation *evaluation)
+{
+   g_return_if_fail(evaluation != NULL);
+   g_return_if_fail(evaluation->ref_count > 0);
+
+   if (g_atomic_int_dec_and_test(&evaluation->ref_count)) {
+      g_strfreev(evaluation->class_names);
+      g_free(evaluation->confusion);
+      g_free(evaluation->latencies);
+      g_slice_free(BayesEvaluation, evaluation);
+   }
+}
+
+/**
+ * bayes_evaluation_get_n_documents:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the number of documents that were evaluated.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_evaluation_get_n_documents (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0);
+   return evaluation->n_documents;
+}
+
+/**
+ * bayes_evaluation_get_n_folds:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the number of folds the documents were split into.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_evaluation_get_n_folds (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0);
+   return evaluation->n_folds;
+}
+
+/**
+ * bayes_evaluation_get_n_classes:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the number of classifications found in the documents.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_evaluation_get_n_classes (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0);
+   return evaluation->n_classes;
+}
+
+/**
+ * bayes_evaluation_get_class_names:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the classifications found in the documents, in the order
+ * they first appeared. Their indexes are used by
+ * bayes_evaluation_get_confusion().
+ *
+ * Returns: (transfer none) (array zero-terminated=1): The class names.
+ */
+const gchar * const *
+bayes_evaluation_get_class_names (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, NULL);
+   return (const gchar * const *)evaluation->class_names;
+}
+
+/**
+ * bayes_evaluation_get_accuracy:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the fraction of documents whose best guess was their own
+ * classification.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_evaluation_get_accuracy (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0.0);
+   return (gdouble)evaluation->n_correct / evaluation->n_documents;
+}
+
+/**
+ * bayes_evaluation_get_confusion:
+ * @evaluation: (in): A #BayesEvaluation.
+ * @actual: (in): The index of the classification of the documents.
+ * @predicted: (in): The index of the classification guessed, or -1 for
+ *   documents that could not be classified at all.
+ *
+ * Retrieves the number of documents of classification @actual whose
+ * best guess was @predicted.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_evaluation_get_confusion (BayesEvaluation *evaluation,
+                                guint            actual,
+                                gint             predicted)
+{
+   g_return_val_if_fail(evaluation, 0);
+   g_return_val_if_fail(actual < evaluation->n_classes, 0);
+   g_return_val_if_fail(predicted >= -1, 0);
+   g_return_val_if_fail(predicted < (gint)evaluation->n_classes, 0);
+
+   if (predicted < 0) {
+      predicted = evaluation->n_classes;
+   }
+
+   return evaluation->confusion[actual * (evaluation->n_classes + 1) +
+                                predicted];
+}
+
+/**
+ * bayes_evaluation_get_train_seconds:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the wall clock time taken to train and merge the storage of
+ * every fold.
+ *
+ * Returns: A #gdouble in seconds.
+ */
+gdouble
+bayes_evaluation_get_train_seconds (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0.0);
+   return evaluation->train_seconds;
+}
+
+/**
+ * bayes_evaluation_get_documents_per_second:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Retrieves the number of documents guessed per second of wall clock
+ * time, using every worker thread.
+ *
+ * Returns: A #gdouble.
+ */
+gdouble
+bayes_evaluation_get_documents_per_second (BayesEvaluation *evaluation)
+{
+   g_return_val_if_fail(evaluation, 0.0);
+   return evaluation->n_documents / MAX(evaluation->guess_seconds, 1e-9);
+}
+
+/**
+ * bayes_evaluation_get_latency:
+ * @evaluation: (in): A #BayesEvaluation.
+ * @percentile: (in): A percentile between 0.0 and 100.0.
+ *
+ * Retrieves the time a single guess took at @percentile, such as 50.0
+ * for the median or 99.0 for the slowest percent.
+ *
+ * Returns: A #gdouble in seconds.
+ */
+gdouble
+bayes_evaluation_get_latency (BayesEvaluation *evaluation,
+                              gdouble          percentile)
+{
+   g_return_val_if_fail(evaluation, 0.0);
+   g_return_val_if_fail(percentile >= 0.0 && percentile <= 100.0, 0.0);
+
+   return evaluation->latencies[(guint)((evaluation->n_documents - 1) *
+                                        percentile / 100.0)];
+}
+
+/**
+ * bayes_evaluation_to_string:
+ * @evaluation: (in): A #BayesEvaluation.
+ *
+ * Formats the results of @evaluation as a report for people to read,
+ * with the confusion matrix laid out with one row per actual
+ * classification.
+ *
+ * Returns: (transfer full): A newly allocated string.
+ */
+gchar *
+bayes_evaluation_to_string (BayesEvaluation *evaluation)
+{
+   GString *str;
+   guint width = 10;
+   guint i;
+   guint j;
+
+   g_return_val_if_fail(evaluation, NULL);
+
+   for (i = 0; i < evaluation->n_classes; i++) {
+      width = MAX(width, strlen(evaluation->class_names[i]));
+   }
+
+   str = g_string_new(NULL);
+   g_string_append_printf(str, "documents:  %u in %u folds\n",
+                          evaluation->n_documents, evaluation->n_folds);
+   g_string_append_printf(str, "accuracy:   %.4f\n",
+                          bayes_evaluation_get_accuracy(evaluation));
+   g_string_append_printf(str, "training:   %.3f s\n",
+                          evaluation->train_seconds);
+   g_string_append_printf(str, "throughput: %.0f docs/s\n",
+                          bayes_evaluation_get_documents_per_second(evaluation));
+   g_string_append_printf(str, "latency:    p50 %.1f us, p90 %.1f us, "
+                          "p99 %.1f us\n",
+                          bayes_evaluation_get_latency(evaluation, 50) * 1e6,
+                          bayes_evaluation_get_latency(evaluation, 90) * 1e6,
+                          bayes_evaluation_get_latency(evaluation, 99) * 1e6);
+
+   g_string_append_printf(str, "\n%*s", width, "");
+   for (j = 0; j < evaluation->n_classes; j++) {
+      g_string_append_printf(str, " %*s", width, evaluation->class_names[j]);
+   }
+   g_string_append_printf(str, " %*s\n", width, "(none)");
+
+   for (i = 0; i < evaluation->n_classes; i++) {
+      g_string_append_printf(str, "%*s", width, evaluation->class_names[i]);
+      for (j = 0; j <= evaluation->n_classes; j++) {
+         g_string_append_printf(str, " %*u", width,
+                                evaluation->confusion[i * (evaluation->n_classes + 1) + j]);
+      }
+      g_string_append_c(str, '\n');
+   }
+
+   return g_string_free(str, FALSE);
+}
+
+GType
+bayes_evaluation_get_type (void)
+{
+   static gsize initialized = FALSE;
+   static GType type_id;
+
+   if (g_once_init_enter(&initialized)) {
+      type_id = g_boxed_type_register_static("BayesEvaluation",
+                                             (GBoxedCopyFunc)bayes_evaluation_ref,
+                                             (GBoxedFreeFunc)bayes_evaluation_unref);
+      g_once_init_leave(&initialized, TRUE);
+   }
+
+   return type_id;
+}
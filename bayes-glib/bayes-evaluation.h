@@ -0,0 +1,53 @@
+/* bayes-evaluation.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_EVALUATION_H
+#define BAYES_EVALUATION_H
+
+#include "bayes-classifier.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_EVALUATION (bayes_evaluation_get_type())
+
+typedef struct _BayesEvaluation BayesEvaluation;
+
+gdouble              bayes_evaluation_get_accuracy             (BayesEvaluation     *evaluation);
+const gchar * const *bayes_evaluation_get_class_names          (BayesEvaluation     *evaluation);
+guint                bayes_evaluation_get_confusion            (BayesEvaluation     *evaluation,
+                                                                guint                actual,
+                                                                gint                 predicted);
+gdouble              bayes_evaluation_get_documents_per_second (BayesEvaluation     *evaluation);
+gdouble              bayes_evaluation_get_latency              (BayesEvaluation     *evaluation,
+                                                                gdouble              percentile);
+guint                bayes_evaluation_get_n_classes            (BayesEvaluation     *evaluation);
+guint                bayes_evaluation_get_n_documents          (BayesEvaluation     *evaluation);
+guint                bayes_evaluation_get_n_folds              (BayesEvaluation     *evaluation);
+gdouble              bayes_evaluation_get_train_seconds        (BayesEvaluation     *evaluation);
+GType                bayes_evaluation_get_type                 (void) G_GNUC_CONST;
+BayesEvaluation     *bayes_evaluation_new                      (BayesClassifier     *classifier,
+                                                                const gchar * const *names,
+                                                                const gchar * const *texts,
+                                                                guint                n_folds);
+BayesEvaluation     *bayes_evaluation_ref                      (BayesEvaluation     *evaluation);
+gchar               *bayes_evaluation_to_string                (BayesEvaluation     *evaluation);
+void                 bayes_evaluation_unref                    (BayesEvaluation     *evaluation);
+
+G_END_DECLS
+
+#endif /* BAYES_EVALUATION_H */
@@ -19,9 +19,16 @@
 #ifndef BAYES_GLIB_H
 #define BAYES_GLIB_H
 
+#include "bayes-batch-result.h"
 #include "bayes-classifier.h"
+#include "bayes-combiner.h"
+#include "bayes-document.h"
+#include "bayes-evaluation.h"
 #include "bayes-guess.h"
+#include "bayes-guess-context.h"
 #include "bayes-storage.h"
+#include "bayes-storage-compact.h"
+#include "bayes-storage-fork.h"
 #include "bayes-storage-memory.h"
 #include "bayes-tokenizer.h"
 
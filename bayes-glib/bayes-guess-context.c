@@ -0,0 +1,564 @@
+/* bayes-guess-context.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n.h>
+#include <string.h>
+
+#include "bayes-classifier-private.h"
+#include "bayes-combiner-private.h"
+#include "bayes-guess-context.h"
+
+/**
+ * SECTION:bayes-guess-context
+ * @title: BayesGuessContext
+ * @short_description: Incremental classification of streamed text.
+ *
+ * #BayesGuessContext classifies text that arrives a piece at a time,
+ * such as a chat transcript or a log stream. Each call to
+ * bayes_guess_context_feed() only scores the new tokens; the evidence
+ * for every classification is accumulated in the log domain so the
+ * running classification may be retrieved at any time.
+ *
+ * Each chunk is tokenized on its own, so chunks should be split on
+ * token boundaries such as lines.
+ *
+ * If #BayesGuessContext:threshold is set, the #BayesGuessContext::confident
+ * signal is emitted once the leading classification reaches it, letting
+ * the caller stop reading early.
+ *
+ * With a custom #BayesCombiner the probabilities of every token fed so
+ * far must be kept and combined again after each chunk. The built-in
+ * combiners do not have that cost.
+ *
+ * If the storage of the classifier is replaced between two chunks, such
+ * as by bayes_classifier_watch_file(), the evidence gathered so far is
+ * discarded and the classification starts over with the next chunk.
+ *
+ * A #BayesGuessContext must only be used from one thread at a time.
+ */
+
+G_DEFINE_TYPE(BayesGuessContext, bayes_guess_context, G_TYPE_OBJECT)
+
+typedef struct
+{
+   BayesEvidence  evidence;
+   GArray        *probabilities; /* Only used with custom combiners */
+   gdouble        score;
+} ClassState;
+
+struct _BayesGuessContextPrivate
+{
+   BayesClassifier *classifier;
+
+   GArray    *classes; /* ClassState by class identifier */
+   GPtrArray *names;   /* Class name by class identifier */
+   guint64    serial;  /* Storage the class identifiers belong to */
+   guint      n_tokens;
+
+   gint       best;
+   gdouble    threshold;
+   gboolean   confident;
+};
+
+enum
+{
+   PROP_0,
+   PROP_CLASSIFIER,
+   PROP_THRESHOLD,
+   LAST_PROP
+};
+
+enum
+{
+   CONFIDENT,
+   LAST_SIGNAL
+};
+
+static GParamSpec *gParamSpecs[LAST_PROP];
+static guint       gSignals[LAST_SIGNAL];
+
+static void
+class_state_clear (gpointer data)
+{
+   ClassState *state = data;
+
+   g_array_unref(state->probabilities);
+}
+
+static gint
+sort_guesses (gconstpointer a,
+              gconstpointer b)
+{
+   gdouble ap = bayes_guess_get_probability((BayesGuess *)a);
+   gdouble bp = bayes_guess_get_probability((BayesGuess *)b);
+   return (ap < bp) - (ap > bp);
+}
+
+/**
+ * bayes_guess_context_new:
+ * @classifier: (in): A #BayesClassifier.
+ *
+ * Creates a new #BayesGuessContext that classifies text using the
+ * training data of @classifier.
+ *
+ * Returns: (transfer full): A newly allocated #BayesGuessContext.
+ */
+BayesGuessContext *
+bayes_guess_context_new (BayesClassifier *classifier)
+{
+   g_return_val_if_fail(BAYES_IS_CLASSIFIER(classifier), NULL);
+
+   return g_object_new(BAYES_TYPE_GUESS_CONTEXT,
+                       "classifier", classifier,
+                       NULL);
+}
+
+/*
+ * Makes room for classifications that were trained since the last chunk.
+ * Their evidence starts with the current chunk.
+ */
+static void
+bayes_guess_context_grow (BayesGuessContext   *context,
+                          const gchar * const *names,
+                          guint                n_classes)
+{
+   BayesGuessContextPrivate *priv = context->priv;
+   ClassState state;
+
+   while (priv->classes->len < n_classes) {
+      memset(&state, 0, sizeof state);
+      state.probabilities = g_array_new(FALSE, FALSE, sizeof(gdouble));
+      state.score = 0.5;
+      g_ptr_array_add(priv->names, g_strdup(names[priv->classes->len]));
+      g_array_append_val(priv->classes, state);
+   }
+}
+
+/**
+ * bayes_guess_context_feed:
+ * @context: (in): A #BayesGuessContext.
+ * @text: (in): The next chunk of text.
+ *
+ * Tokenizes @text and adds the evidence of its tokens to the running
+ * classification. Only the tokens of @text are scored.
+ *
+ * Returns: %TRUE if the leading classification has reached
+ *   #BayesGuessContext:threshold.
+ */
+gboolean
+bayes_guess_context_feed (BayesGuessContext *context,
+                          const gchar       *text)
+{
+   BayesStorageMemoryToken **resolved;
+   BayesClassifierSnapshot *snapshot;
+   BayesGuessContextPrivate *priv;
+   const gchar * const *names;
+   BayesEvidenceFunc func;
+   BayesCombiner combiner;
+   BayesStorage *storage;
+   ClassState *state;
+   gpointer user_data;
+   gdouble *probs;
+   gchar **tokens;
+   guint64 serial;
+   guint n_classes;
+   guint n_tokens;
+   guint i;
+
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), FALSE);
+   g_return_val_if_fail(text, FALSE);
+
+   priv = context->priv;
+
+   snapshot = _bayes_classifier_read_lock(priv->classifier);
+
+   /*
+    * Class identifiers only mean something to the storage they came
+    * from. Training that storage only adds classes, but another one may
+    * order them differently, so the evidence gathered with a storage that
+    * has since been replaced is thrown away.
+    */
+   serial = _bayes_classifier_snapshot_get_serial(snapshot);
+   if (serial != priv->serial) {
+      bayes_guess_context_reset(context);
+      g_array_set_size(priv->classes, 0);
+      g_ptr_array_set_size(priv->names, 0);
+      priv->serial = serial;
+   }
+
+   tokens = _bayes_classifier_tokenize(priv->classifier, text);
+   n_tokens = tokens ? g_strv_length(tokens) : 0;
+
+   if (n_tokens) {
+      storage = _bayes_classifier_snapshot_get_storage(snapshot);
+      names = bayes_storage_get_classes(storage, &n_classes);
+      combiner = _bayes_classifier_get_combiner(priv->classifier, &user_data);
+      func = _bayes_combiner_get_evidence_func(combiner);
+
+      bayes_guess_context_grow(context, names, n_classes);
+
+      probs = g_new(gdouble, n_tokens);
+      resolved = _bayes_classifier_resolve(priv->classifier, snapshot,
+                                           tokens, n_tokens);
+
+      for (i = 0; i < n_classes; i++) {
+         state = &g_array_index(priv->classes, ClassState, i);
+
+         _bayes_classifier_get_probabilities(priv->classifier, snapshot, i,
+                                             tokens, resolved, n_tokens,
+                                             probs);
+
+         if (func) {
+            _bayes_evidence_accumulate(&state->evidence, probs, n_tokens);
+            state->score = func(&state->evidence);
+         } else {
+            g_array_append_vals(state->probabilities, probs, n_tokens);
+            state->score = combiner((gdouble *)state->probabilities->data,
+                                    state->probabilities->len,
+                                    user_data);
+         }
+      }
+
+      priv->n_tokens += n_tokens;
+
+      g_free(resolved);
+      g_free(probs);
+   }
+
+   _bayes_classifier_read_unlock(priv->classifier, snapshot);
+
+   g_strfreev(tokens);
+
+   /*
+    * Find the new leader.
+    */
+   for (i = 0; priv->n_tokens && i < priv->classes->len; i++) {
+      state = &g_array_index(priv->classes, ClassState, i);
+      if (priv->best < 0 ||
+          state->score >
+          g_array_index(priv->classes, ClassState, priv->best).score) {
+         priv->best = i;
+      }
+   }
+
+   if (!priv->confident &&
+       priv->threshold > 0.0 &&
+       priv->best >= 0 &&
+       g_array_index(priv->classes, ClassState, priv->best).score >=
+       priv->threshold) {
+      priv->confident = TRUE;
+      g_signal_emit(context, gSignals[CONFIDENT], 0);
+   }
+
+   return priv->confident;
+}
+
+/**
+ * bayes_guess_context_get_best:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Retrieves the leading classification of the text fed so far.
+ *
+ * Returns: (transfer full): A #BayesGuess or %NULL if no tokens have
+ *   been fed.
+ */
+BayesGuess *
+bayes_guess_context_get_best (BayesGuessContext *context)
+{
+   BayesGuessContextPrivate *priv;
+
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), NULL);
+
+   priv = context->priv;
+
+   if (priv->best < 0) {
+      return NULL;
+   }
+
+   return bayes_guess_new(g_ptr_array_index(priv->names, priv->best),
+                          g_array_index(priv->classes, ClassState,
+                                        priv->best).score);
+}
+
+/**
+ * bayes_guess_context_get_guesses:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Retrieves the classification of the text fed so far like
+ * bayes_classifier_guess() would for all of it at once.
+ *
+ * Returns: (transfer full) (element-type BayesGuess*): The guesses.
+ */
+GList *
+bayes_guess_context_get_guesses (BayesGuessContext *context)
+{
+   BayesGuessContextPrivate *priv;
+   GList *ret = NULL;
+   guint i;
+
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), NULL);
+
+   priv = context->priv;
+
+   for (i = 0; priv->n_tokens && i < priv->classes->len; i++) {
+      ret = g_list_prepend(ret,
+         bayes_guess_new(g_ptr_array_index(priv->names, i),
+                         g_array_index(priv->classes, ClassState, i).score));
+   }
+
+   return g_list_sort(ret, sort_guesses);
+}
+
+/**
+ * bayes_guess_context_get_classifier:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Retrieves the classifier used by @context.
+ *
+ * Returns: (transfer none): A #BayesClassifier.
+ */
+BayesClassifier *
+bayes_guess_context_get_classifier (BayesGuessContext *context)
+{
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), NULL);
+   return context->priv->classifier;
+}
+
+/**
+ * bayes_guess_context_get_n_tokens:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Retrieves the number of tokens fed to @context.
+ *
+ * Returns: A #guint.
+ */
+guint
+bayes_guess_context_get_n_tokens (BayesGuessContext *context)
+{
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), 0);
+   return context->priv->n_tokens;
+}
+
+/**
+ * bayes_guess_context_get_threshold:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Retrieves the #BayesGuessContext:threshold property.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0.
+ */
+gdouble
+bayes_guess_context_get_threshold (BayesGuessContext *context)
+{
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), 0.0);
+   return context->priv->threshold;
+}
+
+/**
+ * bayes_guess_context_set_threshold:
+ * @context: (in): A #BayesGuessContext.
+ * @threshold: (in): A probability between 0.0 and 1.0.
+ *
+ * Sets the probability the leading classification must reach before
+ * @context is confident. A @threshold of 0.0 disables the check.
+ */
+void
+bayes_guess_context_set_threshold (BayesGuessContext *context,
+                                   gdouble            threshold)
+{
+   g_return_if_fail(BAYES_IS_GUESS_CONTEXT(context));
+   g_return_if_fail(threshold >= 0.0 && threshold <= 1.0);
+
+   context->priv->threshold = threshold;
+   g_object_notify_by_pspec(G_OBJECT(context), gParamSpecs[PROP_THRESHOLD]);
+}
+
+/**
+ * bayes_guess_context_is_confident:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Checks if the leading classification has reached
+ * #BayesGuessContext:threshold.
+ *
+ * Returns: %TRUE if @context is confident.
+ */
+gboolean
+bayes_guess_context_is_confident (BayesGuessContext *context)
+{
+   g_return_val_if_fail(BAYES_IS_GUESS_CONTEXT(context), FALSE);
+   return context->priv->confident;
+}
+
+/**
+ * bayes_guess_context_reset:
+ * @context: (in): A #BayesGuessContext.
+ *
+ * Discards the text fed so far so that @context may be reused for
+ * another stream.
+ */
+void
+bayes_guess_context_reset (BayesGuessContext *context)
+{
+   BayesGuessContextPrivate *priv;
+   ClassState *state;
+   guint i;
+
+   g_return_if_fail(BAYES_IS_GUESS_CONTEXT(context));
+
+   priv = context->priv;
+
+   for (i = 0; i < priv->classes->len; i++) {
+      state = &g_array_index(priv->classes, ClassState, i);
+      memset(&state->evidence, 0, sizeof state->evidence);
+      g_array_set_size(state->probabilities, 0);
+      state->score = 0.5;
+   }
+
+   priv->n_tokens = 0;
+   priv->best = -1;
+   priv->confident = FALSE;
+}
+
+static void
+bayes_guess_context_finalize (GObject *object)
+{
+   BayesGuessContextPrivate *priv = BAYES_GUESS_CONTEXT(object)->priv;
+
+   g_clear_object(&priv->classifier);
+   g_array_unref(priv->classes);
+   g_ptr_array_unref(priv->names);
+
+   G_OBJECT_CLASS(bayes_guess_context_parent_class)->finalize(object);
+}
+
+static void
+bayes_guess_context_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+   BayesGuessContext *context = BAYES_GUESS_CONTEXT(object);
+
+   switch (prop_id) {
+   case PROP_CLASSIFIER:
+      g_value_set_object(value, bayes_guess_context_get_classifier(context));
+      break;
+   case PROP_THRESHOLD:
+      g_value_set_double(value, bayes_guess_context_get_threshold(context));
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+   }
+}
+
+static void
+bayes_guess_context_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+   BayesGuessContext *context = BAYES_GUESS_CONTEXT(object);
+
+   switch (prop_id) {
+   case PROP_CLASSIFIER:
+      context->priv->classifier = g_value_dup_object(value);
+      break;
+   case PROP_THRESHOLD:
+      bayes_guess_context_set_threshold(context, g_value_get_double(value));
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+   }
+}
+
+static void
+bayes_guess_context_class_init (BayesGuessContextClass *klass)
+{
+   GObjectClass *object_class;
+
+   object_class = G_OBJECT_CLASS(klass);
+   object_class->finalize = bayes_guess_context_finalize;
+   object_class->get_property = bayes_guess_context_get_property;
+   object_class->set_property = bayes_guess_context_set_property;
+   g_type_class_add_private(object_class, sizeof(BayesGuessContextPrivate));
+
+   /**
+    * BayesGuessContext:classifier:
+    *
+    * The "classifier" property. The classifier whose training data is
+    * used to score the text.
+    */
+   gParamSpecs[PROP_CLASSIFIER] =
+      g_param_spec_object("classifier",
+                          _("Classifier"),
+                          _("The classifier to guess with."),
+                          BAYES_TYPE_CLASSIFIER,
+                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY);
+   g_object_class_install_property(object_class, PROP_CLASSIFIER,
+                                   gParamSpecs[PROP_CLASSIFIER]);
+
+   /**
+    * BayesGuessContext:threshold:
+    *
+    * The "threshold" property. The probability the leading
+    * classification must reach before #BayesGuessContext::confident is
+    * emitted, or 0.0 to never emit it.
+    */
+   gParamSpecs[PROP_THRESHOLD] =
+      g_param_spec_double("threshold",
+                          _("Threshold"),
+                          _("The probability at which to be confident."),
+                          0.0,
+                          1.0,
+                          0.0,
+                          G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_THRESHOLD,
+                                   gParamSpecs[PROP_THRESHOLD]);
+
+   /**
+    * BayesGuessContext::confident:
+    * @context: The #BayesGuessContext.
+    *
+    * The "confident" signal is emitted from bayes_guess_context_feed()
+    * the first time the leading classification reaches
+    * #BayesGuessContext:threshold.
+    */
+   gSignals[CONFIDENT] = g_signal_new("confident",
+                                      BAYES_TYPE_GUESS_CONTEXT,
+                                      G_SIGNAL_RUN_LAST,
+                                      G_STRUCT_OFFSET(BayesGuessContextClass,
+                                                      confident),
+                                      NULL,
+                                      NULL,
+                                      g_cclosure_marshal_VOID__VOID,
+                                      G_TYPE_NONE,
+                                      0);
+}
+
+static void
+bayes_guess_context_init (BayesGuessContext *context)
+{
+   context->priv =
+      G_TYPE_INSTANCE_GET_PRIVATE(context,
+                                  BAYES_TYPE_GUESS_CONTEXT,
+                                  BayesGuessContextPrivate);
+   context->priv->classes = g_array_new(FALSE, FALSE, sizeof(ClassState));
+   g_array_set_clear_func(context->priv->classes, class_state_clear);
+   context->priv->names = g_ptr_array_new_with_free_func(g_free);
+   context->priv->best = -1;
+}
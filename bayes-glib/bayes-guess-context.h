@@ -0,0 +1,70 @@
+/* bayes-guess-context.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_GUESS_CONTEXT_H
+#define BAYES_GUESS_CONTEXT_H
+
+#include "bayes-classifier.h"
+#include "bayes-guess.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_GUESS_CONTEXT            (bayes_guess_context_get_type())
+#define BAYES_GUESS_CONTEXT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_GUESS_CONTEXT, BayesGuessContext))
+#define BAYES_GUESS_CONTEXT_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_GUESS_CONTEXT, BayesGuessContext const))
+#define BAYES_GUESS_CONTEXT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  BAYES_TYPE_GUESS_CONTEXT, BayesGuessContextClass))
+#define BAYES_IS_GUESS_CONTEXT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), BAYES_TYPE_GUESS_CONTEXT))
+#define BAYES_IS_GUESS_CONTEXT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  BAYES_TYPE_GUESS_CONTEXT))
+#define BAYES_GUESS_CONTEXT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  BAYES_TYPE_GUESS_CONTEXT, BayesGuessContextClass))
+
+typedef struct _BayesGuessContext        BayesGuessContext;
+typedef struct _BayesGuessContextClass   BayesGuessContextClass;
+typedef struct _BayesGuessContextPrivate BayesGuessContextPrivate;
+
+struct _BayesGuessContext
+{
+   GObject parent;
+
+   /*< private >*/
+   BayesGuessContextPrivate *priv;
+};
+
+struct _BayesGuessContextClass
+{
+   GObjectClass parent_class;
+
+   void (*confident) (BayesGuessContext *context);
+};
+
+gboolean           bayes_guess_context_feed           (BayesGuessContext *context,
+                                                       const gchar       *text);
+BayesGuess        *bayes_guess_context_get_best       (BayesGuessContext *context);
+BayesClassifier   *bayes_guess_context_get_classifier (BayesGuessContext *context);
+GList             *bayes_guess_context_get_guesses    (BayesGuessContext *context);
+guint              bayes_guess_context_get_n_tokens   (BayesGuessContext *context);
+gdouble            bayes_guess_context_get_threshold  (BayesGuessContext *context);
+GType              bayes_guess_context_get_type       (void) G_GNUC_CONST;
+gboolean           bayes_guess_context_is_confident   (BayesGuessContext *context);
+BayesGuessContext *bayes_guess_context_new            (BayesClassifier   *classifier);
+void               bayes_guess_context_reset          (BayesGuessContext *context);
+void               bayes_guess_context_set_threshold  (BayesGuessContext *context,
+                                                       gdouble            threshold);
+
+G_END_DECLS
+
+#endif /* BAYES_GUESS_CONTEXT_H */
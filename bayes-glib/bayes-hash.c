@@ -0,0 +1,149 @@
+/* bayes-hash.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bayes-hash.h"
+
+/*
+ * The 128-bit variant of MurmurHash3 for 64-bit platforms by Austin
+ * Appleby, which is in the public domain. It processes 16 bytes per
+ * round and is much faster than a cryptographic hash, which we do not
+ * need since fingerprints are not used to defend against attackers.
+ */
+
+#define C1 G_GUINT64_CONSTANT(0x87c37b91114253d5)
+#define C2 G_GUINT64_CONSTANT(0x4cf5ad432745937f)
+
+static inline guint64
+rotl64 (guint64 x,
+        gint    r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+static inline guint64
+fmix64 (guint64 k)
+{
+   k ^= k >> 33;
+   k *= G_GUINT64_CONSTANT(0xff51afd7ed558ccd);
+   k ^= k >> 33;
+   k *= G_GUINT64_CONSTANT(0xc4ceb9fe1a85ec53);
+   k ^= k >> 33;
+   return k;
+}
+
+static inline guint64
+read64 (const guint8 *p)
+{
+   guint64 v;
+
+   memcpy(&v, p, sizeof v);
+   return GUINT64_FROM_LE(v);
+}
+
+void
+_bayes_fingerprint_init (BayesFingerprint *fingerprint,
+                         gconstpointer     data,
+                         gsize             length,
+                         guint64           seed)
+{
+   const guint8 *bytes = data;
+   const guint8 *tail;
+   guint64 h1 = seed;
+   guint64 h2 = seed;
+   guint64 k1 = 0;
+   guint64 k2 = 0;
+   gsize n_blocks;
+   gsize i;
+
+   g_return_if_fail(fingerprint);
+   g_return_if_fail(data || !length);
+
+   n_blocks = length / 16;
+
+   for (i = 0; i < n_blocks; i++) {
+      k1 = read64(bytes + i * 16);
+      k2 = read64(bytes + i * 16 + 8);
+
+      k1 *= C1; k1 = rotl64(k1, 31); k1 *= C2; h1 ^= k1;
+      h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+
+      k2 *= C2; k2 = rotl64(k2, 33); k2 *= C1; h2 ^= k2;
+      h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+   }
+
+   tail = bytes + n_blocks * 16;
+   k1 = 0;
+   k2 = 0;
+
+   switch (length & 15) {
+   case 15: k2 ^= (guint64)tail[14] << 48; /* fall through */
+   case 14: k2 ^= (guint64)tail[13] << 40; /* fall through */
+   case 13: k2 ^= (guint64)tail[12] << 32; /* fall through */
+   case 12: k2 ^= (guint64)tail[11] << 24; /* fall through */
+   case 11: k2 ^= (guint64)tail[10] << 16; /* fall through */
+   case 10: k2 ^= (guint64)tail[9] << 8;  /* fall through */
+   case 9:  k2 ^= (guint64)tail[8];
+            k2 *= C2; k2 = rotl64(k2, 33); k2 *= C1; h2 ^= k2;
+            /* fall through */
+   case 8:  k1 ^= (guint64)tail[7] << 56; /* fall through */
+   case 7:  k1 ^= (guint64)tail[6] << 48; /* fall through */
+   case 6:  k1 ^= (guint64)tail[5] << 40; /* fall through */
+   case 5:  k1 ^= (guint64)tail[4] << 32; /* fall through */
+   case 4:  k1 ^= (guint64)tail[3] << 24; /* fall through */
+   case 3:  k1 ^= (guint64)tail[2] << 16; /* fall through */
+   case 2:  k1 ^= (guint64)tail[1] << 8;  /* fall through */
+   case 1:  k1 ^= (guint64)tail[0];
+            k1 *= C1; k1 = rotl64(k1, 31); k1 *= C2; h1 ^= k1;
+            /* fall through */
+   default:
+      break;
+   }
+
+   h1 ^= length;
+   h2 ^= length;
+   h1 += h2;
+   h2 += h1;
+   h1 = fmix64(h1);
+   h2 = fmix64(h2);
+   h1 += h2;
+   h2 += h1;
+
+   fingerprint->h1 = h1;
+   fingerprint->h2 = h2;
+}
+
+gboolean
+_bayes_fingerprint_equal (gconstpointer a,
+                          gconstpointer b)
+{
+   const BayesFingerprint *fa = a;
+   const BayesFingerprint *fb = b;
+
+   return (fa->h1 == fb->h1) && (fa->h2 == fb->h2);
+}
+
+guint
+_bayes_fingerprint_hash (gconstpointer fingerprint)
+{
+   /*
+    * The bits are already well mixed, any of them will do.
+    */
+   return (guint)((const BayesFingerprint *)fingerprint)->h1;
+}
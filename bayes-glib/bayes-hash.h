@@ -0,0 +1,49 @@
+/* bayes-hash.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_HASH_H
+#define BAYES_HASH_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * BayesFingerprint is a 128-bit hash used to recognize documents that
+ * have been seen before. Collisions are assumed to never happen.
+ */
+typedef struct
+{
+   guint64 h1;
+   guint64 h2;
+} BayesFingerprint;
+
+G_GNUC_INTERNAL
+void     _bayes_fingerprint_init  (BayesFingerprint *fingerprint,
+                                   gconstpointer     data,
+                                   gsize             length,
+                                   guint64           seed);
+G_GNUC_INTERNAL
+gboolean _bayes_fingerprint_equal (gconstpointer     a,
+                                   gconstpointer     b);
+G_GNUC_INTERNAL
+guint    _bayes_fingerprint_hash  (gconstpointer     fingerprint);
+
+G_END_DECLS
+
+#endif /* BAYES_HASH_H */
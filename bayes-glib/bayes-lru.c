@@ -0,0 +1,203 @@
+/* bayes-lru.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bayes-lru.h"
+
+typedef struct
+{
+   gpointer key;
+   gpointer value;
+} Entry;
+
+struct _BayesLru
+{
+   GHashTable     *table; /* key -> GList link in queue */
+   GQueue          queue; /* Entry, most recently used first */
+   guint           max_size;
+   GDestroyNotify  key_destroy;
+   GDestroyNotify  value_destroy;
+};
+
+BayesLru *
+_bayes_lru_new (guint          max_size,
+                GHashFunc      hash_func,
+                GEqualFunc     equal_func,
+                GDestroyNotify key_destroy,
+                GDestroyNotify value_destroy)
+{
+   BayesLru *lru;
+
+   g_return_val_if_fail(hash_func, NULL);
+   g_return_val_if_fail(equal_func, NULL);
+
+   lru = g_slice_new0(BayesLru);
+   lru->table = g_hash_table_new(hash_func, equal_func);
+   g_queue_init(&lru->queue);
+   lru->max_size = max_size;
+   lru->key_destroy = key_destroy;
+   lru->value_destroy = value_destroy;
+
+   return lru;
+}
+
+static void
+bayes_lru_unlink (BayesLru *lru,
+                  GList    *link)
+{
+   Entry *entry = link->data;
+
+   g_hash_table_remove(lru->table, entry->key);
+   g_queue_delete_link(&lru->queue, link);
+
+   if (lru->key_destroy) {
+      lru->key_destroy(entry->key);
+   }
+   if (lru->value_destroy) {
+      lru->value_destroy(entry->value);
+   }
+
+   g_slice_free(Entry, entry);
+}
+
+static void
+bayes_lru_trim (BayesLru *lru,
+                guint     size)
+{
+   while (lru->queue.length > size) {
+      bayes_lru_unlink(lru, lru->queue.tail);
+   }
+}
+
+/*
+ * Returns the value for @key and marks it as the most recently used
+ * entry, or NULL if @key is not in @lru.
+ */
+gpointer
+_bayes_lru_lookup (BayesLru      *lru,
+                   gconstpointer  key)
+{
+   GList *link;
+
+   g_return_val_if_fail(lru, NULL);
+
+   if (!(link = g_hash_table_lookup(lru->table, key))) {
+      return NULL;
+   }
+
+   if (link != lru->queue.head) {
+      g_queue_unlink(&lru->queue, link);
+      g_queue_push_head_link(&lru->queue, link);
+   }
+
+   return ((Entry *)link->data)->value;
+}
+
+/*
+ * Inserts @value for @key, taking ownership of both. An existing entry
+ * for @key is replaced and the least recently used entry is evicted if
+ * @lru is full.
+ */
+void
+_bayes_lru_insert (BayesLru *lru,
+                   gpointer  key,
+                   gpointer  value)
+{
+   Entry *entry;
+   GList *link;
+
+   g_return_if_fail(lru);
+
+   if ((link = g_hash_table_lookup(lru->table, key))) {
+      bayes_lru_unlink(lru, link);
+   }
+
+   if (!lru->max_size) {
+      if (lru->key_destroy) {
+         lru->key_destroy(key);
+      }
+      if (lru->value_destroy) {
+         lru->value_destroy(value);
+      }
+      return;
+   }
+
+   bayes_lru_trim(lru, lru->max_size - 1);
+
+   entry = g_slice_new(Entry);
+   entry->key = key;
+   entry->value = value;
+   g_queue_push_head(&lru->queue, entry);
+   g_hash_table_insert(lru->table, key, lru->queue.head);
+}
+
+gboolean
+_bayes_lru_remove (BayesLru      *lru,
+                   gconstpointer  key)
+{
+   GList *link;
+
+   g_return_val_if_fail(lru, FALSE);
+
+   if ((link = g_hash_table_lookup(lru->table, key))) {
+      bayes_lru_unlink(lru, link);
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+void
+_bayes_lru_remove_all (BayesLru *lru)
+{
+   g_return_if_fail(lru);
+   bayes_lru_trim(lru, 0);
+}
+
+guint
+_bayes_lru_get_size (BayesLru *lru)
+{
+   g_return_val_if_fail(lru, 0);
+   return lru->queue.length;
+}
+
+guint
+_bayes_lru_get_max_size (BayesLru *lru)
+{
+   g_return_val_if_fail(lru, 0);
+   return lru->max_size;
+}
+
+void
+_bayes_lru_set_max_size (BayesLru *lru,
+                         guint     max_size)
+{
+   g_return_if_fail(lru);
+
+   lru->max_size = max_size;
+   bayes_lru_trim(lru, max_size);
+}
+
+void
+_bayes_lru_free (BayesLru *lru)
+{
+   if (lru) {
+      bayes_lru_trim(lru, 0);
+      g_hash_table_unref(lru->table);
+      g_slice_free(BayesLru, lru);
+   }
+}
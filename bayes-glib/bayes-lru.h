@@ -0,0 +1,63 @@
+/* bayes-lru.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_LRU_H
+#define BAYES_LRU_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * BayesLru is a hash table that holds at most max_size entries,
+ * evicting the least recently used entry when it is full. It is not
+ * thread-safe.
+ */
+typedef struct _BayesLru BayesLru;
+
+G_GNUC_INTERNAL
+void      _bayes_lru_free         (BayesLru       *lru);
+G_GNUC_INTERNAL
+guint     _bayes_lru_get_max_size (BayesLru       *lru);
+G_GNUC_INTERNAL
+guint     _bayes_lru_get_size     (BayesLru       *lru);
+G_GNUC_INTERNAL
+void      _bayes_lru_insert       (BayesLru       *lru,
+                                   gpointer        key,
+                                   gpointer        value);
+G_GNUC_INTERNAL
+gpointer  _bayes_lru_lookup       (BayesLru       *lru,
+                                   gconstpointer   key);
+G_GNUC_INTERNAL
+BayesLru *_bayes_lru_new          (guint           max_size,
+                                   GHashFunc       hash_func,
+                                   GEqualFunc      equal_func,
+                                   GDestroyNotify  key_destroy,
+                                   GDestroyNotify  value_destroy);
+G_GNUC_INTERNAL
+gboolean  _bayes_lru_remove       (BayesLru       *lru,
+                                   gconstpointer   key);
+G_GNUC_INTERNAL
+void      _bayes_lru_remove_all   (BayesLru       *lru);
+G_GNUC_INTERNAL
+void      _bayes_lru_set_max_size (BayesLru       *lru,
+                                   guint           max_size);
+
+G_END_DECLS
+
+#endif /* BAYES_LRU_H */
@@ -0,0 +1,187 @@
+/* bayes-parallel.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bayes-parallel.h"
+
+/*
+ * Items are handed out in chunks so that threads that finish early keep
+ * claiming work from the shared cursor instead of idling while a slower
+ * thread finishes a large static partition.
+ */
+#define CHUNKS_PER_THREAD 16
+
+typedef struct
+{
+   volatile gint      ref_count;
+   volatile gint      cursor;
+   guint              n_items;
+   guint              chunk;
+   BayesParallelFunc  func;
+   gpointer           user_data;
+   GMutex             mutex;
+   GCond              cond;
+   guint              n_done;
+} Job;
+
+static GThreadPool *gPool;
+
+static Job *
+job_ref (Job *job)
+{
+   g_atomic_int_inc(&job->ref_count);
+   return job;
+}
+
+static void
+job_unref (Job *job)
+{
+   if (g_atomic_int_dec_and_test(&job->ref_count)) {
+      g_mutex_clear(&job->mutex);
+      g_cond_clear(&job->cond);
+      g_slice_free(Job, job);
+   }
+}
+
+static void
+job_run (Job *job)
+{
+   guint begin;
+   guint end;
+   guint done = 0;
+   guint i;
+
+   while ((begin = g_atomic_int_add(&job->cursor, job->chunk)) < job->n_items) {
+      end = MIN(begin + job->chunk, job->n_items);
+      for (i = begin; i < end; i++) {
+         job->func(i, job->user_data);
+      }
+      done += end - begin;
+   }
+
+   if (done) {
+      g_mutex_lock(&job->mutex);
+      job->n_done += done;
+      if (job->n_done == job->n_items) {
+         g_cond_broadcast(&job->cond);
+      }
+      g_mutex_unlock(&job->mutex);
+   }
+}
+
+static void
+worker (gpointer data,
+        gpointer user_data)
+{
+   Job *job = data;
+
+   job_run(job);
+   job_unref(job);
+}
+
+/**
+ * _bayes_parallel_get_n_threads:
+ *
+ * Retrieves the number of threads used by _bayes_parallel_for(),
+ * including the calling thread. This is the number of processors unless
+ * the BAYES_THREADS environment variable is set when the first parallel
+ * work is started.
+ *
+ * Returns: A #guint greater than zero.
+ */
+guint
+_bayes_parallel_get_n_threads (void)
+{
+   static gsize initialized = FALSE;
+   static guint n_threads;
+   const gchar *env;
+
+   if (g_once_init_enter(&initialized)) {
+      n_threads = MAX(1, g_get_num_processors());
+      if ((env = g_getenv("BAYES_THREADS")) &&
+          g_ascii_strtoull(env, NULL, 10) > 0) {
+         n_threads = MIN(g_ascii_strtoull(env, NULL, 10), 1024);
+      }
+      if (n_threads > 1) {
+         gPool = g_thread_pool_new(worker, NULL, n_threads - 1, FALSE, NULL);
+      }
+      g_once_init_leave(&initialized, TRUE);
+   }
+
+   return n_threads;
+}
+
+/**
+ * _bayes_parallel_for:
+ * @n_items: (in): The number of items.
+ * @func: (in): The function to call for each item.
+ * @user_data: (in): User data for @func.
+ *
+ * Calls @func once for every index below @n_items using the shared
+ * worker pool. The calling thread takes part in the work and this
+ * function returns once every item has been processed.
+ *
+ * Workers that are only scheduled after the work has run out find
+ * nothing to claim and return, so nested calls cannot deadlock.
+ */
+void
+_bayes_parallel_for (guint             n_items,
+                     BayesParallelFunc func,
+                     gpointer          user_data)
+{
+   guint n_threads;
+   guint i;
+   Job *job;
+
+   g_return_if_fail(func);
+
+   if (!n_items) {
+      return;
+   }
+
+   n_threads = MIN(_bayes_parallel_get_n_threads(), n_items);
+
+   if (n_threads == 1) {
+      for (i = 0; i < n_items; i++) {
+         func(i, user_data);
+      }
+      return;
+   }
+
+   job = g_slice_new0(Job);
+   job->ref_count = 1;
+   job->n_items = n_items;
+   job->chunk = MAX(1, n_items / (n_threads * CHUNKS_PER_THREAD));
+   job->func = func;
+   job->user_data = user_data;
+   g_mutex_init(&job->mutex);
+   g_cond_init(&job->cond);
+
+   for (i = 1; i < n_threads; i++) {
+      g_thread_pool_push(gPool, job_ref(job), NULL);
+   }
+
+   job_run(job);
+
+   g_mutex_lock(&job->mutex);
+   while (job->n_done < job->n_items) {
+      g_cond_wait(&job->cond, &job->mutex);
+   }
+   g_mutex_unlock(&job->mutex);
+
+   job_unref(job);
+}
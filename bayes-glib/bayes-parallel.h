@@ -0,0 +1,38 @@
+/* bayes-parallel.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_PARALLEL_H
+#define BAYES_PARALLEL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef void (*BayesParallelFunc) (guint    index,
+                                   gpointer user_data);
+
+G_GNUC_INTERNAL
+guint _bayes_parallel_get_n_threads (void);
+G_GNUC_INTERNAL
+void  _bayes_parallel_for           (guint             n_items,
+                                     BayesParallelFunc func,
+                                     gpointer          user_data);
+
+G_END_DECLS
+
+#endif /* BAYES_PARALLEL_H */
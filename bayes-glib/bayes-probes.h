@@ -0,0 +1,93 @@
+/* bayes-probes.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_PROBES_H
+#define BAYES_PROBES_H
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Static tracepoints for perf, bpftrace and SystemTap, added with
+ * ./configure --enable-sdt. Each probe has a semaphore that the tracer
+ * increments while it is attached. The probes test their semaphore
+ * before evaluating any arguments, so an unattached probe costs a single
+ * branch. Without --enable-sdt the probes compile to nothing.
+ *
+ * Every probe used in a file must be defined there once with
+ * BAYES_PROBE_DEFINE().
+ */
+
+#ifdef ENABLE_SDT
+
+# define _SDT_HAS_SEMAPHORES 1
+# include <sys/sdt.h>
+
+# define BAYES_PROBE_DEFINE(name) \
+   static volatile unsigned short bayes_##name##_semaphore \
+      __attribute__((used, section(".probes")));
+
+# define BAYES_PROBE_ENABLED(name) G_UNLIKELY(bayes_##name##_semaphore)
+
+# define BAYES_PROBE1(name, a) \
+   G_STMT_START { \
+      if (BAYES_PROBE_ENABLED(name)) \
+         DTRACE_PROBE1(bayes, name, a); \
+   } G_STMT_END
+# define BAYES_PROBE2(name, a, b) \
+   G_STMT_START { \
+      if (BAYES_PROBE_ENABLED(name)) \
+         DTRACE_PROBE2(bayes, name, a, b); \
+   } G_STMT_END
+# define BAYES_PROBE3(name, a, b, c) \
+   G_STMT_START { \
+      if (BAYES_PROBE_ENABLED(name)) \
+         DTRACE_PROBE3(bayes, name, a, b, c); \
+   } G_STMT_END
+
+#else /* !ENABLE_SDT */
+
+/*
+ * The arguments are still referenced from dead code so that variables
+ * only used by probes do not cause warnings.
+ */
+# define BAYES_PROBE_DEFINE(name)
+# define BAYES_PROBE_ENABLED(name) (0)
+# define BAYES_PROBE1(name, a) \
+   G_STMT_START { \
+      if (0) { (void)(a); } \
+   } G_STMT_END
+# define BAYES_PROBE2(name, a, b) \
+   G_STMT_START { \
+      if (0) { (void)(a); (void)(b); } \
+   } G_STMT_END
+# define BAYES_PROBE3(name, a, b, c) \
+   G_STMT_START { \
+      if (0) { (void)(a); (void)(b); (void)(c); } \
+   } G_STMT_END
+
+#endif /* ENABLE_SDT */
+
+G_END_DECLS
+
+#endif /* BAYES_PROBES_H */
@@ -0,0 +1,40 @@
+/* bayes-storage-compact-private.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_STORAGE_COMPACT_PRIVATE_H
+#define BAYES_STORAGE_COMPACT_PRIVATE_H
+
+#include "bayes-storage-compact.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Scores @tokens against every class of @compact with the naive Bayes
+ * combiner, storing one score per class in @scores. The quantized
+ * log-odds of each token are summed for all classes at once in integer
+ * accumulators rather than one class at a time.
+ */
+G_GNUC_INTERNAL
+void _bayes_storage_compact_score_naive (BayesStorageCompact  *compact,
+                                         gchar               **tokens,
+                                         guint                 n_tokens,
+                                         gdouble              *scores);
+
+G_END_DECLS
+
+#endif /* BAYES_STORAGE_COMPACT_PRIVATE_H */
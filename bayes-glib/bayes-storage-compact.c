@@ -0,0 +1,918 @@
+/* bayes-storage-compact.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n.h>
+#include <math.h>
+#include <string.h>
+
+#include "bayes-bloom.h"
+#include "bayes-combiner-private.h"
+#include "bayes-hash.h"
+#include "bayes-storage-compact.h"
+#include "bayes-storage-compact-private.h"
+
+/**
+ * SECTION:bayes-storage-compact
+ * @title: BayesStorageCompact
+ * @short_description: Read-only quantized snapshot of training data.
+ *
+ * #BayesStorageCompact is a frozen snapshot of another #BayesStorage.
+ * It is meant for scoring large vocabularies once training is done.
+ * Rather than token counts, it keeps the log-odds log(p / (1 - p)) of
+ * the probability of every token for every classification. These are
+ * stored as 8 or 16 bit fixed point numbers with one scale per
+ * classification. All classifications of a token are adjacent in memory,
+ * so one token lookup touches a single short row.
+ *
+ * Tokens are found by a 64-bit hash in an open addressed table. The
+ * token strings themselves are not kept, so two tokens whose hashes
+ * collide share a row. The chance of that is negligible for any
+ * realistic vocabulary. A Bloom filter of the tokens is kept alongside
+ * the table so that most tokens that were never trained are turned away
+ * after reading a single cache line, without probing the table.
+ *
+ * The snapshot has a single layout that is used both in memory and on
+ * disk. bayes_storage_compact_save() writes it to a file and
+ * bayes_storage_compact_new_from_file() maps the file back in without
+ * parsing or copying it. The file uses the byte order of the machine it
+ * was written on.
+ *
+ * <refsect2><title>Accuracy</title>
+ * <para>
+ * Probabilities are clamped to 0.0001 - 0.9999 before they are
+ * stored, so log-odds lie within +/-9.21. A class with the largest
+ * log-odds magnitude M is stored with a step of M / 127 for 8 bits or
+ * M / 32767 for 16 bits. Rounding then changes the log-odds of a token
+ * by at most half a step and its probability by at most a quarter of
+ * that:
+ * </para>
+ * <informaltable>
+ * <tgroup cols="3">
+ * <thead><row><entry>bits</entry><entry>log-odds error</entry><entry>probability error</entry></row></thead>
+ * <tbody>
+ * <row><entry>8</entry><entry>0.0363</entry><entry>0.0091</entry></row>
+ * <row><entry>16</entry><entry>0.00015</entry><entry>0.000036</entry></row>
+ * </tbody>
+ * </tgroup>
+ * </informaltable>
+ * <para>
+ * Tokens without an opinion remain without an opinion. The combined
+ * log-odds of a document of n tokens, as used by bayes_combiner_naive(),
+ * are off by at most n times the per token error. Since rounding errors
+ * are independent, the typical error is closer to the per token error
+ * times the square root of n / 3. The bounds are checked by
+ * tests/test-storage-compact.c.
+ * </para>
+ * </refsect2>
+ *
+ * With bayes_combiner_naive(), #BayesClassifier scores a compact storage
+ * by adding the rows of the tokens of a document in integer accumulators
+ * for all classes at once. The other combiners are given the dequantized
+ * probabilities.
+ */
+
+static void bayes_storage_init (BayesStorageIface *iface);
+
+G_DEFINE_TYPE_EXTENDED(BayesStorageCompact,
+                       bayes_storage_compact,
+                       G_TYPE_OBJECT,
+                       0,
+                       G_IMPLEMENT_INTERFACE(BAYES_TYPE_STORAGE,
+                                             bayes_storage_init))
+
+#define COMPACT_MAGIC      "BAYESQNT"
+#define COMPACT_VERSION    2
+#define COMPACT_BYTE_ORDER 0x01020304
+#define COMPACT_ALIGN(n)   (((n) + 15) & ~(gsize)15)
+
+/*
+ * Fraction of the tokens never trained that get past the filter.
+ */
+#define FILTER_FALSE_POSITIVE_RATE 0.01
+
+/*
+ * Number of tokens that may be summed into 32-bit accumulators before
+ * they must be folded into doubles: 32767 * 65536 < 2^31.
+ */
+#define FOLD_INTERVAL 65536
+
+typedef struct
+{
+   gchar   magic[8];
+   guint32 version;
+   guint32 byte_order;
+   guint32 bits;
+   guint32 n_classes;
+   guint32 n_tokens;
+   guint32 n_slots;     /* Power of two */
+   guint32 names_size;  /* Bytes of nul terminated class names */
+   guint32 filter_hashes;
+   guint32 filter_blocks; /* Since version 2, 0 if there is no filter */
+   guint32 reserved;
+} Header;
+
+/*
+ * The snapshot is laid out as the header followed by these sections,
+ * each aligned to 16 bytes:
+ *
+ *   names  - class names, each nul terminated
+ *   scales - gdouble[n_classes], log-odds per quantization step
+ *   keys   - guint64[n_slots], token hash or 0 for an empty slot
+ *   rows   - guint32[n_slots], row of the token in matrix
+ *   matrix - gint8 or gint16[n_tokens][n_classes]
+ *   filter - guint64[filter_blocks][8], see bayes-bloom.h
+ *
+ * The filter is aligned to BAYES_BLOOM_BLOCK_SIZE instead so that its
+ * blocks fall on cache lines when the file is mapped. Version 1 is the
+ * same without the filter, its header ending before filter_blocks.
+ */
+struct _BayesStorageCompactPrivate
+{
+   GBytes        *bytes;
+   const Header  *header;
+   const gdouble *scales;
+   const guint64 *keys;
+   const guint32 *rows;
+   gconstpointer  matrix;
+   const guint64 *filter;
+   gsize          stride;
+   GPtrArray     *classes;   /* Class identifier -> name, NULL terminated */
+   GHashTable    *class_ids; /* Class name -> class identifier */
+};
+
+typedef struct
+{
+   gsize names;
+   gsize scales;
+   gsize keys;
+   gsize rows;
+   gsize matrix;
+   gsize filter;
+   gsize total;
+} Layout;
+
+GQuark
+bayes_storage_compact_error_quark (void)
+{
+   return g_quark_from_static_string("bayes-storage-compact-error-quark");
+}
+
+static void
+layout_init (Layout       *layout,
+             const Header *header)
+{
+   layout->names = COMPACT_ALIGN(sizeof(Header));
+   layout->scales = COMPACT_ALIGN(layout->names + header->names_size);
+   layout->keys = COMPACT_ALIGN(layout->scales +
+                                sizeof(gdouble) * header->n_classes);
+   layout->rows = COMPACT_ALIGN(layout->keys +
+                                sizeof(guint64) * header->n_slots);
+   layout->matrix = COMPACT_ALIGN(layout->rows +
+                                  sizeof(guint32) * header->n_slots);
+   layout->total = layout->matrix +
+                   (gsize)header->n_tokens * header->n_classes *
+                   (header->bits / 8);
+   layout->filter = layout->total;
+
+   if (header->version >= 2 && header->filter_blocks) {
+      layout->filter = (layout->total + BAYES_BLOOM_BLOCK_SIZE - 1) &
+                       ~(gsize)(BAYES_BLOOM_BLOCK_SIZE - 1);
+      layout->total = layout->filter +
+                      (gsize)header->filter_blocks * BAYES_BLOOM_BLOCK_SIZE;
+   }
+}
+
+static inline guint64
+hash_fingerprint (const BayesFingerprint *fingerprint)
+{
+   /*
+    * 0 marks an empty slot.
+    */
+   return fingerprint->h1 ? fingerprint->h1 : 1;
+}
+
+static inline guint64
+hash_token (const gchar *token)
+{
+   BayesFingerprint fingerprint;
+
+   _bayes_fingerprint_init(&fingerprint, token, strlen(token), 0);
+
+   return hash_fingerprint(&fingerprint);
+}
+
+static inline gconstpointer
+bayes_storage_compact_lookup_row (BayesStorageCompact *compact,
+                                  const gchar         *token)
+{
+   BayesStorageCompactPrivate *priv = compact->priv;
+   BayesFingerprint fingerprint;
+   guint64 key;
+   guint64 mask;
+   guint64 i;
+
+   _bayes_fingerprint_init(&fingerprint, token, strlen(token), 0);
+
+   if (priv->filter &&
+       !_bayes_bloom_test(priv->filter, priv->header->filter_blocks,
+                          priv->header->filter_hashes, &fingerprint)) {
+      return NULL;
+   }
+
+   key = hash_fingerprint(&fingerprint);
+   mask = priv->header->n_slots - 1;
+
+   for (i = key & mask; priv->keys[i]; i = (i + 1) & mask) {
+      if (priv->keys[i] == key) {
+         return (const guint8 *)priv->matrix + priv->rows[i] * priv->stride;
+      }
+   }
+
+   return NULL;
+}
+
+static inline gint
+row_get (BayesStorageCompact *compact,
+         gconstpointer        row,
+         guint                class_id)
+{
+   if (compact->priv->header->bits == 8) {
+      return ((const gint8 *)row)[class_id];
+   }
+
+   return ((const gint16 *)row)[class_id];
+}
+
+/*
+ * Points the private data into the snapshot in @bytes, which must have
+ * been validated.
+ */
+static void
+bayes_storage_compact_set_bytes (BayesStorageCompact *compact,
+                                 GBytes              *bytes)
+{
+   BayesStorageCompactPrivate *priv = compact->priv;
+   const guint8 *data;
+   const gchar *name;
+   Layout layout;
+   guint i;
+
+   data = g_bytes_get_data(bytes, NULL);
+
+   priv->bytes = bytes;
+   priv->header = (const Header *)data;
+
+   layout_init(&layout, priv->header);
+
+   priv->scales = (const gdouble *)(data + layout.scales);
+   priv->keys = (const guint64 *)(data + layout.keys);
+   priv->rows = (const guint32 *)(data + layout.rows);
+   priv->matrix = data + layout.matrix;
+   priv->filter = (layout.filter < layout.total) ?
+                  (const guint64 *)(data + layout.filter) : NULL;
+   priv->stride = priv->header->n_classes * (priv->header->bits / 8);
+
+   g_ptr_array_set_size(priv->classes, 0);
+   name = (const gchar *)(data + layout.names);
+   for (i = 0; i < priv->header->n_classes; i++) {
+      g_ptr_array_add(priv->classes, g_strdup(name));
+      g_hash_table_insert(priv->class_ids, g_ptr_array_index(priv->classes, i),
+                          GUINT_TO_POINTER(i));
+      name += strlen(name) + 1;
+   }
+   g_ptr_array_add(priv->classes, NULL);
+}
+
+static gboolean
+validate (GBytes  *bytes,
+          GError **error)
+{
+   const Header *header;
+   const guint8 *data;
+   const guint32 *rows;
+   const guint64 *keys;
+   const gchar *names;
+   Layout layout;
+   gsize length;
+   guint n_names = 0;
+   guint n_keys = 0;
+   guint i;
+
+   data = g_bytes_get_data(bytes, &length);
+   header = (const Header *)data;
+
+   if (length < sizeof *header ||
+       memcmp(header->magic, COMPACT_MAGIC, sizeof header->magic) ||
+       header->version < 1 ||
+       header->version > COMPACT_VERSION ||
+       header->byte_order != COMPACT_BYTE_ORDER ||
+       (header->bits != 8 && header->bits != 16) ||
+       !header->n_slots ||
+       (header->n_slots & (header->n_slots - 1)) ||
+       header->n_slots <= header->n_tokens) {
+      goto failure;
+   }
+
+   if (header->version >= 2 &&
+       header->filter_blocks &&
+       (!header->filter_hashes ||
+        header->filter_hashes > BAYES_BLOOM_BLOCK_BITS)) {
+      goto failure;
+   }
+
+   layout_init(&layout, header);
+
+   if (layout.total != length) {
+      goto failure;
+   }
+
+   names = (const gchar *)(data + layout.names);
+   if (header->names_size && names[header->names_size - 1] != '\0') {
+      goto failure;
+   }
+   for (i = 0; i < header->names_size; i++) {
+      n_names += (names[i] == '\0');
+   }
+   if (n_names != header->n_classes) {
+      goto failure;
+   }
+
+   keys = (const guint64 *)(data + layout.keys);
+   rows = (const guint32 *)(data + layout.rows);
+   for (i = 0; i < header->n_slots; i++) {
+      if (keys[i]) {
+         if (rows[i] >= header->n_tokens) {
+            goto failure;
+         }
+         n_keys++;
+      }
+   }
+
+   /*
+    * Lookups probe until they find an empty slot, so there must be one.
+    */
+   if (n_keys > header->n_tokens) {
+      goto failure;
+   }
+
+   return TRUE;
+
+failure:
+   g_set_error(error, BAYES_STORAGE_COMPACT_ERROR,
+               BAYES_STORAGE_COMPACT_ERROR_INVALID,
+               _("The data is not a compact model of this machine."));
+   return FALSE;
+}
+
+static void
+collect_token (const gchar *token,
+               gpointer     user_data)
+{
+   g_ptr_array_add(user_data, (gchar *)token);
+}
+
+/**
+ * bayes_storage_compact_new:
+ * @storage: (in): The #BayesStorage to take a snapshot of.
+ * @bits: (in): 8 or 16.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Creates a new #BayesStorageCompact holding the probabilities found in
+ * @storage, quantized to @bits bits. @storage must support
+ * bayes_storage_foreach_token() and must not be modified while the
+ * snapshot is taken.
+ *
+ * Returns: (transfer full): A #BayesStorageCompact or %NULL if @storage
+ *   cannot enumerate its tokens.
+ */
+BayesStorage *
+bayes_storage_compact_new (BayesStorage  *storage,
+                           guint          bits,
+                           GError       **error)
+{
+   BayesFingerprint fingerprint;
+   BayesStorageCompact *compact;
+   const gchar * const *names;
+   const guint64 *blocks;
+   BayesBloom *filter = NULL;
+   GPtrArray *tokens;
+   GString *packed;
+   Header *header;
+   Layout layout;
+   guint64 *keys;
+   guint32 *rows;
+   gdouble *scales;
+   gdouble *odds;
+   guint8 *data;
+   const gchar *token;
+   guint64 n_blocks;
+   guint64 mask;
+   guint64 slot;
+   gdouble p;
+   gint q;
+   guint n_classes;
+   guint i;
+   guint j;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), NULL);
+   g_return_val_if_fail(bits == 8 || bits == 16, NULL);
+
+   tokens = g_ptr_array_new();
+
+   if (!bayes_storage_foreach_token(storage, collect_token, tokens)) {
+      g_set_error(error, BAYES_STORAGE_COMPACT_ERROR,
+                  BAYES_STORAGE_COMPACT_ERROR_UNSUPPORTED,
+                  _("The storage cannot enumerate its tokens."));
+      g_ptr_array_unref(tokens);
+      return NULL;
+   }
+
+   names = bayes_storage_get_classes(storage, &n_classes);
+
+   packed = g_string_new(NULL);
+   for (i = 0; i < n_classes; i++) {
+      g_string_append_len(packed, names[i], strlen(names[i]) + 1);
+   }
+
+   header = g_new0(Header, 1);
+   memcpy(header->magic, COMPACT_MAGIC, sizeof header->magic);
+   header->version = COMPACT_VERSION;
+   header->byte_order = COMPACT_BYTE_ORDER;
+   header->bits = bits;
+   header->n_classes = n_classes;
+   header->n_tokens = tokens->len;
+   header->names_size = packed->len;
+
+   /*
+    * Keep the table at most half full so probes stay short.
+    */
+   for (header->n_slots = 2;
+        header->n_slots < 2 * (guint64)tokens->len;
+        header->n_slots *= 2) {
+   }
+
+   if (tokens->len) {
+      filter = _bayes_bloom_new(tokens->len, FILTER_FALSE_POSITIVE_RATE);
+      _bayes_bloom_get_blocks(filter, &n_blocks, &header->filter_hashes);
+      header->filter_blocks = n_blocks;
+   }
+
+   layout_init(&layout, header);
+
+   data = g_malloc0(layout.total);
+   memcpy(data, header, sizeof *header);
+   memcpy(data + layout.names, packed->str, packed->len);
+   scales = (gdouble *)(data + layout.scales);
+   keys = (guint64 *)(data + layout.keys);
+   rows = (guint32 *)(data + layout.rows);
+
+   /*
+    * Find the largest log-odds of every class to choose its scale.
+    */
+   odds = g_new(gdouble, MAX((gsize)tokens->len * n_classes, 1));
+
+   for (j = 0; j < n_classes; j++) {
+      scales[j] = 0.0;
+   }
+
+   for (i = 0; i < tokens->len; i++) {
+      for (j = 0; j < n_classes; j++) {
+         p = bayes_storage_get_class_token_probability(
+               storage, j, g_ptr_array_index(tokens, i));
+         if (p == 0.0) {
+            odds[i * n_classes + j] = 0.0;
+         } else {
+            p = CLAMP(p, BAYES_PROBABILITY_MIN, BAYES_PROBABILITY_MAX);
+            odds[i * n_classes + j] = log(p / (1.0 - p));
+            scales[j] = MAX(scales[j], fabs(odds[i * n_classes + j]));
+         }
+      }
+   }
+
+   for (j = 0; j < n_classes; j++) {
+      scales[j] = scales[j] ? scales[j] / ((1 << (bits - 1)) - 1) : 1.0;
+   }
+
+   mask = header->n_slots - 1;
+
+   for (i = 0; i < tokens->len; i++) {
+      token = g_ptr_array_index(tokens, i);
+      _bayes_fingerprint_init(&fingerprint, token, strlen(token), 0);
+      _bayes_bloom_add(filter, &fingerprint);
+
+      for (slot = hash_fingerprint(&fingerprint) & mask;
+           keys[slot];
+           slot = (slot + 1) & mask) {
+      }
+      keys[slot] = hash_fingerprint(&fingerprint);
+      rows[slot] = i;
+
+      for (j = 0; j < n_classes; j++) {
+         q = lrint(odds[i * n_classes + j] / scales[j]);
+         if (bits == 8) {
+            ((gint8 *)(data + layout.matrix))[i * n_classes + j] = q;
+         } else {
+            ((gint16 *)(data + layout.matrix))[i * n_classes + j] = q;
+         }
+      }
+   }
+
+   if (filter) {
+      blocks = _bayes_bloom_get_blocks(filter, NULL, NULL);
+      memcpy(data + layout.filter, blocks,
+             (gsize)header->filter_blocks * BAYES_BLOOM_BLOCK_SIZE);
+      _bayes_bloom_free(filter);
+   }
+
+   compact = g_object_new(BAYES_TYPE_STORAGE_COMPACT, NULL);
+   bayes_storage_compact_set_bytes(compact,
+                                   g_bytes_new_take(data, layout.total));
+
+   g_free(odds);
+   g_free(header);
+   g_string_free(packed, TRUE);
+   g_ptr_array_unref(tokens);
+
+   return BAYES_STORAGE(compact);
+}
+
+/**
+ * bayes_storage_compact_new_from_file:
+ * @filename: (in): The file written by bayes_storage_compact_save().
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Creates a new #BayesStorageCompact by mapping @filename into memory.
+ * Pages of the file are only read once tokens found in them are scored
+ * and are shared by every process mapping the same file.
+ *
+ * Returns: (transfer full): A #BayesStorageCompact or %NULL on failure.
+ */
+BayesStorage *
+bayes_storage_compact_new_from_file (const gchar  *filename,
+                                     GError      **error)
+{
+   BayesStorageCompact *compact;
+   GMappedFile *mapped;
+   GBytes *bytes;
+
+   g_return_val_if_fail(filename, NULL);
+
+   if (!(mapped = g_mapped_file_new(filename, FALSE, error))) {
+      return NULL;
+   }
+
+   bytes = g_mapped_file_get_bytes(mapped);
+   g_mapped_file_unref(mapped);
+
+   if (!validate(bytes, error)) {
+      g_bytes_unref(bytes);
+      return NULL;
+   }
+
+   compact = g_object_new(BAYES_TYPE_STORAGE_COMPACT, NULL);
+   bayes_storage_compact_set_bytes(compact, bytes);
+
+   return BAYES_STORAGE(compact);
+}
+
+/**
+ * bayes_storage_compact_save:
+ * @compact: (in): A #BayesStorageCompact.
+ * @filename: (in): The file to write.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Writes @compact to @filename so that it can be loaded with
+ * bayes_storage_compact_new_from_file(). The file is replaced
+ * atomically.
+ *
+ * Returns: %TRUE if successful; otherwise %FALSE and @error is set.
+ */
+gboolean
+bayes_storage_compact_save (BayesStorageCompact  *compact,
+                            const gchar          *filename,
+                            GError              **error)
+{
+   gconstpointer data;
+   gsize length;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), FALSE);
+   g_return_val_if_fail(filename, FALSE);
+
+   data = g_bytes_get_data(compact->priv->bytes, &length);
+
+   return g_file_set_contents(filename, data, length, error);
+}
+
+/**
+ * bayes_storage_compact_get_bits:
+ * @compact: (in): A #BayesStorageCompact.
+ *
+ * Retrieves the number of bits every log-odds value is stored in.
+ *
+ * Returns: 8 or 16.
+ */
+guint
+bayes_storage_compact_get_bits (BayesStorageCompact *compact)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), 0);
+   return compact->priv->header->bits;
+}
+
+/**
+ * bayes_storage_compact_get_bytes_per_token:
+ * @compact: (in): A #BayesStorageCompact.
+ *
+ * Retrieves the number of bytes read to score one token against every
+ * classification: the hash and row of its slot plus its row of log-odds.
+ * Probing past colliding slots adds 12 bytes each, which is rare as the
+ * table is kept at most half full.
+ *
+ * Returns: A #gsize.
+ */
+gsize
+bayes_storage_compact_get_bytes_per_token (BayesStorageCompact *compact)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), 0);
+   return sizeof(guint64) + sizeof(guint32) + compact->priv->stride;
+}
+
+#define SCORE_NAIVE(type)                                                  \
+   G_STMT_START {                                                          \
+      const type *row;                                                     \
+      for (i = 0; i < n_tokens; i++) {                                     \
+         if ((row = bayes_storage_compact_lookup_row(compact,              \
+                                                     tokens[i]))) {        \
+            for (j = 0; j < n_classes; j++) {                              \
+               acc[j] += row[j];                                           \
+            }                                                              \
+         }                                                                 \
+         if (!((i + 1) % FOLD_INTERVAL)) {                                 \
+            for (j = 0; j < n_classes; j++) {                              \
+               sums[j] += acc[j];                                          \
+               acc[j] = 0;                                                 \
+            }                                                              \
+         }                                                                 \
+      }                                                                    \
+   } G_STMT_END
+
+void
+_bayes_storage_compact_score_naive (BayesStorageCompact  *compact,
+                                    gchar               **tokens,
+                                    guint                 n_tokens,
+                                    gdouble              *scores)
+{
+   BayesStorageCompactPrivate *priv = compact->priv;
+   gdouble *sums;
+   gint32 *acc;
+   guint n_classes;
+   guint i;
+   guint j;
+
+   n_classes = priv->header->n_classes;
+   acc = g_new0(gint32, MAX(n_classes, 1));
+   sums = g_new0(gdouble, MAX(n_classes, 1));
+
+   if (priv->header->bits == 8) {
+      SCORE_NAIVE(gint8);
+   } else {
+      SCORE_NAIVE(gint16);
+   }
+
+   /*
+    * Same as _bayes_evidence_naive() given the summed log-odds. A class
+    * without any opinion sums to 0 and so scores 0.5 as well.
+    */
+   for (j = 0; j < n_classes; j++) {
+      sums[j] += acc[j];
+      scores[j] = 1.0 / (1.0 + exp(-sums[j] * priv->scales[j]));
+   }
+
+   g_free(sums);
+   g_free(acc);
+}
+
+static void
+bayes_storage_compact_add_token_count (BayesStorage *storage,
+                                       const gchar  *name,
+                                       const gchar  *token,
+                                       guint         count)
+{
+   g_warning("BayesStorageCompact is read-only, train the storage it was "
+             "created from instead.");
+}
+
+static gdouble
+bayes_storage_compact_get_class_token_probability (BayesStorage *storage,
+                                                   guint         class_id,
+                                                   const gchar  *token)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+   gconstpointer row;
+   gint q;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   if (class_id >= compact->priv->header->n_classes ||
+       !(row = bayes_storage_compact_lookup_row(compact, token)) ||
+       !(q = row_get(compact, row, class_id))) {
+      return 0.0;
+   }
+
+   return 1.0 / (1.0 + exp(-q * compact->priv->scales[class_id]));
+}
+
+static gdouble
+bayes_storage_compact_get_token_probability (BayesStorage *storage,
+                                             const gchar  *name,
+                                             const gchar  *token)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+   gpointer class_id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), 0.0);
+   g_return_val_if_fail(name, 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   if (!g_hash_table_lookup_extended(compact->priv->class_ids, name, NULL,
+                                     &class_id)) {
+      return 0.0;
+   }
+
+   return bayes_storage_compact_get_class_token_probability(
+         storage, GPOINTER_TO_UINT(class_id), token);
+}
+
+/*
+ * Token counts are not part of the snapshot.
+ */
+static guint
+bayes_storage_compact_get_token_count (BayesStorage *storage,
+                                       const gchar  *name,
+                                       const gchar  *token)
+{
+   return 0;
+}
+
+static guint
+bayes_storage_compact_get_class_token_count (BayesStorage *storage,
+                                             guint         class_id,
+                                             const gchar  *token)
+{
+   return 0;
+}
+
+static const gchar * const *
+bayes_storage_compact_get_classes (BayesStorage *storage,
+                                   guint        *n_classes)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), NULL);
+
+   if (n_classes) {
+      *n_classes = compact->priv->header->n_classes;
+   }
+
+   return (const gchar * const *)compact->priv->classes->pdata;
+}
+
+static gint
+bayes_storage_compact_lookup_class (BayesStorage *storage,
+                                    const gchar  *name)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+   gpointer class_id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), -1);
+   g_return_val_if_fail(name, -1);
+
+   if (g_hash_table_lookup_extended(compact->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
+   }
+
+   return -1;
+}
+
+/*
+ * The snapshot never changes.
+ */
+static guint64
+bayes_storage_compact_get_generation (BayesStorage *storage)
+{
+   return 0;
+}
+
+static void
+bayes_storage_compact_get_footprint (BayesStorage          *storage,
+                                     BayesStorageFootprint *footprint)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+   const Header *header;
+
+   g_return_if_fail(BAYES_IS_STORAGE_COMPACT(compact));
+
+   header = compact->priv->header;
+
+   /*
+    * Tokens are only kept as their hash. The row indexes belong to the
+    * table along with the empty slots.
+    */
+   footprint->n_tokens = header->n_tokens;
+   footprint->n_buckets = header->n_slots;
+   footprint->load_factor = (gdouble)header->n_tokens / header->n_slots;
+   footprint->key_bytes = (gsize)header->n_tokens * sizeof(guint64);
+   footprint->value_bytes = (gsize)header->n_tokens * compact->priv->stride +
+                            header->n_classes * sizeof(gdouble);
+   footprint->table_bytes = (gsize)header->n_slots *
+                            (sizeof(guint64) + sizeof(guint32)) -
+                            footprint->key_bytes;
+   if (compact->priv->filter) {
+      footprint->table_bytes += (gsize)header->filter_blocks *
+                                BAYES_BLOOM_BLOCK_SIZE;
+   }
+   footprint->class_bytes = header->names_size +
+                            (header->n_classes + 1) * sizeof(gpointer);
+}
+
+static gchar **
+bayes_storage_compact_get_names (BayesStorage *storage)
+{
+   BayesStorageCompact *compact = (BayesStorageCompact *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_COMPACT(compact), NULL);
+
+   return g_strdupv((gchar **)compact->priv->classes->pdata);
+}
+
+static void
+bayes_storage_compact_finalize (GObject *object)
+{
+   BayesStorageCompactPrivate *priv = BAYES_STORAGE_COMPACT(object)->priv;
+
+   if (priv->bytes) {
+      g_bytes_unref(priv->bytes);
+   }
+   g_hash_table_unref(priv->class_ids);
+   g_ptr_array_unref(priv->classes);
+
+   G_OBJECT_CLASS(bayes_storage_compact_parent_class)->finalize(object);
+}
+
+static void
+bayes_storage_compact_class_init (BayesStorageCompactClass *klass)
+{
+   GObjectClass *object_class;
+
+   object_class = G_OBJECT_CLASS(klass);
+   object_class->finalize = bayes_storage_compact_finalize;
+   g_type_class_add_private(object_class, sizeof(BayesStorageCompactPrivate));
+}
+
+static void
+bayes_storage_compact_init (BayesStorageCompact *compact)
+{
+   BayesStorageCompactPrivate *priv;
+
+   compact->priv =
+      G_TYPE_INSTANCE_GET_PRIVATE(compact,
+                                  BAYES_TYPE_STORAGE_COMPACT,
+                                  BayesStorageCompactPrivate);
+
+   priv = compact->priv;
+
+   priv->classes = g_ptr_array_new_with_free_func(g_free);
+   priv->class_ids = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+static void
+bayes_storage_init (BayesStorageIface *iface)
+{
+   iface->add_token_count = bayes_storage_compact_add_token_count;
+   iface->get_names = bayes_storage_compact_get_names;
+   iface->get_token_count = bayes_storage_compact_get_token_count;
+   iface->get_token_probability = bayes_storage_compact_get_token_probability;
+   iface->get_classes = bayes_storage_compact_get_classes;
+   iface->lookup_class = bayes_storage_compact_lookup_class;
+   iface->get_class_token_count = bayes_storage_compact_get_class_token_count;
+   iface->get_class_token_probability =
+      bayes_storage_compact_get_class_token_probability;
+   iface->get_generation = bayes_storage_compact_get_generation;
+   iface->get_footprint = bayes_storage_compact_get_footprint;
+}
@@ -0,0 +1,83 @@
+/* bayes-storage-compact.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_STORAGE_COMPACT_H
+#define BAYES_STORAGE_COMPACT_H
+
+#include "bayes-storage.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_STORAGE_COMPACT            (bayes_storage_compact_get_type())
+#define BAYES_STORAGE_COMPACT(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_COMPACT, BayesStorageCompact))
+#define BAYES_STORAGE_COMPACT_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_COMPACT, BayesStorageCompact const))
+#define BAYES_STORAGE_COMPACT_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  BAYES_TYPE_STORAGE_COMPACT, BayesStorageCompactClass))
+#define BAYES_IS_STORAGE_COMPACT(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), BAYES_TYPE_STORAGE_COMPACT))
+#define BAYES_IS_STORAGE_COMPACT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  BAYES_TYPE_STORAGE_COMPACT))
+#define BAYES_STORAGE_COMPACT_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  BAYES_TYPE_STORAGE_COMPACT, BayesStorageCompactClass))
+
+#define BAYES_STORAGE_COMPACT_ERROR (bayes_storage_compact_error_quark())
+
+/**
+ * BayesStorageCompactError:
+ * @BAYES_STORAGE_COMPACT_ERROR_INVALID: The file is not a compact model
+ *   or was written by a machine of another byte order.
+ * @BAYES_STORAGE_COMPACT_ERROR_UNSUPPORTED: The source storage cannot
+ *   enumerate its tokens.
+ *
+ * Errors of #BayesStorageCompact.
+ */
+typedef enum
+{
+   BAYES_STORAGE_COMPACT_ERROR_INVALID = 1,
+   BAYES_STORAGE_COMPACT_ERROR_UNSUPPORTED,
+} BayesStorageCompactError;
+
+typedef struct _BayesStorageCompact        BayesStorageCompact;
+typedef struct _BayesStorageCompactClass   BayesStorageCompactClass;
+typedef struct _BayesStorageCompactPrivate BayesStorageCompactPrivate;
+
+struct _BayesStorageCompact
+{
+   GObject parent;
+
+   /*< private >*/
+   BayesStorageCompactPrivate *priv;
+};
+
+struct _BayesStorageCompactClass
+{
+   GObjectClass parent_class;
+};
+
+GQuark        bayes_storage_compact_error_quark         (void) G_GNUC_CONST;
+guint         bayes_storage_compact_get_bits            (BayesStorageCompact  *compact);
+gsize         bayes_storage_compact_get_bytes_per_token (BayesStorageCompact  *compact);
+GType         bayes_storage_compact_get_type            (void) G_GNUC_CONST;
+BayesStorage *bayes_storage_compact_new                 (BayesStorage         *storage,
+                                                         guint                 bits,
+                                                         GError              **error);
+BayesStorage *bayes_storage_compact_new_from_file       (const gchar          *filename,
+                                                         GError              **error);
+gboolean      bayes_storage_compact_save                (BayesStorageCompact  *compact,
+                                                         const gchar          *filename,
+                                                         GError              **error);
+
+G_END_DECLS
+
+#endif /* BAYES_STORAGE_COMPACT_H */
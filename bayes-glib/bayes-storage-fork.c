@@ -0,0 +1,587 @@
+/* bayes-storage-fork.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "bayes-storage-fork.h"
+#include "bayes-storage-memory.h"
+#include "bayes-storage-memory-private.h"
+
+/**
+ * SECTION:bayes-storage-fork
+ * @title: BayesStorageFork
+ * @short_description: Copy-on-write training layered over another storage.
+ *
+ * #BayesStorageFork layers new training over a parent #BayesStorage
+ * without copying or modifying it. Tokens added to the fork are counted
+ * in a #BayesStorageMemory of its own, the delta, and every lookup adds
+ * the counts of the parent and the delta. The memory used by a fork
+ * therefore grows with its own training rather than with the parent,
+ * which makes it cheap to keep many models that share a large base,
+ * such as one per tenant or per experiment.
+ *
+ * The parent is treated as immutable: it must provide token counts, as
+ * #BayesStorageMemory does, and must not be trained for as long as it
+ * has forks. The classifications of the parent keep their class
+ * identifiers in the fork, and classifications first trained in the
+ * fork are numbered after them.
+ *
+ * bayes_storage_foreach_token() lists the tokens of the parent followed
+ * by the tokens only found in the delta. If the parent cannot enumerate
+ * its tokens, only the tokens of the delta are listed.
+ */
+
+static void bayes_storage_init (BayesStorageIface *iface);
+
+G_DEFINE_TYPE_EXTENDED(BayesStorageFork,
+                       bayes_storage_fork,
+                       G_TYPE_OBJECT,
+                       0,
+                       G_IMPLEMENT_INTERFACE(BAYES_TYPE_STORAGE,
+                                             bayes_storage_init))
+
+struct _BayesStorageForkPrivate
+{
+   BayesStorage       *parent;
+   BayesStorageMemory *parent_memory; /* parent if it is a BayesStorageMemory */
+   BayesStorageMemory *delta;
+   guint               n_parent_classes;
+
+   GPtrArray  *classes;      /* Class identifier -> name, NULL terminated */
+   GHashTable *class_ids;    /* Class name -> class identifier */
+   GArray     *class_counts; /* Class identifier -> count of all tokens */
+   GArray     *delta_ids;    /* Class identifier -> delta identifier or -1 */
+   guint       count;        /* Count of all tokens */
+};
+
+typedef struct
+{
+   BayesStorageFork        *fork;
+   BayesStorageForeachFunc  func;
+   gpointer                 user_data;
+} ForeachData;
+
+/*
+ * Looks up the count of @token in the parent for @class_id, which may be
+ * beyond the classifications of the parent, and in all classifications.
+ */
+static void
+bayes_storage_fork_get_parent_counts (BayesStorageFork *fork,
+                                      guint             class_id,
+                                      const gchar      *token,
+                                      guint            *this_count,
+                                      guint            *tot_count)
+{
+   BayesStorageForkPrivate *priv = fork->priv;
+   BayesStorageMemoryToken *tok;
+
+   if (priv->parent_memory) {
+      tok = _bayes_storage_memory_lookup_token(priv->parent_memory, token);
+      *this_count = (tok && class_id < tok->n_counts) ?
+                    tok->counts[class_id] : 0;
+      *tot_count = tok ? tok->count : 0;
+      return;
+   }
+
+   *tot_count = bayes_storage_get_token_count(priv->parent, NULL, token);
+   *this_count = (*tot_count && class_id < priv->n_parent_classes) ?
+                 bayes_storage_get_class_token_count(priv->parent, class_id,
+                                                     token) :
+                 0;
+}
+
+/*
+ * Looks up the count of @token in the delta for @class_id and in all
+ * classifications.
+ */
+static void
+bayes_storage_fork_get_delta_counts (BayesStorageFork *fork,
+                                     guint             class_id,
+                                     const gchar      *token,
+                                     guint            *this_count,
+                                     guint            *tot_count)
+{
+   BayesStorageForkPrivate *priv = fork->priv;
+   BayesStorageMemoryToken *tok;
+   gint delta_id;
+
+   tok = _bayes_storage_memory_lookup_token(priv->delta, token);
+   delta_id = g_array_index(priv->delta_ids, gint, class_id);
+
+   *this_count = (tok && delta_id >= 0 && (guint)delta_id < tok->n_counts) ?
+                 tok->counts[delta_id] : 0;
+   *tot_count = tok ? tok->count : 0;
+}
+
+static guint
+bayes_storage_fork_add_class (BayesStorageFork *fork,
+                              const gchar      *name)
+{
+   BayesStorageForkPrivate *priv = fork->priv;
+   gpointer class_id;
+   gint delta_id = -1;
+   guint zero = 0;
+
+   if (g_hash_table_lookup_extended(priv->class_ids, name, NULL,
+                                    &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
+   }
+
+   class_id = GUINT_TO_POINTER(priv->class_counts->len);
+   g_ptr_array_index(priv->classes, priv->classes->len - 1) = g_strdup(name);
+   g_ptr_array_add(priv->classes, NULL);
+   g_hash_table_insert(priv->class_ids,
+                       g_ptr_array_index(priv->classes,
+                                         priv->classes->len - 2),
+                       class_id);
+   g_array_append_val(priv->class_counts, zero);
+   g_array_append_val(priv->delta_ids, delta_id);
+
+   return GPOINTER_TO_UINT(class_id);
+}
+
+static void
+bayes_storage_fork_add_token_count (BayesStorage *storage,
+                                    const gchar  *name,
+                                    const gchar  *token,
+                                    guint         count)
+{
+   BayesStorageForkPrivate *priv;
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   guint class_id;
+
+   g_return_if_fail(BAYES_IS_STORAGE_FORK(fork));
+   g_return_if_fail(name);
+   g_return_if_fail(token);
+
+   priv = fork->priv;
+
+   class_id = bayes_storage_fork_add_class(fork, name);
+
+   bayes_storage_add_token_count(BAYES_STORAGE(priv->delta), name, token,
+                                 count);
+
+   if (g_array_index(priv->delta_ids, gint, class_id) < 0) {
+      g_array_index(priv->delta_ids, gint, class_id) =
+         bayes_storage_lookup_class(BAYES_STORAGE(priv->delta), name);
+   }
+
+   g_array_index(priv->class_counts, guint, class_id) += count;
+   priv->count += count;
+}
+
+static guint
+bayes_storage_fork_get_class_token_count (BayesStorage *storage,
+                                          guint         class_id,
+                                          const gchar  *token)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   guint parent_count;
+   guint parent_total;
+   guint delta_count;
+   guint delta_total;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), 0);
+
+   if (class_id >= fork->priv->class_counts->len) {
+      return 0;
+   } else if (!token) {
+      return g_array_index(fork->priv->class_counts, guint, class_id);
+   }
+
+   bayes_storage_fork_get_parent_counts(fork, class_id, token,
+                                        &parent_count, &parent_total);
+   bayes_storage_fork_get_delta_counts(fork, class_id, token,
+                                       &delta_count, &delta_total);
+
+   return parent_count + delta_count;
+}
+
+static guint
+bayes_storage_fork_get_token_count (BayesStorage *storage,
+                                    const gchar  *name,
+                                    const gchar  *token)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   gpointer class_id;
+   guint parent_count;
+   guint delta_count;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), 0);
+
+   if (name) {
+      if (g_hash_table_lookup_extended(fork->priv->class_ids, name, NULL,
+                                       &class_id)) {
+         return bayes_storage_fork_get_class_token_count(
+               storage, GPOINTER_TO_UINT(class_id), token);
+      }
+   } else if (!token) {
+      return fork->priv->count;
+   } else {
+      parent_count = bayes_storage_get_token_count(fork->priv->parent, NULL,
+                                                   token);
+      delta_count = bayes_storage_get_token_count(
+            BAYES_STORAGE(fork->priv->delta), NULL, token);
+      return parent_count + delta_count;
+   }
+
+   return 0;
+}
+
+static gdouble
+bayes_storage_fork_get_class_token_probability (BayesStorage *storage,
+                                                guint         class_id,
+                                                const gchar  *token)
+{
+   BayesStorageForkPrivate *priv;
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   guint parent_count;
+   guint parent_total;
+   guint delta_count;
+   guint delta_total;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   priv = fork->priv;
+
+   if (class_id >= priv->class_counts->len) {
+      return 0.0;
+   }
+
+   bayes_storage_fork_get_parent_counts(fork, class_id, token,
+                                        &parent_count, &parent_total);
+   bayes_storage_fork_get_delta_counts(fork, class_id, token,
+                                       &delta_count, &delta_total);
+
+   return _bayes_storage_memory_compute_probability(
+         parent_count + delta_count,
+         parent_total + delta_total,
+         g_array_index(priv->class_counts, guint, class_id),
+         priv->count);
+}
+
+static gdouble
+bayes_storage_fork_get_token_probability (BayesStorage *storage,
+                                          const gchar  *name,
+                                          const gchar  *token)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   gpointer class_id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), 0.0);
+   g_return_val_if_fail(name, 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   if (g_hash_table_lookup_extended(fork->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      return bayes_storage_fork_get_class_token_probability(
+            storage, GPOINTER_TO_UINT(class_id), token);
+   }
+
+   return 0.0;
+}
+
+static const gchar * const *
+bayes_storage_fork_get_classes (BayesStorage *storage,
+                                guint        *n_classes)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), NULL);
+
+   if (n_classes) {
+      *n_classes = fork->priv->class_counts->len;
+   }
+
+   return (const gchar * const *)fork->priv->classes->pdata;
+}
+
+static gint
+bayes_storage_fork_lookup_class (BayesStorage *storage,
+                                 const gchar  *name)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   gpointer class_id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), -1);
+   g_return_val_if_fail(name, -1);
+
+   if (g_hash_table_lookup_extended(fork->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
+   }
+
+   return -1;
+}
+
+static guint64
+bayes_storage_fork_get_generation (BayesStorage *storage)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), 0);
+
+   return bayes_storage_get_generation(fork->priv->parent) +
+          bayes_storage_get_generation(BAYES_STORAGE(fork->priv->delta));
+}
+
+static void
+foreach_delta_token (const gchar *token,
+                     gpointer     user_data)
+{
+   ForeachData *data = user_data;
+
+   if (!bayes_storage_get_token_count(data->fork->priv->parent, NULL, token)) {
+      data->func(token, data->user_data);
+   }
+}
+
+static void
+bayes_storage_fork_foreach_token (BayesStorage            *storage,
+                                  BayesStorageForeachFunc  func,
+                                  gpointer                 user_data)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   ForeachData data;
+
+   g_return_if_fail(BAYES_IS_STORAGE_FORK(fork));
+
+   data.fork = fork;
+   data.func = func;
+   data.user_data = user_data;
+
+   bayes_storage_foreach_token(fork->priv->parent, func, user_data);
+   bayes_storage_foreach_token(BAYES_STORAGE(fork->priv->delta),
+                               foreach_delta_token, &data);
+}
+
+/*
+ * Only the delta and the class tables of the fork are counted, the
+ * parent being shared with its other forks.
+ */
+static void
+bayes_storage_fork_get_footprint (BayesStorage          *storage,
+                                  BayesStorageFootprint *footprint)
+{
+   BayesStorageForkPrivate *priv;
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   guint n_classes;
+   guint i;
+
+   g_return_if_fail(BAYES_IS_STORAGE_FORK(fork));
+
+   priv = fork->priv;
+   n_classes = priv->class_counts->len;
+
+   bayes_storage_get_footprint(BAYES_STORAGE(priv->delta), footprint);
+
+   for (i = 0; i < n_classes; i++) {
+      footprint->class_bytes +=
+         strlen(g_ptr_array_index(priv->classes, i)) + 1;
+   }
+   footprint->class_bytes += (n_classes + 1) * sizeof(gpointer) +
+                             n_classes * (sizeof(guint) + sizeof(gint));
+}
+
+static void
+bayes_storage_fork_get_class_footprint (BayesStorage *storage,
+                                        guint         class_id,
+                                        guint        *n_tokens,
+                                        gsize        *n_bytes)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+   gint delta_id;
+
+   g_return_if_fail(BAYES_IS_STORAGE_FORK(fork));
+
+   if (class_id < fork->priv->delta_ids->len &&
+       (delta_id = g_array_index(fork->priv->delta_ids, gint, class_id)) >= 0) {
+      bayes_storage_get_class_footprint(BAYES_STORAGE(fork->priv->delta),
+                                        delta_id, n_tokens, n_bytes);
+   }
+}
+
+/*
+ * Every lookup reads the parent, so let it fetch the tokens at once.
+ */
+static void
+bayes_storage_fork_prefetch_tokens (BayesStorage        *storage,
+                                    const gchar * const *tokens,
+                                    guint                n_tokens)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+
+   g_return_if_fail(BAYES_IS_STORAGE_FORK(fork));
+
+   if (!fork->priv->parent_memory) {
+      bayes_storage_prefetch_tokens(fork->priv->parent, tokens, n_tokens);
+   }
+}
+
+static gchar **
+bayes_storage_fork_get_names (BayesStorage *storage)
+{
+   BayesStorageFork *fork = (BayesStorageFork *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), NULL);
+
+   return g_strdupv((gchar **)fork->priv->classes->pdata);
+}
+
+/**
+ * bayes_storage_fork_new:
+ * @parent: (in): The #BayesStorage to layer the fork over.
+ *
+ * Creates a new #BayesStorageFork that starts out with the training of
+ * @parent and keeps any further training to itself. @parent must not be
+ * trained while the fork is in use. See also bayes_storage_fork().
+ *
+ * Returns: (transfer full): A #BayesStorageFork.
+ */
+BayesStorage *
+bayes_storage_fork_new (BayesStorage *parent)
+{
+   BayesStorageForkPrivate *priv;
+   BayesStorageFork *fork;
+   const gchar * const *names;
+   guint n_classes;
+   guint total;
+   guint i;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(parent), NULL);
+
+   fork = g_object_new(BAYES_TYPE_STORAGE_FORK, NULL);
+   priv = fork->priv;
+
+   priv->parent = g_object_ref(parent);
+   if (BAYES_IS_STORAGE_MEMORY(parent)) {
+      priv->parent_memory = BAYES_STORAGE_MEMORY(parent);
+   }
+
+   /*
+    * The totals of the classifications are the only counts copied from
+    * the parent, so that probabilities need not ask the parent for them.
+    */
+   names = bayes_storage_get_classes(parent, &n_classes);
+   for (i = 0; i < n_classes; i++) {
+      bayes_storage_fork_add_class(fork, names[i]);
+      total = bayes_storage_get_class_token_count(parent, i, NULL);
+      g_array_index(priv->class_counts, guint, i) = total;
+      priv->count += total;
+   }
+   priv->n_parent_classes = n_classes;
+
+   return BAYES_STORAGE(fork);
+}
+
+/**
+ * bayes_storage_fork_get_parent:
+ * @fork: (in): A #BayesStorageFork.
+ *
+ * Retrieves the storage @fork is layered over.
+ *
+ * Returns: (transfer none): A #BayesStorage.
+ */
+BayesStorage *
+bayes_storage_fork_get_parent (BayesStorageFork *fork)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), NULL);
+   return fork->priv->parent;
+}
+
+/**
+ * bayes_storage_fork_get_delta:
+ * @fork: (in): A #BayesStorageFork.
+ *
+ * Retrieves the #BayesStorageMemory holding the training added to @fork
+ * since it was created, such as to save only what a tenant has learned.
+ * It must not be trained directly.
+ *
+ * Returns: (transfer none): A #BayesStorage.
+ */
+BayesStorage *
+bayes_storage_fork_get_delta (BayesStorageFork *fork)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_FORK(fork), NULL);
+   return BAYES_STORAGE(fork->priv->delta);
+}
+
+static void
+bayes_storage_fork_finalize (GObject *object)
+{
+   BayesStorageForkPrivate *priv = BAYES_STORAGE_FORK(object)->priv;
+
+   g_clear_object(&priv->parent);
+   g_clear_object(&priv->delta);
+   g_hash_table_unref(priv->class_ids);
+   g_ptr_array_unref(priv->classes);
+   g_array_unref(priv->class_counts);
+   g_array_unref(priv->delta_ids);
+
+   G_OBJECT_CLASS(bayes_storage_fork_parent_class)->finalize(object);
+}
+
+static void
+bayes_storage_fork_class_init (BayesStorageForkClass *klass)
+{
+   GObjectClass *object_class;
+
+   object_class = G_OBJECT_CLASS(klass);
+   object_class->finalize = bayes_storage_fork_finalize;
+   g_type_class_add_private(object_class, sizeof(BayesStorageForkPrivate));
+}
+
+static void
+bayes_storage_fork_init (BayesStorageFork *fork)
+{
+   BayesStorageForkPrivate *priv;
+
+   fork->priv =
+      G_TYPE_INSTANCE_GET_PRIVATE(fork,
+                                  BAYES_TYPE_STORAGE_FORK,
+                                  BayesStorageForkPrivate);
+
+   priv = fork->priv;
+
+   priv->delta = BAYES_STORAGE_MEMORY(bayes_storage_memory_new());
+   priv->classes = g_ptr_array_new_with_free_func(g_free);
+   g_ptr_array_add(priv->classes, NULL);
+   priv->class_ids = g_hash_table_new(g_str_hash, g_str_equal);
+   priv->class_counts = g_array_new(FALSE, FALSE, sizeof(guint));
+   priv->delta_ids = g_array_new(FALSE, FALSE, sizeof(gint));
+}
+
+static void
+bayes_storage_init (BayesStorageIface *iface)
+{
+   iface->add_token_count = bayes_storage_fork_add_token_count;
+   iface->get_names = bayes_storage_fork_get_names;
+   iface->get_token_count = bayes_storage_fork_get_token_count;
+   iface->get_token_probability = bayes_storage_fork_get_token_probability;
+   iface->get_classes = bayes_storage_fork_get_classes;
+   iface->lookup_class = bayes_storage_fork_lookup_class;
+   iface->get_class_token_count = bayes_storage_fork_get_class_token_count;
+   iface->get_class_token_probability =
+      bayes_storage_fork_get_class_token_probability;
+   iface->get_generation = bayes_storage_fork_get_generation;
+   iface->foreach_token = bayes_storage_fork_foreach_token;
+   iface->get_footprint = bayes_storage_fork_get_footprint;
+   iface->get_class_footprint = bayes_storage_fork_get_class_footprint;
+   iface->prefetch_tokens = bayes_storage_fork_prefetch_tokens;
+}
@@ -0,0 +1,58 @@
+/* bayes-storage-fork.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_STORAGE_FORK_H
+#define BAYES_STORAGE_FORK_H
+
+#include "bayes-storage.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_STORAGE_FORK            (bayes_storage_fork_get_type())
+#define BAYES_STORAGE_FORK(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_FORK, BayesStorageFork))
+#define BAYES_STORAGE_FORK_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_FORK, BayesStorageFork const))
+#define BAYES_STORAGE_FORK_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  BAYES_TYPE_STORAGE_FORK, BayesStorageForkClass))
+#define BAYES_IS_STORAGE_FORK(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), BAYES_TYPE_STORAGE_FORK))
+#define BAYES_IS_STORAGE_FORK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  BAYES_TYPE_STORAGE_FORK))
+#define BAYES_STORAGE_FORK_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  BAYES_TYPE_STORAGE_FORK, BayesStorageForkClass))
+
+typedef struct _BayesStorageFork        BayesStorageFork;
+typedef struct _BayesStorageForkClass   BayesStorageForkClass;
+typedef struct _BayesStorageForkPrivate BayesStorageForkPrivate;
+
+struct _BayesStorageFork
+{
+   GObject parent;
+
+   /*< private >*/
+   BayesStorageForkPrivate *priv;
+};
+
+struct _BayesStorageForkClass
+{
+   GObjectClass parent_class;
+};
+
+BayesStorage *bayes_storage_fork_get_delta  (BayesStorageFork *fork);
+BayesStorage *bayes_storage_fork_get_parent (BayesStorageFork *fork);
+GType         bayes_storage_fork_get_type   (void) G_GNUC_CONST;
+BayesStorage *bayes_storage_fork_new        (BayesStorage     *parent);
+
+G_END_DECLS
+
+#endif /* BAYES_STORAGE_FORK_H */
@@ -0,0 +1,191 @@
+/* bayes-storage-memory-private.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_STORAGE_MEMORY_PRIVATE_H
+#define BAYES_STORAGE_MEMORY_PRIVATE_H
+
+#include <string.h>
+
+#include "bayes-bloom.h"
+#include "bayes-storage-memory.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The internals of #BayesStorageMemory are shared with the classifier so
+ * that it can read the built-in storage without going through the
+ * #BayesStorage interface for every token.
+ */
+
+typedef struct
+{
+   guint  count;    /* Count within all classifications */
+   guint  n_counts; /* Length of counts, may be less than n_classes */
+   guint *counts;   /* Count per class identifier */
+} BayesStorageMemoryToken;
+
+struct _BayesStorageMemoryPrivate
+{
+   GHashTable *tokens;       /* Token name -> BayesStorageMemoryToken */
+   GPtrArray  *classes;      /* Class identifier -> name, NULL terminated */
+   GHashTable *class_ids;    /* Class name -> class identifier */
+   GArray     *class_counts; /* Class identifier -> count of all tokens */
+   guint       count;        /* Count of all tokens */
+   guint64     generation;
+
+   /*
+    * Kept up to date by training so that the footprint is known without
+    * walking the tables.
+    */
+   gsize       key_bytes;    /* Length of all token strings */
+   gsize       n_slots;      /* Length of all token count arrays */
+   guint       n_buckets;    /* Buckets of tokens, see table_grow() */
+   guint       n_class_buckets;
+   gsize       class_bytes;  /* Length of all class names */
+   GArray     *class_tokens; /* Class identifier -> tokens counted */
+   GArray     *class_slots;  /* Class identifier -> count arrays covering it */
+
+   /*
+    * Every token in @tokens, so that tokens that were never trained can
+    * be turned away without probing @tokens. Rebuilt twice as large once
+    * it holds vocabulary_capacity tokens.
+    */
+   BayesBloom *vocabulary;
+   guint       vocabulary_capacity;
+
+   /*
+    * Counts added since bayes_storage_memory_checkpoint(), keyed by the
+    * keys of @tokens, or NULL if changes are not tracked.
+    */
+   GHashTable *changes;
+   guint       n_change_slots;
+};
+
+/*
+ * Like _bayes_storage_memory_lookup_token() but adds one to @n_probes
+ * when the token table is actually probed, which is not the case for
+ * tokens the vocabulary filter knows were never trained.
+ */
+static inline BayesStorageMemoryToken *
+_bayes_storage_memory_probe_token (BayesStorageMemory *memory,
+                                   const gchar        *token,
+                                   guint64            *n_probes)
+{
+   BayesFingerprint fingerprint;
+
+   _bayes_fingerprint_init(&fingerprint, token, strlen(token), 0);
+
+   if (!_bayes_bloom_contains(memory->priv->vocabulary, &fingerprint)) {
+      return NULL;
+   }
+
+   (*n_probes)++;
+
+   return g_hash_table_lookup(memory->priv->tokens, token);
+}
+
+static inline BayesStorageMemoryToken *
+_bayes_storage_memory_lookup_token (BayesStorageMemory *memory,
+                                    const gchar        *token)
+{
+   guint64 n_probes = 0;
+
+   return _bayes_storage_memory_probe_token(memory, token, &n_probes);
+}
+
+static inline guint
+_bayes_storage_memory_get_n_tokens (BayesStorageMemory *memory)
+{
+   return g_hash_table_size(memory->priv->tokens);
+}
+
+/*
+ * Computes the probability that a token belongs to a classification from
+ * @this_count, its count in the classification, @tot_count, its count
+ * in all classifications, @pool_count, the count of all tokens in the
+ * classification, and @count, the count of all tokens.
+ */
+static inline gdouble
+_bayes_storage_memory_compute_probability (guint this_count,
+                                           guint tot_count,
+                                           guint pool_count,
+                                           guint count)
+{
+   gdouble them_count;
+   gdouble other_count;
+   gdouble good_metric;
+   gdouble bad_metric;
+   gdouble f;
+
+   them_count = MAX((gdouble)count - pool_count, 1);
+   other_count = (gdouble)tot_count - this_count;
+   good_metric = (!pool_count) ? 1.0 : MIN(1.0, other_count / pool_count);
+   bad_metric = MIN(1.0, this_count / them_count);
+   f = bad_metric / (good_metric + bad_metric);
+
+   if (ABS(f - 0.5) >= 0.1) {
+       return MAX(0.0001, MIN(0.9999, f));
+   }
+
+   return 0.0;
+}
+
+/*
+ * Computes the probability of a token found with
+ * _bayes_storage_memory_lookup_token(), which may be %NULL. Looking the
+ * token up once allows scoring it against every class without hashing
+ * it again.
+ */
+static inline gdouble
+_bayes_storage_memory_get_token_probability (BayesStorageMemory      *memory,
+                                             guint                    class_id,
+                                             BayesStorageMemoryToken *tok)
+{
+   BayesStorageMemoryPrivate *priv = memory->priv;
+
+   if (class_id >= priv->class_counts->len) {
+      return 0.0;
+   }
+
+   return _bayes_storage_memory_compute_probability(
+         (tok && class_id < tok->n_counts) ? tok->counts[class_id] : 0,
+         tok ? tok->count : 0,
+         g_array_index(priv->class_counts, guint, class_id),
+         priv->count);
+}
+
+/*
+ * Same as bayes_storage_get_class_token_probability() without any type
+ * or argument checks.
+ */
+static inline gdouble
+_bayes_storage_memory_get_class_token_probability (BayesStorageMemory *memory,
+                                                   guint               class_id,
+                                                   const gchar        *token)
+{
+   return _bayes_storage_memory_get_token_probability(
+         memory, class_id, _bayes_storage_memory_lookup_token(memory, token));
+}
+
+G_GNUC_INTERNAL
+void _bayes_storage_memory_merge (BayesStorageMemory *memory,
+                                  BayesStorageMemory *other);
+
+G_END_DECLS
+
+#endif /* BAYES_STORAGE_MEMORY_PRIVATE_H */
@@ -17,8 +17,11 @@
  */
 
 #include <glib/gi18n.h>
+#include <string.h>
 
+#include "bayes-delta.h"
 #include "bayes-storage-memory.h"
+#include "bayes-storage-memory-private.h"
 
 /**
  * SECTION:bayes-storage-memory
@@ -30,6 +33,17 @@
  * #GHashTable. It is mean for smaller data sets and offers no
  * storage of the training data to disk. It is mostly handy for
  * just trying things out.
+ *
+ * All classifications share a single table of tokens. Each token keeps
+ * its count for every classification in an array indexed by class
+ * identifier, so a token is only hashed once no matter how many
+ * classifications have been trained.
+ *
+ * To replicate training to other processes, call
+ * bayes_storage_memory_checkpoint() and later ship the counts added
+ * since with bayes_storage_memory_export_delta(). The replicas apply
+ * them with bayes_storage_import_delta(). The size of a delta and the
+ * cost of applying it depend only on what changed.
  */
 
 static void bayes_storage_init (BayesStorageIface *iface);
@@ -41,26 +55,46 @@ G_DEFINE_TYPE_EXTENDED(BayesStorageMemory,
                        G_IMPLEMENT_INTERFACE(BAYES_TYPE_STORAGE,
                                              bayes_storage_init))
 
-typedef struct
-{
-   GHashTable *tokens;
-   guint count;
-} Tokens;
+typedef BayesStorageMemoryToken Token;
 
-struct _BayesStorageMemoryPrivate
+/*
+ * The size of a new #GHashTable and the bytes used by each of its
+ * buckets for the key, the value and the hash.
+ */
+#define TABLE_MIN_BUCKETS 8
+#define TABLE_BUCKET_SIZE (2 * sizeof(gpointer) + sizeof(guint))
+
+/*
+ * The filter of trained tokens starts out with room for this many and
+ * lets this fraction of the tokens never trained through to the table.
+ */
+#define VOCABULARY_MIN_CAPACITY        1024
+#define VOCABULARY_FALSE_POSITIVE_RATE 0.01
+
+/*
+ * Follows how #GHashTable grows as entries are inserted, so that its
+ * number of buckets is known without access to its internals. Tables
+ * here are never shrunk, which keeps this exact for the resize policy of
+ * GLib 2.60 and later and a close estimate otherwise.
+ */
+static void
+table_grow (guint *n_buckets,
+            guint  n_entries)
 {
-   GHashTable *names;
-   Tokens *corpus;
-};
+   if (*n_buckets <= n_entries + n_entries / 16) {
+      *n_buckets = MAX(1U << g_bit_storage(n_entries + n_entries / 3),
+                       TABLE_MIN_BUCKETS);
+   }
+}
 
 static void
-tokens_free (gpointer data)
+token_free (gpointer data)
 {
-   Tokens *tokens = data;
+   Token *token = data;
 
-   if (tokens) {
-      g_hash_table_unref(tokens->tokens);
-      g_free(tokens);
+   if (token) {
+      g_free(token->counts);
+      g_slice_free(Token, token);
    }
 }
 
@@ -77,26 +111,258 @@ bayes_storage_memory_new (void)
    return g_object_new(BAYES_TYPE_STORAGE_MEMORY, NULL);
 }
 
-static void
-tokens_inc (Tokens      *tokens,
-            const gchar *token,
-            guint        count)
+/**
+ * bayes_storage_memory_checkpoint:
+ * @memory: (in): A #BayesStorageMemory.
+ *
+ * Marks the current training as the starting point of the next delta.
+ * Until the first checkpoint changes are not tracked, so replicating
+ * storage costs nothing unless it is used. See
+ * bayes_storage_memory_export_delta().
+ */
+void
+bayes_storage_memory_checkpoint (BayesStorageMemory *memory)
 {
-   guint *token_count;
+   BayesStorageMemoryPrivate *priv;
 
-   /*
-    * Get the container for the token count or create it if necessary.
-    */
-   if (!(token_count = g_hash_table_lookup(tokens->tokens, token))) {
-      token_count = g_new0(guint, 1);
-      g_hash_table_insert(tokens->tokens, g_strdup(token), token_count);
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
+
+   priv = memory->priv;
+
+   if (priv->changes) {
+      g_hash_table_remove_all(priv->changes);
+   } else {
+      priv->changes = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            NULL, token_free);
+   }
+
+   priv->n_change_slots = 0;
+}
+
+static gint
+compare_tokens (gconstpointer a,
+                gconstpointer b)
+{
+   return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/**
+ * bayes_storage_memory_export_delta:
+ * @memory: (in): A #BayesStorageMemory.
+ *
+ * Packs the token counts added to @memory since the last call to
+ * bayes_storage_memory_checkpoint(), which must have been made, so that
+ * they can be applied to a replica with bayes_storage_import_delta().
+ * The tokens are sorted and the counts are stored as variable length
+ * integers, so the delta is about as large as the text of the tokens
+ * that changed.
+ *
+ * The checkpoint is left in place. Call bayes_storage_memory_checkpoint()
+ * once the delta has been shipped to start the next one.
+ *
+ * Returns: (transfer full): A #GBytes.
+ */
+GBytes *
+bayes_storage_memory_export_delta (BayesStorageMemory *memory)
+{
+   BayesStorageMemoryPrivate *priv;
+   GHashTableIter iter;
+   GByteArray *buffer;
+   const gchar *previous = "";
+   const gchar *token;
+   GPtrArray *tokens;
+   gpointer key;
+   Token *change;
+   gsize prefix;
+   gsize length;
+   guint n_counts;
+   guint i;
+   guint j;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), NULL);
+   g_return_val_if_fail(memory->priv->changes, NULL);
+
+   priv = memory->priv;
+
+   buffer = g_byte_array_new();
+   g_byte_array_append(buffer, (const guint8 *)BAYES_DELTA_MAGIC,
+                       strlen(BAYES_DELTA_MAGIC));
+   _bayes_varint_append(buffer, BAYES_DELTA_VERSION);
+
+   _bayes_varint_append(buffer, priv->class_counts->len);
+   for (i = 0; i < priv->class_counts->len; i++) {
+      token = g_ptr_array_index(priv->classes, i);
+      length = strlen(token);
+      _bayes_varint_append(buffer, length);
+      g_byte_array_append(buffer, (const guint8 *)token, length);
+   }
+
+   tokens = g_ptr_array_sized_new(g_hash_table_size(priv->changes));
+   g_hash_table_iter_init(&iter, priv->changes);
+   while (g_hash_table_iter_next(&iter, &key, NULL)) {
+      g_ptr_array_add(tokens, key);
+   }
+   g_ptr_array_sort(tokens, compare_tokens);
+
+   _bayes_varint_append(buffer, tokens->len);
+   for (i = 0; i < tokens->len; i++) {
+      token = g_ptr_array_index(tokens, i);
+      change = g_hash_table_lookup(priv->changes, token);
+
+      for (prefix = 0;
+           previous[prefix] && previous[prefix] == token[prefix];
+           prefix++) {
+      }
+      length = strlen(token + prefix);
+      _bayes_varint_append(buffer, prefix);
+      _bayes_varint_append(buffer, length);
+      g_byte_array_append(buffer, (const guint8 *)token + prefix, length);
+
+      for (j = 0, n_counts = 0; j < change->n_counts; j++) {
+         n_counts += !!change->counts[j];
+      }
+      _bayes_varint_append(buffer, n_counts);
+      for (j = 0; j < change->n_counts; j++) {
+         if (change->counts[j]) {
+            _bayes_varint_append(buffer, j);
+            _bayes_varint_append(buffer, change->counts[j]);
+         }
+      }
+
+      previous = token;
+   }
+
+   g_ptr_array_unref(tokens);
+
+   return g_byte_array_free_to_bytes(buffer);
+}
+
+/*
+ * Adds every count of @other to @memory, as if @memory had also been
+ * trained with everything @other was. @other is only read, so several
+ * storages may be merged from it at once.
+ */
+void
+_bayes_storage_memory_merge (BayesStorageMemory *memory,
+                             BayesStorageMemory *other)
+{
+   GHashTableIter iter;
+   gpointer token;
+   Token *tok;
+   guint i;
+
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(other));
+
+   g_hash_table_iter_init(&iter, other->priv->tokens);
+   while (g_hash_table_iter_next(&iter, &token, (gpointer *)&tok)) {
+      for (i = 0; i < tok->n_counts; i++) {
+         if (tok->counts[i]) {
+            bayes_storage_add_token_count(
+                  BAYES_STORAGE(memory),
+                  g_ptr_array_index(other->priv->classes, i),
+                  token, tok->counts[i]);
+         }
+      }
+   }
+}
+
+static guint
+bayes_storage_memory_get_class (BayesStorageMemory *memory,
+                                const gchar        *name)
+{
+   BayesStorageMemoryPrivate *priv = memory->priv;
+   gpointer class_id;
+   gchar *copy;
+   guint zero = 0;
+
+   if (g_hash_table_lookup_extended(priv->class_ids, name, NULL, &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
    }
 
    /*
-    * Increment the count of the token.
+    * Append the classification, keeping the array NULL terminated so it
+    * can be handed out from get_classes() without a copy.
     */
-   *token_count += count;
-   tokens->count += count;
+   copy = g_strdup(name);
+   g_ptr_array_index(priv->classes, priv->classes->len - 1) = copy;
+   g_ptr_array_add(priv->classes, NULL);
+   g_array_append_val(priv->class_counts, zero);
+   g_array_append_val(priv->class_tokens, zero);
+   g_array_append_val(priv->class_slots, zero);
+   g_hash_table_insert(priv->class_ids, copy,
+                       GUINT_TO_POINTER(priv->class_counts->len - 1));
+   priv->class_bytes += strlen(name) + 1;
+   table_grow(&priv->n_class_buckets, priv->class_counts->len);
+
+   return priv->class_counts->len - 1;
+}
+
+static void
+vocabulary_add (BayesStorageMemory *memory,
+                const gchar        *token)
+{
+   BayesFingerprint fingerprint;
+
+   _bayes_fingerprint_init(&fingerprint, token, strlen(token), 0);
+   _bayes_bloom_add(memory->priv->vocabulary, &fingerprint);
+}
+
+/*
+ * Makes room in the filter for one more token, rebuilding it from the
+ * table at twice the size if it is full so that its false positive rate
+ * does not grow with the vocabulary.
+ */
+static void
+vocabulary_reserve (BayesStorageMemory *memory)
+{
+   BayesStorageMemoryPrivate *priv = memory->priv;
+   GHashTableIter iter;
+   gpointer token;
+
+   if (_bayes_bloom_get_n_items(priv->vocabulary) < priv->vocabulary_capacity) {
+      return;
+   }
+
+   priv->vocabulary_capacity *= 2;
+   _bayes_bloom_free(priv->vocabulary);
+   priv->vocabulary = _bayes_bloom_new(priv->vocabulary_capacity,
+                                       VOCABULARY_FALSE_POSITIVE_RATE);
+
+   g_hash_table_iter_init(&iter, priv->tokens);
+   while (g_hash_table_iter_next(&iter, &token, NULL)) {
+      vocabulary_add(memory, token);
+   }
+}
+
+/*
+ * Records that @count was added to @key, the key of the token in the
+ * table of tokens, since the checkpoint.
+ */
+static void
+changes_add (BayesStorageMemory *memory,
+             const gchar        *key,
+             guint               class_id,
+             guint               count)
+{
+   BayesStorageMemoryPrivate *priv = memory->priv;
+   Token *change;
+
+   if (!(change = g_hash_table_lookup(priv->changes, key))) {
+      change = g_slice_new0(Token);
+      g_hash_table_insert(priv->changes, (gchar *)key, change);
+   }
+
+   if (class_id >= change->n_counts) {
+      change->counts = g_renew(guint, change->counts, class_id + 1);
+      memset(change->counts + change->n_counts, 0,
+             sizeof(guint) * (class_id + 1 - change->n_counts));
+      priv->n_change_slots += class_id + 1 - change->n_counts;
+      change->n_counts = class_id + 1;
+   }
+
+   change->counts[class_id] += count;
+   change->count += count;
 }
 
 static void
@@ -107,7 +373,10 @@ bayes_storage_memory_add_token_count (BayesStorage *storage,
 {
    BayesStorageMemoryPrivate *priv;
    BayesStorageMemory *memory = (BayesStorageMemory *)storage;
-   Tokens *tokens;
+   gpointer key;
+   Token *tok;
+   guint class_id;
+   guint i;
 
    g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
    g_return_if_fail(name);
@@ -115,18 +384,74 @@ bayes_storage_memory_add_token_count (BayesStorage *storage,
 
    priv = memory->priv;
 
+   class_id = bayes_storage_memory_get_class(memory, name);
+
    /*
-    * Get the classification hashtable or create it if necessary.
+    * Get the container for the token counts or create it if necessary.
     */
-   if (!(tokens = g_hash_table_lookup(priv->names, name))) {
-      tokens = g_new0(Tokens, 1);
-      tokens->tokens = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                             g_free, g_free);
-      g_hash_table_insert(priv->names, g_strdup(name), tokens);
+   if (!g_hash_table_lookup_extended(priv->tokens, token, &key,
+                                     (gpointer *)&tok)) {
+      tok = g_slice_new0(Token);
+      key = g_strdup(token);
+      vocabulary_reserve(memory);
+      vocabulary_add(memory, token);
+      g_hash_table_insert(priv->tokens, key, tok);
+      priv->key_bytes += strlen(token) + 1;
+      table_grow(&priv->n_buckets, g_hash_table_size(priv->tokens));
    }
 
-   tokens_inc(tokens, token, count);
-   tokens_inc(priv->corpus, token, count);
+   if (class_id >= tok->n_counts) {
+      tok->counts = g_renew(guint, tok->counts, priv->class_counts->len);
+      memset(tok->counts + tok->n_counts, 0,
+             sizeof(guint) * (priv->class_counts->len - tok->n_counts));
+      for (i = tok->n_counts; i < priv->class_counts->len; i++) {
+         g_array_index(priv->class_slots, guint, i)++;
+      }
+      priv->n_slots += priv->class_counts->len - tok->n_counts;
+      tok->n_counts = priv->class_counts->len;
+   }
+
+   if (!tok->counts[class_id] && count) {
+      g_array_index(priv->class_tokens, guint, class_id)++;
+   }
+
+   /*
+    * Increment the count of the token.
+    */
+   tok->counts[class_id] += count;
+   tok->count += count;
+   g_array_index(priv->class_counts, guint, class_id) += count;
+   priv->count += count;
+   priv->generation++;
+
+   if (priv->changes) {
+      changes_add(memory, key, class_id, count);
+   }
+}
+
+static guint
+bayes_storage_memory_get_class_token_count (BayesStorage *storage,
+                                            guint         class_id,
+                                            const gchar  *token)
+{
+   BayesStorageMemoryPrivate *priv;
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+   Token *tok;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), 0);
+
+   priv = memory->priv;
+
+   if (class_id >= priv->class_counts->len) {
+      return 0;
+   } else if (!token) {
+      return g_array_index(priv->class_counts, guint, class_id);
+   } else if ((tok = _bayes_storage_memory_lookup_token(memory, token)) &&
+              class_id < tok->n_counts) {
+      return tok->counts[class_id];
+   }
+
+   return 0;
 }
 
 static guint
@@ -136,26 +461,42 @@ bayes_storage_memory_get_token_count (BayesStorage *storage,
 {
    BayesStorageMemoryPrivate *priv;
    BayesStorageMemory *memory = (BayesStorageMemory *)storage;
-   Tokens *tokens;
-   guint *token_count;
+   gpointer class_id;
+   Token *tok;
 
    g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), 0);
 
    priv = memory->priv;
 
-   tokens = name ? g_hash_table_lookup(priv->names, name)
-                       : priv->corpus;
-   if (tokens) {
-      if (!token) {
-         return tokens->count;
-      } else if ((token_count = g_hash_table_lookup(tokens->tokens, token))) {
-         return *token_count;
+   if (name) {
+      if (g_hash_table_lookup_extended(priv->class_ids, name, NULL,
+                                       &class_id)) {
+         return bayes_storage_memory_get_class_token_count(
+               storage, GPOINTER_TO_UINT(class_id), token);
       }
+   } else if (!token) {
+      return priv->count;
+   } else if ((tok = _bayes_storage_memory_lookup_token(memory, token))) {
+      return tok->count;
    }
 
    return 0;
 }
 
+static gdouble
+bayes_storage_memory_get_class_token_probability (BayesStorage *storage,
+                                                  guint         class_id,
+                                                  const gchar  *token)
+{
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   return _bayes_storage_memory_get_class_token_probability(memory, class_id,
+                                                            token);
+}
+
 static gdouble
 bayes_storage_memory_get_token_probability (BayesStorage *storage,
                                             const gchar  *name,
@@ -163,15 +504,7 @@ bayes_storage_memory_get_token_probability (BayesStorage *storage,
 {
    BayesStorageMemoryPrivate *priv;
    BayesStorageMemory *memory = (BayesStorageMemory *)storage;
-   gdouble pool_count;
-   gdouble them_count;
-   gdouble tot_count;
-   gdouble this_count;
-   gdouble other_count;
-   gdouble good_metric;
-   gdouble bad_metric;
-   gdouble f;
-   Tokens *tokens;
+   gpointer class_id;
 
    g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), 0.0);
    g_return_val_if_fail(name, 0.0);
@@ -179,47 +512,146 @@ bayes_storage_memory_get_token_probability (BayesStorage *storage,
 
    priv = memory->priv;
 
-   if (!(tokens = g_hash_table_lookup(priv->names, name))) {
+   if (!g_hash_table_lookup_extended(priv->class_ids, name, NULL, &class_id)) {
       return 0.0;
    }
 
-   pool_count = tokens->count;
-   them_count = MAX(priv->corpus->count - pool_count, 1);
-   this_count = bayes_storage_get_token_count(storage, name, token);
-   tot_count = bayes_storage_get_token_count(storage, NULL, token);
-   other_count = tot_count - this_count;
-   good_metric = (!pool_count) ? 1.0 : MIN(1.0, other_count / pool_count);
-   bad_metric = MIN(1.0, this_count / them_count);
-   f = bad_metric / (good_metric + bad_metric);
-
-   if (ABS(f - 0.5) >= 0.1) {
-       return MAX(0.0001, MIN(0.9999, f));
+   return _bayes_storage_memory_get_class_token_probability(
+         memory, GPOINTER_TO_UINT(class_id), token);
+}
+
+static const gchar * const *
+bayes_storage_memory_get_classes (BayesStorage *storage,
+                                  guint        *n_classes)
+{
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), NULL);
+
+   if (n_classes) {
+      *n_classes = memory->priv->class_counts->len;
+   }
+
+   return (const gchar * const *)memory->priv->classes->pdata;
+}
+
+static gint
+bayes_storage_memory_lookup_class (BayesStorage *storage,
+                                   const gchar  *name)
+{
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+   gpointer class_id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), -1);
+   g_return_val_if_fail(name, -1);
+
+   if (g_hash_table_lookup_extended(memory->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
    }
 
-   return 0.0;
+   return -1;
 }
 
-static gchar **
-bayes_storage_memory_get_names (BayesStorage *storage)
+static guint64
+bayes_storage_memory_get_generation (BayesStorage *storage)
+{
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), 0);
+
+   return memory->priv->generation;
+}
+
+static void
+bayes_storage_memory_foreach_token (BayesStorage            *storage,
+                                    BayesStorageForeachFunc  func,
+                                    gpointer                 user_data)
 {
-   BayesStorageMemoryPrivate *priv;
    BayesStorageMemory *memory = (BayesStorageMemory *)storage;
    GHashTableIter iter;
-   GPtrArray *ret;
-   gchar *key;
+   gpointer token;
 
-   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), NULL);
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
+
+   g_hash_table_iter_init(&iter, memory->priv->tokens);
+   while (g_hash_table_iter_next(&iter, &token, NULL)) {
+      func(token, user_data);
+   }
+}
+
+static void
+bayes_storage_memory_get_footprint (BayesStorage          *storage,
+                                    BayesStorageFootprint *footprint)
+{
+   BayesStorageMemoryPrivate *priv;
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+   guint n_classes;
+
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
+
+   priv = memory->priv;
+   n_classes = priv->class_counts->len;
+
+   footprint->n_tokens = g_hash_table_size(priv->tokens);
+   footprint->n_buckets = priv->n_buckets;
+   footprint->load_factor = (gdouble)footprint->n_tokens / priv->n_buckets;
+   footprint->key_bytes = priv->key_bytes;
+   footprint->value_bytes = footprint->n_tokens * sizeof(Token) +
+                            priv->n_slots * sizeof(guint);
+   footprint->table_bytes = (priv->n_buckets + priv->n_class_buckets) *
+                            TABLE_BUCKET_SIZE +
+                            _bayes_bloom_get_size(priv->vocabulary);
+
+   /*
+    * Changes tracked since the checkpoint, roughly, as their table is
+    * not followed as closely as the others.
+    */
+   if (priv->changes) {
+      footprint->value_bytes += g_hash_table_size(priv->changes) *
+                                sizeof(Token) +
+                                priv->n_change_slots * sizeof(guint);
+      footprint->table_bytes += g_hash_table_size(priv->changes) *
+                                TABLE_BUCKET_SIZE * 2;
+   }
+
+   /*
+    * The names, the NULL terminated array of them, and the total, the
+    * number of tokens and the number of count arrays of each class.
+    */
+   footprint->class_bytes = priv->class_bytes +
+                            (n_classes + 1) * sizeof(gpointer) +
+                            n_classes * 3 * sizeof(guint);
+}
+
+static void
+bayes_storage_memory_get_class_footprint (BayesStorage *storage,
+                                          guint         class_id,
+                                          guint        *n_tokens,
+                                          gsize        *n_bytes)
+{
+   BayesStorageMemoryPrivate *priv;
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+
+   g_return_if_fail(BAYES_IS_STORAGE_MEMORY(memory));
 
    priv = memory->priv;
 
-   ret = g_ptr_array_new();
-   g_hash_table_iter_init(&iter, priv->names);
-   while (g_hash_table_iter_next(&iter, (gpointer *)&key, NULL)) {
-      g_ptr_array_add(ret, g_strdup(key));
+   if (class_id < priv->class_counts->len) {
+      *n_tokens = g_array_index(priv->class_tokens, guint, class_id);
+      *n_bytes = g_array_index(priv->class_slots, guint, class_id) *
+                 sizeof(guint);
    }
-   g_ptr_array_add(ret, NULL);
+}
+
+static gchar **
+bayes_storage_memory_get_names (BayesStorage *storage)
+{
+   BayesStorageMemory *memory = (BayesStorageMemory *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_MEMORY(memory), NULL);
 
-   return (gchar **)g_ptr_array_free(ret, FALSE);
+   return g_strdupv((gchar **)memory->priv->classes->pdata);
 }
 
 static void
@@ -227,8 +659,16 @@ bayes_storage_memory_finalize (GObject *object)
 {
    BayesStorageMemoryPrivate *priv = BAYES_STORAGE_MEMORY(object)->priv;
 
-   g_hash_table_unref(priv->names);
-   tokens_free(priv->corpus);
+   if (priv->changes) {
+      g_hash_table_unref(priv->changes);
+   }
+   g_hash_table_unref(priv->tokens);
+   g_hash_table_unref(priv->class_ids);
+   g_ptr_array_unref(priv->classes);
+   g_array_unref(priv->class_counts);
+   g_array_unref(priv->class_tokens);
+   g_array_unref(priv->class_slots);
+   _bayes_bloom_free(priv->vocabulary);
 
    G_OBJECT_CLASS(bayes_storage_memory_parent_class)->finalize(object);
 }
@@ -246,21 +686,28 @@ bayes_storage_memory_class_init (BayesStorageMemoryClass *klass)
 static void
 bayes_storage_memory_init (BayesStorageMemory *memory)
 {
-   Tokens *tokens;
+   BayesStorageMemoryPrivate *priv;
 
    memory->priv =
       G_TYPE_INSTANCE_GET_PRIVATE(memory,
                                   BAYES_TYPE_STORAGE_MEMORY,
                                   BayesStorageMemoryPrivate);
 
-   memory->priv->names =
-      g_hash_table_new_full(g_str_hash, g_str_equal,
-                            g_free, tokens_free);
+   priv = memory->priv;
 
-   tokens = g_new0(Tokens, 1);
-   tokens->tokens = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                          g_free, g_free);
-   memory->priv->corpus = tokens;
+   priv->tokens = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        g_free, token_free);
+   priv->classes = g_ptr_array_new_with_free_func(g_free);
+   g_ptr_array_add(priv->classes, NULL);
+   priv->class_ids = g_hash_table_new(g_str_hash, g_str_equal);
+   priv->class_counts = g_array_new(FALSE, FALSE, sizeof(guint));
+   priv->class_tokens = g_array_new(FALSE, FALSE, sizeof(guint));
+   priv->class_slots = g_array_new(FALSE, FALSE, sizeof(guint));
+   priv->n_buckets = TABLE_MIN_BUCKETS;
+   priv->n_class_buckets = TABLE_MIN_BUCKETS;
+   priv->vocabulary_capacity = VOCABULARY_MIN_CAPACITY;
+   priv->vocabulary = _bayes_bloom_new(VOCABULARY_MIN_CAPACITY,
+                                       VOCABULARY_FALSE_POSITIVE_RATE);
 }
 
 static void
@@ -270,4 +717,13 @@ bayes_storage_init (BayesStorageIface *iface)
    iface->get_names = bayes_storage_memory_get_names;
    iface->get_token_count = bayes_storage_memory_get_token_count;
    iface->get_token_probability = bayes_storage_memory_get_token_probability;
+   iface->get_classes = bayes_storage_memory_get_classes;
+   iface->lookup_class = bayes_storage_memory_lookup_class;
+   iface->get_class_token_count = bayes_storage_memory_get_class_token_count;
+   iface->get_class_token_probability =
+      bayes_storage_memory_get_class_token_probability;
+   iface->get_generation = bayes_storage_memory_get_generation;
+   iface->foreach_token = bayes_storage_memory_foreach_token;
+   iface->get_footprint = bayes_storage_memory_get_footprint;
+   iface->get_class_footprint = bayes_storage_memory_get_class_footprint;
 }
@@ -48,8 +48,10 @@ struct _BayesStorageMemoryClass
    GObjectClass parent_class;
 };
 
-GType         bayes_storage_memory_get_type (void) G_GNUC_CONST;
-BayesStorage *bayes_storage_memory_new      (void);
+void          bayes_storage_memory_checkpoint   (BayesStorageMemory *memory);
+GBytes       *bayes_storage_memory_export_delta (BayesStorageMemory *memory);
+GType         bayes_storage_memory_get_type     (void) G_GNUC_CONST;
+BayesStorage *bayes_storage_memory_new          (void);
 
 G_END_DECLS
 
@@ -0,0 +1,1269 @@
+/* bayes-storage-sqlite.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib/gi18n.h>
+#include <sqlite3.h>
+#include <string.h>
+
+#include "bayes-lru.h"
+#include "bayes-storage-memory-private.h"
+#include "bayes-storage-sqlite.h"
+
+/**
+ * SECTION:bayes-storage-sqlite
+ * @title: BayesStorageSqlite
+ * @short_description: Durable token counts in a SQLite database.
+ *
+ * #BayesStorageSqlite keeps its token counts in a SQLite database file
+ * rather than in memory, for models that are too large for memory or
+ * that must survive the process. Only the classifications and their
+ * totals are loaded when the file is opened. The counts are kept in two
+ * plain tables, so they can be inspected with the sqlite3 shell:
+ *
+ * |[
+ * CREATE TABLE classes (id INTEGER PRIMARY KEY,
+ *                       name TEXT NOT NULL UNIQUE,
+ *                       count INTEGER NOT NULL);
+ * CREATE TABLE tokens (token TEXT NOT NULL,
+ *                      class INTEGER NOT NULL REFERENCES classes (id),
+ *                      count INTEGER NOT NULL,
+ *                      PRIMARY KEY (token, class)) WITHOUT ROWID;
+ * ]|
+ *
+ * Writes are grouped into transactions. #BayesClassifier calls
+ * bayes_storage_flush() once it has trained a document, and a
+ * transaction is committed every #BayesStorageSqlite:batch-size of
+ * those. Raising the batch size trades durability of the last documents
+ * for training throughput. bayes_storage_sqlite_sync() commits at once,
+ * and so does releasing the storage.
+ *
+ * The rows of recently used tokens are cached, up to
+ * #BayesStorageSqlite:cache-size tokens. #BayesClassifier calls
+ * bayes_storage_prefetch_tokens() before scoring a document, which
+ * fetches the tokens missing from the cache with a single query, so
+ * scoring a document against any number of classifications costs one
+ * query rather than one per token and classification.
+ *
+ * All access goes through one connection that is serialized by the
+ * storage. Only one process should write to a file at a time.
+ */
+
+static void bayes_storage_init (BayesStorageIface *iface);
+
+G_DEFINE_TYPE_EXTENDED(BayesStorageSqlite,
+                       bayes_storage_sqlite,
+                       G_TYPE_OBJECT,
+                       0,
+                       G_IMPLEMENT_INTERFACE(BAYES_TYPE_STORAGE,
+                                             bayes_storage_init))
+
+/*
+ * Stored in the file with PRAGMA application_id ("BAYS") and
+ * PRAGMA user_version.
+ */
+#define SQLITE_APPLICATION_ID 1111578963
+#define SQLITE_SCHEMA_VERSION 1
+
+#define DEFAULT_BATCH_SIZE 1
+#define DEFAULT_CACHE_SIZE 65536
+
+/*
+ * Number of tokens bound to one prefetch query. Unused parameters are
+ * bound to NULL, which matches no token, so that a single prepared
+ * statement serves every document.
+ */
+#define PREFETCH_BATCH 128
+
+enum
+{
+   STMT_BEGIN,
+   STMT_COMMIT,
+   STMT_INSERT_CLASS,
+   STMT_UPDATE_CLASS,
+   STMT_UPSERT_TOKEN,
+   STMT_SELECT_TOKEN,
+   STMT_SELECT_TOKENS,
+   LAST_STMT
+};
+
+static const gchar *gStatements[LAST_STMT] = {
+   "BEGIN",
+   "COMMIT",
+   "INSERT INTO classes (id, name, count) VALUES (?1, ?2, 0)",
+   "UPDATE classes SET count = ?1 WHERE id = ?2",
+   "INSERT INTO tokens (token, class, count) VALUES (?1, ?2, ?3) "
+   "ON CONFLICT (token, class) DO UPDATE SET count = count + excluded.count",
+   "SELECT class, count FROM tokens WHERE token = ?1",
+   NULL, /* Built for PREFETCH_BATCH parameters */
+};
+
+/*
+ * Must match SQLITE_APPLICATION_ID and SQLITE_SCHEMA_VERSION.
+ */
+static const gchar gSchema[] =
+   "BEGIN;"
+   "CREATE TABLE classes (id INTEGER PRIMARY KEY,"
+   "                      name TEXT NOT NULL UNIQUE,"
+   "                      count INTEGER NOT NULL DEFAULT 0);"
+   "CREATE TABLE tokens (token TEXT NOT NULL,"
+   "                     class INTEGER NOT NULL REFERENCES classes (id),"
+   "                     count INTEGER NOT NULL,"
+   "                     PRIMARY KEY (token, class)) WITHOUT ROWID;"
+   "PRAGMA application_id = 1111578963;"
+   "PRAGMA user_version = 1;"
+   "COMMIT;";
+
+/*
+ * A cached row of the tokens table, or an empty one for a token that was
+ * never trained.
+ */
+typedef struct
+{
+   guint  count;    /* Count within all classifications */
+   guint  n_counts; /* Length of counts */
+   guint *counts;   /* Count per class identifier */
+} Row;
+
+struct _BayesStorageSqlitePrivate
+{
+   GRecMutex     mutex;
+   gchar        *filename;
+   sqlite3      *db;
+   sqlite3_stmt *stmts[LAST_STMT];
+
+   GPtrArray    *classes;       /* Class identifier -> name, NULL terminated */
+   GHashTable   *class_ids;     /* Class name -> class identifier */
+   GArray       *class_counts;  /* Class identifier -> count of all tokens */
+   guint         count;         /* Count of all tokens */
+   guint64       generation;
+
+   gboolean      in_transaction;
+   gboolean      classes_dirty; /* class_counts not yet written */
+   guint         n_pending;     /* Flushes since the last commit */
+   guint         batch_size;
+
+   BayesLru     *cache;         /* Token -> Row */
+   Row          *scratch;       /* Last row read while the cache is off */
+   guint64       hits;
+   guint64       misses;
+   guint64       queries;
+};
+
+enum
+{
+   PROP_0,
+   PROP_BATCH_SIZE,
+   PROP_CACHE_SIZE,
+   PROP_FILENAME,
+   LAST_PROP
+};
+
+static GParamSpec *gParamSpecs[LAST_PROP];
+
+GQuark
+bayes_storage_sqlite_error_quark (void)
+{
+   return g_quark_from_static_string("bayes-storage-sqlite-error-quark");
+}
+
+static Row *
+row_new (void)
+{
+   return g_slice_new0(Row);
+}
+
+static void
+row_free (gpointer data)
+{
+   Row *row = data;
+
+   if (row) {
+      g_free(row->counts);
+      g_slice_free(Row, row);
+   }
+}
+
+static void
+row_add (Row   *row,
+         guint  class_id,
+         guint  count)
+{
+   if (class_id >= row->n_counts) {
+      row->counts = g_renew(guint, row->counts, class_id + 1);
+      memset(row->counts + row->n_counts, 0,
+             (class_id + 1 - row->n_counts) * sizeof(guint));
+      row->n_counts = class_id + 1;
+   }
+
+   row->counts[class_id] += count;
+   row->count += count;
+}
+
+/*
+ * Appends a classification, keeping the array NULL terminated so it can
+ * be handed out from get_classes() without a copy.
+ */
+static void
+bayes_storage_sqlite_append_class (BayesStorageSqlite *sqlite,
+                                   const gchar        *name,
+                                   guint               count)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   gchar *copy;
+
+   copy = g_strdup(name);
+   g_ptr_array_index(priv->classes, priv->classes->len - 1) = copy;
+   g_ptr_array_add(priv->classes, NULL);
+   g_hash_table_insert(priv->class_ids, copy,
+                       GUINT_TO_POINTER(priv->class_counts->len));
+   g_array_append_val(priv->class_counts, count);
+   priv->count += count;
+}
+
+/*
+ * Adds the (class, count) columns starting at @column of the current
+ * result row of @stmt to @row. Classifications added by another
+ * connection since the file was opened are not known and skipped.
+ */
+static void
+bayes_storage_sqlite_read_row (BayesStorageSqlite *sqlite,
+                               sqlite3_stmt       *stmt,
+                               gint                column,
+                               Row                *row)
+{
+   gint64 class_id;
+
+   class_id = sqlite3_column_int64(stmt, column);
+   if (class_id >= 0 && class_id < sqlite->priv->class_counts->len) {
+      row_add(row, class_id, sqlite3_column_int64(stmt, column + 1));
+   }
+}
+
+static void
+bayes_storage_sqlite_warn (BayesStorageSqlite *sqlite)
+{
+   g_warning("%s: %s", sqlite->priv->filename,
+             sqlite3_errmsg(sqlite->priv->db));
+}
+
+static void
+bayes_storage_sqlite_set_error (BayesStorageSqlite  *sqlite,
+                                GError             **error)
+{
+   g_set_error(error, BAYES_STORAGE_SQLITE_ERROR,
+               BAYES_STORAGE_SQLITE_ERROR_FAILED,
+               "%s: %s", sqlite->priv->filename,
+               sqlite3_errmsg(sqlite->priv->db));
+}
+
+/*
+ * Runs a statement that returns no rows and resets it.
+ */
+static gboolean
+bayes_storage_sqlite_step (BayesStorageSqlite *sqlite,
+                           sqlite3_stmt       *stmt)
+{
+   gint rc;
+
+   rc = sqlite3_step(stmt);
+   sqlite3_reset(stmt);
+
+   return rc == SQLITE_DONE;
+}
+
+static gint64
+bayes_storage_sqlite_pragma (BayesStorageSqlite *sqlite,
+                             const gchar        *sql)
+{
+   sqlite3_stmt *stmt;
+   gint64 ret = -1;
+
+   if (sqlite3_prepare_v2(sqlite->priv->db, sql, -1, &stmt, NULL) ==
+       SQLITE_OK) {
+      if (sqlite3_step(stmt) == SQLITE_ROW) {
+         ret = sqlite3_column_int64(stmt, 0);
+      }
+      sqlite3_finalize(stmt);
+   }
+
+   return ret;
+}
+
+/*
+ * Opens the file, creating the schema if it is a new database, and loads
+ * the classifications.
+ */
+static gboolean
+bayes_storage_sqlite_open (BayesStorageSqlite  *sqlite,
+                           GError             **error)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   sqlite3_stmt *stmt;
+   GString *sql;
+   guint i;
+   gint rc;
+
+   if (sqlite3_open_v2(priv->filename, &priv->db,
+                       SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE |
+                       SQLITE_OPEN_NOMUTEX, NULL) != SQLITE_OK) {
+      bayes_storage_sqlite_set_error(sqlite, error);
+      return FALSE;
+   }
+
+   if (!bayes_storage_sqlite_pragma(sqlite,
+                                    "SELECT count(*) FROM sqlite_master")) {
+      if (sqlite3_exec(priv->db, gSchema, NULL, NULL, NULL) != SQLITE_OK) {
+         bayes_storage_sqlite_set_error(sqlite, error);
+         return FALSE;
+      }
+   }
+
+   if (bayes_storage_sqlite_pragma(sqlite, "PRAGMA application_id") !=
+       SQLITE_APPLICATION_ID ||
+       bayes_storage_sqlite_pragma(sqlite, "PRAGMA user_version") !=
+       SQLITE_SCHEMA_VERSION) {
+      g_set_error(error, BAYES_STORAGE_SQLITE_ERROR,
+                  BAYES_STORAGE_SQLITE_ERROR_INVALID,
+                  _("%s is not a database of this version of "
+                    "BayesStorageSqlite."), priv->filename);
+      return FALSE;
+   }
+
+   /*
+    * Write-ahead logging lets other connections query the counts while
+    * training is under way. It is not available for in-memory databases,
+    * which keep their journal mode.
+    */
+   sqlite3_exec(priv->db, "PRAGMA journal_mode = WAL", NULL, NULL, NULL);
+   sqlite3_exec(priv->db, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+
+   sql = g_string_new("SELECT token, class, count FROM tokens "
+                      "WHERE token IN (?");
+   for (i = 1; i < PREFETCH_BATCH; i++) {
+      g_string_append(sql, ", ?");
+   }
+   g_string_append_c(sql, ')');
+
+   for (i = 0; i < LAST_STMT; i++) {
+      rc = sqlite3_prepare_v3(priv->db, gStatements[i] ? gStatements[i]
+                                                       : sql->str,
+                              -1, SQLITE_PREPARE_PERSISTENT,
+                              &priv->stmts[i], NULL);
+      if (rc != SQLITE_OK) {
+         bayes_storage_sqlite_set_error(sqlite, error);
+         g_string_free(sql, TRUE);
+         return FALSE;
+      }
+   }
+
+   g_string_free(sql, TRUE);
+
+   /*
+    * Class identifiers are the indexes used by the rest of the library,
+    * so they must run from 0 without gaps.
+    */
+   if (sqlite3_prepare_v2(priv->db,
+                          "SELECT id, name, count FROM classes ORDER BY id",
+                          -1, &stmt, NULL) != SQLITE_OK) {
+      bayes_storage_sqlite_set_error(sqlite, error);
+      return FALSE;
+   }
+
+   while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      if (sqlite3_column_int64(stmt, 0) != priv->class_counts->len) {
+         break;
+      }
+      bayes_storage_sqlite_append_class(
+            sqlite, (const gchar *)sqlite3_column_text(stmt, 1),
+            sqlite3_column_int64(stmt, 2));
+   }
+
+   sqlite3_finalize(stmt);
+
+   if (rc != SQLITE_DONE) {
+      g_set_error(error, BAYES_STORAGE_SQLITE_ERROR,
+                  BAYES_STORAGE_SQLITE_ERROR_INVALID,
+                  _("%s has malformed classifications."), priv->filename);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+static void
+bayes_storage_sqlite_begin (BayesStorageSqlite *sqlite)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+
+   if (!priv->in_transaction) {
+      if (!bayes_storage_sqlite_step(sqlite, priv->stmts[STMT_BEGIN])) {
+         bayes_storage_sqlite_warn(sqlite);
+      }
+      priv->in_transaction = !sqlite3_get_autocommit(priv->db);
+   }
+}
+
+/*
+ * Writes the totals of the classifications and commits the transaction,
+ * if one is open. Must be called with the mutex held.
+ */
+static gboolean
+bayes_storage_sqlite_commit (BayesStorageSqlite  *sqlite,
+                             GError             **error)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   sqlite3_stmt *stmt = priv->stmts[STMT_UPDATE_CLASS];
+   guint i;
+
+   if (!priv->in_transaction) {
+      return TRUE;
+   }
+
+   for (i = 0; priv->classes_dirty && i < priv->class_counts->len; i++) {
+      sqlite3_bind_int64(stmt, 1, g_array_index(priv->class_counts, guint, i));
+      sqlite3_bind_int64(stmt, 2, i);
+      if (!bayes_storage_sqlite_step(sqlite, stmt)) {
+         bayes_storage_sqlite_set_error(sqlite, error);
+         return FALSE;
+      }
+   }
+   priv->classes_dirty = FALSE;
+
+   /*
+    * A commit that fails because another connection is reading may be
+    * retried later, the transaction is still open then.
+    */
+   if (!bayes_storage_sqlite_step(sqlite, priv->stmts[STMT_COMMIT])) {
+      bayes_storage_sqlite_set_error(sqlite, error);
+      priv->in_transaction = !sqlite3_get_autocommit(priv->db);
+      priv->classes_dirty = priv->in_transaction;
+      return FALSE;
+   }
+
+   priv->in_transaction = FALSE;
+   priv->n_pending = 0;
+
+   return TRUE;
+}
+
+/*
+ * Keeps @row for @token in the cache, or as the scratch row if the cache
+ * is disabled. The row remains valid until the next lookup.
+ */
+static Row *
+bayes_storage_sqlite_keep_row (BayesStorageSqlite *sqlite,
+                               const gchar        *token,
+                               Row                *row)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+
+   if (_bayes_lru_get_max_size(priv->cache)) {
+      _bayes_lru_insert(priv->cache, g_strdup(token), row);
+   } else {
+      row_free(priv->scratch);
+      priv->scratch = row;
+   }
+
+   return row;
+}
+
+/*
+ * Looks up the row of @token in the cache, or reads it from the
+ * database. Must be called with the mutex held.
+ */
+static Row *
+bayes_storage_sqlite_lookup_row (BayesStorageSqlite *sqlite,
+                                 const gchar        *token)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   sqlite3_stmt *stmt = priv->stmts[STMT_SELECT_TOKEN];
+   Row *row;
+   gint rc;
+
+   if ((row = _bayes_lru_lookup(priv->cache, token))) {
+      priv->hits++;
+      return row;
+   }
+
+   priv->misses++;
+   priv->queries++;
+
+   row = row_new();
+   sqlite3_bind_text(stmt, 1, token, -1, SQLITE_STATIC);
+   while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      bayes_storage_sqlite_read_row(sqlite, stmt, 0, row);
+   }
+   if (rc != SQLITE_DONE) {
+      bayes_storage_sqlite_warn(sqlite);
+   }
+   sqlite3_reset(stmt);
+
+   return bayes_storage_sqlite_keep_row(sqlite, token, row);
+}
+
+/*
+ * Fetches the rows of @tokens that are not cached, PREFETCH_BATCH tokens
+ * per query. Tokens that were never trained are cached as empty rows.
+ */
+static void
+bayes_storage_sqlite_prefetch_tokens (BayesStorage        *storage,
+                                      const gchar * const *tokens,
+                                      guint                n_tokens)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   BayesStorageSqlitePrivate *priv;
+   sqlite3_stmt *stmt;
+   GHashTable *missing;
+   GPtrArray *order;
+   Row *row;
+   guint i;
+   guint j;
+   gint rc;
+
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+
+   priv = sqlite->priv;
+   stmt = priv->stmts[STMT_SELECT_TOKENS];
+
+   g_rec_mutex_lock(&priv->mutex);
+
+   if (!_bayes_lru_get_max_size(priv->cache)) {
+      g_rec_mutex_unlock(&priv->mutex);
+      return;
+   }
+
+   missing = g_hash_table_new(g_str_hash, g_str_equal);
+   order = g_ptr_array_new();
+
+   for (i = 0; i < n_tokens; i++) {
+      if (_bayes_lru_lookup(priv->cache, tokens[i])) {
+         priv->hits++;
+      } else if (!g_hash_table_contains(missing, tokens[i])) {
+         g_hash_table_insert(missing, (gchar *)tokens[i], row_new());
+         g_ptr_array_add(order, (gchar *)tokens[i]);
+      }
+   }
+
+   for (i = 0; i < order->len; i += PREFETCH_BATCH) {
+      for (j = 0; j < PREFETCH_BATCH; j++) {
+         if (i + j < order->len) {
+            sqlite3_bind_text(stmt, j + 1, g_ptr_array_index(order, i + j),
+                              -1, SQLITE_STATIC);
+         } else {
+            sqlite3_bind_null(stmt, j + 1);
+         }
+      }
+
+      while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+         row = g_hash_table_lookup(missing, sqlite3_column_text(stmt, 0));
+         if (row) {
+            bayes_storage_sqlite_read_row(sqlite, stmt, 1, row);
+         }
+      }
+      if (rc != SQLITE_DONE) {
+         bayes_storage_sqlite_warn(sqlite);
+      }
+      sqlite3_reset(stmt);
+      priv->queries++;
+   }
+
+   priv->misses += order->len;
+
+   for (i = 0; i < order->len; i++) {
+      _bayes_lru_insert(priv->cache, g_strdup(g_ptr_array_index(order, i)),
+                        g_hash_table_lookup(missing,
+                                            g_ptr_array_index(order, i)));
+   }
+
+   g_rec_mutex_unlock(&priv->mutex);
+
+   g_ptr_array_unref(order);
+   g_hash_table_unref(missing);
+}
+
+/*
+ * Returns the class identifier of @name, adding the classification if
+ * it is new. Must be called with the mutex held.
+ */
+static guint
+bayes_storage_sqlite_ensure_class (BayesStorageSqlite *sqlite,
+                                   const gchar        *name)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   sqlite3_stmt *stmt = priv->stmts[STMT_INSERT_CLASS];
+   gpointer class_id;
+   guint id;
+
+   if (g_hash_table_lookup_extended(priv->class_ids, name, NULL, &class_id)) {
+      return GPOINTER_TO_UINT(class_id);
+   }
+
+   id = priv->class_counts->len;
+
+   bayes_storage_sqlite_begin(sqlite);
+   sqlite3_bind_int64(stmt, 1, id);
+   sqlite3_bind_text(stmt, 2, name, -1, SQLITE_STATIC);
+   if (!bayes_storage_sqlite_step(sqlite, stmt)) {
+      bayes_storage_sqlite_warn(sqlite);
+   }
+
+   bayes_storage_sqlite_append_class(sqlite, name, 0);
+
+   return id;
+}
+
+static void
+bayes_storage_sqlite_add_token_count (BayesStorage *storage,
+                                      const gchar  *name,
+                                      const gchar  *token,
+                                      guint         count)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   BayesStorageSqlitePrivate *priv;
+   sqlite3_stmt *stmt;
+   guint class_id;
+   Row *row;
+
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+   g_return_if_fail(name);
+   g_return_if_fail(token);
+
+   priv = sqlite->priv;
+   stmt = priv->stmts[STMT_UPSERT_TOKEN];
+
+   g_rec_mutex_lock(&priv->mutex);
+
+   class_id = bayes_storage_sqlite_ensure_class(sqlite, name);
+   bayes_storage_sqlite_begin(sqlite);
+
+   sqlite3_bind_text(stmt, 1, token, -1, SQLITE_STATIC);
+   sqlite3_bind_int64(stmt, 2, class_id);
+   sqlite3_bind_int64(stmt, 3, count);
+   if (!bayes_storage_sqlite_step(sqlite, stmt)) {
+      bayes_storage_sqlite_warn(sqlite);
+   }
+
+   g_array_index(priv->class_counts, guint, class_id) += count;
+   priv->count += count;
+   priv->classes_dirty = TRUE;
+   priv->generation++;
+
+   if ((row = _bayes_lru_lookup(priv->cache, token))) {
+      row_add(row, class_id, count);
+   }
+
+   g_rec_mutex_unlock(&priv->mutex);
+}
+
+static void
+bayes_storage_sqlite_flush (BayesStorage *storage)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   BayesStorageSqlitePrivate *priv;
+   GError *error = NULL;
+
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+
+   priv = sqlite->priv;
+
+   g_rec_mutex_lock(&priv->mutex);
+   if (priv->in_transaction && ++priv->n_pending >= priv->batch_size &&
+       !bayes_storage_sqlite_commit(sqlite, &error)) {
+      g_warning("%s", error->message);
+      g_error_free(error);
+   }
+   g_rec_mutex_unlock(&priv->mutex);
+}
+
+/*
+ * Must be called with the mutex held.
+ */
+static gdouble
+bayes_storage_sqlite_get_probability (BayesStorageSqlite *sqlite,
+                                      guint               class_id,
+                                      const gchar        *token)
+{
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   Row *row;
+
+   if (class_id >= priv->class_counts->len) {
+      return 0.0;
+   }
+
+   row = bayes_storage_sqlite_lookup_row(sqlite, token);
+
+   return _bayes_storage_memory_compute_probability(
+         (class_id < row->n_counts) ? row->counts[class_id] : 0,
+         row->count,
+         g_array_index(priv->class_counts, guint, class_id),
+         priv->count);
+}
+
+static gdouble
+bayes_storage_sqlite_get_class_token_probability (BayesStorage *storage,
+                                                  guint         class_id,
+                                                  const gchar  *token)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   gdouble ret;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   ret = bayes_storage_sqlite_get_probability(sqlite, class_id, token);
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static gdouble
+bayes_storage_sqlite_get_token_probability (BayesStorage *storage,
+                                            const gchar  *name,
+                                            const gchar  *token)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   gpointer class_id;
+   gdouble ret = 0.0;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0.0);
+   g_return_val_if_fail(name, 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   if (g_hash_table_lookup_extended(sqlite->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      ret = bayes_storage_sqlite_get_probability(
+            sqlite, GPOINTER_TO_UINT(class_id), token);
+   }
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static guint
+bayes_storage_sqlite_get_class_token_count (BayesStorage *storage,
+                                            guint         class_id,
+                                            const gchar  *token)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   guint ret;
+   Row *row;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0);
+   g_return_val_if_fail(token, 0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   row = bayes_storage_sqlite_lookup_row(sqlite, token);
+   ret = (class_id < row->n_counts) ? row->counts[class_id] : 0;
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+/*
+ * If @name is %NULL, the count of @token within all classifications is
+ * returned.
+ */
+static guint
+bayes_storage_sqlite_get_token_count (BayesStorage *storage,
+                                      const gchar  *name,
+                                      const gchar  *token)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   gpointer class_id;
+   guint ret = 0;
+   Row *row;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0);
+   g_return_val_if_fail(token, 0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   if (!name) {
+      ret = bayes_storage_sqlite_lookup_row(sqlite, token)->count;
+   } else if (g_hash_table_lookup_extended(sqlite->priv->class_ids, name,
+                                           NULL, &class_id)) {
+      row = bayes_storage_sqlite_lookup_row(sqlite, token);
+      if (GPOINTER_TO_UINT(class_id) < row->n_counts) {
+         ret = row->counts[GPOINTER_TO_UINT(class_id)];
+      }
+   }
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static const gchar * const *
+bayes_storage_sqlite_get_classes (BayesStorage *storage,
+                                  guint        *n_classes)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), NULL);
+
+   if (n_classes) {
+      *n_classes = sqlite->priv->class_counts->len;
+   }
+
+   return (const gchar * const *)sqlite->priv->classes->pdata;
+}
+
+static gint
+bayes_storage_sqlite_lookup_class (BayesStorage *storage,
+                                   const gchar  *name)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   gpointer class_id;
+   gint ret = -1;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), -1);
+   g_return_val_if_fail(name, -1);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   if (g_hash_table_lookup_extended(sqlite->priv->class_ids, name, NULL,
+                                    &class_id)) {
+      ret = GPOINTER_TO_UINT(class_id);
+   }
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static gchar **
+bayes_storage_sqlite_get_names (BayesStorage *storage)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   gchar **ret;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), NULL);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   ret = g_strdupv((gchar **)sqlite->priv->classes->pdata);
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static guint64
+bayes_storage_sqlite_get_generation (BayesStorage *storage)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   guint64 ret;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   ret = sqlite->priv->generation;
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static void
+bayes_storage_sqlite_foreach_token (BayesStorage            *storage,
+                                    BayesStorageForeachFunc  func,
+                                    gpointer                 user_data)
+{
+   BayesStorageSqlite *sqlite = (BayesStorageSqlite *)storage;
+   sqlite3_stmt *stmt;
+   gint rc;
+
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+
+   if (sqlite3_prepare_v2(sqlite->priv->db,
+                          "SELECT DISTINCT token FROM tokens", -1,
+                          &stmt, NULL) != SQLITE_OK) {
+      bayes_storage_sqlite_warn(sqlite);
+      g_rec_mutex_unlock(&sqlite->priv->mutex);
+      return;
+   }
+
+   while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+      func((const gchar *)sqlite3_column_text(stmt, 0), user_data);
+   }
+   if (rc != SQLITE_DONE) {
+      bayes_storage_sqlite_warn(sqlite);
+   }
+   sqlite3_finalize(stmt);
+
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+}
+
+/**
+ * bayes_storage_sqlite_new:
+ * @filename: (in): The database file, created if it does not exist.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Opens the token counts kept in @filename. A new file is created with
+ * an empty schema. ":memory:" opens a private in-memory database, as
+ * with sqlite3_open().
+ *
+ * Returns: (transfer full): A #BayesStorageSqlite or %NULL if the file
+ *   could not be opened.
+ */
+BayesStorage *
+bayes_storage_sqlite_new (const gchar  *filename,
+                          GError      **error)
+{
+   BayesStorageSqlite *sqlite;
+
+   g_return_val_if_fail(filename, NULL);
+
+   sqlite = g_object_new(BAYES_TYPE_STORAGE_SQLITE, NULL);
+   sqlite->priv->filename = g_strdup(filename);
+
+   if (!bayes_storage_sqlite_open(sqlite, error)) {
+      g_object_unref(sqlite);
+      return NULL;
+   }
+
+   return BAYES_STORAGE(sqlite);
+}
+
+/**
+ * bayes_storage_sqlite_get_filename:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ *
+ * Retrieves the #BayesStorageSqlite:filename property.
+ *
+ * Returns: The database file.
+ */
+const gchar *
+bayes_storage_sqlite_get_filename (BayesStorageSqlite *sqlite)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), NULL);
+   return sqlite->priv->filename;
+}
+
+/**
+ * bayes_storage_sqlite_get_batch_size:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ *
+ * Retrieves the #BayesStorageSqlite:batch-size property.
+ *
+ * Returns: The number of flushes per transaction.
+ */
+guint
+bayes_storage_sqlite_get_batch_size (BayesStorageSqlite *sqlite)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0);
+   return sqlite->priv->batch_size;
+}
+
+/**
+ * bayes_storage_sqlite_set_batch_size:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ * @batch_size: (in): The number of flushes per transaction, at least 1.
+ *
+ * Sets the number of calls to bayes_storage_flush(), usually trained
+ * documents, whose writes are committed in one transaction. Training
+ * that is not yet committed is lost if the process dies.
+ */
+void
+bayes_storage_sqlite_set_batch_size (BayesStorageSqlite *sqlite,
+                                     guint               batch_size)
+{
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+   g_return_if_fail(batch_size >= 1);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   sqlite->priv->batch_size = batch_size;
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   g_object_notify_by_pspec(G_OBJECT(sqlite), gParamSpecs[PROP_BATCH_SIZE]);
+}
+
+/**
+ * bayes_storage_sqlite_get_cache_size:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ *
+ * Retrieves the #BayesStorageSqlite:cache-size property.
+ *
+ * Returns: The number of token rows cached.
+ */
+guint
+bayes_storage_sqlite_get_cache_size (BayesStorageSqlite *sqlite)
+{
+   guint ret;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), 0);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   ret = _bayes_lru_get_max_size(sqlite->priv->cache);
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+/**
+ * bayes_storage_sqlite_set_cache_size:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ * @cache_size: (in): The number of token rows to cache, or 0.
+ *
+ * Sets the number of recently used token rows kept in memory. With 0,
+ * every lookup is a query and bayes_storage_prefetch_tokens() does
+ * nothing.
+ */
+void
+bayes_storage_sqlite_set_cache_size (BayesStorageSqlite *sqlite,
+                                     guint               cache_size)
+{
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   _bayes_lru_set_max_size(sqlite->priv->cache, cache_size);
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   g_object_notify_by_pspec(G_OBJECT(sqlite), gParamSpecs[PROP_CACHE_SIZE]);
+}
+
+/**
+ * bayes_storage_sqlite_get_cache_stats:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ * @hits: (out) (allow-none): A location for the number of cache hits.
+ * @misses: (out) (allow-none): A location for the number of cache misses.
+ * @queries: (out) (allow-none): A location for the number of queries
+ *   run to read token rows.
+ *
+ * Retrieves how often token rows were found in the cache. Since rows are
+ * prefetched in batches, @queries is usually far below @misses.
+ */
+void
+bayes_storage_sqlite_get_cache_stats (BayesStorageSqlite *sqlite,
+                                      guint64            *hits,
+                                      guint64            *misses,
+                                      guint64            *queries)
+{
+   BayesStorageSqlitePrivate *priv;
+
+   g_return_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite));
+
+   priv = sqlite->priv;
+
+   g_rec_mutex_lock(&priv->mutex);
+   if (hits) {
+      *hits = priv->hits;
+   }
+   if (misses) {
+      *misses = priv->misses;
+   }
+   if (queries) {
+      *queries = priv->queries;
+   }
+   g_rec_mutex_unlock(&priv->mutex);
+}
+
+/**
+ * bayes_storage_sqlite_sync:
+ * @sqlite: (in): A #BayesStorageSqlite.
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Commits the training added since the last transaction without waiting
+ * for #BayesStorageSqlite:batch-size documents.
+ *
+ * Returns: %TRUE if all training is committed.
+ */
+gboolean
+bayes_storage_sqlite_sync (BayesStorageSqlite  *sqlite,
+                           GError             **error)
+{
+   gboolean ret;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE_SQLITE(sqlite), FALSE);
+
+   g_rec_mutex_lock(&sqlite->priv->mutex);
+   ret = bayes_storage_sqlite_commit(sqlite, error);
+   g_rec_mutex_unlock(&sqlite->priv->mutex);
+
+   return ret;
+}
+
+static void
+bayes_storage_sqlite_finalize (GObject *object)
+{
+   BayesStorageSqlite *sqlite = BAYES_STORAGE_SQLITE(object);
+   BayesStorageSqlitePrivate *priv = sqlite->priv;
+   GError *error = NULL;
+   guint i;
+
+   if (priv->db) {
+      if (!bayes_storage_sqlite_commit(sqlite, &error)) {
+         g_warning("%s", error->message);
+         g_error_free(error);
+      }
+      for (i = 0; i < LAST_STMT; i++) {
+         sqlite3_finalize(priv->stmts[i]);
+      }
+      sqlite3_close(priv->db);
+   }
+
+   _bayes_lru_free(priv->cache);
+   row_free(priv->scratch);
+   g_hash_table_unref(priv->class_ids);
+   g_ptr_array_unref(priv->classes);
+   g_array_unref(priv->class_counts);
+   g_free(priv->filename);
+   g_rec_mutex_clear(&priv->mutex);
+
+   G_OBJECT_CLASS(bayes_storage_sqlite_parent_class)->finalize(object);
+}
+
+static void
+bayes_storage_sqlite_get_property (GObject    *object,
+                                   guint       prop_id,
+                                   GValue     *value,
+                                   GParamSpec *pspec)
+{
+   BayesStorageSqlite *sqlite = BAYES_STORAGE_SQLITE(object);
+
+   switch (prop_id) {
+   case PROP_BATCH_SIZE:
+      g_value_set_uint(value, bayes_storage_sqlite_get_batch_size(sqlite));
+      break;
+   case PROP_CACHE_SIZE:
+      g_value_set_uint(value, bayes_storage_sqlite_get_cache_size(sqlite));
+      break;
+   case PROP_FILENAME:
+      g_value_set_string(value, bayes_storage_sqlite_get_filename(sqlite));
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+   }
+}
+
+static void
+bayes_storage_sqlite_set_property (GObject      *object,
+                                   guint         prop_id,
+                                   const GValue *value,
+                                   GParamSpec   *pspec)
+{
+   BayesStorageSqlite *sqlite = BAYES_STORAGE_SQLITE(object);
+
+   switch (prop_id) {
+   case PROP_BATCH_SIZE:
+      bayes_storage_sqlite_set_batch_size(sqlite, g_value_get_uint(value));
+      break;
+   case PROP_CACHE_SIZE:
+      bayes_storage_sqlite_set_cache_size(sqlite, g_value_get_uint(value));
+      break;
+   default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+   }
+}
+
+static void
+bayes_storage_sqlite_class_init (BayesStorageSqliteClass *klass)
+{
+   GObjectClass *object_class;
+
+   object_class = G_OBJECT_CLASS(klass);
+   object_class->finalize = bayes_storage_sqlite_finalize;
+   object_class->get_property = bayes_storage_sqlite_get_property;
+   object_class->set_property = bayes_storage_sqlite_set_property;
+   g_type_class_add_private(object_class, sizeof(BayesStorageSqlitePrivate));
+
+   /**
+    * BayesStorageSqlite:batch-size:
+    *
+    * The "batch-size" property. The number of trained documents whose
+    * writes are committed in one transaction.
+    */
+   gParamSpecs[PROP_BATCH_SIZE] =
+      g_param_spec_uint("batch-size",
+                        _("Batch Size"),
+                        _("The number of documents per transaction."),
+                        1,
+                        G_MAXUINT,
+                        DEFAULT_BATCH_SIZE,
+                        G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_BATCH_SIZE,
+                                   gParamSpecs[PROP_BATCH_SIZE]);
+
+   /**
+    * BayesStorageSqlite:cache-size:
+    *
+    * The "cache-size" property. The number of token rows to keep in
+    * memory, or 0 to query the database for every lookup.
+    */
+   gParamSpecs[PROP_CACHE_SIZE] =
+      g_param_spec_uint("cache-size",
+                        _("Cache Size"),
+                        _("The number of token rows to cache."),
+                        0,
+                        G_MAXUINT,
+                        DEFAULT_CACHE_SIZE,
+                        G_PARAM_READWRITE);
+   g_object_class_install_property(object_class, PROP_CACHE_SIZE,
+                                   gParamSpecs[PROP_CACHE_SIZE]);
+
+   /**
+    * BayesStorageSqlite:filename:
+    *
+    * The "filename" property. The database file.
+    */
+   gParamSpecs[PROP_FILENAME] =
+      g_param_spec_string("filename",
+                          _("Filename"),
+                          _("The database file."),
+                          NULL,
+                          G_PARAM_READABLE);
+   g_object_class_install_property(object_class, PROP_FILENAME,
+                                   gParamSpecs[PROP_FILENAME]);
+}
+
+static void
+bayes_storage_sqlite_init (BayesStorageSqlite *sqlite)
+{
+   BayesStorageSqlitePrivate *priv;
+
+   sqlite->priv =
+      G_TYPE_INSTANCE_GET_PRIVATE(sqlite,
+                                  BAYES_TYPE_STORAGE_SQLITE,
+                                  BayesStorageSqlitePrivate);
+
+   priv = sqlite->priv;
+
+   g_rec_mutex_init(&priv->mutex);
+   priv->batch_size = DEFAULT_BATCH_SIZE;
+   priv->cache = _bayes_lru_new(DEFAULT_CACHE_SIZE, g_str_hash, g_str_equal,
+                                g_free, row_free);
+   priv->classes = g_ptr_array_new_with_free_func(g_free);
+   g_ptr_array_add(priv->classes, NULL);
+   priv->class_ids = g_hash_table_new(g_str_hash, g_str_equal);
+   priv->class_counts = g_array_new(FALSE, FALSE, sizeof(guint));
+}
+
+static void
+bayes_storage_init (BayesStorageIface *iface)
+{
+   iface->add_token_count = bayes_storage_sqlite_add_token_count;
+   iface->get_names = bayes_storage_sqlite_get_names;
+   iface->get_token_count = bayes_storage_sqlite_get_token_count;
+   iface->get_token_probability = bayes_storage_sqlite_get_token_probability;
+   iface->get_classes = bayes_storage_sqlite_get_classes;
+   iface->lookup_class = bayes_storage_sqlite_lookup_class;
+   iface->get_class_token_count = bayes_storage_sqlite_get_class_token_count;
+   iface->get_class_token_probability =
+      bayes_storage_sqlite_get_class_token_probability;
+   iface->get_generation = bayes_storage_sqlite_get_generation;
+   iface->foreach_token = bayes_storage_sqlite_foreach_token;
+   iface->prefetch_tokens = bayes_storage_sqlite_prefetch_tokens;
+   iface->flush = bayes_storage_sqlite_flush;
+}
@@ -0,0 +1,87 @@
+/* bayes-storage-sqlite.h
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BAYES_STORAGE_SQLITE_H
+#define BAYES_STORAGE_SQLITE_H
+
+#include "bayes-storage.h"
+
+G_BEGIN_DECLS
+
+#define BAYES_TYPE_STORAGE_SQLITE            (bayes_storage_sqlite_get_type())
+#define BAYES_STORAGE_SQLITE(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_SQLITE, BayesStorageSqlite))
+#define BAYES_STORAGE_SQLITE_CONST(obj)      (G_TYPE_CHECK_INSTANCE_CAST ((obj), BAYES_TYPE_STORAGE_SQLITE, BayesStorageSqlite const))
+#define BAYES_STORAGE_SQLITE_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST ((klass),  BAYES_TYPE_STORAGE_SQLITE, BayesStorageSqliteClass))
+#define BAYES_IS_STORAGE_SQLITE(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), BAYES_TYPE_STORAGE_SQLITE))
+#define BAYES_IS_STORAGE_SQLITE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass),  BAYES_TYPE_STORAGE_SQLITE))
+#define BAYES_STORAGE_SQLITE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj),  BAYES_TYPE_STORAGE_SQLITE, BayesStorageSqliteClass))
+
+#define BAYES_STORAGE_SQLITE_ERROR (bayes_storage_sqlite_error_quark())
+
+/**
+ * BayesStorageSqliteError:
+ * @BAYES_STORAGE_SQLITE_ERROR_FAILED: SQLite failed, the message says why.
+ * @BAYES_STORAGE_SQLITE_ERROR_INVALID: The file is a database of another
+ *   application or of a newer version.
+ *
+ * Errors of #BayesStorageSqlite.
+ */
+typedef enum
+{
+   BAYES_STORAGE_SQLITE_ERROR_FAILED = 1,
+   BAYES_STORAGE_SQLITE_ERROR_INVALID,
+} BayesStorageSqliteError;
+
+typedef struct _BayesStorageSqlite        BayesStorageSqlite;
+typedef struct _BayesStorageSqliteClass   BayesStorageSqliteClass;
+typedef struct _BayesStorageSqlitePrivate BayesStorageSqlitePrivate;
+
+struct _BayesStorageSqlite
+{
+   GObject parent;
+
+   /*< private >*/
+   BayesStorageSqlitePrivate *priv;
+};
+
+struct _BayesStorageSqliteClass
+{
+   GObjectClass parent_class;
+};
+
+GQuark        bayes_storage_sqlite_error_quark     (void) G_GNUC_CONST;
+guint         bayes_storage_sqlite_get_batch_size  (BayesStorageSqlite  *sqlite);
+guint         bayes_storage_sqlite_get_cache_size  (BayesStorageSqlite  *sqlite);
+void          bayes_storage_sqlite_get_cache_stats (BayesStorageSqlite  *sqlite,
+                                                    guint64             *hits,
+                                                    guint64             *misses,
+                                                    guint64             *queries);
+const gchar  *bayes_storage_sqlite_get_filename    (BayesStorageSqlite  *sqlite);
+GType         bayes_storage_sqlite_get_type        (void) G_GNUC_CONST;
+BayesStorage *bayes_storage_sqlite_new             (const gchar         *filename,
+                                                    GError             **error);
+void          bayes_storage_sqlite_set_batch_size  (BayesStorageSqlite  *sqlite,
+                                                    guint                batch_size);
+void          bayes_storage_sqlite_set_cache_size  (BayesStorageSqlite  *sqlite,
+                                                    guint                cache_size);
+gboolean      bayes_storage_sqlite_sync            (BayesStorageSqlite  *sqlite,
+                                                    GError             **error);
+
+G_END_DECLS
+
+#endif /* BAYES_STORAGE_SQLITE_H */
@@ -16,7 +16,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <glib/gi18n.h>
+#include <string.h>
+
+#include "bayes-delta.h"
 #include "bayes-storage.h"
+#include "bayes-storage-fork.h"
 
 /**
  * SECTION:bayes-storage
@@ -27,7 +32,102 @@
  * training data for the classifier.
  *
  * See #BayesStorageMemory for in memory storage of training data.
+ * bayes_storage_fork() layers further training over existing storage
+ * without copying it.
+ *
+ * Each classification is assigned a stable integer identifier, its index
+ * in the array returned from bayes_storage_get_classes(). The identifiers
+ * of existing classes never change when new ones are added, so they may
+ * be used with bayes_storage_get_class_token_probability() to avoid
+ * looking up the classification by name for every token.
+ */
+
+/*
+ * Fallback provides class identifiers and a training generation for
+ * storage that does not implement them. The class identifiers are built
+ * from get_names() the first time they are needed and extended as new
+ * classifications are trained through bayes_storage_add_token_count().
  */
+typedef struct
+{
+   GPtrArray  *names; /* NULL until class identifiers are needed */
+   GHashTable *ids;
+   guint64     generation;
+} Fallback;
+
+static GMutex gFallbackMutex;
+
+static GQuark
+fallback_quark (void)
+{
+   static gsize quark;
+
+   if (g_once_init_enter(&quark)) {
+      g_once_init_leave(&quark,
+                        g_quark_from_static_string("bayes-storage-fallback"));
+   }
+
+   return quark;
+}
+
+static void
+fallback_add_class (Fallback    *fallback,
+                    const gchar *name)
+{
+   gchar *copy;
+
+   copy = g_strdup(name);
+   g_hash_table_insert(fallback->ids, copy,
+                       GUINT_TO_POINTER(fallback->names->len - 1));
+   g_ptr_array_index(fallback->names, fallback->names->len - 1) = copy;
+   g_ptr_array_add(fallback->names, NULL);
+}
+
+static void
+fallback_free (gpointer data)
+{
+   Fallback *fallback = data;
+
+   if (fallback->names) {
+      g_ptr_array_unref(fallback->names);
+      g_hash_table_unref(fallback->ids);
+   }
+   g_slice_free(Fallback, fallback);
+}
+
+static Fallback *
+bayes_storage_get_fallback (BayesStorage *storage,
+                            gboolean      need_classes)
+{
+   Fallback *fallback;
+   gchar **names;
+   guint i;
+
+   fallback = g_object_get_qdata(G_OBJECT(storage), fallback_quark());
+
+   if (!fallback || (need_classes && !fallback->names)) {
+      g_mutex_lock(&gFallbackMutex);
+      if (!(fallback = g_object_get_qdata(G_OBJECT(storage),
+                                          fallback_quark()))) {
+         fallback = g_slice_new0(Fallback);
+         g_object_set_qdata_full(G_OBJECT(storage), fallback_quark(),
+                                 fallback, fallback_free);
+      }
+      if (need_classes && !fallback->names) {
+         fallback->ids = g_hash_table_new(g_str_hash, g_str_equal);
+         fallback->names = g_ptr_array_new_with_free_func(g_free);
+         g_ptr_array_add(fallback->names, NULL);
+         names = BAYES_STORAGE_GET_INTERFACE(storage)->get_names(storage);
+         for (i = 0; names && names[i]; i++) {
+            fallback_add_class(fallback, names[i]);
+         }
+         g_strfreev(names);
+      }
+      g_mutex_unlock(&gFallbackMutex);
+   }
+
+   return fallback;
+}
 
 /**
  * bayes_storage_add_token_count:
@@ -46,13 +146,33 @@ bayes_storage_add_token_count (BayesStorage *storage,
                                const gchar  *token,
                                guint         count)
 {
+   BayesStorageIface *iface;
+   Fallback *fallback;
+
    g_return_if_fail(BAYES_IS_STORAGE(storage));
    g_return_if_fail(name);
    g_return_if_fail(token);
    g_return_if_fail(count);
 
-   BAYES_STORAGE_GET_INTERFACE(storage)->
-      add_token_count(storage, name, token, count);
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+   iface->add_token_count(storage, name, token, count);
+
+   /*
+    * Keep the class identifiers and generation of storage without native
+    * support in sync. If the class identifiers have not been built yet
+    * they will pick up the new classification from get_names().
+    */
+   if (!iface->get_generation || !iface->get_classes) {
+      fallback = bayes_storage_get_fallback(storage, FALSE);
+      if (!iface->get_generation) {
+         fallback->generation++;
+      }
+      if (!iface->get_classes &&
+          fallback->names &&
+          !g_hash_table_lookup_extended(fallback->ids, name, NULL, NULL)) {
+         fallback_add_class(fallback, name);
+      }
+   }
 }
 
 /**
@@ -73,8 +193,316 @@ bayes_storage_add_token (BayesStorage *storage,
    g_return_if_fail(name);
    g_return_if_fail(token);
 
-   BAYES_STORAGE_GET_INTERFACE(storage)->
-      add_token_count(storage, name, token, 1);
+   bayes_storage_add_token_count(storage, name, token, 1);
+}
+
+/**
+ * bayes_storage_error_quark:
+ *
+ * The error domain of #BayesStorage.
+ *
+ * Returns: A #GQuark.
+ */
+GQuark
+bayes_storage_error_quark (void)
+{
+   return g_quark_from_static_string("bayes-storage-error-quark");
+}
+
+/*
+ * Walks the delta in @data, adding its counts to @storage if @apply is
+ * set. Returns %FALSE if the delta is malformed.
+ */
+static gboolean
+delta_parse (BayesStorage *storage,
+             const guint8 *data,
+             gsize         length,
+             gboolean      apply)
+{
+   const guint8 *end = data + length;
+   GPtrArray *names;
+   GString *token;
+   gboolean ret = FALSE;
+   guint64 n_classes;
+   guint64 n_tokens;
+   guint64 n_counts;
+   guint64 version;
+   guint64 prefix;
+   guint64 class_id;
+   guint64 count;
+   guint64 size;
+   guint64 i;
+   guint64 j;
+
+   if (length < strlen(BAYES_DELTA_MAGIC) ||
+       memcmp(data, BAYES_DELTA_MAGIC, strlen(BAYES_DELTA_MAGIC))) {
+      return FALSE;
+   }
+   data += strlen(BAYES_DELTA_MAGIC);
+
+   if (!_bayes_varint_read(&data, end, &version) ||
+       version != BAYES_DELTA_VERSION ||
+       !_bayes_varint_read(&data, end, &n_classes) ||
+       n_classes > (guint64)(end - data)) {
+      return FALSE;
+   }
+
+   names = g_ptr_array_new_with_free_func(g_free);
+   token = g_string_new(NULL);
+
+   for (i = 0; i < n_classes; i++) {
+      if (!_bayes_varint_read(&data, end, &size) ||
+          size > (guint64)(end - data) ||
+          memchr(data, '\0', size)) {
+         goto cleanup;
+      }
+      g_ptr_array_add(names, g_strndup((const gchar *)data, size));
+      data += size;
+   }
+
+   if (!_bayes_varint_read(&data, end, &n_tokens)) {
+      goto cleanup;
+   }
+
+   for (i = 0; i < n_tokens; i++) {
+      if (!_bayes_varint_read(&data, end, &prefix) ||
+          prefix > token->len ||
+          !_bayes_varint_read(&data, end, &size) ||
+          size > (guint64)(end - data) ||
+          memchr(data, '\0', size)) {
+         goto cleanup;
+      }
+      g_string_truncate(token, prefix);
+      g_string_append_len(token, (const gchar *)data, size);
+      data += size;
+
+      if (!token->len || !_bayes_varint_read(&data, end, &n_counts)) {
+         goto cleanup;
+      }
+
+      for (j = 0; j < n_counts; j++) {
+         if (!_bayes_varint_read(&data, end, &class_id) ||
+             class_id >= n_classes ||
+             !_bayes_varint_read(&data, end, &count) ||
+             !count ||
+             count > G_MAXUINT) {
+            goto cleanup;
+         }
+         if (apply) {
+            bayes_storage_add_token_count(storage,
+                                          g_ptr_array_index(names, class_id),
+                                          token->str, count);
+         }
+      }
+   }
+
+   ret = (data == end);
+
+cleanup:
+   g_string_free(token, TRUE);
+   g_ptr_array_unref(names);
+
+   return ret;
+}
+
+/**
+ * bayes_storage_import_delta:
+ * @storage: (in): A #BayesStorage.
+ * @delta: (in): A delta from bayes_storage_memory_export_delta().
+ * @error: (out): A location for a #GError, or %NULL.
+ *
+ * Adds the token counts in @delta to @storage, bringing a replica up to
+ * date with the storage the delta was exported from. The cost is
+ * proportional to the size of @delta. Deltas must be applied in the
+ * order they were exported, and each of them only once.
+ *
+ * @delta is checked in full before anything is applied, so @storage is
+ * left untouched if it is malformed.
+ *
+ * Returns: %TRUE if @delta was applied.
+ */
+gboolean
+bayes_storage_import_delta (BayesStorage  *storage,
+                            GBytes        *delta,
+                            GError       **error)
+{
+   gconstpointer data;
+   gsize length;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), FALSE);
+   g_return_val_if_fail(delta, FALSE);
+
+   data = g_bytes_get_data(delta, &length);
+
+   if (!delta_parse(storage, data, length, FALSE)) {
+      g_set_error(error, BAYES_STORAGE_ERROR, BAYES_STORAGE_ERROR_INVALID,
+                  _("The data is not a valid delta."));
+      return FALSE;
+   }
+
+   delta_parse(storage, data, length, TRUE);
+   bayes_storage_flush(storage);
+
+   return TRUE;
+}
+
+/**
+ * bayes_storage_fork:
+ * @storage: (in): A #BayesStorage.
+ *
+ * Creates a copy-on-write fork of @storage. The fork starts out with the
+ * training of @storage, but tokens added to it are kept in the fork
+ * alone, so it only takes as much memory as its own training. @storage
+ * must not be trained while the fork is in use.
+ *
+ * See #BayesStorageFork.
+ *
+ * Returns: (transfer full): A new #BayesStorage.
+ */
+BayesStorage *
+bayes_storage_fork (BayesStorage *storage)
+{
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), NULL);
+   return bayes_storage_fork_new(storage);
+}
+
+/**
+ * bayes_storage_get_generation:
+ * @storage: (in): A #BayesStorage.
+ *
+ * Retrieves the training generation of @storage. The generation changes
+ * whenever tokens are added, so anything derived from the training data
+ * may be considered stale once it no longer matches.
+ *
+ * Returns: A #guint64.
+ */
+guint64
+bayes_storage_get_generation (BayesStorage *storage)
+{
+   BayesStorageIface *iface;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), 0);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->get_generation) {
+      return iface->get_generation(storage);
+   }
+
+   return bayes_storage_get_fallback(storage, FALSE)->generation;
+}
+
+/**
+ * bayes_storage_foreach_token:
+ * @storage: (in): A #BayesStorage.
+ * @func: (in) (scope call): A #BayesStorageForeachFunc.
+ * @user_data: (in): User data for @func.
+ *
+ * Calls @func for every distinct token found in @storage, in no
+ * particular order. @storage must not be modified from @func.
+ *
+ * Enumerating tokens is optional for storage implementations.
+ *
+ * Returns: %TRUE if @storage supports enumerating its tokens.
+ */
+gboolean
+bayes_storage_foreach_token (BayesStorage            *storage,
+                             BayesStorageForeachFunc  func,
+                             gpointer                 user_data)
+{
+   BayesStorageIface *iface;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), FALSE);
+   g_return_val_if_fail(func, FALSE);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->foreach_token) {
+      iface->foreach_token(storage, func, user_data);
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+/**
+ * bayes_storage_get_footprint:
+ * @storage: (in): A #BayesStorage.
+ * @footprint: (out caller-allocates): A location for the footprint.
+ *
+ * Retrieves how much memory @storage holds, broken down by what it is
+ * used for. This is meant for capacity planning, so it is cheap enough
+ * to call on a storage of any size.
+ *
+ * Reporting the footprint is optional for storage implementations.
+ *
+ * Returns: %TRUE if @footprint was filled in.
+ */
+gboolean
+bayes_storage_get_footprint (BayesStorage          *storage,
+                             BayesStorageFootprint *footprint)
+{
+   BayesStorageIface *iface;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), FALSE);
+   g_return_val_if_fail(footprint, FALSE);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->get_footprint) {
+      memset(footprint, 0, sizeof *footprint);
+      iface->get_footprint(storage, footprint);
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+/**
+ * bayes_storage_get_class_footprint:
+ * @storage: (in): A #BayesStorage.
+ * @class_id: (in): The class identifier.
+ * @n_tokens: (out) (allow-none): A location for the number of distinct
+ *   tokens trained in the classification.
+ * @n_bytes: (out) (allow-none): A location for the bytes used by the
+ *   counts of the classification.
+ *
+ * Retrieves the size of the vocabulary of the classification identified
+ * by @class_id and the memory its counts take up in @storage. Both are
+ * 0 for an unknown @class_id.
+ *
+ * Reporting the footprint is optional for storage implementations.
+ *
+ * Returns: %TRUE if @n_tokens and @n_bytes were filled in.
+ */
+gboolean
+bayes_storage_get_class_footprint (BayesStorage *storage,
+                                   guint         class_id,
+                                   guint        *n_tokens,
+                                   gsize        *n_bytes)
+{
+   BayesStorageIface *iface;
+   guint tokens = 0;
+   gsize bytes = 0;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), FALSE);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (!iface->get_class_footprint) {
+      return FALSE;
+   }
+
+   iface->get_class_footprint(storage, class_id, &tokens, &bytes);
+
+   if (n_tokens) {
+      *n_tokens = tokens;
+   }
+   if (n_bytes) {
+      *n_bytes = bytes;
+   }
+
+   return TRUE;
 }
 
 /**
@@ -93,6 +521,203 @@ bayes_storage_get_names (BayesStorage *storage)
    return BAYES_STORAGE_GET_INTERFACE(storage)->get_names(storage);
 }
 
+/**
+ * bayes_storage_get_classes:
+ * @storage: (in): A #BayesStorage.
+ * @n_classes: (out) (allow-none): A location for the number of classes.
+ *
+ * Retrieves the names of the classifications trained in this storage
+ * instance, indexed by their class identifier. Unlike
+ * bayes_storage_get_names() no copy is made; the array is owned by
+ * @storage and is only valid until the storage is next modified.
+ *
+ * Returns: (transfer none) (array zero-terminated=1): The class names.
+ */
+const gchar * const *
+bayes_storage_get_classes (BayesStorage *storage,
+                           guint        *n_classes)
+{
+   BayesStorageIface *iface;
+   Fallback *fallback;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), NULL);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->get_classes) {
+      return iface->get_classes(storage, n_classes);
+   }
+
+   fallback = bayes_storage_get_fallback(storage, TRUE);
+   if (n_classes) {
+      *n_classes = fallback->names->len - 1;
+   }
+
+   return (const gchar * const *)fallback->names->pdata;
+}
+
+/**
+ * bayes_storage_lookup_class:
+ * @storage: (in): A #BayesStorage.
+ * @name: (in): The classification.
+ *
+ * Retrieves the class identifier of the classification named @name.
+ *
+ * Returns: The class identifier or -1 if @name has not been trained.
+ */
+gint
+bayes_storage_lookup_class (BayesStorage *storage,
+                            const gchar  *name)
+{
+   BayesStorageIface *iface;
+   gpointer id;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), -1);
+   g_return_val_if_fail(name, -1);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->lookup_class) {
+      return iface->lookup_class(storage, name);
+   }
+
+   if (g_hash_table_lookup_extended(bayes_storage_get_fallback(storage,
+                                                               TRUE)->ids,
+                                    name, NULL, &id)) {
+      return GPOINTER_TO_UINT(id);
+   }
+
+   return -1;
+}
+
+/**
+ * bayes_storage_prefetch_tokens:
+ * @storage: (in): A #BayesStorage.
+ * @tokens: (in) (array length=n_tokens): The tokens about to be looked up.
+ * @n_tokens: (in): The number of elements in @tokens.
+ *
+ * Hints that the counts of @tokens are about to be looked up, usually
+ * for every classification while scoring a document. Storage kept out of
+ * process, such as #BayesStorageSqlite, can then fetch them all at once
+ * instead of one at a time. #BayesClassifier calls this once per
+ * document.
+ *
+ * Storage that does not need the hint ignores it.
+ */
+void
+bayes_storage_prefetch_tokens (BayesStorage        *storage,
+                               const gchar * const *tokens,
+                               guint                n_tokens)
+{
+   BayesStorageIface *iface;
+
+   g_return_if_fail(BAYES_IS_STORAGE(storage));
+   g_return_if_fail(tokens || !n_tokens);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->prefetch_tokens && n_tokens) {
+      iface->prefetch_tokens(storage, tokens, n_tokens);
+   }
+}
+
+/**
+ * bayes_storage_flush:
+ * @storage: (in): A #BayesStorage.
+ *
+ * Hints that a unit of training, such as the document of one call to
+ * bayes_classifier_train(), has been added. Storage that writes to disk,
+ * such as #BayesStorageSqlite, uses this to group writes into
+ * transactions.
+ *
+ * Storage that does not need the hint ignores it.
+ */
+void
+bayes_storage_flush (BayesStorage *storage)
+{
+   BayesStorageIface *iface;
+
+   g_return_if_fail(BAYES_IS_STORAGE(storage));
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->flush) {
+      iface->flush(storage);
+   }
+}
+
+/**
+ * bayes_storage_get_class_token_count:
+ * @storage: (in): A #BayesStorage.
+ * @class_id: (in): The class identifier.
+ * @token: (in) (allow-none): The token or %NULL for all.
+ *
+ * Like bayes_storage_get_token_count() but the classification is given
+ * by its class identifier.
+ *
+ * Returns: A #guint containing the count of all items.
+ */
+guint
+bayes_storage_get_class_token_count (BayesStorage *storage,
+                                     guint         class_id,
+                                     const gchar  *token)
+{
+   BayesStorageIface *iface;
+   Fallback *fallback;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), 0);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->get_class_token_count) {
+      return iface->get_class_token_count(storage, class_id, token);
+   }
+
+   fallback = bayes_storage_get_fallback(storage, TRUE);
+   g_return_val_if_fail(class_id < fallback->names->len - 1, 0);
+
+   return iface->get_token_count(storage,
+                                 g_ptr_array_index(fallback->names, class_id),
+                                 token);
+}
+
+/**
+ * bayes_storage_get_class_token_probability:
+ * @storage: (in): A #BayesStorage.
+ * @class_id: (in): The class identifier.
+ * @token: (in): The desired token.
+ *
+ * Like bayes_storage_get_token_probability() but the classification is
+ * given by its class identifier.
+ *
+ * Returns: A #gdouble between 0.0 and 1.0 containing the probability.
+ */
+gdouble
+bayes_storage_get_class_token_probability (BayesStorage *storage,
+                                           guint         class_id,
+                                           const gchar  *token)
+{
+   BayesStorageIface *iface;
+   Fallback *fallback;
+
+   g_return_val_if_fail(BAYES_IS_STORAGE(storage), 0.0);
+   g_return_val_if_fail(token, 0.0);
+
+   iface = BAYES_STORAGE_GET_INTERFACE(storage);
+
+   if (iface->get_class_token_probability) {
+      return iface->get_class_token_probability(storage, class_id, token);
+   }
+
+   fallback = bayes_storage_get_fallback(storage, TRUE);
+   g_return_val_if_fail(class_id < fallback->names->len - 1, 0.0);
+
+   return iface->get_token_probability(storage,
+                                       g_ptr_array_index(fallback->names,
+                                                         class_id),
+                                       token);
+}
+
 /**
  * bayes_storage_get_token_count:
  * @storage: (in): A #BayesStorage.
@@ -27,9 +27,59 @@ G_BEGIN_DECLS
 #define BAYES_STORAGE(o)               (G_TYPE_CHECK_INSTANCE_CAST((o),    BAYES_TYPE_STORAGE, BayesStorage))
 #define BAYES_IS_STORAGE(o)            (G_TYPE_CHECK_INSTANCE_TYPE((o),    BAYES_TYPE_STORAGE))
 #define BAYES_STORAGE_GET_INTERFACE(o) (G_TYPE_INSTANCE_GET_INTERFACE((o), BAYES_TYPE_STORAGE, BayesStorageIface))
+#define BAYES_STORAGE_ERROR            (bayes_storage_error_quark())
 
-typedef struct _BayesStorage      BayesStorage;
-typedef struct _BayesStorageIface BayesStorageIface;
+/**
+ * BayesStorageError:
+ * @BAYES_STORAGE_ERROR_INVALID: The data given is malformed.
+ *
+ * Errors of #BayesStorage.
+ */
+typedef enum
+{
+   BAYES_STORAGE_ERROR_INVALID = 1,
+} BayesStorageError;
+
+typedef struct _BayesStorage          BayesStorage;
+typedef struct _BayesStorageFootprint BayesStorageFootprint;
+typedef struct _BayesStorageIface     BayesStorageIface;
+
+/**
+ * BayesStorageForeachFunc:
+ * @token: (in): A token found in the storage.
+ * @user_data: (in): User data provided to bayes_storage_foreach_token().
+ *
+ * Callback for bayes_storage_foreach_token().
+ */
+typedef void (*BayesStorageForeachFunc) (const gchar *token,
+                                         gpointer     user_data);
+
+/**
+ * BayesStorageFootprint:
+ * @key_bytes: Bytes used by the tokens themselves.
+ * @value_bytes: Bytes used by the counts of the tokens.
+ * @table_bytes: Bytes used by the tables indexing the tokens and the
+ *   classifications, including their empty buckets.
+ * @class_bytes: Bytes used by the names and totals of the
+ *   classifications.
+ * @n_tokens: The number of distinct tokens.
+ * @n_buckets: The number of buckets in the table of tokens.
+ * @load_factor: @n_tokens divided by @n_buckets.
+ *
+ * The memory held by a #BayesStorage, as returned by
+ * bayes_storage_get_footprint(). Sizes are what was requested from the
+ * allocator and do not include its own overhead.
+ */
+struct _BayesStorageFootprint
+{
+   gsize   key_bytes;
+   gsize   value_bytes;
+   gsize   table_bytes;
+   gsize   class_bytes;
+   guint   n_tokens;
+   guint   n_buckets;
+   gdouble load_factor;
+};
 
 struct _BayesStorageIface
 {
@@ -47,23 +97,86 @@ struct _BayesStorageIface
    gdouble (*get_token_probability) (BayesStorage *storage,
                                      const gchar  *name,
                                      const gchar  *token);
+
+   /*
+    * Optional. Storage that does not implement these falls back to the
+    * name based methods above.
+    */
+   const gchar * const *(*get_classes)                 (BayesStorage *storage,
+                                                        guint        *n_classes);
+   gint                 (*lookup_class)                (BayesStorage *storage,
+                                                        const gchar  *name);
+   guint                (*get_class_token_count)       (BayesStorage *storage,
+                                                        guint         class_id,
+                                                        const gchar  *token);
+   gdouble              (*get_class_token_probability) (BayesStorage *storage,
+                                                        guint         class_id,
+                                                        const gchar  *token);
+   guint64              (*get_generation)              (BayesStorage *storage);
+   void                 (*foreach_token)               (BayesStorage            *storage,
+                                                        BayesStorageForeachFunc  func,
+                                                        gpointer                 user_data);
+   void                 (*get_footprint)               (BayesStorage            *storage,
+                                                        BayesStorageFootprint   *footprint);
+   void                 (*get_class_footprint)         (BayesStorage            *storage,
+                                                        guint                    class_id,
+                                                        guint                   *n_tokens,
+                                                        gsize                   *n_bytes);
+
+   /*
+    * Optional hints for storage that is slow to reach, such as a
+    * database. Storage that does not implement them ignores them.
+    */
+   void                 (*prefetch_tokens)             (BayesStorage            *storage,
+                                                        const gchar * const     *tokens,
+                                                        guint                    n_tokens);
+   void                 (*flush)                       (BayesStorage            *storage);
 };
 
-void      bayes_storage_add_token             (BayesStorage *storage,
-                                               const gchar  *name,
-                                               const gchar  *token);
-void      bayes_storage_add_token_count       (BayesStorage *storage,
-                                               const gchar  *name,
-                                               const gchar  *token,
-                                               guint         count);
-gchar   **bayes_storage_get_names             (BayesStorage *storage);
-GType     bayes_storage_get_type              (void) G_GNUC_CONST;
-guint     bayes_storage_get_token_count       (BayesStorage *storage,
-                                               const gchar  *name,
-                                               const gchar  *token);
-gdouble   bayes_storage_get_token_probability (BayesStorage *storage,
-                                               const gchar  *name,
-                                               const gchar  *token);
+void                  bayes_storage_add_token                   (BayesStorage             *storage,
+                                                                 const gchar              *name,
+                                                                 const gchar              *token);
+void                  bayes_storage_add_token_count             (BayesStorage             *storage,
+                                                                 const gchar              *name,
+                                                                 const gchar              *token,
+                                                                 guint                     count);
+GQuark                bayes_storage_error_quark                 (void) G_GNUC_CONST;
+void                  bayes_storage_flush                       (BayesStorage             *storage);
+gboolean              bayes_storage_foreach_token               (BayesStorage             *storage,
+                                                                 BayesStorageForeachFunc   func,
+                                                                 gpointer                  user_data);
+BayesStorage         *bayes_storage_fork                        (BayesStorage             *storage);
+gboolean              bayes_storage_get_class_footprint         (BayesStorage             *storage,
+                                                                 guint                     class_id,
+                                                                 guint                    *n_tokens,
+                                                                 gsize                    *n_bytes);
+guint                 bayes_storage_get_class_token_count       (BayesStorage             *storage,
+                                                                 guint                     class_id,
+                                                                 const gchar              *token);
+gdouble               bayes_storage_get_class_token_probability (BayesStorage             *storage,
+                                                                 guint                     class_id,
+                                                                 const gchar              *token);
+const gchar * const  *bayes_storage_get_classes                 (BayesStorage             *storage,
+                                                                 guint                    *n_classes);
+gboolean              bayes_storage_get_footprint               (BayesStorage             *storage,
+                                                                 BayesStorageFootprint    *footprint);
+guint64               bayes_storage_get_generation              (BayesStorage             *storage);
+gchar               **bayes_storage_get_names                   (BayesStorage             *storage);
+guint                 bayes_storage_get_token_count             (BayesStorage             *storage,
+                                                                 const gchar              *name,
+                                                                 const gchar              *token);
+gdouble               bayes_storage_get_token_probability       (BayesStorage             *storage,
+                                                                 const gchar              *name,
+                                                                 const gchar              *token);
+GType                 bayes_storage_get_type                    (void) G_GNUC_CONST;
+gboolean              bayes_storage_import_delta                (BayesStorage             *storage,
+                                                                 GBytes                   *delta,
+                                                                 GError                  **error);
+gint                  bayes_storage_lookup_class                (BayesStorage             *storage,
+                                                                 const gchar              *name);
+void                  bayes_storage_prefetch_tokens             (BayesStorage             *storage,
+                                                                 const gchar * const      *tokens,
+                                                                 guint                     n_tokens);
 
 G_END_DECLS
 
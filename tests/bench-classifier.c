@@ -0,0 +1,247 @@
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-storage-compact.h"
+#include "bayes-glib/bayes-storage-memory.h"
+
+#include "bench-corpus.h"
+
+static BenchCorpus *
+create_corpus (guint n_classes,
+               guint n_documents)
+{
+   BenchCorpusConfig config;
+
+   bench_corpus_config_init(&config);
+   config.n_classes = n_classes;
+
+   return bench_corpus_new(&config, n_documents * bench_scale());
+}
+
+static BayesClassifier *
+create_classifier (BenchCorpus *corpus)
+{
+   BayesClassifier *classifier;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_dedup_size(classifier, 0);
+   bayes_classifier_train_batch(classifier,
+                                (const gchar * const *)corpus->names,
+                                (const gchar * const *)corpus->texts);
+
+   return classifier;
+}
+
+/*
+ * Times each guess separately and reports the latency distribution in
+ * microseconds. Returns the mean latency.
+ */
+static gdouble
+measure_guess_latency (BayesClassifier *classifier,
+                       BenchCorpus     *corpus,
+                       const gchar     *label)
+{
+   gdouble *samples;
+   gdouble total = 0.0;
+   gdouble p50;
+   gdouble p90;
+   gdouble p99;
+   gint64 begin;
+   GList *guesses;
+   guint i;
+
+   samples = g_new(gdouble, corpus->n_documents);
+
+   for (i = 0; i < corpus->n_documents; i++) {
+      begin = g_get_monotonic_time();
+      guesses = bayes_classifier_guess(classifier, corpus->texts[i]);
+      samples[i] = g_get_monotonic_time() - begin;
+      total += samples[i];
+      g_assert(guesses);
+      g_list_free_full(guesses, (GDestroyNotify)bayes_guess_unref);
+   }
+
+   bench_percentiles(samples, corpus->n_documents, &p50, &p90, &p99);
+
+   g_test_minimized_result(p50, "%s guess p50: %.0f us", label, p50);
+   g_test_minimized_result(p90, "%s guess p90: %.0f us", label, p90);
+   g_test_minimized_result(p99, "%s guess p99: %.0f us", label, p99);
+
+   g_free(samples);
+
+   return total / corpus->n_documents;
+}
+
+/*
+ * Returns the mean latency of bayes_classifier_guess_best() over the
+ * corpus in microseconds.
+ */
+static gdouble
+measure_guess_best (BayesClassifier *classifier,
+                    BenchCorpus     *corpus)
+{
+   BayesGuess *guess;
+   gint64 begin;
+   guint i;
+
+   begin = g_get_monotonic_time();
+   for (i = 0; i < corpus->n_documents; i++) {
+      guess = bayes_classifier_guess_best(classifier, corpus->texts[i]);
+      g_assert(guess);
+      bayes_guess_unref(guess);
+   }
+
+   return (gdouble)(g_get_monotonic_time() - begin) / corpus->n_documents;
+}
+
+static void
+bench1 (void)
+{
+   BayesClassifier *classifier;
+   BenchCorpus *corpus;
+   GTimer *timer;
+   gdouble elapsed;
+   guint i;
+
+   corpus = create_corpus(8, 20000);
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_dedup_size(classifier, 0);
+   timer = g_timer_new();
+   for (i = 0; i < corpus->n_documents; i++) {
+      bayes_classifier_train(classifier, corpus->names[i], corpus->texts[i]);
+   }
+   elapsed = g_timer_elapsed(timer, NULL);
+   g_test_maximized_result(corpus->n_documents / elapsed,
+                           "train: %.0f docs/s",
+                           corpus->n_documents / elapsed);
+   g_object_unref(classifier);
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_dedup_size(classifier, 0);
+   g_timer_start(timer);
+   bayes_classifier_train_batch(classifier,
+                                (const gchar * const *)corpus->names,
+                                (const gchar * const *)corpus->texts);
+   elapsed = g_timer_elapsed(timer, NULL);
+   g_test_maximized_result(corpus->n_documents / elapsed,
+                           "train batch: %.0f docs/s",
+                           corpus->n_documents / elapsed);
+   g_object_unref(classifier);
+
+   g_timer_destroy(timer);
+   bench_corpus_free(corpus);
+}
+
+static void
+bench2 (void)
+{
+   BayesClassifier *classifier;
+   BenchCorpus *corpus;
+
+   corpus = create_corpus(8, 20000);
+   classifier = create_classifier(corpus);
+   bayes_classifier_set_cache_size(classifier, 0);
+
+   measure_guess_latency(classifier, corpus, "8 classes");
+
+   g_object_unref(classifier);
+   bench_corpus_free(corpus);
+}
+
+static void
+bench3 (void)
+{
+   static const guint n_classes[] = { 2, 8, 32, 128 };
+   BayesClassifier *classifier;
+   BenchCorpus *corpus;
+   gdouble mean;
+   gchar *label;
+   guint i;
+
+   for (i = 0; i < G_N_ELEMENTS(n_classes); i++) {
+      corpus = create_corpus(n_classes[i], 10000);
+      classifier = create_classifier(corpus);
+      bayes_classifier_set_cache_size(classifier, 0);
+
+      label = g_strdup_printf("%u classes", n_classes[i]);
+      mean = measure_guess_latency(classifier, corpus, label);
+      g_test_minimized_result(mean, "%s guess mean: %.1f us", label, mean);
+      mean = measure_guess_best(classifier, corpus);
+      g_test_minimized_result(mean, "%s guess best mean: %.1f us", label,
+                              mean);
+      g_free(label);
+
+      g_object_unref(classifier);
+      bench_corpus_free(corpus);
+   }
+}
+
+static void
+count_token (const gchar *token,
+             gpointer     user_data)
+{
+   (*(guint *)user_data)++;
+}
+
+static void
+bench4 (void)
+{
+   BayesClassifier *classifier;
+   BayesStorageFootprint footprint;
+   BayesStorage *compact;
+   BenchCorpus *corpus;
+   gsize before;
+   gsize total;
+   gsize after;
+   guint n_tokens = 0;
+
+   corpus = create_corpus(8, 20000);
+
+   before = bench_heap_size();
+   classifier = create_classifier(corpus);
+   after = bench_heap_size();
+
+   bayes_storage_foreach_token(bayes_classifier_get_storage(classifier),
+                               count_token, &n_tokens);
+   g_assert_cmpuint(n_tokens, >, 0);
+
+   if (before && after > before) {
+      g_test_minimized_result((after - before) / (gdouble)n_tokens,
+                              "memory: %.1f bytes per token",
+                              (after - before) / (gdouble)n_tokens);
+   }
+
+   g_assert(bayes_storage_get_footprint(bayes_classifier_get_storage(classifier),
+                                        &footprint));
+   total = footprint.key_bytes + footprint.value_bytes +
+           footprint.table_bytes + footprint.class_bytes;
+   g_test_minimized_result(total / (gdouble)n_tokens,
+                           "footprint: %.1f bytes per token, load factor %.2f",
+                           total / (gdouble)n_tokens, footprint.load_factor);
+
+   compact = bayes_storage_compact_new(bayes_classifier_get_storage(classifier),
+                                       8, NULL);
+   g_assert(compact);
+   g_test_minimized_result(
+      bayes_storage_compact_get_bytes_per_token(BAYES_STORAGE_COMPACT(compact)),
+      "compact 8 bit: %u bytes per token",
+      (guint)bayes_storage_compact_get_bytes_per_token(BAYES_STORAGE_COMPACT(compact)));
+   g_object_unref(compact);
+
+   g_object_unref(classifier);
+   bench_corpus_free(corpus);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Bench/Classifier/train", bench1);
+   g_test_add_func("/Bench/Classifier/guess", bench2);
+   g_test_add_func("/Bench/Classifier/classes", bench3);
+   g_test_add_func("/Bench/Classifier/memory", bench4);
+
+   return g_test_run();
+}
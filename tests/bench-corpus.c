@@ -0,0 +1,198 @@
+#include <math.h>
+#include <stdlib.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "bench-corpus.h"
+
+void
+bench_corpus_config_init (BenchCorpusConfig *config)
+{
+   config->seed = 1;
+   config->n_classes = 8;
+   config->n_words = 50000;
+   config->zipf_s = 1.0;
+   config->class_bias = 0.3;
+   config->min_length = 20;
+   config->max_length = 400;
+}
+
+/*
+ * Spells @index as a lowercase word so that it survives any tokenizer
+ * that splits on non-word characters.
+ */
+static void
+append_word (GString *str,
+             guint    index)
+{
+   do {
+      g_string_append_c(str, 'a' + index % 26);
+      index /= 26;
+   } while (index);
+}
+
+static guint
+sample_rank (const gdouble *cdf,
+             guint          n_words,
+             GRand         *rand)
+{
+   gdouble u = g_rand_double(rand);
+   guint lo = 0;
+   guint hi = n_words - 1;
+   guint mid;
+
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (cdf[mid] < u) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+
+   return lo;
+}
+
+/*
+ * Generates the same corpus for the same @config and @n_documents on
+ * every run and every machine.
+ */
+BenchCorpus *
+bench_corpus_new (const BenchCorpusConfig *config,
+                  guint                    n_documents)
+{
+   BenchCorpus *corpus;
+   GString *text;
+   gdouble *cdf;
+   gdouble total = 0.0;
+   GRand *rand;
+   guint class_id;
+   guint length;
+   guint rank;
+   guint i;
+   guint j;
+
+   g_assert(config->n_classes > 0);
+   g_assert(config->n_words > 0);
+   g_assert(config->min_length <= config->max_length);
+
+   cdf = g_new(gdouble, config->n_words);
+   for (i = 0; i < config->n_words; i++) {
+      total += 1.0 / pow(i + 1, config->zipf_s);
+      cdf[i] = total;
+   }
+   for (i = 0; i < config->n_words; i++) {
+      cdf[i] /= total;
+   }
+
+   rand = g_rand_new_with_seed(config->seed);
+   text = g_string_new(NULL);
+
+   corpus = g_new0(BenchCorpus, 1);
+   corpus->n_documents = n_documents;
+   corpus->names = g_new0(gchar *, n_documents + 1);
+   corpus->texts = g_new0(gchar *, n_documents + 1);
+
+   for (i = 0; i < n_documents; i++) {
+      class_id = g_rand_int_range(rand, 0, config->n_classes);
+      length = g_rand_int_range(rand, config->min_length,
+                                config->max_length + 1);
+
+      g_string_truncate(text, 0);
+      for (j = 0; j < length; j++) {
+         rank = sample_rank(cdf, config->n_words, rand);
+         if (g_rand_double(rand) < config->class_bias) {
+            rank = (rank + 1 + class_id * (config->n_words / config->n_classes))
+                   % config->n_words;
+         }
+         if (j) {
+            g_string_append_c(text, ' ');
+         }
+         append_word(text, rank);
+      }
+
+      corpus->names[i] = g_strdup_printf("class%u", class_id);
+      corpus->texts[i] = g_strndup(text->str, text->len);
+      corpus->n_words += length;
+      corpus->n_bytes += text->len;
+   }
+
+   g_string_free(text, TRUE);
+   g_rand_free(rand);
+   g_free(cdf);
+
+   return corpus;
+}
+
+void
+bench_corpus_free (BenchCorpus *corpus)
+{
+   if (corpus) {
+      g_strfreev(corpus->names);
+      g_strfreev(corpus->texts);
+      g_free(corpus);
+   }
+}
+
+/*
+ * Benchmarks run at full size with -m=perf, as with make perf-report, and
+ * as a quick smoke test otherwise.
+ */
+gdouble
+bench_scale (void)
+{
+   return g_test_perf() ? 1.0 : 0.01;
+}
+
+static gint
+compare_doubles (gconstpointer a,
+                 gconstpointer b)
+{
+   gdouble da = *(const gdouble *)a;
+   gdouble db = *(const gdouble *)b;
+   return (da > db) - (da < db);
+}
+
+/*
+ * Sorts @samples in place and picks the nearest rank percentiles.
+ */
+void
+bench_percentiles (gdouble *samples,
+                   guint    n_samples,
+                   gdouble *p50,
+                   gdouble *p90,
+                   gdouble *p99)
+{
+   g_assert(n_samples > 0);
+
+   qsort(samples, n_samples, sizeof(gdouble), compare_doubles);
+
+   *p50 = samples[(n_samples - 1) * 50 / 100];
+   *p90 = samples[(n_samples - 1) * 90 / 100];
+   *p99 = samples[(n_samples - 1) * 99 / 100];
+}
+
+/*
+ * Returns the number of bytes allocated from the heap, or 0 where the C
+ * library cannot tell.
+ */
+gsize
+bench_heap_size (void)
+{
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+   struct mallinfo2 info;
+
+   /*
+    * mallinfo2() returns a struct, which --enable-debug turns into an
+    * error through -Waggregate-return.
+    */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggregate-return"
+   info = mallinfo2();
+#pragma GCC diagnostic pop
+   return info.uordblks + info.hblkhd;
+#else
+   return 0;
+#endif
+}
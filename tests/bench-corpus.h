@@ -0,0 +1,47 @@
+#ifndef BENCH_CORPUS_H
+#define BENCH_CORPUS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Settings for a synthetic corpus. Word frequencies follow Zipf's law
+ * with exponent zipf_s. Each class shifts the ranks of part of its words
+ * so that the classes can be told apart.
+ */
+typedef struct
+{
+   guint32 seed;
+   guint   n_classes;
+   guint   n_words;
+   gdouble zipf_s;
+   gdouble class_bias;  /* Fraction of words drawn from the class ranks */
+   guint   min_length;  /* Words per document */
+   guint   max_length;
+} BenchCorpusConfig;
+
+typedef struct
+{
+   guint    n_documents;
+   guint    n_words;     /* Total words in all documents */
+   gsize    n_bytes;     /* Total length of all documents */
+   gchar  **names;       /* Class of each document, NULL terminated */
+   gchar  **texts;       /* Each document, NULL terminated */
+} BenchCorpus;
+
+void         bench_corpus_config_init (BenchCorpusConfig       *config);
+BenchCorpus *bench_corpus_new         (const BenchCorpusConfig *config,
+                                       guint                    n_documents);
+void         bench_corpus_free        (BenchCorpus             *corpus);
+gdouble      bench_scale              (void);
+void         bench_percentiles        (gdouble                 *samples,
+                                       guint                    n_samples,
+                                       gdouble                 *p50,
+                                       gdouble                 *p90,
+                                       gdouble                 *p99);
+gsize        bench_heap_size          (void);
+
+G_END_DECLS
+
+#endif /* BENCH_CORPUS_H */
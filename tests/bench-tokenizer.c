@@ -0,0 +1,49 @@
+#include "bayes-glib/bayes-tokenizer.h"
+
+#include "bench-corpus.h"
+
+static void
+bench1 (void)
+{
+   BenchCorpusConfig config;
+   BenchCorpus *corpus;
+   GTimer *timer;
+   gdouble elapsed;
+   gchar **tokens;
+   guint n_tokens = 0;
+   guint i;
+
+   bench_corpus_config_init(&config);
+   corpus = bench_corpus_new(&config, 20000 * bench_scale());
+
+   timer = g_timer_new();
+   for (i = 0; i < corpus->n_documents; i++) {
+      tokens = bayes_tokenizer_word(corpus->texts[i], NULL);
+      n_tokens += g_strv_length(tokens);
+      g_strfreev(tokens);
+   }
+   elapsed = g_timer_elapsed(timer, NULL);
+   g_timer_destroy(timer);
+
+   g_assert_cmpuint(n_tokens, ==, corpus->n_words);
+
+   g_test_maximized_result(corpus->n_bytes / elapsed / (1024.0 * 1024.0),
+                           "word tokenizer: %.2f MiB/s",
+                           corpus->n_bytes / elapsed / (1024.0 * 1024.0));
+   g_test_maximized_result(n_tokens / elapsed,
+                           "word tokenizer: %.0f tokens/s",
+                           n_tokens / elapsed);
+
+   bench_corpus_free(corpus);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+
+   g_test_add_func("/Bench/Tokenizer/word", bench1);
+
+   return g_test_run();
+}
@@ -0,0 +1,723 @@
+#include <glib/gstdio.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-storage-compact.h"
+
+static BayesClassifier *
+create_classifier (void)
+{
+   BayesClassifier *classifier;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_train(classifier, "french", "le la les du un une je il elle de en");
+   bayes_classifier_train(classifier, "german", "der die das ein eine");
+   bayes_classifier_train(classifier, "spanish", "el uno una las de la en");
+   bayes_classifier_train(classifier, "english", "the it she he they them are were to");
+
+   return classifier;
+}
+
+static void
+test1 (void)
+{
+   BayesClassifier *classifier;
+   BayesGuess *guess;
+   GList *list;
+
+   classifier = create_classifier();
+
+   list = bayes_classifier_guess(classifier, "they were flying planes");
+   g_assert(list);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(list->data));
+
+   guess = bayes_classifier_guess_best(classifier, "they were flying planes");
+   g_assert(guess);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(guess));
+   g_assert_cmpfloat(bayes_guess_get_probability(guess), ==,
+                     bayes_guess_get_probability(list->data));
+
+   bayes_guess_unref(guess);
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+   g_object_unref(classifier);
+}
+
+static void
+test2 (void)
+{
+   BayesClassifier *classifier;
+   BayesGuess *guess;
+
+   classifier = create_classifier();
+   bayes_classifier_set_combiner(classifier, bayes_combiner_fisher, NULL, NULL);
+
+   guess = bayes_classifier_guess_best(classifier, "der die das und das");
+   g_assert(guess);
+   g_assert_cmpstr("german", ==, bayes_guess_get_name(guess));
+   bayes_guess_unref(guess);
+
+   g_assert(!bayes_classifier_guess_best(classifier, "   "));
+
+   g_object_unref(classifier);
+}
+
+static void
+test3 (void)
+{
+   static const gchar *texts[] = {
+      "they were flying planes",
+      "der die das",
+      "",
+      "el uno una",
+      NULL
+   };
+   BayesClassifier *classifier;
+   BayesBatchResult *result;
+   const gchar * const *names;
+   guint i;
+
+   classifier = create_classifier();
+
+   result = bayes_classifier_guess_batch(classifier, texts);
+   g_assert(result);
+   g_assert_cmpint(4, ==, bayes_batch_result_get_n_documents(result));
+   g_assert_cmpint(4, ==, bayes_batch_result_get_n_classes(result));
+
+   names = bayes_batch_result_get_class_names(result);
+   for (i = 0; i < 4; i++) {
+      g_assert(names[i]);
+   }
+   g_assert(!names[4]);
+
+   g_assert_cmpstr("english", ==, bayes_batch_result_get_best_name(result, 0));
+   g_assert_cmpstr("german", ==, bayes_batch_result_get_best_name(result, 1));
+   g_assert_cmpint(-1, ==, bayes_batch_result_get_best(result, 2));
+   g_assert(!bayes_batch_result_get_best_name(result, 2));
+   g_assert_cmpstr("spanish", ==, bayes_batch_result_get_best_name(result, 3));
+
+   bayes_batch_result_unref(result);
+   g_object_unref(classifier);
+}
+
+static void
+test4 (void)
+{
+   static const gchar *names[] = {
+      "french", "german", "spanish", "english", "english", NULL
+   };
+   static const gchar *texts[] = {
+      "le la les du un une je il elle de en",
+      "der die das ein eine",
+      "el uno una las de la en",
+      "the it she he they them are were to",
+      "they were there",
+      NULL
+   };
+   BayesClassifier *classifier;
+   BayesStorage *storage;
+   BayesGuess *guess;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_train_batch(classifier, names, texts);
+
+   storage = bayes_classifier_get_storage(classifier);
+   g_assert_cmpint(2, ==, bayes_storage_get_token_count(storage, "english", "they"));
+   g_assert_cmpint(1, ==, bayes_storage_get_token_count(storage, "spanish", "la"));
+   g_assert_cmpint(12, ==, bayes_storage_get_token_count(storage, "english", NULL));
+
+   guess = bayes_classifier_guess_best(classifier, "they were flying planes");
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(guess));
+   bayes_guess_unref(guess);
+
+   g_object_unref(classifier);
+}
+
+static void
+test5_cb (GObject      *object,
+          GAsyncResult *result,
+          gpointer      user_data)
+{
+   GMainLoop *main_loop = user_data;
+   GError *error = NULL;
+   GList *list;
+
+   list = bayes_classifier_guess_finish(BAYES_CLASSIFIER(object), result, &error);
+   g_assert_no_error(error);
+   g_assert(list);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(list->data));
+
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+   g_main_loop_quit(main_loop);
+}
+
+static void
+test5 (void)
+{
+   BayesClassifier *classifier;
+   GMainLoop *main_loop;
+
+   classifier = create_classifier();
+   main_loop = g_main_loop_new(NULL, FALSE);
+
+   bayes_classifier_guess_async(classifier, "they were flying planes",
+                                NULL, test5_cb, main_loop);
+   g_main_loop_run(main_loop);
+
+   g_main_loop_unref(main_loop);
+   g_object_unref(classifier);
+}
+
+static void
+test6 (void)
+{
+   BayesClassifier *classifier;
+   BayesGuess *guess;
+   guint64 hits;
+   guint64 misses;
+   GList *list;
+   GList *cached;
+
+   classifier = create_classifier();
+   bayes_classifier_set_cache_size(classifier, 2);
+
+   list = bayes_classifier_guess(classifier, "they were flying planes");
+   cached = bayes_classifier_guess(classifier, "they were flying planes");
+   g_assert_cmpint(g_list_length(list), ==, g_list_length(cached));
+   g_assert_cmpstr(bayes_guess_get_name(list->data), ==, bayes_guess_get_name(cached->data));
+   g_assert_cmpfloat(bayes_guess_get_probability(list->data), ==,
+                     bayes_guess_get_probability(cached->data));
+   bayes_classifier_get_cache_stats(classifier, &hits, &misses);
+   g_assert_cmpint(hits, ==, 1);
+   g_assert_cmpint(misses, ==, 1);
+   g_list_foreach(cached, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(cached);
+
+   guess = bayes_classifier_guess_best(classifier, "they were flying planes");
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(guess));
+   bayes_guess_unref(guess);
+   bayes_classifier_get_cache_stats(classifier, &hits, NULL);
+   g_assert_cmpint(hits, ==, 2);
+
+   /*
+    * Training makes the cached result stale.
+    */
+   bayes_classifier_train(classifier, "spanish", "they were flying planes");
+   cached = bayes_classifier_guess(classifier, "they were flying planes");
+   bayes_classifier_get_cache_stats(classifier, &hits, &misses);
+   g_assert_cmpint(hits, ==, 2);
+   g_assert_cmpint(misses, ==, 2);
+   g_assert_cmpfloat(bayes_guess_get_probability(list->data), !=,
+                     bayes_guess_get_probability(cached->data));
+   g_list_foreach(cached, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(cached);
+
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+   g_object_unref(classifier);
+}
+
+static void
+test7 (void)
+{
+   static const gchar *names[] = { "french", "french", "german", NULL };
+   static const gchar *texts[] = { "le la", "le la", "le la", NULL };
+   BayesClassifier *classifier;
+   BayesStorage *storage;
+   guint64 unique;
+   guint64 duplicates;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_dedup_size(classifier, 100);
+   storage = bayes_classifier_get_storage(classifier);
+
+   bayes_classifier_train(classifier, "english", "the it she");
+   bayes_classifier_train(classifier, "english", "the it she");
+   bayes_classifier_train(classifier, "spanish", "the it she");
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "english", "the"), ==, 1);
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "spanish", "the"), ==, 1);
+
+   bayes_classifier_train_batch(classifier, names, texts);
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "french", "le"), ==, 1);
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "german", "le"), ==, 1);
+
+   bayes_classifier_get_dedup_stats(classifier, &unique, &duplicates);
+   g_assert_cmpint(unique, ==, 4);
+   g_assert_cmpint(duplicates, ==, 2);
+
+   /*
+    * Disabling suppression trains every document again.
+    */
+   bayes_classifier_set_dedup_size(classifier, 0);
+   bayes_classifier_train(classifier, "english", "the it she");
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "english", "the"), ==, 2);
+
+   g_object_unref(classifier);
+}
+
+static gdouble
+test8_combiner (const gdouble *probs,
+                guint          n_probs,
+                gpointer       user_data)
+{
+   *(guint *)user_data = n_probs;
+   return probs[0];
+}
+
+static void
+test8 (void)
+{
+   static const BayesFeature spam[] = {
+      { "x-spam-flag", 0, 2.0 },
+      { NULL, 7, 3.0 },
+   };
+   static const BayesFeature ham[] = {
+      { "list-id", 0, 1.0 },
+      { NULL, 8, 1.4 },
+   };
+   static const BayesFeature words[] = {
+      { "they", 0, 1.0 },
+      { "were", 0, 1.0 },
+      { "flying", 0, 1.0 },
+   };
+   static const BayesFeature unknown[] = {
+      { NULL, 7, 0.5 },
+      { "flying", 0, 1.0 },
+   };
+   static const BayesFeature huge[] = {
+      { "they", 0, 4294967296.0 },
+      { "were", 0, 1e300 },
+      { "flying", 0, 1e300 },
+   };
+   BayesClassifier *classifier;
+   BayesStorage *storage;
+   GList *expected;
+   GList *list;
+   guint n_probs = 0;
+
+   classifier = create_classifier();
+   storage = bayes_classifier_get_storage(classifier);
+
+   bayes_classifier_train_features(classifier, "spam", spam, G_N_ELEMENTS(spam));
+   bayes_classifier_train_features(classifier, "ham", ham, G_N_ELEMENTS(ham));
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "spam", "x-spam-flag"), ==, 2);
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "spam", "#7"), ==, 3);
+   g_assert_cmpint(bayes_storage_get_token_count(storage, "ham", "#8"), ==, 1);
+
+   list = bayes_classifier_guess_features(classifier, unknown, G_N_ELEMENTS(unknown));
+   g_assert_cmpint(g_list_length(list), ==, 6);
+   g_assert_cmpstr("spam", ==, bayes_guess_get_name(list->data));
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+
+   /*
+    * Features of weight 1 score like the same tokens in text.
+    */
+   expected = bayes_classifier_guess(classifier, "they were flying");
+   list = bayes_classifier_guess_features(classifier, words, G_N_ELEMENTS(words));
+   g_assert_cmpstr(bayes_guess_get_name(expected->data), ==,
+                   bayes_guess_get_name(list->data));
+   g_assert_cmpfloat(fabs(bayes_guess_get_probability(expected->data) -
+                          bayes_guess_get_probability(list->data)), <, 1e-9);
+   g_list_foreach(expected, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(expected);
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+
+   /*
+    * A custom combiner sees each feature a bounded number of times.
+    */
+   bayes_classifier_set_combiner(classifier, test8_combiner, &n_probs, NULL);
+   list = bayes_classifier_guess_features(classifier, huge, G_N_ELEMENTS(huge));
+   g_assert_cmpint(g_list_length(list), ==, 6);
+   g_assert_cmpint(n_probs, ==, 65536 * 3);
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+
+   g_object_unref(classifier);
+}
+
+static void
+test9 (void)
+{
+   static const gchar *names[] = { "french", "english", NULL };
+   static const gchar train[] = "le la les\0the it she\0";
+   static const gchar texts[] = "she and it\0\0les uns\0";
+   const BayesBatchEntry *entries;
+   BayesClassifier *classifier;
+   BayesBatchResult *result;
+   const gdouble *scores;
+   GBytes *bytes;
+   gdouble best;
+   gsize length;
+
+   classifier = bayes_classifier_new();
+   bytes = g_bytes_new_static(train, sizeof train - 1);
+   bayes_classifier_train_many(classifier, names, bytes);
+   g_bytes_unref(bytes);
+
+   bytes = g_bytes_new_static(texts, sizeof texts - 1);
+   result = bayes_classifier_guess_many(classifier, bytes);
+   g_bytes_unref(bytes);
+   g_assert_cmpint(bayes_batch_result_get_n_documents(result), ==, 3);
+   g_assert_cmpint(bayes_batch_result_get_n_classes(result), ==, 2);
+   g_assert_cmpstr(bayes_batch_result_get_class_names(result)[0], ==, "french");
+
+   bytes = bayes_batch_result_get_best_bytes(result);
+   entries = g_bytes_get_data(bytes, &length);
+   g_assert_cmpint(length, ==, 3 * sizeof(BayesBatchEntry));
+   g_assert_cmpint(entries[0].class_index, ==, 1);
+   g_assert_cmpfloat(entries[0].score, ==, bayes_batch_result_get_score(result, 0, 1));
+   g_assert_cmpint(entries[1].class_index, ==, -1);
+   g_assert_cmpint(entries[2].class_index, ==, 0);
+   best = entries[0].score;
+   g_bytes_unref(bytes);
+
+   bytes = bayes_batch_result_get_scores_bytes(result);
+   bayes_batch_result_unref(result);
+   scores = g_bytes_get_data(bytes, &length);
+   g_assert_cmpint(length, ==, 3 * 2 * sizeof(gdouble));
+   g_assert_cmpfloat(scores[0 * 2 + 1], ==, best);
+   g_assert_cmpfloat(scores[2 * 2 + 0], >, scores[2 * 2 + 1]);
+   g_bytes_unref(bytes);
+
+   g_object_unref(classifier);
+}
+
+static void
+test10 (void)
+{
+   BayesClassifier *classifier;
+   BayesStats stats;
+   GList *guesses;
+
+   classifier = bayes_classifier_new();
+   g_assert(!bayes_classifier_get_stats_enabled(classifier));
+
+   /*
+    * Nothing is counted until stats are enabled.
+    */
+   bayes_classifier_train(classifier, "french", "le la les");
+   bayes_classifier_get_stats(classifier, &stats);
+   g_assert_cmpint(stats.n_documents, ==, 0);
+   g_assert_cmpint(stats.n_tokens, ==, 0);
+
+   g_object_set(classifier, "stats-enabled", TRUE, NULL);
+   bayes_classifier_set_cache_size(classifier, 4);
+
+   bayes_classifier_train(classifier, "english", "the it the");
+   bayes_classifier_get_stats(classifier, &stats);
+   g_assert_cmpint(stats.n_documents, ==, 1);
+   g_assert_cmpint(stats.n_tokens, ==, 3);
+   g_assert_cmpint(stats.n_unique_tokens, ==, 2);
+
+   guesses = bayes_classifier_guess(classifier, "the le it");
+   g_list_free_full(guesses, (GDestroyNotify)bayes_guess_unref);
+   guesses = bayes_classifier_guess(classifier, "the le it");
+   g_list_free_full(guesses, (GDestroyNotify)bayes_guess_unref);
+
+   bayes_classifier_get_stats(classifier, &stats);
+   g_assert_cmpint(stats.n_documents, ==, 2);
+   g_assert_cmpint(stats.n_tokens, ==, 6);
+   g_assert_cmpint(stats.n_lookups, ==, 3 * 2);
+   g_assert_cmpint(stats.n_hash_probes, ==, 3);
+   g_assert_cmpint(stats.n_cache_hits, ==, 1);
+
+   bayes_classifier_reset_stats(classifier);
+   bayes_classifier_get_stats(classifier, &stats);
+   g_assert_cmpint(stats.n_documents, ==, 0);
+   g_assert_cmpint(stats.n_lookups, ==, 0);
+   g_assert_cmpint(stats.tokenize_nsec, ==, 0);
+   g_assert_cmpint(stats.lookup_nsec, ==, 0);
+   g_assert_cmpint(stats.combine_nsec, ==, 0);
+
+   /*
+    * Tokens that were never trained are rejected before the hash table.
+    */
+   guesses = bayes_classifier_guess(classifier, "das der die");
+   g_list_free_full(guesses, (GDestroyNotify)bayes_guess_unref);
+
+   bayes_classifier_get_stats(classifier, &stats);
+   g_assert_cmpint(stats.n_lookups, ==, 3 * 2);
+   g_assert_cmpint(stats.n_hash_probes, ==, 0);
+
+   g_object_unref(classifier);
+}
+
+static void
+save_model (const gchar *filename,
+            const gchar *name,
+            const gchar *text)
+{
+   BayesClassifier *classifier;
+   BayesStorage *compact;
+   GError *error = NULL;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_train(classifier, name, text);
+   bayes_classifier_train(classifier, "other", "nothing in common");
+   compact = bayes_storage_compact_new(bayes_classifier_get_storage(classifier), 16, &error);
+   g_assert_no_error(error);
+   g_assert(bayes_storage_compact_save(BAYES_STORAGE_COMPACT(compact), filename, &error));
+   g_assert_no_error(error);
+   g_object_unref(compact);
+   g_object_unref(classifier);
+}
+
+static void
+test11_notify (GObject    *object,
+               GParamSpec *pspec,
+               gpointer    user_data)
+{
+   g_main_loop_quit(user_data);
+}
+
+static gboolean
+test11_timeout (gpointer user_data)
+{
+   g_assert_not_reached();
+   return FALSE;
+}
+
+static void
+test11 (void)
+{
+   BayesClassifier *classifier;
+   GMainLoop *main_loop;
+   BayesGuess *guess;
+   GError *error = NULL;
+   gchar *filename;
+   guint timeout;
+   gint fd;
+
+   fd = g_file_open_tmp("test-classifier-XXXXXX", &filename, &error);
+   g_assert_no_error(error);
+   close(fd);
+
+   save_model(filename, "english", "the quick brown fox");
+
+   classifier = bayes_classifier_new();
+   g_assert(bayes_classifier_watch_file(classifier, filename, &error));
+   g_assert_no_error(error);
+   g_assert(BAYES_IS_STORAGE_COMPACT(bayes_classifier_get_storage(classifier)));
+
+   guess = bayes_classifier_guess_best(classifier, "the fox");
+   g_assert_cmpstr(bayes_guess_get_name(guess), ==, "english");
+   bayes_guess_unref(guess);
+
+   main_loop = g_main_loop_new(NULL, FALSE);
+   g_signal_connect(classifier, "notify::storage",
+                    G_CALLBACK(test11_notify), main_loop);
+   timeout = g_timeout_add_seconds(10, test11_timeout, NULL);
+
+   save_model(filename, "spanish", "the quick brown fox");
+   g_main_loop_run(main_loop);
+   g_source_remove(timeout);
+
+   guess = bayes_classifier_guess_best(classifier, "the fox");
+   g_assert_cmpstr(bayes_guess_get_name(guess), ==, "spanish");
+   bayes_guess_unref(guess);
+
+   bayes_classifier_unwatch_file(classifier);
+   g_main_loop_unref(main_loop);
+   g_object_unref(classifier);
+
+   classifier = bayes_classifier_new();
+   g_assert(!bayes_classifier_watch_file(classifier, "does-not-exist", &error));
+   g_assert(error);
+   g_clear_error(&error);
+   g_object_unref(classifier);
+
+   g_unlink(filename);
+   g_free(filename);
+}
+
+typedef struct
+{
+   GMutex   mutex;
+   GCond    cond;
+   gboolean entered;
+   gboolean released;
+} Test12Gate;
+
+static gchar **
+test12_tokenize (const gchar *text,
+                 gpointer     user_data)
+{
+   Test12Gate *gate = user_data;
+
+   if (!strcmp(text, "wait the fox")) {
+      g_mutex_lock(&gate->mutex);
+      gate->entered = TRUE;
+      g_cond_broadcast(&gate->cond);
+      while (!gate->released) {
+         g_cond_wait(&gate->cond, &gate->mutex);
+      }
+      g_mutex_unlock(&gate->mutex);
+   }
+
+   return bayes_tokenizer_word(text, NULL);
+}
+
+static gpointer
+test12_thread (gpointer data)
+{
+   static const gchar *texts[] = { "wait the fox", NULL };
+
+   return bayes_classifier_guess_batch(data, texts);
+}
+
+static void
+test12 (void)
+{
+   BayesClassifier *classifier;
+   BayesClassifier *trainer;
+   BayesBatchResult *result;
+   BayesGuess *guess;
+   Test12Gate gate = { { 0 } };
+   GThread *thread;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_tokenizer(classifier, test12_tokenize, &gate, NULL);
+   bayes_classifier_train(classifier, "english", "the quick brown fox");
+   bayes_classifier_train(classifier, "other", "nothing in common");
+
+   trainer = bayes_classifier_new();
+   bayes_classifier_train(trainer, "spanish", "the quick brown fox");
+   bayes_classifier_train(trainer, "other", "nothing in common");
+
+   g_mutex_init(&gate.mutex);
+   g_cond_init(&gate.cond);
+
+   /*
+    * Replace the storage while a batch is stuck scoring against the old
+    * one. Neither the swap nor new guesses may wait for it.
+    */
+   thread = g_thread_new("test12", test12_thread, classifier);
+   g_mutex_lock(&gate.mutex);
+   while (!gate.entered) {
+      g_cond_wait(&gate.cond, &gate.mutex);
+   }
+   g_mutex_unlock(&gate.mutex);
+
+   bayes_classifier_set_storage(classifier,
+                                bayes_classifier_get_storage(trainer));
+   g_object_unref(trainer);
+
+   guess = bayes_classifier_guess_best(classifier, "the fox");
+   g_assert_cmpstr(bayes_guess_get_name(guess), ==, "spanish");
+   bayes_guess_unref(guess);
+
+   g_mutex_lock(&gate.mutex);
+   gate.released = TRUE;
+   g_cond_broadcast(&gate.cond);
+   g_mutex_unlock(&gate.mutex);
+
+   result = g_thread_join(thread);
+   g_assert_cmpstr(bayes_batch_result_get_best_name(result, 0), ==, "english");
+   bayes_batch_result_unref(result);
+
+   g_object_unref(classifier);
+   g_mutex_clear(&gate.mutex);
+   g_cond_clear(&gate.cond);
+}
+
+static void
+test13 (void)
+{
+   static const BayesCombiner combiners[] = {
+      bayes_combiner_robinson,
+      bayes_combiner_fisher,
+      bayes_combiner_naive,
+   };
+   BayesClassifier *classifier;
+   BayesGuess *guess;
+   GString *str;
+   GList *list;
+   gchar *name;
+   GRand *rand;
+   guint i;
+   guint j;
+   guint k;
+
+   /*
+    * Documents many times longer than the chunks guess_best() scores at
+    * a time, over enough classes that with the naive combiner most of
+    * them are abandoned part way.
+    */
+   classifier = bayes_classifier_new();
+   rand = g_rand_new_with_seed(1234);
+   str = g_string_new(NULL);
+
+   for (i = 0; i < 24; i++) {
+      name = g_strdup_printf("class%u", i);
+      for (j = 0; j < 4; j++) {
+         g_string_truncate(str, 0);
+         for (k = 0; k < 50; k++) {
+            g_string_append_printf(str, "w%u_%u shared%u ", i,
+                                   g_rand_int_range(rand, 0, 40),
+                                   g_rand_int_range(rand, 0, 20));
+         }
+         bayes_classifier_train(classifier, name, str->str);
+      }
+      g_free(name);
+   }
+
+   for (i = 0; i < G_N_ELEMENTS(combiners); i++) {
+      bayes_classifier_set_combiner(classifier, combiners[i], NULL, NULL);
+
+      for (j = 0; j < 24; j++) {
+         g_string_truncate(str, 0);
+         for (k = 0; k < 150; k++) {
+            g_string_append_printf(str, "w%u_%u unknown%u ",
+                                   g_rand_int_range(rand, 0, 2) ?
+                                      j : (guint)g_rand_int_range(rand, 0, 24),
+                                   g_rand_int_range(rand, 0, 40), k);
+         }
+
+         list = bayes_classifier_guess(classifier, str->str);
+         g_assert(list);
+         guess = bayes_classifier_guess_best(classifier, str->str);
+         g_assert(guess);
+         g_assert_cmpstr(bayes_guess_get_name(guess), ==,
+                         bayes_guess_get_name(list->data));
+         g_assert_cmpfloat(fabs(bayes_guess_get_probability(guess) -
+                                bayes_guess_get_probability(list->data)),
+                           <, 1e-9);
+
+         bayes_guess_unref(guess);
+         g_list_free_full(list, (GDestroyNotify)bayes_guess_unref);
+      }
+   }
+
+   g_string_free(str, TRUE);
+   g_rand_free(rand);
+   g_object_unref(classifier);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Classifier/guess_best", test1);
+   g_test_add_func("/Classifier/guess_best_fisher", test2);
+   g_test_add_func("/Classifier/guess_batch", test3);
+   g_test_add_func("/Classifier/train_batch", test4);
+   g_test_add_func("/Classifier/guess_async", test5);
+   g_test_add_func("/Classifier/cache", test6);
+   g_test_add_func("/Classifier/dedup", test7);
+   g_test_add_func("/Classifier/features", test8);
+   g_test_add_func("/Classifier/bytes", test9);
+   g_test_add_func("/Classifier/stats", test10);
+   g_test_add_func("/Classifier/watch_file", test11);
+   g_test_add_func("/Classifier/swap_storage", test12);
+   g_test_add_func("/Classifier/guess_best_long", test13);
+
+   return g_test_run();
+}
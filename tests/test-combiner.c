@@ -0,0 +1,77 @@
+#include <math.h>
+
+#include "bayes-glib/bayes-combiner.h"
+
+static void
+test1 (void)
+{
+   gdouble probs[] = { 0.9999, 0.9999, 0.0, 0.0 };
+
+   /*
+    * Matches the result of the product based implementation.
+    */
+   g_assert_cmpfloat(ABS(0.4975 - bayes_combiner_robinson(probs, 4, NULL)), <, 0.0001);
+}
+
+static void
+test2 (void)
+{
+   gdouble *probs;
+   gdouble r;
+   guint i;
+
+   /*
+    * A product of this many probabilities underflows a double.
+    */
+   probs = g_new(gdouble, 20000);
+   for (i = 0; i < 20000; i++) {
+      probs[i] = (i % 3) ? 0.99 : 0.2;
+   }
+
+   r = bayes_combiner_robinson(probs, 20000, NULL);
+   g_assert(isfinite(r));
+   g_assert_cmpfloat(r, >, 0.5);
+
+   r = bayes_combiner_fisher(probs, 20000, NULL);
+   g_assert(isfinite(r));
+   g_assert_cmpfloat(r, >, 0.5);
+
+   r = bayes_combiner_naive(probs, 20000, NULL);
+   g_assert(isfinite(r));
+   g_assert_cmpfloat(r, >, 0.5);
+
+   for (i = 0; i < 20000; i++) {
+      probs[i] = 1.0 - probs[i];
+   }
+
+   g_assert_cmpfloat(bayes_combiner_robinson(probs, 20000, NULL), <, 0.5);
+   g_assert_cmpfloat(bayes_combiner_fisher(probs, 20000, NULL), <, 0.5);
+   g_assert_cmpfloat(bayes_combiner_naive(probs, 20000, NULL), <, 0.5);
+
+   g_free(probs);
+}
+
+static void
+test3 (void)
+{
+   gdouble probs[] = { 0.9, 0.1 };
+
+   /*
+    * Symmetric evidence is undecided.
+    */
+   g_assert_cmpfloat(ABS(0.5 - bayes_combiner_fisher(probs, 2, NULL)), <, 0.0001);
+   g_assert_cmpfloat(ABS(0.5 - bayes_combiner_naive(probs, 2, NULL)), <, 0.0001);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+
+   g_test_add_func("/Combiner/robinson", test1);
+   g_test_add_func("/Combiner/long_documents", test2);
+   g_test_add_func("/Combiner/symmetric", test3);
+
+   return g_test_run();
+}
@@ -0,0 +1,128 @@
+#include <math.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-document.h"
+
+static BayesClassifier *
+create_classifier (void)
+{
+   BayesClassifier *classifier;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_train(classifier, "french", "le la les du un une je il elle de en");
+   bayes_classifier_train(classifier, "german", "der die das ein eine");
+   bayes_classifier_train(classifier, "spanish", "el uno una las de la en");
+   bayes_classifier_train(classifier, "english", "the it she he they them are were to");
+
+   return classifier;
+}
+
+static gchar **
+split_tokenizer (const gchar *text,
+                 gpointer     user_data)
+{
+   return g_strsplit(text, ",", 0);
+}
+
+static void
+assert_same_guesses (GList *a,
+                     GList *b)
+{
+   g_assert_cmpint(g_list_length(a), ==, g_list_length(b));
+
+   for (; a && b; a = a->next, b = b->next) {
+      g_assert_cmpstr(bayes_guess_get_name(a->data), ==,
+                      bayes_guess_get_name(b->data));
+      g_assert(fabs(bayes_guess_get_probability(a->data) -
+                    bayes_guess_get_probability(b->data)) < 1e-9);
+   }
+}
+
+static void
+free_guesses (GList *list)
+{
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+}
+
+static void
+test1 (void)
+{
+   BayesDocument *document;
+   const gchar * const *tokens;
+   const guint *counts;
+   guint n_tokens;
+
+   document = bayes_document_new("they were the best of the best", NULL, NULL);
+   g_assert_cmpint(bayes_document_get_n_tokens(document), ==, 7);
+
+   tokens = bayes_document_get_tokens(document, &counts, &n_tokens);
+   g_assert_cmpint(n_tokens, ==, 5);
+   g_assert_cmpstr(tokens[0], ==, "they");
+   g_assert_cmpstr(tokens[2], ==, "the");
+   g_assert_cmpint(counts[2], ==, 2);
+   g_assert_cmpstr(tokens[3], ==, "best");
+   g_assert_cmpint(counts[3], ==, 2);
+   g_assert(!tokens[5]);
+
+   bayes_document_unref(document);
+}
+
+static void
+test2 (void)
+{
+   static const gchar *text = "they were the flying planes of the day";
+   BayesClassifier *classifier;
+   BayesClassifier *other;
+   BayesDocument *document;
+   GList *expected;
+   GList *list;
+
+   classifier = create_classifier();
+   other = create_classifier();
+   bayes_classifier_set_storage(other, NULL);
+   bayes_classifier_train(other, "english", "day night");
+   bayes_classifier_train(other, "french", "jour nuit");
+
+   document = bayes_document_new(text, NULL, NULL);
+
+   expected = bayes_classifier_guess(classifier, text);
+   list = bayes_classifier_guess_document(classifier, document);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(list->data));
+   assert_same_guesses(expected, list);
+   free_guesses(expected);
+   free_guesses(list);
+
+   expected = bayes_classifier_guess(other, text);
+   list = bayes_classifier_guess_document(other, document);
+   assert_same_guesses(expected, list);
+   free_guesses(expected);
+   free_guesses(list);
+
+   /*
+    * A classifier with another tokenizer tokenizes the text again.
+    */
+   bayes_classifier_set_tokenizer(other, split_tokenizer, NULL, NULL);
+   list = bayes_classifier_guess_document(other, document);
+   expected = bayes_classifier_guess(other, text);
+   assert_same_guesses(expected, list);
+   free_guesses(expected);
+   free_guesses(list);
+
+   bayes_document_unref(document);
+   g_object_unref(classifier);
+   g_object_unref(other);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Document/tokens", test1);
+   g_test_add_func("/Document/guess", test2);
+
+   return g_test_run();
+}
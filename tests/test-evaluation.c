@@ -0,0 +1,122 @@
+#include <string.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-evaluation.h"
+
+static const gchar *english_words[] = {
+   "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+   "it", "was", "best", "of", "times", "worst", "and", "friends",
+};
+
+static const gchar *spanish_words[] = {
+   "el", "rapido", "zorro", "marron", "salta", "sobre", "perro",
+   "perezoso", "era", "mejor", "de", "los", "tiempos", "peor", "y", "amigos",
+};
+
+static void
+build_corpus (guint    n_docs,
+              gchar ***names,
+              gchar ***texts)
+{
+   const gchar **words;
+   GString *str;
+   GRand *rand;
+   guint i;
+   guint j;
+
+   rand = g_rand_new_with_seed(42);
+   *names = g_new0(gchar *, n_docs + 1);
+   *texts = g_new0(gchar *, n_docs + 1);
+
+   for (i = 0; i < n_docs; i++) {
+      words = (i % 2) ? spanish_words : english_words;
+      str = g_string_new(NULL);
+      for (j = 0; j < 8; j++) {
+         g_string_append_printf(str, "%s ",
+                                words[g_rand_int_range(rand, 0, 16)]);
+      }
+      (*names)[i] = g_strdup((i % 2) ? "spanish" : "english");
+      (*texts)[i] = g_string_free(str, FALSE);
+   }
+
+   g_rand_free(rand);
+}
+
+static void
+test1 (void)
+{
+   BayesClassifier *classifier;
+   BayesEvaluation *evaluation;
+   const gchar * const *class_names;
+   gchar **names;
+   gchar **texts;
+   gchar *report;
+   guint total = 0;
+   guint i;
+   gint j;
+
+   build_corpus(60, &names, &texts);
+   classifier = bayes_classifier_new();
+
+   evaluation = bayes_evaluation_new(classifier,
+                                     (const gchar * const *)names,
+                                     (const gchar * const *)texts, 3);
+   g_assert(evaluation);
+   g_assert_cmpint(bayes_evaluation_get_n_documents(evaluation), ==, 60);
+   g_assert_cmpint(bayes_evaluation_get_n_folds(evaluation), ==, 3);
+   g_assert_cmpint(bayes_evaluation_get_n_classes(evaluation), ==, 2);
+
+   class_names = bayes_evaluation_get_class_names(evaluation);
+   g_assert_cmpstr(class_names[0], ==, "english");
+   g_assert_cmpstr(class_names[1], ==, "spanish");
+   g_assert(!class_names[2]);
+
+   /*
+    * The vocabularies do not overlap, so every guess must be right.
+    */
+   g_assert_cmpfloat(bayes_evaluation_get_accuracy(evaluation), ==, 1.0);
+   g_assert_cmpint(bayes_evaluation_get_confusion(evaluation, 0, 0), ==, 30);
+   g_assert_cmpint(bayes_evaluation_get_confusion(evaluation, 1, 1), ==, 30);
+   for (i = 0; i < 2; i++) {
+      for (j = -1; j < 2; j++) {
+         total += bayes_evaluation_get_confusion(evaluation, i, j);
+      }
+   }
+   g_assert_cmpint(total, ==, 60);
+
+   g_assert_cmpfloat(bayes_evaluation_get_documents_per_second(evaluation), >, 0.0);
+   g_assert_cmpfloat(bayes_evaluation_get_train_seconds(evaluation), >=, 0.0);
+   g_assert_cmpfloat(bayes_evaluation_get_latency(evaluation, 0), <=,
+                     bayes_evaluation_get_latency(evaluation, 50));
+   g_assert_cmpfloat(bayes_evaluation_get_latency(evaluation, 50), <=,
+                     bayes_evaluation_get_latency(evaluation, 99));
+   g_assert_cmpfloat(bayes_evaluation_get_latency(evaluation, 99), <=,
+                     bayes_evaluation_get_latency(evaluation, 100));
+
+   report = bayes_evaluation_to_string(evaluation);
+   g_assert(strstr(report, "accuracy:"));
+   g_assert(strstr(report, "spanish"));
+   g_free(report);
+
+   /*
+    * The classifier being evaluated is left untrained.
+    */
+   g_assert(!bayes_classifier_guess_best(classifier, texts[0]));
+
+   bayes_evaluation_unref(evaluation);
+   g_object_unref(classifier);
+   g_strfreev(names);
+   g_strfreev(texts);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Evaluation/k_fold", test1);
+
+   return g_test_run();
+}
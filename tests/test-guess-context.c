@@ -0,0 +1,154 @@
+#include <math.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-guess-context.h"
+
+static BayesClassifier *
+create_classifier (void)
+{
+   BayesClassifier *classifier;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_train(classifier, "french", "le la les du un une je il elle de en");
+   bayes_classifier_train(classifier, "german", "der die das ein eine");
+   bayes_classifier_train(classifier, "spanish", "el uno una las de la en");
+   bayes_classifier_train(classifier, "english", "the it she he they them are were to");
+
+   return classifier;
+}
+
+static void
+test1 (void)
+{
+   BayesClassifier *classifier;
+   BayesGuessContext *context;
+   BayesGuess *guess;
+   GList *list;
+
+   classifier = create_classifier();
+   context = bayes_guess_context_new(classifier);
+
+   g_assert(!bayes_guess_context_get_best(context));
+
+   bayes_guess_context_feed(context, "they were");
+   bayes_guess_context_feed(context, "");
+   bayes_guess_context_feed(context, "flying planes");
+   g_assert_cmpint(4, ==, bayes_guess_context_get_n_tokens(context));
+
+   /*
+    * Feeding the text in chunks must agree with guessing it at once.
+    */
+   list = bayes_classifier_guess(classifier, "they were flying planes");
+   guess = bayes_guess_context_get_best(context);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(guess));
+   g_assert_cmpstr(bayes_guess_get_name(list->data), ==, bayes_guess_get_name(guess));
+   g_assert_cmpfloat(fabs(bayes_guess_get_probability(list->data) -
+                          bayes_guess_get_probability(guess)), <, 1e-12);
+   bayes_guess_unref(guess);
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+
+   bayes_guess_context_reset(context);
+   g_assert_cmpint(0, ==, bayes_guess_context_get_n_tokens(context));
+   g_assert(!bayes_guess_context_get_best(context));
+
+   bayes_guess_context_feed(context, "der die das");
+   guess = bayes_guess_context_get_best(context);
+   g_assert_cmpstr("german", ==, bayes_guess_get_name(guess));
+   bayes_guess_unref(guess);
+
+   g_object_unref(context);
+   g_object_unref(classifier);
+}
+
+static void
+confident_cb (BayesGuessContext *context,
+              gpointer           user_data)
+{
+   (*(guint *)user_data)++;
+}
+
+static void
+test2 (void)
+{
+   BayesClassifier *classifier;
+   BayesGuessContext *context;
+   guint n_confident = 0;
+
+   classifier = create_classifier();
+   bayes_classifier_set_combiner(classifier, bayes_combiner_fisher, NULL, NULL);
+   context = bayes_guess_context_new(classifier);
+   bayes_guess_context_set_threshold(context, 0.9);
+   g_signal_connect(context, "confident", G_CALLBACK(confident_cb), &n_confident);
+
+   g_assert(!bayes_guess_context_feed(context, "planes"));
+   g_assert_cmpint(0, ==, n_confident);
+
+   while (!bayes_guess_context_feed(context, "der die das ein eine")) {
+      g_assert_cmpint(bayes_guess_context_get_n_tokens(context), <, 1000);
+   }
+   g_assert_cmpint(1, ==, n_confident);
+   g_assert(bayes_guess_context_is_confident(context));
+
+   /*
+    * The signal is only emitted the first time.
+    */
+   g_assert(bayes_guess_context_feed(context, "der"));
+   g_assert_cmpint(1, ==, n_confident);
+
+   g_object_unref(context);
+   g_object_unref(classifier);
+}
+
+static void
+test3 (void)
+{
+   BayesClassifier *classifier;
+   BayesClassifier *other;
+   BayesGuessContext *context;
+   BayesGuess *guess;
+   GList *list;
+
+   classifier = create_classifier();
+   context = bayes_guess_context_new(classifier);
+   bayes_guess_context_feed(context, "der die das ein eine");
+
+   /*
+    * The new storage has fewer classes in another order. Only the text
+    * fed after the swap may count.
+    */
+   other = bayes_classifier_new();
+   bayes_classifier_train(other, "english", "the quick brown fox");
+   bayes_classifier_train(other, "german", "der fuchs");
+   bayes_classifier_set_storage(classifier, bayes_classifier_get_storage(other));
+   g_object_unref(other);
+
+   bayes_guess_context_feed(context, "the fox");
+   g_assert_cmpint(2, ==, bayes_guess_context_get_n_tokens(context));
+
+   guess = bayes_guess_context_get_best(context);
+   g_assert_cmpstr("english", ==, bayes_guess_get_name(guess));
+   bayes_guess_unref(guess);
+
+   list = bayes_guess_context_get_guesses(context);
+   g_assert_cmpint(2, ==, g_list_length(list));
+   g_list_foreach(list, (GFunc)bayes_guess_unref, NULL);
+   g_list_free(list);
+
+   g_object_unref(context);
+   g_object_unref(classifier);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/GuessContext/feed", test1);
+   g_test_add_func("/GuessContext/confident", test2);
+   g_test_add_func("/GuessContext/swap_storage", test3);
+
+   return g_test_run();
+}
@@ -0,0 +1,306 @@
+#include <glib/gstdio.h>
+#include <math.h>
+#include <unistd.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-storage-compact.h"
+#include "bayes-glib/bayes-storage-memory.h"
+
+#define N_CLASSES  8
+#define N_WORDS    2000
+#define ALIGN16(n) (((n) + 15) & ~(gsize)15)
+
+/*
+ * Trains @classifier with a deterministic corpus in which each class
+ * prefers its own slice of the vocabulary.
+ */
+static void
+train_corpus (BayesClassifier *classifier,
+              guint            n_documents)
+{
+   GString *text;
+   GRand *rand;
+   gchar name[16];
+   guint class_id;
+   guint i;
+   guint j;
+
+   rand = g_rand_new_with_seed(42);
+   text = g_string_new(NULL);
+
+   for (i = 0; i < n_documents; i++) {
+      class_id = i % N_CLASSES;
+      g_string_truncate(text, 0);
+      for (j = 0; j < 20; j++) {
+         if (g_rand_int_range(rand, 0, 3)) {
+            g_string_append_printf(text, "w%u ",
+                                   class_id * (N_WORDS / N_CLASSES) +
+                                   g_rand_int_range(rand, 0, N_WORDS / N_CLASSES));
+         } else {
+            g_string_append_printf(text, "w%u ",
+                                   g_rand_int_range(rand, 0, N_WORDS));
+         }
+      }
+      g_snprintf(name, sizeof name, "class%u", class_id);
+      bayes_classifier_train(classifier, name, text->str);
+   }
+
+   g_string_free(text, TRUE);
+   g_rand_free(rand);
+}
+
+static gdouble
+not_naive (const gdouble *probabilities,
+           guint          n_probabilities,
+           gpointer       user_data)
+{
+   return bayes_combiner_naive(probabilities, n_probabilities, user_data);
+}
+
+static void
+check_accuracy (guint   bits,
+                gdouble max_error)
+{
+   BayesClassifier *classifier;
+   BayesStorage *compact;
+   BayesStorage *memory;
+   gdouble error = 0.0;
+   gdouble p;
+   gdouble q;
+   gchar word[16];
+   guint i;
+   guint j;
+
+   classifier = bayes_classifier_new();
+   train_corpus(classifier, 400);
+   memory = bayes_classifier_get_storage(classifier);
+
+   compact = bayes_storage_compact_new(memory, bits, NULL);
+   g_assert(compact);
+   g_assert_cmpint(bayes_storage_compact_get_bits(BAYES_STORAGE_COMPACT(compact)), ==, bits);
+
+   for (i = 0; i < N_WORDS; i++) {
+      g_snprintf(word, sizeof word, "w%u", i);
+      for (j = 0; j < N_CLASSES; j++) {
+         p = bayes_storage_get_class_token_probability(memory, j, word);
+         q = bayes_storage_get_class_token_probability(compact, j, word);
+         g_assert_cmpint(p == 0.0, ==, q == 0.0);
+         error = MAX(error, fabs(p - q));
+      }
+   }
+
+   g_test_message("%u bits: largest probability error %g", bits, error);
+   g_assert_cmpfloat(error, <=, max_error);
+   g_assert_cmpfloat(bayes_storage_get_class_token_probability(compact, 0, "unknown"), ==, 0.0);
+
+   g_object_unref(compact);
+   g_object_unref(classifier);
+}
+
+static void
+test1 (void)
+{
+   check_accuracy(8, 0.0091);
+   check_accuracy(16, 0.000036);
+}
+
+static void
+test2 (void)
+{
+   static const gchar *text = "w1 w2 w300 w301 w302 w999 w1500 unknown";
+   BayesStorageFootprint footprint;
+   BayesStorageFootprint memory;
+   BayesClassifier *classifier;
+   BayesStorage *compact;
+   BayesGuess *fast;
+   BayesGuess *slow;
+   GList *list;
+
+   classifier = bayes_classifier_new();
+   train_corpus(classifier, 400);
+   compact = bayes_storage_compact_new(bayes_classifier_get_storage(classifier), 8, NULL);
+
+   g_assert(bayes_storage_get_footprint(bayes_classifier_get_storage(classifier), &memory));
+   g_assert(bayes_storage_get_footprint(compact, &footprint));
+   g_assert_cmpint(footprint.n_tokens, ==, memory.n_tokens);
+   g_assert_cmpint(footprint.value_bytes, <, memory.value_bytes);
+   g_assert_cmpfloat(footprint.load_factor, <=, 0.5);
+   g_assert(!bayes_storage_get_class_footprint(compact, 0, NULL, NULL));
+
+   bayes_classifier_set_storage(classifier, compact);
+
+   /*
+    * The integer accumulation used for bayes_combiner_naive() agrees with
+    * combining the dequantized probabilities.
+    */
+   bayes_classifier_set_combiner(classifier, bayes_combiner_naive, NULL, NULL);
+   list = bayes_classifier_guess(classifier, text);
+   fast = bayes_guess_ref(list->data);
+   g_list_free_full(list, (GDestroyNotify)bayes_guess_unref);
+
+   bayes_classifier_set_combiner(classifier, not_naive, NULL, NULL);
+   list = bayes_classifier_guess(classifier, text);
+   slow = bayes_guess_ref(list->data);
+   g_list_free_full(list, (GDestroyNotify)bayes_guess_unref);
+
+   g_assert_cmpstr(bayes_guess_get_name(fast), ==, bayes_guess_get_name(slow));
+   g_assert_cmpfloat(fabs(bayes_guess_get_probability(fast) -
+                          bayes_guess_get_probability(slow)), <, 1e-6);
+
+   bayes_guess_unref(fast);
+   bayes_guess_unref(slow);
+   g_object_unref(compact);
+   g_object_unref(classifier);
+}
+
+static void
+test3 (void)
+{
+   BayesClassifier *classifier;
+   BayesStorage *compact;
+   BayesStorage *loaded;
+   GError *error = NULL;
+   guint32 *header;
+   guint64 *keys;
+   gchar *contents;
+   gchar *filename;
+   gchar word[16];
+   gsize length;
+   gint fd;
+   guint i;
+
+   classifier = bayes_classifier_new();
+   train_corpus(classifier, 100);
+   compact = bayes_storage_compact_new(bayes_classifier_get_storage(classifier), 16, NULL);
+
+   fd = g_file_open_tmp("test-storage-compact-XXXXXX", &filename, &error);
+   g_assert_no_error(error);
+   close(fd);
+
+   g_assert(bayes_storage_compact_save(BAYES_STORAGE_COMPACT(compact), filename, &error));
+   g_assert_no_error(error);
+
+   loaded = bayes_storage_compact_new_from_file(filename, &error);
+   g_assert_no_error(error);
+   g_assert(loaded);
+   g_assert_cmpstr(bayes_storage_get_classes(loaded, NULL)[3], ==, "class3");
+   g_assert_cmpint(bayes_storage_lookup_class(loaded, "class5"), ==, 5);
+   for (i = 0; i < N_WORDS; i++) {
+      g_snprintf(word, sizeof word, "w%u", i);
+      g_assert_cmpfloat(bayes_storage_get_class_token_probability(loaded, 2, word), ==,
+                        bayes_storage_get_class_token_probability(compact, 2, word));
+      g_snprintf(word, sizeof word, "x%u", i);
+      g_assert_cmpfloat(bayes_storage_get_class_token_probability(loaded, 2, word), ==, 0.0);
+   }
+   g_object_unref(loaded);
+
+   /*
+    * Fill every empty slot of the key table, which would leave lookups of
+    * unknown tokens probing forever. The offsets follow the file layout
+    * of bayes-storage-compact.c.
+    */
+   g_assert(g_file_get_contents(filename, &contents, &length, NULL));
+   header = (guint32 *)(contents + 8);
+   keys = (guint64 *)(contents +
+                      ALIGN16(ALIGN16(48 + header[6]) +
+                              sizeof(gdouble) * header[3]));
+   for (i = 0; i < header[5]; i++) {
+      if (!keys[i]) {
+         keys[i] = i + 1;
+      }
+   }
+   g_assert(g_file_set_contents(filename, contents, length, NULL));
+   g_free(contents);
+   g_assert(!bayes_storage_compact_new_from_file(filename, &error));
+   g_assert_error(error, BAYES_STORAGE_COMPACT_ERROR, BAYES_STORAGE_COMPACT_ERROR_INVALID);
+   g_clear_error(&error);
+
+   g_assert(g_file_set_contents(filename, "BAYESQNT", -1, NULL));
+   g_assert(!bayes_storage_compact_new_from_file(filename, &error));
+   g_assert_error(error, BAYES_STORAGE_COMPACT_ERROR, BAYES_STORAGE_COMPACT_ERROR_INVALID);
+   g_clear_error(&error);
+
+   g_unlink(filename);
+   g_free(filename);
+   g_object_unref(compact);
+   g_object_unref(classifier);
+}
+
+static gdouble
+time_guesses (BayesClassifier *classifier)
+{
+   GTimer *timer;
+   GList *list;
+   gdouble elapsed;
+   gchar text[64];
+   guint i;
+
+   timer = g_timer_new();
+
+   for (i = 0; i < 20000; i++) {
+      g_snprintf(text, sizeof text, "w%u w%u w%u w%u w%u w%u",
+                 i % N_WORDS, (i * 7) % N_WORDS, (i * 13) % N_WORDS,
+                 (i * 31) % N_WORDS, (i * 61) % N_WORDS, (i * 97) % N_WORDS);
+      list = bayes_classifier_guess(classifier, text);
+      g_list_free_full(list, (GDestroyNotify)bayes_guess_unref);
+   }
+
+   g_timer_stop(timer);
+   elapsed = g_timer_elapsed(timer, NULL);
+   g_timer_destroy(timer);
+
+   return elapsed;
+}
+
+static void
+test4 (void)
+{
+   BayesClassifier *classifier;
+   BayesStorage *memory;
+   BayesStorage *compact;
+   gdouble elapsed;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_combiner(classifier, bayes_combiner_naive, NULL, NULL);
+   train_corpus(classifier, 2000);
+   memory = g_object_ref(bayes_classifier_get_storage(classifier));
+
+   elapsed = time_guesses(classifier);
+   g_test_minimized_result(elapsed, "memory: %.3f seconds", elapsed);
+
+   compact = bayes_storage_compact_new(memory, 8, NULL);
+   bayes_classifier_set_storage(classifier, compact);
+   elapsed = time_guesses(classifier);
+   g_test_minimized_result(elapsed, "compact 8 bit: %.3f seconds, %u bytes per token",
+                           elapsed, (guint)bayes_storage_compact_get_bytes_per_token(
+                              BAYES_STORAGE_COMPACT(compact)));
+   g_object_unref(compact);
+
+   compact = bayes_storage_compact_new(memory, 16, NULL);
+   bayes_classifier_set_storage(classifier, compact);
+   elapsed = time_guesses(classifier);
+   g_test_minimized_result(elapsed, "compact 16 bit: %.3f seconds, %u bytes per token",
+                           elapsed, (guint)bayes_storage_compact_get_bytes_per_token(
+                              BAYES_STORAGE_COMPACT(compact)));
+   g_object_unref(compact);
+
+   g_object_unref(memory);
+   g_object_unref(classifier);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Storage/Compact/accuracy", test1);
+   g_test_add_func("/Storage/Compact/naive", test2);
+   g_test_add_func("/Storage/Compact/file", test3);
+   if (g_test_perf()) {
+      g_test_add_func("/Storage/Compact/perf", test4);
+   }
+
+   return g_test_run();
+}
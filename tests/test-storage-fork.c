@@ -0,0 +1,158 @@
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-storage-fork.h"
+#include "bayes-glib/bayes-storage-memory.h"
+
+static const gchar *base_docs[][2] = {
+   { "english", "the quick brown fox jumps over the lazy dog" },
+   { "english", "it was the best of times it was the worst of times" },
+   { "spanish", "el rapido zorro marron salta sobre el perro perezoso" },
+   { "spanish", "era el mejor de los tiempos era el peor de los tiempos" },
+};
+
+static const gchar *tenant_docs[][2] = {
+   { "english", "the fox and the dog were friends" },
+   { "spanish", "el zorro y el perro eran amigos" },
+   { "french", "le renard et le chien etaient amis" },
+};
+
+static void
+train (BayesStorage  *storage,
+       const gchar  *(*docs)[2],
+       guint          n_docs)
+{
+   BayesClassifier *classifier;
+   guint i;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_storage(classifier, storage);
+   for (i = 0; i < n_docs; i++) {
+      bayes_classifier_train(classifier, docs[i][0], docs[i][1]);
+   }
+   g_object_unref(classifier);
+}
+
+static void
+test1 (void)
+{
+   BayesStorage *parent;
+   BayesStorage *fork;
+   BayesStorage *copy;
+   gchar **words;
+   guint parent_count;
+   guint i;
+   guint j;
+
+   parent = bayes_storage_memory_new();
+   train(parent, base_docs, G_N_ELEMENTS(base_docs));
+   parent_count = bayes_storage_get_token_count(parent, "english", NULL);
+
+   fork = bayes_storage_fork(parent);
+   g_assert(BAYES_IS_STORAGE_FORK(fork));
+   g_assert(bayes_storage_fork_get_parent(BAYES_STORAGE_FORK(fork)) == parent);
+   train(fork, tenant_docs, G_N_ELEMENTS(tenant_docs));
+
+   /*
+    * The fork must behave as if both had been trained into one storage.
+    */
+   copy = bayes_storage_memory_new();
+   train(copy, base_docs, G_N_ELEMENTS(base_docs));
+   train(copy, tenant_docs, G_N_ELEMENTS(tenant_docs));
+
+   g_assert_cmpint(bayes_storage_lookup_class(fork, "english"), ==, 0);
+   g_assert_cmpint(bayes_storage_lookup_class(fork, "spanish"), ==, 1);
+   g_assert_cmpint(bayes_storage_lookup_class(fork, "french"), ==, 2);
+   g_assert_cmpint(bayes_storage_lookup_class(parent, "french"), ==, -1);
+
+   for (i = 0; i < G_N_ELEMENTS(base_docs) + G_N_ELEMENTS(tenant_docs); i++) {
+      if (i < G_N_ELEMENTS(base_docs)) {
+         words = g_strsplit(base_docs[i][1], " ", 0);
+      } else {
+         words = g_strsplit(tenant_docs[i - G_N_ELEMENTS(base_docs)][1], " ", 0);
+      }
+      for (j = 0; words[j]; j++) {
+         g_assert_cmpint(bayes_storage_get_token_count(fork, NULL, words[j]), ==,
+                         bayes_storage_get_token_count(copy, NULL, words[j]));
+         g_assert_cmpint(bayes_storage_get_token_count(fork, "spanish", words[j]), ==,
+                         bayes_storage_get_token_count(copy, "spanish", words[j]));
+         g_assert_cmpfloat(bayes_storage_get_token_probability(fork, "english", words[j]), ==,
+                           bayes_storage_get_token_probability(copy, "english", words[j]));
+         g_assert_cmpfloat(bayes_storage_get_token_probability(fork, "french", words[j]), ==,
+                           bayes_storage_get_token_probability(copy, "french", words[j]));
+      }
+      g_strfreev(words);
+   }
+
+   g_assert_cmpint(bayes_storage_get_token_count(fork, "english", NULL), ==,
+                   bayes_storage_get_token_count(copy, "english", NULL));
+
+   /*
+    * The parent is left untouched.
+    */
+   g_assert_cmpint(bayes_storage_get_token_count(parent, "english", NULL), ==, parent_count);
+   g_assert_cmpint(bayes_storage_get_token_count(parent, NULL, "friends"), ==, 0);
+
+   g_object_unref(copy);
+   g_object_unref(fork);
+   g_object_unref(parent);
+}
+
+static void
+count_token (const gchar *token,
+             gpointer     user_data)
+{
+   (*(guint *)user_data)++;
+}
+
+static void
+test2 (void)
+{
+   BayesStorageFootprint parent_footprint;
+   BayesStorageFootprint footprint;
+   BayesStorage *parent;
+   BayesStorage *fork;
+   gchar token[32];
+   guint n_tokens = 0;
+   guint i;
+
+   parent = bayes_storage_memory_new();
+   for (i = 0; i < 10000; i++) {
+      g_snprintf(token, sizeof token, "base%u", i);
+      bayes_storage_add_token(parent, "english", token);
+   }
+
+   fork = bayes_storage_fork(parent);
+   bayes_storage_add_token(fork, "english", "base1");
+   bayes_storage_add_token(fork, "english", "tenant");
+
+   g_assert(bayes_storage_foreach_token(fork, count_token, &n_tokens));
+   g_assert_cmpint(n_tokens, ==, 10001);
+
+   /*
+    * A fork only pays for its own training.
+    */
+   g_assert(bayes_storage_get_footprint(parent, &parent_footprint));
+   g_assert(bayes_storage_get_footprint(fork, &footprint));
+   g_assert_cmpint(footprint.n_tokens, ==, 2);
+   g_assert_cmpint(footprint.key_bytes, <, parent_footprint.key_bytes / 100);
+   g_assert_cmpint(footprint.value_bytes, <, parent_footprint.value_bytes / 100);
+
+   g_assert_cmpint(bayes_storage_get_token_count(fork, "english", "base1"), ==, 2);
+   g_assert_cmpint(bayes_storage_get_generation(fork), >,
+                   bayes_storage_get_generation(parent));
+
+   g_object_unref(fork);
+   g_object_unref(parent);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Storage/Fork/counts", test1);
+   g_test_add_func("/Storage/Fork/footprint", test2);
+
+   return g_test_run();
+}
@@ -1,3 +1,6 @@
+#include <glib/gstdio.h>
+#include <unistd.h>
+
 #include "bayes-glib/bayes-storage.h"
 #include "bayes-glib/bayes-storage-memory.h"
 
@@ -17,6 +20,230 @@ test1 (void)
    g_object_unref(storage);
 }
 
+static void
+test2 (void)
+{
+   const gchar * const *classes;
+   BayesStorage *storage;
+   guint n_classes;
+   gint english;
+   gint french;
+
+   storage = bayes_storage_memory_new();
+   bayes_storage_add_token(storage, "english", "the");
+   bayes_storage_add_token(storage, "french", "le");
+   bayes_storage_add_token(storage, "english", "they");
+
+   english = bayes_storage_lookup_class(storage, "english");
+   french = bayes_storage_lookup_class(storage, "french");
+   g_assert_cmpint(0, ==, english);
+   g_assert_cmpint(1, ==, french);
+   g_assert_cmpint(-1, ==, bayes_storage_lookup_class(storage, "german"));
+
+   classes = bayes_storage_get_classes(storage, &n_classes);
+   g_assert_cmpint(2, ==, n_classes);
+   g_assert_cmpstr("english", ==, classes[english]);
+   g_assert_cmpstr("french", ==, classes[french]);
+   g_assert(!classes[2]);
+
+   g_assert_cmpint(1, ==, bayes_storage_get_class_token_count(storage, english, "the"));
+   g_assert_cmpint(0, ==, bayes_storage_get_class_token_count(storage, french, "the"));
+   g_assert_cmpint(2, ==, bayes_storage_get_class_token_count(storage, english, NULL));
+   g_assert_cmpfloat(bayes_storage_get_class_token_probability(storage, french, "le"), ==,
+                     bayes_storage_get_token_probability(storage, "french", "le"));
+
+   /*
+    * Adding a class must not change the identifiers of existing ones.
+    */
+   bayes_storage_add_token(storage, "german", "der");
+   g_assert_cmpint(english, ==, bayes_storage_lookup_class(storage, "english"));
+   g_assert_cmpint(french, ==, bayes_storage_lookup_class(storage, "french"));
+   g_assert_cmpint(2, ==, bayes_storage_lookup_class(storage, "german"));
+   g_assert_cmpint(1, ==, bayes_storage_get_token_count(storage, "german", "der"));
+
+   g_object_unref(storage);
+}
+
+static void
+test3 (void)
+{
+   BayesStorageFootprint before;
+   BayesStorageFootprint after;
+   BayesStorage *storage;
+   gchar token[16];
+   gsize n_bytes;
+   guint n_tokens;
+   guint i;
+
+   storage = bayes_storage_memory_new();
+   g_assert(bayes_storage_get_footprint(storage, &before));
+   g_assert_cmpint(before.n_tokens, ==, 0);
+   g_assert_cmpint(before.key_bytes, ==, 0);
+   g_assert_cmpint(before.n_buckets, >, 0);
+
+   bayes_storage_add_token(storage, "english", "the");
+   bayes_storage_add_token(storage, "english", "the");
+   bayes_storage_add_token(storage, "english", "it");
+   bayes_storage_add_token(storage, "french", "le");
+
+   g_assert(bayes_storage_get_footprint(storage, &after));
+   g_assert_cmpint(after.n_tokens, ==, 3);
+   g_assert_cmpint(after.key_bytes, ==, sizeof "the" + sizeof "it" + sizeof "le");
+   g_assert_cmpint(after.value_bytes, >, 0);
+   g_assert_cmpint(after.class_bytes, >, before.class_bytes);
+   g_assert_cmpfloat(after.load_factor, ==, 3.0 / after.n_buckets);
+
+   /*
+    * "the" and "it" were counted before "french" existed, so only "le"
+    * has room for a french count.
+    */
+   g_assert(bayes_storage_get_class_footprint(storage, 0, &n_tokens, &n_bytes));
+   g_assert_cmpint(n_tokens, ==, 2);
+   g_assert_cmpint(n_bytes, ==, 3 * sizeof(guint));
+   g_assert(bayes_storage_get_class_footprint(storage, 1, &n_tokens, &n_bytes));
+   g_assert_cmpint(n_tokens, ==, 1);
+   g_assert_cmpint(n_bytes, ==, 1 * sizeof(guint));
+   g_assert(bayes_storage_get_class_footprint(storage, 2, &n_tokens, &n_bytes));
+   g_assert_cmpint(n_tokens, ==, 0);
+   g_assert_cmpint(n_bytes, ==, 0);
+
+   /*
+    * The table must keep growing to hold the tokens.
+    */
+   for (i = 0; i < 10000; i++) {
+      g_snprintf(token, sizeof token, "t%u", i);
+      bayes_storage_add_token(storage, "english", token);
+   }
+   g_assert(bayes_storage_get_footprint(storage, &after));
+   g_assert_cmpint(after.n_tokens, ==, 10003);
+   g_assert_cmpint(after.n_buckets, >=, after.n_tokens);
+   g_assert_cmpfloat(after.load_factor, >, 0.25);
+   g_assert_cmpfloat(after.load_factor, <=, 1.0);
+
+   g_object_unref(storage);
+}
+
+static void
+test4 (void)
+{
+   BayesStorage *storage;
+   gchar token[32];
+   guint i;
+
+   /*
+    * Enough tokens that the vocabulary filter has to be rebuilt.
+    */
+   storage = bayes_storage_memory_new();
+   for (i = 0; i < 5000; i++) {
+      g_snprintf(token, sizeof token, "known%u", i);
+      bayes_storage_add_token(storage, "english", token);
+   }
+   for (i = 0; i < 5000; i++) {
+      g_snprintf(token, sizeof token, "known%u", i);
+      g_assert_cmpint(1, ==, bayes_storage_get_token_count(storage, NULL, token));
+      g_snprintf(token, sizeof token, "unknown%u", i);
+      g_assert_cmpint(0, ==, bayes_storage_get_token_count(storage, NULL, token));
+      g_assert_cmpfloat(0.0, ==, bayes_storage_get_token_probability(storage, "english", token));
+   }
+   g_object_unref(storage);
+}
+
+static void
+assert_same_counts (BayesStorage *a,
+                    BayesStorage *b,
+                    const gchar  *token)
+{
+   g_assert_cmpint(bayes_storage_get_token_count(a, NULL, token), ==,
+                   bayes_storage_get_token_count(b, NULL, token));
+   g_assert_cmpint(bayes_storage_get_token_count(a, "english", token), ==,
+                   bayes_storage_get_token_count(b, "english", token));
+   g_assert_cmpint(bayes_storage_get_token_count(a, "spanish", token), ==,
+                   bayes_storage_get_token_count(b, "spanish", token));
+}
+
+static void
+test5 (void)
+{
+   BayesStorage *primary;
+   BayesStorage *replica;
+   GError *error = NULL;
+   GBytes *delta;
+   GBytes *truncated;
+   gchar *filename;
+   gchar *contents;
+   gchar token[32];
+   guint64 generation;
+   gsize length;
+   gint fd;
+   guint i;
+
+   primary = bayes_storage_memory_new();
+   replica = bayes_storage_memory_new();
+
+   bayes_storage_memory_checkpoint(BAYES_STORAGE_MEMORY(primary));
+   for (i = 0; i < 1000; i++) {
+      g_snprintf(token, sizeof token, "token%u", i);
+      bayes_storage_add_token_count(primary, (i % 3) ? "english" : "spanish", token, i % 7 + 1);
+   }
+   bayes_storage_add_token_count(primary, "english", "token1", 300);
+
+   /*
+    * Ship the delta through a file, as a replica in another process would.
+    */
+   delta = bayes_storage_memory_export_delta(BAYES_STORAGE_MEMORY(primary));
+   fd = g_file_open_tmp("test-storage-memory-XXXXXX", &filename, &error);
+   g_assert_no_error(error);
+   close(fd);
+   g_assert(g_file_set_contents(filename, g_bytes_get_data(delta, NULL),
+                                g_bytes_get_size(delta), &error));
+   g_assert_no_error(error);
+   g_bytes_unref(delta);
+
+   g_assert(g_file_get_contents(filename, &contents, &length, &error));
+   g_assert_no_error(error);
+   delta = g_bytes_new_take(contents, length);
+   g_assert(bayes_storage_import_delta(replica, delta, &error));
+   g_assert_no_error(error);
+   g_bytes_unref(delta);
+
+   for (i = 0; i < 1000; i++) {
+      g_snprintf(token, sizeof token, "token%u", i);
+      assert_same_counts(primary, replica, token);
+   }
+   g_assert_cmpint(bayes_storage_get_token_count(replica, "english", "token1"), ==, 302);
+
+   /*
+    * The next delta only holds what changed since the checkpoint.
+    */
+   bayes_storage_memory_checkpoint(BAYES_STORAGE_MEMORY(primary));
+   bayes_storage_add_token(primary, "spanish", "token5");
+   bayes_storage_add_token(primary, "english", "novel");
+   delta = bayes_storage_memory_export_delta(BAYES_STORAGE_MEMORY(primary));
+   g_assert_cmpint(g_bytes_get_size(delta), <, 64);
+
+   truncated = g_bytes_new_from_bytes(delta, 0, g_bytes_get_size(delta) - 1);
+   generation = bayes_storage_get_generation(replica);
+   g_assert(!bayes_storage_import_delta(replica, truncated, &error));
+   g_assert_error(error, BAYES_STORAGE_ERROR, BAYES_STORAGE_ERROR_INVALID);
+   g_clear_error(&error);
+   g_assert_cmpint(bayes_storage_get_generation(replica), ==, generation);
+   g_bytes_unref(truncated);
+
+   g_assert(bayes_storage_import_delta(replica, delta, &error));
+   g_assert_no_error(error);
+   g_bytes_unref(delta);
+
+   assert_same_counts(primary, replica, "token5");
+   assert_same_counts(primary, replica, "novel");
+   g_assert_cmpint(bayes_storage_get_token_count(replica, "english", NULL), ==,
+                   bayes_storage_get_token_count(primary, "english", NULL));
+
+   g_unlink(filename);
+   g_free(filename);
+   g_object_unref(replica);
+   g_object_unref(primary);
+}
+
 gint
 main (gint   argc,
       gchar *argv[])
@@ -25,6 +252,10 @@ main (gint   argc,
    g_type_init();
 
    g_test_add_func("/Storage/Memory/basic_tests", test1);
+   g_test_add_func("/Storage/Memory/class_ids", test2);
+   g_test_add_func("/Storage/Memory/footprint", test3);
+   g_test_add_func("/Storage/Memory/vocabulary", test4);
+   g_test_add_func("/Storage/Memory/delta", test5);
 
    return g_test_run();
 }
@@ -0,0 +1,245 @@
+#include <glib/gstdio.h>
+#include <unistd.h>
+
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-storage-memory.h"
+#include "bayes-glib/bayes-storage-sqlite.h"
+
+static const gchar *docs[][2] = {
+   { "english", "the quick brown fox jumps over the lazy dog" },
+   { "english", "it was the best of times it was the worst of times" },
+   { "spanish", "el rapido zorro marron salta sobre el perro perezoso" },
+   { "spanish", "era el mejor de los tiempos era el peor de los tiempos" },
+   { "french", "le renard brun rapide saute par dessus le chien paresseux" },
+   { "german", "der schnelle braune fuchs springt uber den faulen hund" },
+};
+
+static gchar *
+new_filename (void)
+{
+   GError *error = NULL;
+   gchar *filename;
+   gint fd;
+
+   fd = g_file_open_tmp("test-storage-sqlite-XXXXXX", &filename, &error);
+   g_assert_no_error(error);
+   close(fd);
+
+   return filename;
+}
+
+static void
+remove_database (gchar *filename)
+{
+   gchar *path;
+
+   path = g_strdup_printf("%s-wal", filename);
+   g_unlink(path);
+   g_free(path);
+   path = g_strdup_printf("%s-shm", filename);
+   g_unlink(path);
+   g_free(path);
+   g_unlink(filename);
+   g_free(filename);
+}
+
+static BayesStorage *
+open_database (const gchar *filename)
+{
+   BayesStorage *storage;
+   GError *error = NULL;
+
+   storage = bayes_storage_sqlite_new(filename, &error);
+   g_assert_no_error(error);
+   g_assert(BAYES_IS_STORAGE_SQLITE(storage));
+
+   return storage;
+}
+
+static void
+train (BayesStorage *storage,
+       guint         n_docs)
+{
+   BayesClassifier *classifier;
+   guint i;
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_storage(classifier, storage);
+   for (i = 0; i < n_docs; i++) {
+      bayes_classifier_train(classifier, docs[i][0], docs[i][1]);
+   }
+   g_object_unref(classifier);
+}
+
+static void
+assert_same_counts (BayesStorage *storage,
+                    BayesStorage *expected)
+{
+   gchar **words;
+   guint n_classes;
+   guint i;
+   guint j;
+
+   bayes_storage_get_classes(expected, &n_classes);
+   for (i = 0; i < G_N_ELEMENTS(docs); i++) {
+      words = g_strsplit(docs[i][1], " ", 0);
+      for (j = 0; words[j]; j++) {
+         g_assert_cmpint(bayes_storage_get_token_count(storage, docs[i][0], words[j]), ==,
+                         bayes_storage_get_token_count(expected, docs[i][0], words[j]));
+         g_assert_cmpint(bayes_storage_get_token_count(storage, NULL, words[j]), ==,
+                         bayes_storage_get_token_count(expected, NULL, words[j]));
+         g_assert_cmpfloat(bayes_storage_get_class_token_probability(storage, i % n_classes, words[j]), ==,
+                           bayes_storage_get_class_token_probability(expected, i % n_classes, words[j]));
+      }
+      g_strfreev(words);
+   }
+}
+
+static void
+test1 (void)
+{
+   BayesStorage *storage;
+   BayesStorage *memory;
+   GError *error = NULL;
+   gchar *filename;
+
+   filename = new_filename();
+
+   storage = open_database(filename);
+   train(storage, G_N_ELEMENTS(docs));
+   memory = bayes_storage_memory_new();
+   train(memory, G_N_ELEMENTS(docs));
+   assert_same_counts(storage, memory);
+   g_object_unref(storage);
+
+   /*
+    * Everything is committed when the storage is released.
+    */
+   storage = open_database(filename);
+   g_assert_cmpint(bayes_storage_lookup_class(storage, "french"), ==, 2);
+   g_assert_cmpstr(bayes_storage_get_classes(storage, NULL)[3], ==, "german");
+   assert_same_counts(storage, memory);
+   g_object_unref(storage);
+
+   g_assert(g_file_set_contents(filename, "BAYESQNT", -1, NULL));
+   g_assert(!bayes_storage_sqlite_new(filename, &error));
+   g_assert_error(error, BAYES_STORAGE_SQLITE_ERROR, BAYES_STORAGE_SQLITE_ERROR_INVALID);
+   g_clear_error(&error);
+
+   g_object_unref(memory);
+   remove_database(filename);
+}
+
+static void
+test2 (void)
+{
+   BayesStorage *storage;
+   BayesStorage *reader;
+   GError *error = NULL;
+   gchar *filename;
+
+   filename = new_filename();
+   storage = open_database(filename);
+   bayes_storage_sqlite_set_batch_size(BAYES_STORAGE_SQLITE(storage), 3);
+
+   /*
+    * Only the first three documents are committed, so another connection
+    * does not see the fourth.
+    */
+   train(storage, 4);
+   reader = open_database(filename);
+   g_assert_cmpint(bayes_storage_lookup_class(reader, "english"), ==, 0);
+   g_assert_cmpint(bayes_storage_lookup_class(reader, "spanish"), ==, 1);
+   g_assert_cmpint(bayes_storage_get_token_count(reader, "spanish", "rapido"), ==, 1);
+   g_assert_cmpint(bayes_storage_get_token_count(reader, "spanish", "mejor"), ==, 0);
+   g_object_unref(reader);
+
+   g_assert(bayes_storage_sqlite_sync(BAYES_STORAGE_SQLITE(storage), &error));
+   g_assert_no_error(error);
+   reader = open_database(filename);
+   g_assert_cmpint(bayes_storage_get_token_count(reader, "spanish", "mejor"), ==, 1);
+   g_object_unref(reader);
+
+   g_object_unref(storage);
+   remove_database(filename);
+}
+
+static void
+test3 (void)
+{
+   BayesClassifier *classifier;
+   BayesClassifier *expected;
+   BayesStorage *storage;
+   GList *guesses;
+   GList *iter;
+   GList *iter2;
+   GList *other;
+   gchar *filename;
+   guint64 hits;
+   guint64 misses;
+   guint64 queries;
+   guint64 before;
+   guint i;
+
+   filename = new_filename();
+   storage = open_database(filename);
+   train(storage, G_N_ELEMENTS(docs));
+   g_object_unref(storage);
+
+   storage = open_database(filename);
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_storage(classifier, storage);
+   expected = bayes_classifier_new();
+   for (i = 0; i < G_N_ELEMENTS(docs); i++) {
+      bayes_classifier_train(expected, docs[i][0], docs[i][1]);
+   }
+
+   /*
+    * The tokens of the document are fetched with a single query, however
+    * many classifications there are.
+    */
+   bayes_storage_sqlite_get_cache_stats(BAYES_STORAGE_SQLITE(storage), NULL, NULL, &before);
+   guesses = bayes_classifier_guess(classifier, "the quick zorro saute uber the hund");
+   bayes_storage_sqlite_get_cache_stats(BAYES_STORAGE_SQLITE(storage), &hits, &misses, &queries);
+   g_assert_cmpint(queries - before, ==, 1);
+   g_assert_cmpint(misses, ==, 6);
+   g_assert_cmpint(hits, >=, 4 * 7);
+
+   other = bayes_classifier_guess(expected, "the quick zorro saute uber the hund");
+   g_assert_cmpint(g_list_length(guesses), ==, g_list_length(other));
+   for (iter = guesses, iter2 = other; iter; iter = iter->next, iter2 = iter2->next) {
+      g_assert_cmpstr(bayes_guess_get_name(iter->data), ==, bayes_guess_get_name(iter2->data));
+      g_assert_cmpfloat(bayes_guess_get_probability(iter->data), ==,
+                        bayes_guess_get_probability(iter2->data));
+   }
+   g_list_free_full(guesses, (GDestroyNotify)bayes_guess_unref);
+   g_list_free_full(other, (GDestroyNotify)bayes_guess_unref);
+
+   /*
+    * Without a cache, every lookup is a query of its own.
+    */
+   bayes_storage_sqlite_set_cache_size(BAYES_STORAGE_SQLITE(storage), 0);
+   g_assert_cmpfloat(bayes_storage_get_class_token_probability(storage, 0, "fox"), ==,
+                     bayes_storage_get_class_token_probability(bayes_classifier_get_storage(expected), 0, "fox"));
+   bayes_storage_sqlite_get_cache_stats(BAYES_STORAGE_SQLITE(storage), NULL, NULL, &before);
+   g_assert_cmpint(before, ==, queries + 1);
+
+   g_object_unref(classifier);
+   g_object_unref(expected);
+   g_object_unref(storage);
+   remove_database(filename);
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   g_test_init(&argc, &argv, NULL);
+   g_type_init();
+
+   g_test_add_func("/Storage/Sqlite/counts", test1);
+   g_test_add_func("/Storage/Sqlite/batch", test2);
+   g_test_add_func("/Storage/Sqlite/prefetch", test3);
+
+   return g_test_run();
+}
@@ -0,0 +1,975 @@
+/* bayes-tool.c
+ *
+ * Copyright (C) 2012 Christian Hergert <chris@dronelabs.com>
+ *
+ * This file is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * bayes-tool trains, evaluates and runs classifiers on corpora too large
+ * to be worth a harness of their own. Documents are read from files
+ * mapped into memory, files are loaded on worker threads and tokenized
+ * with bayes_classifier_train_batch() and bayes_classifier_guess_batch(),
+ * which use every processor. The throughput is reported on stderr.
+ *
+ * A source of training documents is one of:
+ *
+ *   FILE        One document per line, as the label, a tab and the text.
+ *   DIR         Every subdirectory is a label and every file below it a
+ *               document. Maildirs work as they are, only their tmp
+ *               directories are skipped.
+ *   LABEL=PATH  Every file below the directory PATH, or the file PATH
+ *               itself, is a document of LABEL.
+ *
+ * Models are saved as a delta of all training, which can be loaded and
+ * trained further, or as a read-only compact snapshot for scoring.
+ */
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bayes-glib/bayes-batch-result.h"
+#include "bayes-glib/bayes-classifier.h"
+#include "bayes-glib/bayes-evaluation.h"
+#include "bayes-glib/bayes-storage-compact.h"
+#include "bayes-glib/bayes-storage-memory.h"
+
+#define DEFAULT_BATCH_SIZE 4096
+
+typedef void (*ParallelFunc) (guint    index,
+                              gpointer user_data);
+
+typedef struct
+{
+   volatile gint cursor;
+   guint         n_items;
+   ParallelFunc  func;
+   gpointer      user_data;
+   GMutex        mutex;
+   GCond         cond;
+   guint         n_running;
+} ParallelJob;
+
+/*
+ * Documents read but not yet trained or classified. texts[i] is NULL
+ * until the file at paths[i] is loaded by batch_load().
+ */
+typedef struct
+{
+   GPtrArray *names;
+   GPtrArray *texts;
+   GPtrArray *paths;
+   guint      n_unloaded;
+} Batch;
+
+typedef void (*BatchFunc) (Batch    *batch,
+                           gpointer  user_data);
+
+typedef struct
+{
+   Batch     *batch;
+   guint      batch_size;
+   BatchFunc  func;
+   gpointer   user_data;
+   guint64    n_documents;
+} Reader;
+
+static gint         gThreads;
+static gint         gBatchSize = DEFAULT_BATCH_SIZE;
+static gchar       *gModel;
+static GThreadPool *gPool;
+
+static GOptionEntry gCommonEntries[] = {
+   { "threads", 'j', 0, G_OPTION_ARG_INT, &gThreads,
+     "Number of worker threads, all processors by default", "N" },
+   { "batch-size", 0, 0, G_OPTION_ARG_INT, &gBatchSize,
+     "Number of documents handed to the classifier at once", "N" },
+   { NULL }
+};
+
+static void
+parallel_run (ParallelJob *job)
+{
+   guint i;
+
+   while ((i = g_atomic_int_add(&job->cursor, 1)) < job->n_items) {
+      job->func(i, job->user_data);
+   }
+}
+
+static void
+parallel_worker (gpointer data,
+                 gpointer user_data)
+{
+   ParallelJob *job = data;
+
+   parallel_run(job);
+
+   g_mutex_lock(&job->mutex);
+   if (!--job->n_running) {
+      g_cond_signal(&job->cond);
+   }
+   g_mutex_unlock(&job->mutex);
+}
+
+/*
+ * Calls @func for every index below @n_items on up to gThreads threads,
+ * including the calling one. The other threads are started once and
+ * shared by every call.
+ */
+static void
+parallel_for (guint        n_items,
+              ParallelFunc func,
+              gpointer     user_data)
+{
+   ParallelJob job = { 0, n_items, func, user_data };
+   guint n_threads;
+   guint i;
+
+   n_threads = MIN(n_items, (guint)gThreads);
+
+   if (n_threads > 1 && !gPool) {
+      gPool = g_thread_pool_new(parallel_worker, NULL, gThreads - 1,
+                                TRUE, NULL);
+   }
+
+   g_mutex_init(&job.mutex);
+   g_cond_init(&job.cond);
+   job.n_running = n_threads ? n_threads - 1 : 0;
+
+   for (i = 1; i < n_threads; i++) {
+      g_thread_pool_push(gPool, &job, NULL);
+   }
+
+   parallel_run(&job);
+
+   /*
+    * @job lives on this stack, so wait for every worker to let go of it
+    * rather than only for the items to be done.
+    */
+   g_mutex_lock(&job.mutex);
+   while (job.n_running) {
+      g_cond_wait(&job.cond, &job.mutex);
+   }
+   g_mutex_unlock(&job.mutex);
+
+   g_mutex_clear(&job.mutex);
+   g_cond_clear(&job.cond);
+}
+
+static gchar *
+load_file (const gchar  *path,
+           GError      **error)
+{
+   GMappedFile *mapped;
+   gchar *ret;
+
+   if (!(mapped = g_mapped_file_new(path, FALSE, error))) {
+      return NULL;
+   }
+
+   ret = g_strndup(g_mapped_file_get_contents(mapped),
+                   g_mapped_file_get_length(mapped));
+   g_mapped_file_unref(mapped);
+
+   return ret;
+}
+
+static Batch *
+batch_new (void)
+{
+   Batch *batch;
+
+   batch = g_slice_new0(Batch);
+   batch->names = g_ptr_array_new_with_free_func(g_free);
+   batch->texts = g_ptr_array_new_with_free_func(g_free);
+   batch->paths = g_ptr_array_new_with_free_func(g_free);
+
+   return batch;
+}
+
+static void
+batch_clear (Batch *batch)
+{
+   g_ptr_array_set_size(batch->names, 0);
+   g_ptr_array_set_size(batch->texts, 0);
+   g_ptr_array_set_size(batch->paths, 0);
+   batch->n_unloaded = 0;
+}
+
+static void
+batch_free (Batch *batch)
+{
+   g_ptr_array_unref(batch->names);
+   g_ptr_array_unref(batch->texts);
+   g_ptr_array_unref(batch->paths);
+   g_slice_free(Batch, batch);
+}
+
+static void
+batch_add_text (Batch *batch,
+                gchar *name,
+                gchar *text)
+{
+   g_ptr_array_add(batch->names, name);
+   g_ptr_array_add(batch->texts, text);
+   g_ptr_array_add(batch->paths, NULL);
+}
+
+static void
+batch_add_path (Batch *batch,
+                gchar *name,
+                gchar *path)
+{
+   g_ptr_array_add(batch->names, name);
+   g_ptr_array_add(batch->texts, NULL);
+   g_ptr_array_add(batch->paths, path);
+   batch->n_unloaded++;
+}
+
+static void
+batch_load_worker (guint    index,
+                   gpointer user_data)
+{
+   Batch *batch = user_data;
+   GError *error = NULL;
+   const gchar *path;
+   gchar *text;
+
+   if ((path = g_ptr_array_index(batch->paths, index)) &&
+       !g_ptr_array_index(batch->texts, index)) {
+      if (!(text = load_file(path, &error))) {
+         g_printerr("%s\n", error->message);
+         g_error_free(error);
+         text = g_strdup("");
+      }
+      g_ptr_array_index(batch->texts, index) = text;
+   }
+}
+
+/*
+ * Loads the files of @batch on worker threads.
+ */
+static void
+batch_load (Batch *batch)
+{
+   if (batch->n_unloaded) {
+      parallel_for(batch->texts->len, batch_load_worker, batch);
+      batch->n_unloaded = 0;
+   }
+}
+
+/*
+ * Returns the names of @batch as a NULL terminated array, which is valid
+ * until @batch is modified.
+ */
+static const gchar * const *
+batch_get_names (Batch *batch)
+{
+   g_ptr_array_add(batch->names, NULL);
+   g_ptr_array_set_size(batch->names, batch->names->len - 1);
+   return (const gchar * const *)batch->names->pdata;
+}
+
+static const gchar * const *
+batch_get_texts (Batch *batch)
+{
+   g_ptr_array_add(batch->texts, NULL);
+   g_ptr_array_set_size(batch->texts, batch->texts->len - 1);
+   return (const gchar * const *)batch->texts->pdata;
+}
+
+static void
+reader_init (Reader    *reader,
+             guint      batch_size,
+             BatchFunc  func,
+             gpointer   user_data)
+{
+   memset(reader, 0, sizeof *reader);
+   reader->batch = batch_new();
+   reader->batch_size = batch_size;
+   reader->func = func;
+   reader->user_data = user_data;
+}
+
+/*
+ * Hands the documents read so far to the callback once there are
+ * enough of them, or at all if @force is set.
+ */
+static void
+reader_flush (Reader   *reader,
+              gboolean  force)
+{
+   Batch *batch = reader->batch;
+
+   if (batch->names->len &&
+       (force || batch->names->len >= reader->batch_size)) {
+      batch_load(batch);
+      reader->n_documents += batch->names->len;
+      if (reader->func) {
+         reader->func(batch, reader->user_data);
+         batch_clear(batch);
+      }
+   }
+}
+
+static void
+reader_destroy (Reader *reader)
+{
+   batch_free(reader->batch);
+}
+
+/*
+ * Calls @func for every line of @data, without the line break.
+ */
+static void
+foreach_line (const gchar *data,
+              gsize        length,
+              void       (*func) (const gchar *line,
+                                  gsize        length,
+                                  gpointer     user_data),
+              gpointer     user_data)
+{
+   const gchar *end = data + length;
+   const gchar *eol;
+   gsize len;
+
+   while (data < end) {
+      if (!(eol = memchr(data, '\n', end - data))) {
+         eol = end;
+      }
+      len = eol - data;
+      if (len && data[len - 1] == '\r') {
+         len--;
+      }
+      func(data, len, user_data);
+      data = eol + 1;
+   }
+}
+
+static void
+reader_add_line (const gchar *line,
+                 gsize        length,
+                 gpointer     user_data)
+{
+   Reader *reader = user_data;
+   const gchar *tab;
+
+   if (!(tab = memchr(line, '\t', length)) || tab == line) {
+      return;
+   }
+
+   batch_add_text(reader->batch,
+                  g_strndup(line, tab - line),
+                  g_strndup(tab + 1, line + length - tab - 1));
+   reader_flush(reader, FALSE);
+}
+
+static gboolean
+reader_add_lines (Reader       *reader,
+                  const gchar  *filename,
+                  GError      **error)
+{
+   GMappedFile *mapped;
+
+   if (!(mapped = g_mapped_file_new(filename, FALSE, error))) {
+      return FALSE;
+   }
+
+   foreach_line(g_mapped_file_get_contents(mapped),
+                g_mapped_file_get_length(mapped),
+                reader_add_line, reader);
+   g_mapped_file_unref(mapped);
+
+   return TRUE;
+}
+
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+   return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/*
+ * Lists the entries of @dirname in sorted order, so that documents are
+ * read in the same order on every run, skipping hidden ones.
+ */
+static GPtrArray *
+list_directory (const gchar  *dirname,
+                GError      **error)
+{
+   const gchar *name;
+   GPtrArray *ret;
+   GDir *dir;
+
+   if (!(dir = g_dir_open(dirname, 0, error))) {
+      return NULL;
+   }
+
+   ret = g_ptr_array_new_with_free_func(g_free);
+   while ((name = g_dir_read_name(dir))) {
+      if (name[0] != '.') {
+         g_ptr_array_add(ret, g_build_filename(dirname, name, NULL));
+      }
+   }
+   g_dir_close(dir);
+
+   g_ptr_array_sort(ret, compare_strings);
+
+   return ret;
+}
+
+/*
+ * Adds every file below @path, or @path itself, as a document of @label.
+ */
+static gboolean
+reader_add_files (Reader       *reader,
+                  const gchar  *label,
+                  const gchar  *path,
+                  GError      **error)
+{
+   GPtrArray *entries;
+   gchar *basename;
+   gboolean skip;
+   guint i;
+
+   if (!g_file_test(path, G_FILE_TEST_IS_DIR)) {
+      batch_add_path(reader->batch, g_strdup(label), g_strdup(path));
+      reader_flush(reader, FALSE);
+      return TRUE;
+   }
+
+   if (!(entries = list_directory(path, error))) {
+      return FALSE;
+   }
+
+   for (i = 0; i < entries->len; i++) {
+      basename = g_path_get_basename(g_ptr_array_index(entries, i));
+      skip = g_str_equal(basename, "tmp") &&
+             g_file_test(g_ptr_array_index(entries, i), G_FILE_TEST_IS_DIR);
+      g_free(basename);
+
+      if (!skip &&
+          !reader_add_files(reader, label, g_ptr_array_index(entries, i),
+                            error)) {
+         g_ptr_array_unref(entries);
+         return FALSE;
+      }
+   }
+
+   g_ptr_array_unref(entries);
+
+   return TRUE;
+}
+
+static gboolean
+reader_add_source (Reader       *reader,
+                   const gchar  *source,
+                   GError      **error)
+{
+   GPtrArray *entries;
+   const gchar *equal;
+   gboolean ret = TRUE;
+   gchar *label;
+   guint i;
+
+   if (!g_file_test(source, G_FILE_TEST_EXISTS) &&
+       (equal = strchr(source, '='))) {
+      label = g_strndup(source, equal - source);
+      ret = reader_add_files(reader, label, equal + 1, error);
+      g_free(label);
+      return ret;
+   }
+
+   if (!g_file_test(source, G_FILE_TEST_IS_DIR)) {
+      return reader_add_lines(reader, source, error);
+   }
+
+   if (!(entries = list_directory(source, error))) {
+      return FALSE;
+   }
+
+   for (i = 0; ret && i < entries->len; i++) {
+      if (g_file_test(g_ptr_array_index(entries, i), G_FILE_TEST_IS_DIR)) {
+         label = g_path_get_basename(g_ptr_array_index(entries, i));
+         ret = reader_add_files(reader, label,
+                                g_ptr_array_index(entries, i), error);
+         g_free(label);
+      }
+   }
+
+   g_ptr_array_unref(entries);
+
+   return ret;
+}
+
+/*
+ * Loads a model saved by "train", either a compact snapshot or a delta
+ * that can be trained further.
+ */
+static BayesStorage *
+load_model (const gchar  *filename,
+            GError      **error)
+{
+   BayesStorage *storage;
+   GMappedFile *mapped;
+   GError *local_error = NULL;
+   GBytes *bytes;
+
+   if ((storage = bayes_storage_compact_new_from_file(filename,
+                                                      &local_error))) {
+      return storage;
+   }
+
+   if (!g_error_matches(local_error, BAYES_STORAGE_COMPACT_ERROR,
+                        BAYES_STORAGE_COMPACT_ERROR_INVALID)) {
+      g_propagate_error(error, local_error);
+      return NULL;
+   }
+
+   g_clear_error(&local_error);
+
+   if (!(mapped = g_mapped_file_new(filename, FALSE, error))) {
+      return NULL;
+   }
+
+   storage = bayes_storage_memory_new();
+   bayes_storage_memory_checkpoint(BAYES_STORAGE_MEMORY(storage));
+
+   bytes = g_bytes_new_with_free_func(g_mapped_file_get_contents(mapped),
+                                      g_mapped_file_get_length(mapped),
+                                      (GDestroyNotify)g_mapped_file_unref,
+                                      mapped);
+   if (!bayes_storage_import_delta(storage, bytes, error)) {
+      g_clear_object(&storage);
+   }
+   g_bytes_unref(bytes);
+
+   return storage;
+}
+
+static void
+report (const gchar *verb,
+        guint64      n_documents,
+        GTimer      *timer)
+{
+   gdouble elapsed;
+
+   elapsed = g_timer_elapsed(timer, NULL);
+   g_printerr("%s %" G_GUINT64_FORMAT " documents in %.2f s "
+              "(%.0f docs/s)\n",
+              verb, n_documents, elapsed,
+              n_documents / MAX(elapsed, 1e-9));
+}
+
+/*
+ * Parses the options of a command. The thread count must be known
+ * before the classifier starts its worker threads.
+ */
+static gboolean
+parse_options (const gchar   *parameter_string,
+               GOptionEntry  *entries,
+               gint          *argc,
+               gchar       ***argv)
+{
+   GOptionContext *context;
+   GError *error = NULL;
+   gchar *threads;
+
+   context = g_option_context_new(parameter_string);
+   g_option_context_add_main_entries(context, gCommonEntries, NULL);
+   g_option_context_add_main_entries(context, entries, NULL);
+
+   if (!g_option_context_parse(context, argc, argv, &error)) {
+      g_printerr("%s\n", error->message);
+      g_error_free(error);
+      g_option_context_free(context);
+      return FALSE;
+   }
+
+   g_option_context_free(context);
+
+   if (gBatchSize < 1) {
+      g_printerr("--batch-size must be at least 1\n");
+      return FALSE;
+   }
+
+   if (gThreads > 0) {
+      threads = g_strdup_printf("%d", gThreads);
+      g_setenv("BAYES_THREADS", threads, TRUE);
+      g_free(threads);
+   } else {
+      gThreads = MAX(1, g_get_num_processors());
+   }
+
+   return TRUE;
+}
+
+static void
+train_batch (Batch    *batch,
+             gpointer  user_data)
+{
+   bayes_classifier_train_batch(user_data, batch_get_names(batch),
+                                batch_get_texts(batch));
+}
+
+static gint
+command_train (gint    argc,
+               gchar **argv)
+{
+   BayesClassifier *classifier;
+   BayesStorage *storage = NULL;
+   BayesStorage *compact;
+   GError *error = NULL;
+   gchar *compact_filename = NULL;
+   gchar *output = NULL;
+   GBytes *bytes;
+   GTimer *timer;
+   Reader reader;
+   gint bits = 16;
+   gint ret = EXIT_FAILURE;
+   gint i;
+   GOptionEntry entries[] = {
+      { "model", 'm', 0, G_OPTION_ARG_FILENAME, &gModel,
+        "Continue training the model in FILE", "FILE" },
+      { "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+        "Save the model to FILE", "FILE" },
+      { "compact", 'c', 0, G_OPTION_ARG_FILENAME, &compact_filename,
+        "Save a compact snapshot of the model to FILE", "FILE" },
+      { "bits", 0, 0, G_OPTION_ARG_INT, &bits,
+        "Bits per value of the compact snapshot, 8 or 16", "BITS" },
+      { NULL }
+   };
+
+   if (!parse_options("SOURCE... - train a model", entries, &argc, &argv)) {
+      return EXIT_FAILURE;
+   }
+
+   if (argc < 2) {
+      g_printerr("No source to train from\n");
+      return EXIT_FAILURE;
+   }
+
+   if (gModel) {
+      if (!(storage = load_model(gModel, &error))) {
+         goto failure;
+      }
+      if (!BAYES_IS_STORAGE_MEMORY(storage)) {
+         g_printerr("%s is a compact snapshot and cannot be trained\n",
+                    gModel);
+         goto cleanup;
+      }
+   } else {
+      storage = bayes_storage_memory_new();
+      bayes_storage_memory_checkpoint(BAYES_STORAGE_MEMORY(storage));
+   }
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_storage(classifier, storage);
+
+   timer = g_timer_new();
+   reader_init(&reader, gBatchSize, train_batch, classifier);
+   for (i = 1; i < argc; i++) {
+      if (!reader_add_source(&reader, argv[i], &error)) {
+         break;
+      }
+   }
+   reader_flush(&reader, TRUE);
+   report("trained", reader.n_documents, timer);
+   reader_destroy(&reader);
+   g_timer_destroy(timer);
+   g_object_unref(classifier);
+
+   if (error) {
+      goto failure;
+   }
+
+   if (output) {
+      bytes = bayes_storage_memory_export_delta(BAYES_STORAGE_MEMORY(storage));
+      if (!g_file_set_contents(output, g_bytes_get_data(bytes, NULL),
+                               g_bytes_get_size(bytes), &error)) {
+         g_bytes_unref(bytes);
+         goto failure;
+      }
+      g_bytes_unref(bytes);
+   }
+
+   if (compact_filename) {
+      if (!(compact = bayes_storage_compact_new(storage, bits, &error))) {
+         goto failure;
+      }
+      if (!bayes_storage_compact_save(BAYES_STORAGE_COMPACT(compact),
+                                      compact_filename, &error)) {
+         g_object_unref(compact);
+         goto failure;
+      }
+      g_object_unref(compact);
+   }
+
+   ret = EXIT_SUCCESS;
+   goto cleanup;
+
+failure:
+   g_printerr("%s\n", error->message);
+   g_error_free(error);
+
+cleanup:
+   g_clear_object(&storage);
+   g_free(output);
+   g_free(compact_filename);
+
+   return ret;
+}
+
+/*
+ * Prints the best classification of every document of @batch in order,
+ * prefixed with its name if @batch has names.
+ */
+static void
+classify_batch (Batch    *batch,
+                gpointer  user_data)
+{
+   BayesBatchResult *result;
+   const gchar *name;
+   guint i;
+   gint best;
+
+   result = bayes_classifier_guess_batch(user_data, batch_get_texts(batch));
+
+   for (i = 0; i < batch->texts->len; i++) {
+      if ((name = g_ptr_array_index(batch->names, i))) {
+         fputs(name, stdout);
+         fputc('\t', stdout);
+      }
+      if ((best = bayes_batch_result_get_best(result, i)) >= 0) {
+         printf("%s\t%.4f\n", bayes_batch_result_get_best_name(result, i),
+                bayes_batch_result_get_score(result, i, best));
+      } else {
+         fputs("-\t0.0000\n", stdout);
+      }
+   }
+
+   bayes_batch_result_unref(result);
+}
+
+static void
+classify_add_line (const gchar *line,
+                   gsize        length,
+                   gpointer     user_data)
+{
+   Reader *reader = user_data;
+
+   batch_add_text(reader->batch, NULL, g_strndup(line, length));
+   reader_flush(reader, FALSE);
+}
+
+static gint
+command_classify (gint    argc,
+                  gchar **argv)
+{
+   BayesClassifier *classifier;
+   BayesStorage *storage;
+   GMappedFile *mapped;
+   GError *error = NULL;
+   gboolean files = FALSE;
+   GTimer *timer;
+   Reader reader;
+   gchar *line = NULL;
+   gsize size = 0;
+   gssize length;
+   gint ret = EXIT_SUCCESS;
+   gint i;
+   GOptionEntry entries[] = {
+      { "model", 'm', 0, G_OPTION_ARG_FILENAME, &gModel,
+        "Classify with the model in FILE", "FILE" },
+      { "files", 'f', 0, G_OPTION_ARG_NONE, &files,
+        "Classify each FILE as a whole instead of line by line", NULL },
+      { NULL }
+   };
+
+   if (!parse_options("[FILE...] - classify documents", entries, &argc,
+                      &argv)) {
+      return EXIT_FAILURE;
+   }
+
+   if (!gModel) {
+      g_printerr("No model given, use --model\n");
+      return EXIT_FAILURE;
+   }
+
+   if (!(storage = load_model(gModel, &error))) {
+      g_printerr("%s\n", error->message);
+      g_error_free(error);
+      return EXIT_FAILURE;
+   }
+
+   classifier = bayes_classifier_new();
+   bayes_classifier_set_storage(classifier, storage);
+   g_object_unref(storage);
+
+   timer = g_timer_new();
+   reader_init(&reader, gBatchSize, classify_batch, classifier);
+
+   if (argc < 2 && !files) {
+      while ((length = getline(&line, &size, stdin)) > 0) {
+         if (line[length - 1] == '\n') {
+            length--;
+         }
+         classify_add_line(line, length, &reader);
+      }
+      free(line);
+   }
+
+   for (i = 1; i < argc; i++) {
+      if (files) {
+         batch_add_path(reader.batch, g_strdup(argv[i]), g_strdup(argv[i]));
+         reader_flush(&reader, FALSE);
+      } else if ((mapped = g_mapped_file_new(argv[i], FALSE, &error))) {
+         foreach_line(g_mapped_file_get_contents(mapped),
+                      g_mapped_file_get_length(mapped),
+                      classify_add_line, &reader);
+         g_mapped_file_unref(mapped);
+      } else {
+         g_printerr("%s\n", error->message);
+         g_clear_error(&error);
+         ret = EXIT_FAILURE;
+      }
+   }
+
+   reader_flush(&reader, TRUE);
+   fflush(stdout);
+   report("classified", reader.n_documents, timer);
+
+   reader_destroy(&reader);
+   g_timer_destroy(timer);
+   g_object_unref(classifier);
+
+   return ret;
+}
+
+static gint
+command_evaluate (gint    argc,
+                  gchar **argv)
+{
+   BayesClassifier *classifier;
+   BayesEvaluation *evaluation;
+   GError *error = NULL;
+   Reader reader;
+   gchar *str;
+   gint n_folds = 5;
+   gint ret = EXIT_FAILURE;
+   gint i;
+   GOptionEntry entries[] = {
+      { "folds", 'k', 0, G_OPTION_ARG_INT, &n_folds,
+        "Number of folds, at least 2", "K" },
+      { NULL }
+   };
+
+   if (!parse_options("SOURCE... - cross validate on labelled documents",
+                      entries, &argc, &argv)) {
+      return EXIT_FAILURE;
+   }
+
+   if (argc < 2) {
+      g_printerr("No source to evaluate on\n");
+      return EXIT_FAILURE;
+   }
+
+   reader_init(&reader, G_MAXUINT, NULL, NULL);
+   for (i = 1; i < argc; i++) {
+      if (!reader_add_source(&reader, argv[i], &error)) {
+         g_printerr("%s\n", error->message);
+         g_error_free(error);
+         reader_destroy(&reader);
+         return EXIT_FAILURE;
+      }
+   }
+   reader_flush(&reader, TRUE);
+
+   if (n_folds < 2 || reader.n_documents < (guint64)n_folds) {
+      g_printerr("Need at least 2 folds and a document per fold\n");
+   } else {
+      classifier = bayes_classifier_new();
+      evaluation = bayes_evaluation_new(classifier,
+                                        batch_get_names(reader.batch),
+                                        batch_get_texts(reader.batch),
+                                        n_folds);
+      str = bayes_evaluation_to_string(evaluation);
+      fputs(str, stdout);
+      g_free(str);
+      bayes_evaluation_unref(evaluation);
+      g_object_unref(classifier);
+      ret = EXIT_SUCCESS;
+   }
+
+   reader_destroy(&reader);
+
+   return ret;
+}
+
+static const struct
+{
+   const gchar *name;
+   gint       (*func) (gint    argc,
+                       gchar **argv);
+   const gchar *summary;
+} gCommands[] = {
+   { "train", command_train, "Train a model from labelled documents" },
+   { "classify", command_classify, "Classify documents with a model" },
+   { "evaluate", command_evaluate, "Cross validate on labelled documents" },
+};
+
+static void
+usage (void)
+{
+   guint i;
+
+   g_printerr("Usage:\n  bayes-tool COMMAND [OPTION...]\n\nCommands:\n");
+   for (i = 0; i < G_N_ELEMENTS(gCommands); i++) {
+      g_printerr("  %-10s %s\n", gCommands[i].name, gCommands[i].summary);
+   }
+   g_printerr("\nRun \"bayes-tool COMMAND --help\" for its options.\n");
+}
+
+gint
+main (gint   argc,
+      gchar *argv[])
+{
+   gchar *prgname;
+   guint i;
+   gint ret;
+
+   if (argc >= 2) {
+      for (i = 0; i < G_N_ELEMENTS(gCommands); i++) {
+         if (g_str_equal(argv[1], gCommands[i].name)) {
+            prgname = g_strdup_printf("bayes-tool %s", argv[1]);
+            g_set_prgname(prgname);
+            g_free(prgname);
+            g_type_init();
+            ret = gCommands[i].func(argc - 1, argv + 1);
+            if (gPool) {
+               g_thread_pool_free(gPool, FALSE, TRUE);
+            }
+            return ret;
+         }
+      }
+   }
+
+   usage();
+
+   return EXIT_FAILURE;
+}